@@ -0,0 +1,320 @@
+/*!
+ * @file Arduino.cpp
+ *
+ * Host implementation of the minimal Arduino core in `Arduino.h`.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ */
+
+#include "Arduino.h"
+
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+
+HardwareSerial Serial;
+
+// ----------------------------
+// ----- Timing functions -----
+// ----------------------------
+
+static uint64_t monotonicMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000ULL + (uint64_t) ts.tv_nsec / 1000ULL;
+}
+
+static const uint64_t startMicros = monotonicMicros();
+
+unsigned long millis() {
+    return (unsigned long) ((monotonicMicros() - startMicros) / 1000ULL);
+}
+
+unsigned long micros() {
+    return (unsigned long) (monotonicMicros() - startMicros);
+}
+
+static bool skipDelays = false;
+
+void delay(unsigned long ms) {
+    if (!skipDelays) usleep((useconds_t) ms * 1000);
+}
+
+void nativeSkipDelays(bool skip) {
+    skipDelays = skip;
+}
+
+void yield() {}
+
+long random(long max) {
+    return max > 0 ? (long) (rand() % max) : 0;
+}
+
+long random(long min, long max) {
+    return max > min ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed) {
+    srand((unsigned int) seed);
+}
+
+// ----------------------------
+// ---------- String ----------
+// ----------------------------
+
+String::String(const char* cstr) : _buf(nullptr), _len(0), _cap(0) {
+    assign(cstr ? cstr : "", cstr ? strlen(cstr) : 0);
+}
+
+String::String(const char* cstr, size_t len) : _buf(nullptr), _len(0), _cap(0) {
+    assign(cstr, len);
+}
+
+String::String(const String& other) : _buf(nullptr), _len(0), _cap(0) {
+    assign(other.c_str(), other._len);
+}
+
+String::String(const __FlashStringHelper* str) : _buf(nullptr), _len(0), _cap(0) {
+    const char* cstr = reinterpret_cast<const char*>(str);
+    assign(cstr ? cstr : "", cstr ? strlen(cstr) : 0);
+}
+
+String::String(char c) : _buf(nullptr), _len(0), _cap(0) {
+    assign(&c, 1);
+}
+
+static void formatUnsigned(char* out, unsigned long long value, unsigned char base) {
+    char tmp[66];
+    size_t n = 0;
+    if (base < 2 || base > 16) base = 10;
+    do {
+        tmp[n++] = "0123456789abcdef"[value % base];
+        value /= base;
+    } while (value);
+    for (size_t i = 0; i < n; ++i) out[i] = tmp[n - 1 - i];
+    out[n] = '\0';
+}
+
+static void formatSigned(char* out, long long value, unsigned char base) {
+    if (value < 0 && base == 10) {
+        out[0] = '-';
+        formatUnsigned(out + 1, (unsigned long long) (-(value + 1)) + 1, base);
+    } else {
+        formatUnsigned(out, (unsigned long long) value, base);
+    }
+}
+
+#define TR064_NATIVE_NUMBER_CTOR(type, formatter, cast) \
+    String::String(type value, unsigned char base) : _buf(nullptr), _len(0), _cap(0) { \
+        char tmp[68]; \
+        formatter(tmp, (cast) value, base); \
+        assign(tmp, strlen(tmp)); \
+    }
+
+TR064_NATIVE_NUMBER_CTOR(unsigned char, formatUnsigned, unsigned long long)
+TR064_NATIVE_NUMBER_CTOR(int, formatSigned, long long)
+TR064_NATIVE_NUMBER_CTOR(unsigned int, formatUnsigned, unsigned long long)
+TR064_NATIVE_NUMBER_CTOR(long, formatSigned, long long)
+TR064_NATIVE_NUMBER_CTOR(unsigned long, formatUnsigned, unsigned long long)
+TR064_NATIVE_NUMBER_CTOR(long long, formatSigned, long long)
+TR064_NATIVE_NUMBER_CTOR(unsigned long long, formatUnsigned, unsigned long long)
+
+String::String(float value, unsigned char decimals) : _buf(nullptr), _len(0), _cap(0) {
+    char tmp[64];
+    snprintf(tmp, sizeof(tmp), "%.*f", (int) decimals, (double) value);
+    assign(tmp, strlen(tmp));
+}
+
+String::String(double value, unsigned char decimals) : _buf(nullptr), _len(0), _cap(0) {
+    char tmp[64];
+    snprintf(tmp, sizeof(tmp), "%.*f", (int) decimals, value);
+    assign(tmp, strlen(tmp));
+}
+
+String::~String() {
+    free(_buf);
+}
+
+String& String::operator=(const String& rhs) {
+    if (this != &rhs) assign(rhs.c_str(), rhs._len);
+    return *this;
+}
+
+String& String::operator=(const char* cstr) {
+    assign(cstr ? cstr : "", cstr ? strlen(cstr) : 0);
+    return *this;
+}
+
+String& String::operator=(const __FlashStringHelper* str) {
+    return *this = reinterpret_cast<const char*>(str);
+}
+
+bool String::reserve(size_t size) {
+    if (_buf && _cap >= size) return true;
+    char* buf = (char*) realloc(_buf, size + 1);
+    if (!buf) return false;
+    if (!_buf) buf[0] = '\0';
+    _buf = buf;
+    _cap = size;
+    return true;
+}
+
+void String::assign(const char* cstr, size_t len) {
+    if (len == 0 && !_buf) {
+        // Like the Arduino core, empty strings do not allocate.
+        _len = 0;
+        return;
+    }
+    if (!reserve(len)) return;
+    memmove(_buf, cstr, len);
+    _buf[len] = '\0';
+    _len = len;
+}
+
+bool String::concat(const char* cstr, size_t len) {
+    if (len == 0) return true;
+    size_t newLen = _len + len;
+    if (newLen > _cap && !reserve(newLen > 2 * _cap ? newLen : 2 * _cap)) return false;
+    memcpy(_buf + _len, cstr, len);
+    _len = newLen;
+    _buf[_len] = '\0';
+    return true;
+}
+
+bool String::concat(const String& s) {
+    if (&s == this) {
+        String copy(s);
+        return concat(copy.c_str(), copy._len);
+    }
+    return concat(s.c_str(), s._len);
+}
+
+bool String::concat(const char* cstr) {
+    return cstr ? concat(cstr, strlen(cstr)) : false;
+}
+
+bool String::concat(char c) {
+    return concat(&c, 1);
+}
+
+bool String::equals(const String& s) const {
+    return _len == s._len && memcmp(c_str(), s.c_str(), _len) == 0;
+}
+
+bool String::equals(const char* cstr) const {
+    return strcmp(c_str(), cstr ? cstr : "") == 0;
+}
+
+bool String::equalsIgnoreCase(const String& s) const {
+    return _len == s._len && strncasecmp(c_str(), s.c_str(), _len) == 0;
+}
+
+bool String::startsWith(const String& prefix) const {
+    return prefix._len <= _len && memcmp(c_str(), prefix.c_str(), prefix._len) == 0;
+}
+
+bool String::endsWith(const String& suffix) const {
+    return suffix._len <= _len && memcmp(c_str() + _len - suffix._len, suffix.c_str(), suffix._len) == 0;
+}
+
+char String::charAt(size_t index) const {
+    return index < _len ? _buf[index] : '\0';
+}
+
+int String::indexOf(char c, size_t from) const {
+    if (from >= _len) return -1;
+    const char* p = (const char*) memchr(_buf + from, c, _len - from);
+    return p ? (int) (p - _buf) : -1;
+}
+
+int String::indexOf(const String& s, size_t from) const {
+    if (from > _len) return -1;
+    const char* p = strstr(c_str() + from, s.c_str());
+    return p ? (int) (p - c_str()) : -1;
+}
+
+String String::substring(size_t from) const {
+    return substring(from, _len);
+}
+
+String String::substring(size_t from, size_t to) const {
+    if (from > to) { size_t t = from; from = to; to = t; }
+    if (from >= _len) return String();
+    if (to > _len) to = _len;
+    return String(_buf + from, to - from);
+}
+
+void String::toLowerCase() {
+    for (size_t i = 0; i < _len; ++i) _buf[i] = (char) tolower((unsigned char) _buf[i]);
+}
+
+void String::toUpperCase() {
+    for (size_t i = 0; i < _len; ++i) _buf[i] = (char) toupper((unsigned char) _buf[i]);
+}
+
+void String::trim() {
+    if (!_len) return;
+    size_t begin = 0, end = _len;
+    while (begin < end && isspace((unsigned char) _buf[begin])) ++begin;
+    while (end > begin && isspace((unsigned char) _buf[end - 1])) --end;
+    memmove(_buf, _buf + begin, end - begin);
+    _len = end - begin;
+    _buf[_len] = '\0';
+}
+
+long String::toInt() const {
+    return atol(c_str());
+}
+
+float String::toFloat() const {
+    return (float) atof(c_str());
+}
+
+String operator+(const String& lhs, const String& rhs) { String s(lhs); s.concat(rhs); return s; }
+String operator+(const String& lhs, const char* rhs) { String s(lhs); s.concat(rhs); return s; }
+String operator+(const char* lhs, const String& rhs) { String s(lhs); s.concat(rhs); return s; }
+String operator+(const String& lhs, char rhs) { String s(lhs); s.concat(rhs); return s; }
+String operator+(const String& lhs, int rhs) { return lhs + String(rhs); }
+String operator+(const String& lhs, unsigned int rhs) { return lhs + String(rhs); }
+String operator+(const String& lhs, long rhs) { return lhs + String(rhs); }
+String operator+(const String& lhs, unsigned long rhs) { return lhs + String(rhs); }
+
+// ----------------------------
+// ----------- Print ----------
+// ----------------------------
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+}
+
+size_t Print::printf(const char* format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len < 0) return 0;
+    if ((size_t) len < sizeof(buf)) return write(buf, (size_t) len);
+    char* big = (char*) malloc((size_t) len + 1);
+    if (!big) return 0;
+    va_start(args, format);
+    vsnprintf(big, (size_t) len + 1, format, args);
+    va_end(args);
+    size_t n = write(big, (size_t) len);
+    free(big);
+    return n;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    return fwrite(buffer, 1, size, stdout);
+}
+
+void HardwareSerial::flush() {
+    fflush(stdout);
+}
@@ -0,0 +1,198 @@
+/*!
+ * @file Arduino.h
+ *
+ * Minimal host (Linux) stand-in for the parts of the Arduino core used by
+ * the TR-064 library: `String`, `Print`, `Serial`, the flash-string helpers
+ * and the timing functions. Only used by the native CMake build, never by
+ * the Arduino IDE.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ */
+
+#ifndef tr064_native_arduino_h
+#define tr064_native_arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HEX 16
+#define DEC 10
+#define OCT 8
+#define BIN 2
+
+// Flash strings live in normal memory on the host.
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strncasecmp_P strncasecmp
+#define memcpy_P memcpy
+#define strncpy_P strncpy
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+
+class __FlashStringHelper;
+#define FPSTR(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+#define F(s) FPSTR(PSTR(s))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void nativeSkipDelays(bool skip); // Host only: `delay()` returns at once, e.g. in benchmarks
+void yield();
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+/// Host only: heap accounting of the whole process, see heap.cpp (glibc
+/// only, the counters stay 0 elsewhere).
+struct NativeHeapCounters {
+    uint64_t allocs;    ///< Allocations (malloc, calloc, realloc, operator new)
+    uint64_t bytes;     ///< Bytes requested by them
+    int64_t current;    ///< Usable bytes in use
+    int64_t peak;       ///< Highest `current`, may be reset by the caller
+};
+NativeHeapCounters& nativeHeap();
+
+/**************************************************************************/
+/*!
+    @brief  Heap-backed string with the subset of the Arduino `String` API
+            the library relies on.
+*/
+/**************************************************************************/
+class String {
+    public:
+        String(const char* cstr = "");
+        String(const char* cstr, size_t len);
+        String(const String& other);
+        String(const __FlashStringHelper* str);
+        explicit String(char c);
+        explicit String(unsigned char value, unsigned char base = 10);
+        explicit String(int value, unsigned char base = 10);
+        explicit String(unsigned int value, unsigned char base = 10);
+        explicit String(long value, unsigned char base = 10);
+        explicit String(unsigned long value, unsigned char base = 10);
+        explicit String(long long value, unsigned char base = 10);
+        explicit String(unsigned long long value, unsigned char base = 10);
+        explicit String(float value, unsigned char decimals = 2);
+        explicit String(double value, unsigned char decimals = 2);
+        ~String();
+
+        String& operator=(const String& rhs);
+        String& operator=(const char* cstr);
+        String& operator=(const __FlashStringHelper* str);
+
+        bool reserve(size_t size);
+        size_t length() const { return _len; }
+        const char* c_str() const { return _buf ? _buf : ""; }
+
+        bool concat(const String& s);
+        bool concat(const char* cstr);
+        bool concat(const char* cstr, size_t len);
+        bool concat(char c);
+        String& operator+=(const String& rhs) { concat(rhs); return *this; }
+        String& operator+=(const char* cstr) { concat(cstr); return *this; }
+        String& operator+=(char c) { concat(c); return *this; }
+        String& operator+=(int v) { concat(String(v)); return *this; }
+        String& operator+=(unsigned int v) { concat(String(v)); return *this; }
+        String& operator+=(long v) { concat(String(v)); return *this; }
+        String& operator+=(unsigned long v) { concat(String(v)); return *this; }
+
+        bool equals(const String& s) const;
+        bool equals(const char* cstr) const;
+        bool equalsIgnoreCase(const String& s) const;
+        bool operator==(const String& rhs) const { return equals(rhs); }
+        bool operator==(const char* cstr) const { return equals(cstr); }
+        bool operator!=(const String& rhs) const { return !equals(rhs); }
+        bool operator!=(const char* cstr) const { return !equals(cstr); }
+        bool startsWith(const String& prefix) const;
+        bool endsWith(const String& suffix) const;
+
+        char charAt(size_t index) const;
+        char operator[](size_t index) const { return charAt(index); }
+        int indexOf(char c, size_t from = 0) const;
+        int indexOf(const String& s, size_t from = 0) const;
+        String substring(size_t from) const;
+        String substring(size_t from, size_t to) const;
+
+        void toLowerCase();
+        void toUpperCase();
+        void trim();
+        long toInt() const;
+        float toFloat() const;
+
+    private:
+        char* _buf;
+        size_t _len;
+        size_t _cap;
+        void assign(const char* cstr, size_t len);
+};
+
+String operator+(const String& lhs, const String& rhs);
+String operator+(const String& lhs, const char* rhs);
+String operator+(const char* lhs, const String& rhs);
+String operator+(const String& lhs, char rhs);
+String operator+(const String& lhs, int rhs);
+String operator+(const String& lhs, unsigned int rhs);
+String operator+(const String& lhs, long rhs);
+String operator+(const String& lhs, unsigned long rhs);
+inline bool operator==(const char* lhs, const String& rhs) { return rhs.equals(lhs); }
+inline bool operator!=(const char* lhs, const String& rhs) { return !rhs.equals(lhs); }
+
+/**************************************************************************/
+/*!
+    @brief  Output sink with the usual `print`/`println`/`printf` helpers.
+*/
+/**************************************************************************/
+class Print {
+    public:
+        virtual ~Print() {}
+        virtual size_t write(uint8_t c) = 0;
+        virtual size_t write(const uint8_t* buffer, size_t size);
+        size_t write(const char* str) { return str ? write((const uint8_t*) str, strlen(str)) : 0; }
+        size_t write(const char* buffer, size_t size) { return write((const uint8_t*) buffer, size); }
+        virtual void flush() {}
+
+        size_t print(const String& s) { return write(s.c_str(), s.length()); }
+        size_t print(const char* s) { return write(s); }
+        size_t print(const __FlashStringHelper* s) { return write(reinterpret_cast<const char*>(s)); }
+        size_t print(char c) { return write((uint8_t) c); }
+        size_t print(int n, int base = DEC) { return print(String(n, (unsigned char) base)); }
+        size_t print(unsigned int n, int base = DEC) { return print(String(n, (unsigned char) base)); }
+        size_t print(long n, int base = DEC) { return print(String(n, (unsigned char) base)); }
+        size_t print(unsigned long n, int base = DEC) { return print(String(n, (unsigned char) base)); }
+        size_t print(double n, int digits = 2) { return print(String(n, (unsigned char) digits)); }
+        size_t println() { return write("\r\n"); }
+        template<typename T> size_t println(const T& v) { size_t n = print(v); return n + println(); }
+        size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+/**************************************************************************/
+/*!
+    @brief  Serial port stand-in writing to stdout.
+*/
+/**************************************************************************/
+class HardwareSerial : public Print {
+    public:
+        void begin(unsigned long) {}
+        void setDebugOutput(bool) {}
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t* buffer, size_t size) override;
+        void flush() override;
+        operator bool() const { return true; }
+        using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif
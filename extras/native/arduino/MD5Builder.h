@@ -0,0 +1,35 @@
+/*!
+ * @file MD5Builder.h
+ *
+ * Host stand-in for the ESP8266/ESP32 `MD5Builder` (RFC 1321), used by the
+ * native CMake build only.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ */
+
+#ifndef tr064_native_md5builder_h
+#define tr064_native_md5builder_h
+
+#include "Arduino.h"
+
+class MD5Builder {
+    public:
+        void begin();
+        void add(const uint8_t* data, uint16_t len);
+        void add(const char* data) { add((const uint8_t*) data, (uint16_t) strlen(data)); }
+        void add(const String& data) { add((const uint8_t*) data.c_str(), (uint16_t) data.length()); }
+        void calculate();
+        void getBytes(uint8_t* output) const;
+        void getChars(char* output) const;
+        String toString() const;
+
+    private:
+        void transform(const uint8_t block[64]);
+
+        uint32_t _state[4];
+        uint64_t _count;
+        uint8_t _buffer[64];
+        uint8_t _digest[16];
+};
+
+#endif
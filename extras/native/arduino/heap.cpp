@@ -0,0 +1,65 @@
+/*!
+ * @file heap.cpp
+ *
+ * Host heap accounting, see `nativeHeap()`: malloc and friends are
+ * interposed (glibc), which also covers operator new and the native String.
+ * The object file is only linked into programs that call `nativeHeap()`.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ */
+
+#include "Arduino.h"
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+static NativeHeapCounters heap;
+
+NativeHeapCounters& nativeHeap() {
+    return heap;
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void __libc_free(void* p);
+
+static void noteAlloc(void* p, size_t size) {
+    if (!p) return;
+    ++heap.allocs;
+    heap.bytes += size;
+    heap.current += (int64_t) malloc_usable_size(p);
+    if (heap.current > heap.peak) heap.peak = heap.current;
+}
+
+void* malloc(size_t size) {
+    void* p = __libc_malloc(size);
+    noteAlloc(p, size);
+    return p;
+}
+
+void* calloc(size_t n, size_t size) {
+    void* p = __libc_calloc(n, size);
+    noteAlloc(p, n * size);
+    return p;
+}
+
+void* realloc(void* p, size_t size) {
+    int64_t old = p ? (int64_t) malloc_usable_size(p) : 0;
+    void* q = __libc_realloc(p, size);
+    if (q) {
+        heap.current -= old;
+        noteAlloc(q, size);
+    }
+    return q;
+}
+
+void free(void* p) {
+    if (p) heap.current -= (int64_t) malloc_usable_size(p);
+    __libc_free(p);
+}
+}
+#endif
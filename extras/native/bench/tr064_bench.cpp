@@ -0,0 +1,330 @@
+/*
+ * tr064_bench.cpp
+ *
+ * Microbenchmarks of the hot paths of the library, run natively against
+ * recorded responses of a device (extras/native/fixtures/bench, recorded
+ * with `tr064_fake_router --record DIR` or `curl -i`). A replaying transport
+ * answers each request with the next recorded response, so the complete
+ * path of an action (envelope, authentication, HTTP, parsing) is measured
+ * without sockets. For each benchmark it reports the time per operation,
+ * the heap allocations and allocated bytes per operation and the peak heap
+ * above the level before the benchmark.
+ *
+ * Usage: tr064_bench [--filter TEXT] [--time MS] [--fixtures DIR]
+ *                    [--save FILE] [--baseline FILE [--tolerance PCT]]
+ *
+ * --save writes the results as a baseline; --baseline compares against one
+ * and exits with 1 if a benchmark got slower by more than --tolerance
+ * percent (default 20) or allocates more (count, bytes or peak) than before.
+ * Times depend on the machine, allocations do not: --tolerance -1 only
+ * compares the allocations, e.g. against the committed baseline.txt.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ */
+
+#include <tr064.h>
+#include <tr064_descriptors.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Heap accounting of the native core (nativeHeap(), interposed malloc).
+NativeHeapCounters& heap = nativeHeap();
+
+// ---------------------------------------------------------------------------
+// Replaying transport
+// ---------------------------------------------------------------------------
+
+/* Answers each request with the next response of a list (cycling). */
+class ReplayTransport : public TR064Transport {
+    public:
+        void play(const std::vector<const std::string*>& responses) {
+            _responses = responses;
+            _index = 0;
+            _pos = 0;
+            _reading = false;
+        }
+        bool connect(const char* host, uint16_t port) override { (void) host; (void) port; return true; }
+        bool connected() override { return true; }
+        size_t write(const uint8_t* data, size_t len) override {
+            (void) data;
+            if (_reading) {
+                // A new request: serve the next response
+                _reading = false;
+                _index = (_index + 1) % _responses.size();
+                _pos = 0;
+            }
+            return len;
+        }
+        int read(uint8_t* buf, size_t len, uint32_t timeout) override {
+            (void) timeout;
+            _reading = true;
+            const std::string& r = *_responses[_index];
+            size_t n = std::min(len, r.size() - _pos);
+            memcpy(buf, r.data() + _pos, n);
+            _pos += n;
+            return (int) n;
+        }
+        void stop() override {}
+
+    private:
+        std::vector<const std::string*> _responses;
+        size_t _index = 0;
+        size_t _pos = 0;
+        bool _reading = false;
+};
+
+/* Discards a request body. */
+class NullSink : public TR064ByteSink {
+    public:
+        bool write(const char* data, size_t len) override { (void) data; bytes += len; return true; }
+        size_t bytes = 0;
+};
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+struct Result {
+    std::string name;
+    uint64_t iterations;
+    double ns;
+    double allocs;
+    double bytes;
+    int64_t peak;
+};
+
+struct Options {
+    std::string filter;
+    std::string fixtures = TR064_BENCH_FIXTURES_DIR;
+    std::string save;
+    std::string baseline;
+    double tolerance = 20;
+    int timeMs = 200;
+};
+
+Options opt;
+std::vector<Result> results;
+bool failed = false;
+
+/* Runs `op` (returning its success) often enough to take --time ms. */
+template <class Op>
+void bench(const char* name, Op op) {
+    if (!opt.filter.empty() && std::string(name).find(opt.filter) == std::string::npos) return;
+    if (!op()) {
+        printf("%-28s FAILED\n", name);
+        failed = true;
+        return;
+    }
+    typedef std::chrono::steady_clock Clock;
+    uint64_t n = 1;
+    while (true) {
+        NativeHeapCounters before = heap;
+        heap.peak = heap.current;
+        Clock::time_point start = Clock::now();
+        for (uint64_t i = 0; i < n; ++i) op();
+        double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        if (elapsed >= opt.timeMs * 1e6 || n >= (1ull << 32)) {
+            Result r;
+            r.name = name;
+            r.iterations = n;
+            r.ns = elapsed / n;
+            r.allocs = (double) (heap.allocs - before.allocs) / n;
+            r.bytes = (double) (heap.bytes - before.bytes) / n;
+            r.peak = heap.peak - before.current;
+            results.push_back(r);
+            printf("%-28s %10llu %12.0f ns/op %8.1f allocs/op %10.0f B/op %8lld B peak\n", name,
+                   (unsigned long long) n, r.ns, r.allocs, r.bytes, (long long) r.peak);
+            return;
+        }
+        // Aim at the target time, at most 10x more per round
+        double factor = elapsed > 0 ? opt.timeMs * 1e6 * 1.2 / elapsed : 10;
+        n = (uint64_t) (n * std::min(std::max(factor, 2.0), 10.0));
+    }
+}
+
+std::string readFixture(const char* name) {
+    std::ifstream in(opt.fixtures + "/" + name, std::ios::binary);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    if (ss.str().empty()) {
+        fprintf(stderr, "missing fixture %s/%s\n", opt.fixtures.c_str(), name);
+        exit(2);
+    }
+    return ss.str();
+}
+
+bool saveBaseline(const std::string& path) {
+    std::ofstream out(path);
+    out << "# tr064_bench baseline: name ns/op allocs/op bytes/op peak\n";
+    for (const Result& r : results) {
+        out << r.name << " " << r.ns << " " << r.allocs << " " << r.bytes << " " << r.peak << "\n";
+    }
+    return (bool) out;
+}
+
+/* Compares the results with a baseline. Returns false on a regression. */
+bool compareBaseline(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        fprintf(stderr, "cannot read baseline %s\n", path.c_str());
+        return false;
+    }
+    std::map<std::string, Result> base;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream ss(line);
+        Result r;
+        if (ss >> r.name >> r.ns >> r.allocs >> r.bytes >> r.peak) base[r.name] = r;
+    }
+    bool ok = true;
+    printf("\n%-28s %9s %9s %9s %9s\n", "vs. baseline", "time", "allocs", "bytes", "peak");
+    for (const Result& r : results) {
+        auto it = base.find(r.name);
+        if (it == base.end()) {
+            printf("%-28s (new)\n", r.name.c_str());
+            continue;
+        }
+        const Result& b = it->second;
+        double dt = b.ns > 0 ? (r.ns / b.ns - 1) * 100 : 0;
+        bool slower = opt.tolerance >= 0 && dt > opt.tolerance;
+        // Allocations are deterministic, any increase counts (with some slack for rounding)
+        bool heavier = r.allocs > b.allocs + 0.05 || r.bytes > b.bytes + 0.5 || r.peak > b.peak;
+        printf("%-28s %+8.1f%% %+9.1f %+9.0f %+9lld%s\n", r.name.c_str(), dt, r.allocs - b.allocs, r.bytes - b.bytes,
+               (long long) (r.peak - b.peak), slower || heavier ? "  REGRESSION" : "");
+        ok = ok && !slower && !heavier;
+    }
+    return ok;
+}
+
+void usage(const char* argv0) {
+    fprintf(stderr,
+            "Usage: %s [--filter TEXT] [--time MS] [--fixtures DIR]\n"
+            "          [--save FILE] [--baseline FILE [--tolerance PCT]]\n", argv0);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (a == "--filter" && hasValue) opt.filter = argv[++i];
+        else if (a == "--time" && hasValue) opt.timeMs = atoi(argv[++i]);
+        else if (a == "--fixtures" && hasValue) opt.fixtures = argv[++i];
+        else if (a == "--save" && hasValue) opt.save = argv[++i];
+        else if (a == "--baseline" && hasValue) opt.baseline = argv[++i];
+        else if (a == "--tolerance" && hasValue) opt.tolerance = atof(argv[++i]);
+        else { usage(argv[0]); return 2; }
+    }
+    nativeSkipDelays(true);
+
+    const std::string descSmall = readFixture("tr64desc_small.http");
+    const std::string desc = readFixture("tr64desc.http");
+    const std::string challenge = readFixture("challenge.http");
+    const std::string hostEntry = readFixture("GetSpecificHostEntry.http");
+    const std::string fault = readFixture("fault_714.http");
+    const std::string hostListPath = readFixture("GetHostListPath.http");
+    const std::string hostList = readFixture("hostlist_250.http");
+
+    ReplayTransport replay;
+    TR064 connection(49000, "192.168.178.1", "admin", "admin");
+    connection.setTransport(replay);
+
+    // Description of the device
+    replay.play({&descSmall});
+    bench("init/tr64desc_small", [&]() { connection.init(); return connection.state() >= 0; });
+    replay.play({&desc});
+    bench("init/tr64desc", [&]() { connection.init(); return connection.state() >= 0; });
+
+    // Actions (on the full description, also if the init benchmarks were
+    // filtered out); the first call obtains the challenge
+    replay.play({&desc});
+    connection.init();
+    replay.play({&challenge, &hostEntry});
+    String warmup[][2] = {{"NewActive", ""}};
+    String mac[][2] = {{"NewMACAddress", "02:00:00:00:00:01"}};
+    connection.action("Hosts:1", "GetSpecificHostEntry", mac, 1, warmup, 1);
+    replay.play({&hostEntry});
+    bench("action/string", [&]() {
+        String req[][2] = {{"NewIPAddress", ""}, {"NewAddressSource", ""}, {"NewLeaseTimeRemaining", ""},
+                           {"NewInterfaceType", ""}, {"NewActive", ""}, {"NewHostName", ""}};
+        return connection.action("Hosts:1", "GetSpecificHostEntry", mac, 1, req, 6);
+    });
+    bench("action/typed", [&]() {
+        char ip[16], source[8], type[16], name[32];
+        int32_t lease;
+        bool active;
+        TR064Output out[] = {TR064Output::text("NewIPAddress", ip, sizeof(ip)),
+                             TR064Output::text("NewAddressSource", source, sizeof(source)),
+                             TR064Output::int32("NewLeaseTimeRemaining", &lease),
+                             TR064Output::text("NewInterfaceType", type, sizeof(type)),
+                             TR064Output::boolean("NewActive", &active),
+                             TR064Output::text("NewHostName", name, sizeof(name))};
+        return connection.action("Hosts:1", "GetSpecificHostEntry", mac, 1, out, 6);
+    });
+    bench("action/descriptor", [&]() {
+        char ip[16], source[8], type[16], name[32];
+        int32_t lease;
+        bool active;
+        return connection.action<TR064Actions::Hosts1::GetSpecificHostEntry>("02:00:00:00:00:01", &ip, &source, &lease,
+                                                                             &type, &active, &name);
+    });
+    replay.play({&fault});
+    bench("action/fault_500", [&]() {
+        String req[][2] = {{"NewActive", ""}};
+        // The fault is the expected outcome
+        return !connection.action("Hosts:1", "GetSpecificHostEntry", mac, 1, req, 1);
+    });
+    replay.play({&hostListPath, &hostList});
+    bench("hosts/fetch_250", [&]() {
+        TR064HostTable table;
+        return connection.fetchHosts(table) && table.size() == 250;
+    });
+
+    // Building blocks
+    TR064SoapArg args[] = {{"NewMACAddress", "02:00:00:00:00:01"}};
+    bench("envelope/write", [&]() {
+        TR064SoapEnvelope envelope("Hosts:1", "GetSpecificHostEntry", args, 1);
+        envelope.setClientAuth("admin", "F!Box SOAP-Auth", "A67F13303F0AA8BF", "0123456789abcdef0123456789abcdef");
+        NullSink sink;
+        return envelope.writeTo(sink) && sink.bytes == envelope.length();
+    });
+    TR064AuthSession session;
+    session.setRealm("F!Box SOAP-Auth", "admin", "admin");
+    bench("auth/token", [&]() {
+        TR064SoapEnvelope envelope("Hosts:1", "GetSpecificHostEntry", args, 1);
+        session.setNonce("A67F13303F0AA8BF");
+        session.prepare(envelope, "admin");
+        return session.ready();
+    });
+    bench("auth/secret", [&]() {
+        TR064AuthSession fresh;
+        fresh.setRealm("F!Box SOAP-Auth", "admin", "admin");
+        return fresh.secret()[0] != '\0';
+    });
+    bench("services/find", [&]() { return connection.services().find("X_AVM-DE_Homeauto:1") != nullptr; });
+    bench("legacy/md5String", [&]() { return connection.md5String("admin:F!Box SOAP-Auth:admin").length() == 32; });
+    bench("legacy/byte2hex", [&]() { return connection.byte2hex(0x0a).length() == 2; });
+
+#if !defined(__GLIBC__)
+    printf("(heap accounting needs glibc, allocations are not counted)\n");
+#endif
+    bool ok = !failed;
+    if (!opt.save.empty() && !saveBaseline(opt.save)) {
+        fprintf(stderr, "cannot write %s\n", opt.save.c_str());
+        ok = false;
+    }
+    if (!opt.baseline.empty() && !compareBaseline(opt.baseline)) {
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,1182 @@
+/*
+ * fake_router.cpp
+ *
+ * A small stand-in for a FRITZ!Box TR-064 endpoint, used to run and profile
+ * the library natively on Linux. It serves the device description from the
+ * fixtures directory and answers a handful of SOAP actions with simulated
+ * data, including the SOAP digest authentication of TR-064. Services can
+ * be subscribed to (UPnP GENA): the subscribers get NOTIFY requests with a
+ * simulated change of the state every --notify-interval ms. With
+ * --tls-port, HTTPS is served there too, with a self-signed certificate
+ * made at start (built with OpenSSL only). The call list, the phonebook and
+ * the answering machine messages are served as files like a FRITZ!Box does,
+ * with --calls N simulated calls.
+ *
+ * Usage: tr064_fake_router [--port 49000] [--user admin] [--pass admin]
+ *                          [--fixtures DIR] [--latency MS] [--connect-latency MS]
+ *                          [--hosts N] [--host-base N] [--no-keepalive] [--max-requests N]
+ *                          [--idle-timeout MS] [--chunked] [--no-etag]
+ *                          [--nonce-ttl S] [--record DIR] [--verbose]
+ *                          [--notify-interval MS] [--event-timeout S]
+ *                          [--tls-port N] [--tls-cert FILE] [--tls12]
+ *                          [--calls N] [--contacts N]
+ *
+ * MIT License, all text here must be included in any redistribution.
+ */
+
+#include <MD5Builder.h>
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <mutex>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#ifdef FAKE_ROUTER_TLS
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#endif
+
+#ifndef TR064_FIXTURES_DIR
+#define TR064_FIXTURES_DIR "extras/native/fixtures"
+#endif
+
+namespace {
+
+struct Options {
+    int port = 49000;
+    std::string user = "admin";
+    std::string pass = "admin";
+    std::string realm = "F!Box SOAP-Auth";
+    std::string fixtures = TR064_FIXTURES_DIR;
+    int latencyMs = 0;
+    int connectLatencyMs = 0;
+    int idleTimeoutMs = 0;
+    int hosts = 24;
+    int hostBase = 0;       // Number of the first host, so that several instances (a mesh) have different hosts
+    bool keepAlive = true;
+    int maxRequests = 0;
+    bool chunked = false;
+    bool etag = true;
+    int nonceTtl = 60;
+    std::string record;     // Directory to save each response to, see record()
+    bool verbose = false;
+    int notifyIntervalMs = 1000; // Period of the simulated state changes sent to subscribers (0: none)
+    int eventTimeout = 1800;     // Longest subscription granted (s)
+    int tlsPort = 0;        // Port of the HTTPS front end (0: none)
+    std::string tlsCert;    // File to save its certificate to (PEM)
+    bool tls12 = false;     // Offer TLS 1.2 only (session IDs instead of tickets, like BearSSL)
+    int calls = 500;        // Calls in the call list, one every 73 minutes back from the start
+    int contacts = 100;     // Contacts in the phonebook
+};
+
+Options opt;
+
+struct Request {
+    std::string method;
+    std::string path;
+    std::string version;
+    std::map<std::string, std::string> headers; // lower-case names
+    std::string body;
+
+    std::string header(const std::string& name) const {
+        auto it = headers.find(name);
+        return it == headers.end() ? std::string() : it->second;
+    }
+};
+
+struct Response {
+    int code = 200;
+    std::string contentType = "text/xml; charset=\"utf-8\"";
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+    bool close = false;
+};
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+std::string md5Hex(const std::string& s) {
+    MD5Builder md5;
+    md5.begin();
+    md5.add((const uint8_t*) s.data(), (uint16_t) s.size());
+    md5.calculate();
+    char out[33];
+    md5.getChars(out);
+    return out;
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return std::string();
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+std::string lower(std::string s) {
+    for (auto& c : s) c = (char) tolower((unsigned char) c);
+    return s;
+}
+
+/* Content of the first element with the given local name (namespace prefixes ignored). */
+bool xmlValue(const std::string& xml, const std::string& tag, std::string& value) {
+    size_t pos = 0;
+    while ((pos = xml.find('<', pos)) != std::string::npos) {
+        size_t end = xml.find_first_of(" \t\r\n/>", pos + 1);
+        if (end == std::string::npos) return false;
+        std::string name = xml.substr(pos + 1, end - pos - 1);
+        size_t colon = name.find(':');
+        if (colon != std::string::npos) name = name.substr(colon + 1);
+        size_t close = xml.find('>', end);
+        if (close == std::string::npos) return false;
+        if (name == tag) {
+            if (xml[close - 1] == '/') { value.clear(); return true; }
+            size_t vend = xml.find('<', close + 1);
+            if (vend == std::string::npos) return false;
+            value = xml.substr(close + 1, vend - close - 1);
+            return true;
+        }
+        pos = close + 1;
+    }
+    return false;
+}
+
+bool xmlHas(const std::string& xml, const std::string& tag) {
+    std::string v;
+    return xmlValue(xml, tag, v);
+}
+
+std::string xmlEscape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        switch (c) {
+        case '&': out += "&amp;"; break;
+        case '<': out += "&lt;"; break;
+        case '>': out += "&gt;"; break;
+        case '"': out += "&quot;"; break;
+        default: out += c;
+        }
+    }
+    return out;
+}
+
+bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        sent += (size_t) n;
+    }
+    return true;
+}
+
+std::string randomHex(int n) {
+    static const char* digits = "0123456789ABCDEF";
+    std::string s;
+    for (int i = 0; i < n; ++i) s += digits[rand() % 16];
+    return s;
+}
+
+// ---------------------------------------------------------------------------
+// Simulated device state
+// ---------------------------------------------------------------------------
+
+struct Host {
+    std::string mac;
+    std::string ip;
+    std::string name;
+    std::string interfaceType;
+    bool active;
+    int band; // 0: LAN, 1..3: WLANConfiguration:N
+};
+
+std::vector<Host> hosts;
+std::string hostListSid; // Session id of the last X_AVM-DE_GetHostListPath
+std::string listSid;    // Session id of the last GetCallList, GetPhonebook or GetMessageList
+std::map<std::string, bool> switchStates;
+std::map<std::string, std::string> controlUrls; // serviceType -> controlURL
+std::map<std::string, std::string> eventUrls; // eventSubURL -> service name (first one announcing it)
+time_t started = time(nullptr);
+
+void initHosts() {
+    hosts.clear();
+    for (int n = 0; n < opt.hosts; ++n) {
+        int i = opt.hostBase + n;
+        Host h;
+        char buf[64];
+        snprintf(buf, sizeof(buf), "02:00:00:%02X:%02X:%02X", (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+        h.mac = buf;
+        snprintf(buf, sizeof(buf), "192.168.178.%d", 20 + i % 230);
+        h.ip = buf;
+        snprintf(buf, sizeof(buf), "host-%03d", i);
+        h.name = buf;
+        h.band = i % 4;
+        h.interfaceType = h.band == 0 ? "Ethernet" : "802.11";
+        h.active = (i % 5) != 4;
+        hosts.push_back(h);
+    }
+}
+
+void loadDescription() {
+    std::string desc = readFile(opt.fixtures + "/tr64desc.xml");
+    size_t pos = 0;
+    while ((pos = desc.find("<serviceType>", pos)) != std::string::npos) {
+        size_t end = desc.find("</serviceType>", pos);
+        std::string type = desc.substr(pos + 13, end - pos - 13);
+        size_t c = desc.find("<controlURL>", end);
+        size_t ce = desc.find("</controlURL>", c);
+        controlUrls[type] = desc.substr(c + 12, ce - c - 12);
+        size_t e = desc.find("<eventSubURL>", ce);
+        if (e != std::string::npos && e < desc.find("</service>", ce)) {
+            size_t ee = desc.find("</eventSubURL>", e);
+            eventUrls.emplace(desc.substr(e + 13, ee - e - 13), type.substr(type.rfind(':', type.size() - 3) + 1));
+        }
+        pos = ce;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// SOAP digest authentication
+// ---------------------------------------------------------------------------
+
+std::map<std::string, time_t> nonces; // Outstanding nonces and their issue time
+
+std::string issueNonce() {
+    time_t now = time(nullptr);
+    for (auto it = nonces.begin(); it != nonces.end();) {
+        if (now - it->second > opt.nonceTtl) it = nonces.erase(it); else ++it;
+    }
+    while (nonces.size() >= 64) nonces.erase(nonces.begin());
+    std::string n = randomHex(16);
+    nonces[n] = now;
+    return n;
+}
+
+enum class Auth { None, Init, Valid, Invalid };
+
+Auth checkAuth(const std::string& body) {
+    if (xmlHas(body, "InitChallenge")) return Auth::Init;
+    if (!xmlHas(body, "ClientAuth")) return Auth::None;
+    std::string nonce, auth, user, realm;
+    xmlValue(body, "Nonce", nonce);
+    xmlValue(body, "Auth", auth);
+    xmlValue(body, "UserID", user);
+    xmlValue(body, "Realm", realm);
+    auto it = nonces.find(nonce);
+    if (it == nonces.end() || time(nullptr) - it->second > opt.nonceTtl) return Auth::Invalid;
+    std::string secret = md5Hex(opt.user + ":" + opt.realm + ":" + opt.pass);
+    if (user != opt.user || lower(auth) != md5Hex(secret + ":" + nonce)) return Auth::Invalid;
+    nonces.erase(it);
+    return Auth::Valid;
+}
+
+std::string authHeader(const char* element, const char* status) {
+    std::ostringstream ss;
+    ss << "<s:Header>\n<h:" << element
+       << " xmlns:h=\"http://soap-authentication.org/digest/2001/10/\" s:mustUnderstand=\"1\">\n"
+       << "<Status>" << status << "</Status>\n"
+       << "<Nonce>" << issueNonce() << "</Nonce>\n"
+       << "<Realm>" << opt.realm << "</Realm>\n"
+       << "</h:" << element << ">\n</s:Header>\n";
+    return ss.str();
+}
+
+const char* envelopeStart =
+    "<?xml version=\"1.0\"?>\n"
+    "<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+    "s:encodingStyle=\"http://schemas.xmlsoap.org/soap/encoding/\">\n";
+
+std::string faultBody(int code, const std::string& description) {
+    std::ostringstream ss;
+    ss << "<s:Body>\n<s:Fault>\n<faultcode>s:Client</faultcode>\n<faultstring>UPnPError</faultstring>\n"
+       << "<detail>\n<UPnPError xmlns=\"urn:dslforum-org:control-1-0\">\n"
+       << "<errorCode>" << code << "</errorCode>\n"
+       << "<errorDescription>" << description << "</errorDescription>\n"
+       << "</UPnPError>\n</detail>\n</s:Fault>\n</s:Body>\n";
+    return ss.str();
+}
+
+// ---------------------------------------------------------------------------
+// Actions
+// ---------------------------------------------------------------------------
+
+typedef std::vector<std::pair<std::string, std::string>> Args;
+
+struct ActionError {
+    int code;
+    std::string description;
+};
+
+std::string arg(const std::string& body, const char* name) {
+    std::string v;
+    xmlValue(body, name, v);
+    return v;
+}
+
+const Host* hostByMac(const std::string& mac) {
+    for (const auto& h : hosts) {
+        if (lower(h.mac) == lower(mac)) return &h;
+    }
+    return nullptr;
+}
+
+std::vector<const Host*> wlanHosts(int band) {
+    std::vector<const Host*> v;
+    for (const auto& h : hosts) {
+        if (h.band == band && h.active) v.push_back(&h);
+    }
+    return v;
+}
+
+int indexArg(const std::string& body, const char* name) {
+    std::string v = arg(body, name);
+    return v.empty() ? -1 : atoi(v.c_str());
+}
+
+/* Executes an action, fills `out` or throws an `ActionError`. */
+void runAction(const std::string& service, const std::string& action, const std::string& body, Args& out) {
+    std::string svc = service.substr(0, service.find(':'));
+    int instance = atoi(service.substr(service.find(':') + 1).c_str());
+
+    if (svc == "DeviceInfo" && action == "GetInfo") {
+        out = {{"NewManufacturerName", "AVM"}, {"NewManufacturerOUI", "00040E"},
+               {"NewModelName", "FRITZ!Box 7590"}, {"NewDescription", "FRITZ!Box 7590 154.07.57"},
+               {"NewProductClass", "AVMFB"}, {"NewSerialNumber", "3431C4000000"},
+               {"NewSoftwareVersion", "154.07.57"}, {"NewHardwareVersion", "FRITZ!Box 7590"},
+               {"NewSpecVersion", "1.0"}, {"NewProvisioningCode", ""},
+               {"NewUpTime", std::to_string(time(nullptr) - started)},
+               {"NewDeviceLog", "Log &amp; more"}};
+    } else if (svc == "DeviceInfo" && action == "GetSecurityPort") {
+        out = {{"NewSecurityPort", "49443"}};
+    } else if (svc == "WLANConfiguration" && action == "GetTotalAssociations") {
+        out = {{"NewTotalAssociations", std::to_string(wlanHosts(instance).size())}};
+    } else if (svc == "WLANConfiguration" && action == "GetGenericAssociatedDeviceInfo") {
+        auto list = wlanHosts(instance);
+        int idx = indexArg(body, "NewAssociatedDeviceIndex");
+        if (idx < 0 || idx >= (int) list.size()) throw ActionError{713, "SpecifiedArrayIndexInvalid"};
+        const Host* h = list[idx];
+        out = {{"NewAssociatedDeviceMACAddress", h->mac}, {"NewAssociatedDeviceIPAddress", h->ip},
+               {"NewAssociatedDeviceAuthState", "1"}, {"NewX_AVM-DE_Speed", "866"},
+               {"NewX_AVM-DE_SignalStrength", "70"}};
+    } else if (svc == "WLANConfiguration" && action == "GetSpecificAssociatedDeviceInfo") {
+        const Host* h = hostByMac(arg(body, "NewAssociatedDeviceMACAddress"));
+        if (!h || h->band != instance || !h->active) throw ActionError{714, "NoSuchEntryInArray"};
+        out = {{"NewAssociatedDeviceIPAddress", h->ip}, {"NewAssociatedDeviceAuthState", "1"},
+               {"NewX_AVM-DE_Speed", "866"}, {"NewX_AVM-DE_SignalStrength", "70"}};
+    } else if (svc == "Hosts" && action == "GetHostNumberOfEntries") {
+        out = {{"NewHostNumberOfEntries", std::to_string(hosts.size())}};
+    } else if (svc == "Hosts" && (action == "GetSpecificHostEntry" || action == "GetGenericHostEntry")) {
+        const Host* h = nullptr;
+        if (action == "GetGenericHostEntry") {
+            int idx = indexArg(body, "NewIndex");
+            if (idx < 0 || idx >= (int) hosts.size()) throw ActionError{713, "SpecifiedArrayIndexInvalid"};
+            h = &hosts[idx];
+        } else {
+            h = hostByMac(arg(body, "NewMACAddress"));
+            if (!h) throw ActionError{714, "NoSuchEntryInArray"};
+        }
+        if (action == "GetGenericHostEntry") out.push_back({"NewMACAddress", h->mac});
+        out.push_back({"NewIPAddress", h->ip});
+        out.push_back({"NewAddressSource", "DHCP"});
+        out.push_back({"NewLeaseTimeRemaining", "0"});
+        out.push_back({"NewInterfaceType", h->interfaceType});
+        out.push_back({"NewActive", h->active ? "1" : "0"});
+        out.push_back({"NewHostName", h->name});
+    } else if (svc == "Hosts" && action == "X_AVM-DE_GetHostListPath") {
+        hostListSid = randomHex(8);
+        out = {{"NewX_AVM-DE_HostListPath", "/devicehostlist.lua?sid=" + hostListSid}};
+    } else if (svc == "X_AVM-DE_Homeauto" && action == "GetSpecificDeviceInfos") {
+        std::string ain = arg(body, "NewAIN");
+        if (ain.empty()) throw ActionError{402, "Invalid Args"};
+        unsigned seed = 0;
+        for (char c : ain) seed = seed * 31 + (unsigned char) c;
+        bool on = switchStates.count(ain) ? switchStates[ain] : true;
+        out = {{"NewDeviceId", std::to_string(16 + seed % 100)}, {"NewFunctionBitMask", "35712"},
+               {"NewFirmwareVersion", "04.25"}, {"NewManufacturer", "AVM"},
+               {"NewProductName", "FRITZ!DECT 210"}, {"NewDeviceName", "Plug " + ain},
+               {"NewPresent", "CONNECTED"}, {"NewMultimeterIsEnabled", "ENABLED"},
+               {"NewMultimeterIsValid", "VALID"},
+               {"NewMultimeterPower", on ? std::to_string(1000 + seed % 200000) : "0"},
+               {"NewMultimeterEnergy", std::to_string(seed % 1000000)},
+               {"NewTemperatureIsEnabled", "ENABLED"}, {"NewTemperatureIsValid", "VALID"},
+               {"NewTemperatureCelsius", "215"}, {"NewTemperatureOffset", "0"},
+               {"NewSwitchIsEnabled", "ENABLED"}, {"NewSwitchIsValid", "VALID"},
+               {"NewSwitchState", on ? "ON" : "OFF"}, {"NewSwitchMode", "MANUAL"},
+               {"NewSwitchLock", "0"}};
+    } else if (svc == "X_AVM-DE_Homeauto" && action == "SetSwitch") {
+        std::string ain = arg(body, "NewAIN"), state = arg(body, "NewSwitchState");
+        if (ain.empty() || state.empty()) throw ActionError{402, "Invalid Args"};
+        bool on = switchStates.count(ain) ? switchStates[ain] : true;
+        switchStates[ain] = state == "TOGGLE" ? !on : state == "ON";
+    } else if (svc == "WANCommonInterfaceConfig" && action == "GetTotalBytesSent") {
+        out = {{"NewTotalBytesSent", std::to_string(1234567890u + (time(nullptr) - started) * 1000)}};
+    } else if (svc == "WANCommonInterfaceConfig" && action == "GetTotalBytesReceived") {
+        out = {{"NewTotalBytesReceived", std::to_string(3456789012u + (time(nullptr) - started) * 5000)}};
+    } else if (svc == "WANCommonInterfaceConfig" && action == "X_AVM-DE_GetOnlineMonitor") {
+        out = {{"NewTotalNumberSyncGroups", "1"}, {"NewSyncgroupName", "sync_dsl"},
+               {"NewSyncgroupMode", "VDSL"}, {"Newmax_ds", "13964375"}, {"Newmax_us", "5029375"},
+               {"Newds_current_bps", "44,14,10"}, {"Newmc_current_bps", "0,0,0"},
+               {"Newus_current_bps", "26,2,3"}};
+    } else if (svc == "X_AVM-DE_TAM" && action == "GetInfo") {
+        out = {{"NewEnable", "1"}, {"NewName", "Answering machine"}, {"NewTAMRunning", "1"},
+               {"NewStick", "0"}, {"NewStatus", "0"}, {"NewCapacity", "180"}};
+    } else if (svc == "X_AVM-DE_TAM" && action == "GetMessageList") {
+        if (indexArg(body, "NewIndex") != 0) throw ActionError{713, "SpecifiedArrayIndexInvalid"};
+        listSid = randomHex(16);
+        out = {{"NewURL", "https://fritz.box:49443/download.lua?path=/data/tam/meta0&amp;sid=" + listSid}};
+    } else if (svc == "X_AVM-DE_OnTel" && action == "GetCallList") {
+        listSid = randomHex(16);
+        out = {{"NewCallListURL", "https://fritz.box:49443/calllist.lua?sid=" + listSid}};
+    } else if (svc == "X_AVM-DE_OnTel" && action == "GetPhonebook") {
+        if (indexArg(body, "NewPhonebookID") != 0) throw ActionError{713, "SpecifiedArrayIndexInvalid"};
+        listSid = randomHex(16);
+        out = {{"NewPhonebookName", "Telefonbuch"}, {"NewPhonebookExtraID", ""},
+               {"NewPhonebookURL", "https://fritz.box:49443/phonebook.lua?sid=" + listSid + "&amp;pbid=0"}};
+    } else if (svc == "X_AVM-DE_TAM" && action == "SetEnable") {
+        if (arg(body, "NewEnable").empty()) throw ActionError{402, "Invalid Args"};
+    } else if (svc == "X_VoIP" && action == "X_AVM-DE_DialNumber") {
+        if (arg(body, "NewX_AVM-DE_PhoneNumber").empty()) throw ActionError{402, "Invalid Args"};
+    } else if (svc == "WLANConfiguration" && action == "SetEnable") {
+        if (arg(body, "NewEnable").empty()) throw ActionError{402, "Invalid Args"};
+    } else {
+        throw ActionError{401, "Invalid Action"};
+    }
+}
+
+bool noAuthAction(const std::string& action) {
+    return action == "GetSecurityPort";
+}
+
+Response handleSoap(const Request& req) {
+    Response res;
+    std::string soapaction = req.header("soapaction");
+    if (!soapaction.empty() && soapaction.front() == '"') soapaction = soapaction.substr(1, soapaction.size() - 2);
+    size_t hash = soapaction.find('#');
+    const std::string prefix = "urn:dslforum-org:service:";
+    if (hash == std::string::npos || soapaction.compare(0, prefix.size(), prefix) != 0) {
+        res.code = 500;
+        res.body = std::string(envelopeStart) + faultBody(401, "Invalid Action") + "</s:Envelope>\n";
+        return res;
+    }
+    std::string service = soapaction.substr(prefix.size(), hash - prefix.size());
+    std::string action = soapaction.substr(hash + 1);
+    auto url = controlUrls.find(soapaction.substr(0, hash));
+    if (url == controlUrls.end() || url->second != req.path) {
+        res.code = 500;
+        res.body = std::string(envelopeStart) + faultBody(401, "Invalid Action") + "</s:Envelope>\n";
+        return res;
+    }
+
+    Auth auth = checkAuth(req.body);
+    std::string header;
+    if (auth == Auth::Valid) {
+        header = authHeader("NextChallenge", "Authenticated");
+    } else if (!noAuthAction(action)) {
+        // InitChallenge, missing or invalid credentials: answer with a challenge only
+        res.code = auth == Auth::Init ? 200 : 503;
+        res.body = std::string(envelopeStart) + authHeader("Challenge", "Unauthenticated");
+        res.body += auth == Auth::Init ? "<s:Body/>\n" : faultBody(503, "Auth. failed");
+        res.body += "</s:Envelope>\n";
+        return res;
+    } else if (auth == Auth::Init) {
+        // Actions without authentication still answer an InitChallenge
+        header = authHeader("Challenge", "Unauthenticated");
+    }
+
+    Args out;
+    try {
+        runAction(service, action, req.body, out);
+    } catch (const ActionError& e) {
+        res.code = 500;
+        res.body = std::string(envelopeStart) + header + faultBody(e.code, e.description) + "</s:Envelope>\n";
+        return res;
+    }
+    std::ostringstream ss;
+    ss << envelopeStart << header << "<s:Body>\n<u:" << action << "Response xmlns:u=\"" << prefix << service << "\">\n";
+    for (const auto& kv : out) {
+        ss << "<" << kv.first << ">" << kv.second << "</" << kv.first << ">\n";
+    }
+    ss << "</u:" << action << "Response>\n</s:Body>\n</s:Envelope>\n";
+    res.body = ss.str();
+    return res;
+}
+
+/* The host list of X_AVM-DE_GetHostListPath, in the format of a FRITZ!Box. */
+std::string hostListXml() {
+    std::ostringstream ss;
+    ss << "<?xml version=\"1.0\" ?>\n<List>";
+    int index = 1;
+    for (const auto& h : hosts) {
+        ss << "<Item><Index>" << index++ << "</Index><IPAddress>" << h.ip << "</IPAddress><MACAddress>" << h.mac
+           << "</MACAddress><Active>" << (h.active ? 1 : 0) << "</Active><HostName>" << h.name
+           << "</HostName><InterfaceType>" << h.interfaceType << "</InterfaceType><X_AVM-DE_Port>0</X_AVM-DE_Port>"
+           << "<X_AVM-DE_Speed>" << (h.band == 0 ? 1000 : 866) << "</X_AVM-DE_Speed><X_AVM-DE_UpdateAvailable>0"
+           << "</X_AVM-DE_UpdateAvailable><X_AVM-DE_UpdateSuccessful>unknown</X_AVM-DE_UpdateSuccessful>"
+           << "<X_AVM-DE_InfoURL></X_AVM-DE_InfoURL><X_AVM-DE_Model></X_AVM-DE_Model><X_AVM-DE_URL></X_AVM-DE_URL>"
+           << "<X_AVM-DE_Guest>0</X_AVM-DE_Guest></Item>\n";
+    }
+    ss << "</List>\n";
+    return ss.str();
+}
+
+/* The value of a query parameter of a path, empty if it is missing. */
+std::string queryValue(const std::string& path, const std::string& name) {
+    size_t q = path.find('?');
+    while (q != std::string::npos) {
+        size_t end = path.find('&', q + 1);
+        std::string pair = path.substr(q + 1, end == std::string::npos ? std::string::npos : end - q - 1);
+        if (pair.compare(0, name.size() + 1, name + "=") == 0) return pair.substr(name.size() + 1);
+        q = end;
+    }
+    return std::string();
+}
+
+std::string listDate(time_t t) {
+    char buf[16];
+    strftime(buf, sizeof(buf), "%d.%m.%y %H:%M", localtime(&t));
+    return buf;
+}
+
+/* The call list of GetCallList, newest call first, with the query parameters max, days and id of a FRITZ!Box. */
+std::string callListXml(const std::string& path) {
+    int max = atoi(queryValue(path, "max").c_str());
+    int days = atoi(queryValue(path, "days").c_str());
+    long id = atol(queryValue(path, "id").c_str());
+    static const int types[] = {1, 3, 2, 1, 3, 10, 1};
+    std::ostringstream ss;
+    ss << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<root><timestamp>" << started << "</timestamp>\n";
+    int n = 0;
+    for (int i = opt.calls; i >= 1 && (max == 0 || n < max) && i > id; --i) {
+        time_t t = started - (time_t) (opt.calls - i) * 73 * 60;
+        if (days > 0 && t < started - days * 86400) break;
+        int type = types[i % 7];
+        bool out = type == 3;
+        std::string remote = "0301234" + std::to_string(1000 + i % 97);
+        ss << "<Call><Id>" << i << "</Id><Type>" << type << "</Type>";
+        if (out) ss << "<Called>" << remote << "</Called><CallerNumber>SIP: 987654</CallerNumber>";
+        else ss << "<Caller>" << remote << "</Caller><CalledNumber>SIP: 987654</CalledNumber>";
+        ss << "<Name>" << (i % 97 < opt.contacts && i % 3 ? "Contact " + std::to_string(i % 97) : "") << "</Name>"
+           << "<Numbertype>sip</Numbertype><Device>" << (type == 2 || type == 10 ? "" : "FRITZ!Fon C6") << "</Device>"
+           << "<Port>10</Port><Date>" << listDate(t) << "</Date><Duration>"
+           << (type == 2 || type == 10 ? "0:00" : std::to_string(i % 3) + ":" + (i % 60 < 10 ? "0" : "") + std::to_string(i % 60))
+           << "</Duration><Count></Count><Path /></Call>\n";
+        ++n;
+    }
+    ss << "</root>\n";
+    return ss.str();
+}
+
+/* The phonebook of GetPhonebook, in the format of a FRITZ!Box. */
+std::string phonebookXml() {
+    std::ostringstream ss;
+    ss << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<phonebooks>\n<phonebook owner=\"1\" name=\"Telefonbuch\">"
+       << "<timestamp>" << started << "</timestamp>\n";
+    static const char* const kinds[] = {"home", "mobile", "work"};
+    for (int i = 0; i < opt.contacts; ++i) {
+        ss << "<contact><category>" << (i % 7 == 0 ? 1 : 0) << "</category><person><realName>"
+           << (i % 10 == 9 ? "Family &amp; Friends " : "Contact ") << i << "</realName></person><telephony nid=\""
+           << i % 3 + 1 << "\">";
+        for (int k = 0; k <= i % 3; ++k) {
+            ss << "<number type=\"" << kinds[k] << "\" prio=\"" << (k == 0 ? 1 : 0) << "\" id=\"" << k << "\">"
+               << (k == 1 ? "0170" : "030") << "1234" << 1000 + i << "</number>";
+        }
+        ss << "</telephony><services><email classifier=\"private\">contact" << i << "@example.com</email></services>"
+           << "<setup /><features doorphone=\"0\" /><mod_time>" << started << "</mod_time><uniqueid>" << i + 1
+           << "</uniqueid></contact>\n";
+    }
+    ss << "</phonebook>\n</phonebooks>\n";
+    return ss.str();
+}
+
+/* The message list of GetMessageList. */
+std::string messageListXml() {
+    std::ostringstream ss;
+    ss << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<Root>\n";
+    for (int i = 0; i < 6; ++i) {
+        time_t t = started - (time_t) i * 5 * 3600;
+        ss << "<Message><Index>" << 5 - i << "</Index><Tam>0</Tam><Called>987654</Called><Date>" << listDate(t)
+           << "</Date><Duration>0:0" << i + 1 << "</Duration><Inbook>" << (i % 2) << "</Inbook><Name>"
+           << (i % 2 ? "Contact " + std::to_string(i) : "") << "</Name><New>" << (i < 2 ? 1 : 0) << "</New><Number>0301234"
+           << 1000 + i << "</Number><Path>/download.lua?path=/data/tam/rec/rec.0.00" << 5 - i << "</Path></Message>\n";
+    }
+    ss << "</Root>\n";
+    return ss.str();
+}
+
+// ---------------------------------------------------------------------------
+// Event subscriptions (UPnP GENA)
+// ---------------------------------------------------------------------------
+
+struct Subscriber {
+    std::string sid;
+    std::string service;
+    std::string host;       // Of the callback URL
+    int port = 80;
+    std::string path;
+    uint32_t seq = 0;       // SEQ of the next NOTIFY
+    bool initial = true;    // The initial event (all variables) is still to be sent
+    std::chrono::steady_clock::time_point expires;
+};
+
+std::vector<Subscriber> subscribers;
+uint32_t eventTick = 0;     // Number of simulated state changes
+std::mutex logMutex;        // NOTIFYs are sent from their own threads
+
+/* The evented variables of a service, after `eventTick` changes. */
+std::vector<std::pair<std::string, std::string>> eventVariables(const std::string& service) {
+    std::vector<std::pair<std::string, std::string>> vars;
+    if (service == "Hosts:1") {
+        int active = 0;
+        for (const auto& h : hosts) active += h.active ? 1 : 0;
+        vars.emplace_back("HostNumberOfEntries", std::to_string(hosts.size()));
+        vars.emplace_back("X_AVM-DE_ActiveHosts", std::to_string(active));
+    }
+    vars.emplace_back("X_AVM-DE_ChangeCounter", std::to_string(eventTick));
+    return vars;
+}
+
+/* Sends a NOTIFY to a subscriber from a new thread, so that the server never waits for the subscriber. */
+void notify(const Subscriber& s) {
+    std::ostringstream body;
+    body << "<?xml version=\"1.0\"?>\n<e:propertyset xmlns:e=\"urn:schemas-upnp-org:event-1-0\">\n";
+    for (const auto& kv : eventVariables(s.service)) {
+        body << "<e:property><" << kv.first << ">" << xmlEscape(kv.second) << "</" << kv.first << "></e:property>\n";
+    }
+    body << "</e:propertyset>\n";
+    std::ostringstream ss;
+    ss << "NOTIFY " << s.path << " HTTP/1.1\r\nHOST: " << s.host << ":" << s.port << "\r\n"
+       << "CONTENT-TYPE: text/xml; charset=\"utf-8\"\r\nNT: upnp:event\r\nNTS: upnp:propchange\r\n"
+       << "SID: " << s.sid << "\r\nSEQ: " << s.seq << "\r\nContent-Length: " << body.str().size() << "\r\n\r\n"
+       << body.str();
+    std::string request = ss.str(), host = s.host, sid = s.sid;
+    int port = s.port;
+    uint32_t seq = s.seq;
+    std::thread([request, host, port, sid, seq]() {
+        int code = 0;
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t) port);
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        timeval tv{5, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) == 1 && connect(fd, (sockaddr*) &addr, sizeof(addr)) == 0
+                && sendAll(fd, request)) {
+            char buf[64];
+            ssize_t n = recv(fd, buf, sizeof(buf) - 1, 0);
+            if (n > 9) code = atoi(buf + 9);
+        }
+        close(fd);
+        if (opt.verbose) {
+            std::lock_guard<std::mutex> lock(logMutex);
+            fprintf(stderr, "[fake_router] NOTIFY %s:%d %s SEQ %u -> %d\n", host.c_str(), port, sid.c_str(), seq, code);
+        }
+    }).detach();
+}
+
+Response handleSubscription(const Request& req) {
+    Response res;
+    res.contentType = "text/html";
+    auto service = eventUrls.find(req.path);
+    if (service == eventUrls.end()) {
+        res.code = 404;
+        return res;
+    }
+    auto now = std::chrono::steady_clock::now();
+    std::string sid = req.header("sid");
+    auto it = subscribers.begin();
+    while (it != subscribers.end() && (it->sid != sid || it->expires < now)) ++it;
+    if (req.method == "UNSUBSCRIBE") {
+        if (it == subscribers.end()) res.code = 412;
+        else subscribers.erase(it);
+        return res;
+    }
+    int timeout = opt.eventTimeout;
+    std::string requested = lower(req.header("timeout"));
+    if (requested.compare(0, 7, "second-") == 0 && requested != "second-infinite") {
+        timeout = std::min(timeout, atoi(requested.c_str() + 7));
+    }
+    if (!sid.empty()) {
+        // Renewal
+        if (it == subscribers.end() || !req.header("callback").empty()) {
+            res.code = 412;
+            return res;
+        }
+    } else {
+        std::string callback = req.header("callback");
+        size_t hostStart = callback.find("://"), pathStart = std::string::npos;
+        if (lower(req.header("nt")) != "upnp:event" || callback.empty() || callback[0] != '<' || hostStart == std::string::npos
+                || (pathStart = callback.find('/', hostStart + 3)) == std::string::npos) {
+            res.code = 412;
+            return res;
+        }
+        Subscriber s;
+        s.sid = "uuid:" + lower(randomHex(8) + "-" + randomHex(4) + "-" + randomHex(4) + "-" + randomHex(4) + "-" + randomHex(12));
+        s.service = service->second;
+        std::string hostPort = callback.substr(hostStart + 3, pathStart - hostStart - 3);
+        size_t colon = hostPort.find(':');
+        s.host = hostPort.substr(0, colon);
+        if (colon != std::string::npos) s.port = atoi(hostPort.c_str() + colon + 1);
+        s.path = callback.substr(pathStart, callback.find('>') - pathStart);
+        subscribers.push_back(s);
+        it = subscribers.end() - 1;
+    }
+    it->expires = now + std::chrono::seconds(timeout);
+    res.headers.emplace_back("SID", it->sid);
+    res.headers.emplace_back("TIMEOUT", "Second-" + std::to_string(timeout));
+    return res;
+}
+
+/* Sends the pending initial events, and the next simulated change every --notify-interval ms. */
+void sendEvents(std::chrono::steady_clock::time_point& nextTick) {
+    auto now = std::chrono::steady_clock::now();
+    subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+                                     [&](const Subscriber& s) { return s.expires < now; }),
+                      subscribers.end());
+    bool tick = opt.notifyIntervalMs > 0 && now >= nextTick;
+    if (tick) {
+        ++eventTick;
+        if (!hosts.empty()) hosts[eventTick % hosts.size()].active ^= true;
+        nextTick = now + std::chrono::milliseconds(opt.notifyIntervalMs);
+    }
+    for (auto& s : subscribers) {
+        if (s.initial || tick) {
+            s.initial = false;
+            notify(s);
+            ++s.seq;
+        }
+    }
+}
+
+Response handle(const Request& req) {
+    Response res;
+    if (req.method == "POST" && !req.header("soapaction").empty()) {
+        return handleSoap(req);
+    }
+    if (req.method == "SUBSCRIBE" || req.method == "UNSUBSCRIBE") {
+        return handleSubscription(req);
+    }
+    if (req.method == "GET" || req.method == "HEAD") {
+        std::string path = req.path.substr(0, req.path.find('?'));
+        if (path == "/devicehostlist.lua" && !hostListSid.empty()
+                && req.path.substr(path.size()) == "?sid=" + hostListSid) {
+            res.body = hostListXml();
+            return res;
+        }
+        if (!listSid.empty() && queryValue(req.path, "sid") == listSid) {
+            if (path == "/calllist.lua") res.body = callListXml(req.path);
+            else if (path == "/phonebook.lua") res.body = phonebookXml();
+            else if (path == "/download.lua" && queryValue(req.path, "path") == "/data/tam/meta0") res.body = messageListXml();
+            if (!res.body.empty()) return res;
+        }
+        if (path.find("..") == std::string::npos) {
+            std::string body = readFile(opt.fixtures + path);
+            if (!body.empty()) {
+                if (opt.etag) {
+                    // Changes with the content, like after a firmware update
+                    uint32_t h = 2166136261u;
+                    for (unsigned char c : body) h = (h ^ c) * 16777619u;
+                    char etag[16];
+                    snprintf(etag, sizeof(etag), "\"%08x\"", h);
+                    res.headers.emplace_back("ETag", etag);
+                }
+                res.body = body;
+                return res;
+            }
+        }
+        res.code = 404;
+        res.contentType = "text/html";
+        res.body = "<html><body>404 Not Found</body></html>\n";
+        return res;
+    }
+    res.code = 405;
+    res.contentType = "text/html";
+    return res;
+}
+
+// ---------------------------------------------------------------------------
+// HTTP server
+// ---------------------------------------------------------------------------
+
+const char* reason(int code) {
+    switch (code) {
+    case 200: return "OK";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 412: return "Precondition Failed";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default: return "Unknown";
+    }
+}
+
+struct Connection {
+    int fd;
+    std::string in;
+    int served = 0;
+    std::chrono::steady_clock::time_point lastActive = std::chrono::steady_clock::now();
+};
+
+/* Parses one complete request from the front of `buf`. */
+bool parseRequest(std::string& buf, Request& req) {
+    size_t headEnd = buf.find("\r\n\r\n");
+    if (headEnd == std::string::npos) return false;
+    std::istringstream head(buf.substr(0, headEnd));
+    std::string line;
+    std::getline(head, line);
+    std::istringstream first(line);
+    first >> req.method >> req.path >> req.version;
+    while (std::getline(head, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        req.headers[lower(line.substr(0, colon))] = value;
+    }
+    size_t len = (size_t) atol(req.header("content-length").c_str());
+    if (buf.size() < headEnd + 4 + len) return false;
+    req.body = buf.substr(headEnd + 4, len);
+    buf.erase(0, headEnd + 4 + len);
+    return true;
+}
+
+/* Saves a response as DIR/NNN-label.http, e.g. as a fixture of the benchmark. */
+void record(const Request& req, const std::string& response) {
+    static int count = 0;
+    std::string label = req.header("soapaction");
+    label = label.empty() ? req.path.substr(0, req.path.find('?')) : label.substr(label.find('#') + 1);
+    for (char& c : label) {
+        if (!isalnum((unsigned char) c) && c != '-' && c != '_' && c != '.') c = '_';
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%03d-", ++count);
+    std::ofstream(opt.record + "/" + name + label + ".http", std::ios::binary) << response;
+}
+
+/* Handles all complete requests of a connection. Returns false if it must be closed. */
+bool serve(Connection& c) {
+    Request req;
+    while (parseRequest(c.in, req)) {
+        // The connect latency simulates the TCP (and TLS) handshake of a new connection
+        if (c.served == 0 && opt.connectLatencyMs > 0) usleep(opt.connectLatencyMs * 1000);
+        if (opt.latencyMs > 0) usleep(opt.latencyMs * 1000);
+        Response res = handle(req);
+        c.served++;
+        bool close = !opt.keepAlive || res.close || lower(req.header("connection")) == "close"
+            || req.version == "HTTP/1.0" || (opt.maxRequests > 0 && c.served >= opt.maxRequests);
+        if (opt.verbose) {
+            fprintf(stderr, "[fake_router] %s %s %s -> %d (%zu bytes)%s\n", req.method.c_str(), req.path.c_str(),
+                    req.header("soapaction").c_str(), res.code, res.body.size(), close ? " close" : "");
+        }
+        std::ostringstream ss;
+        ss << "HTTP/1.1 " << res.code << " " << reason(res.code) << "\r\n"
+           << "Content-Type: " << res.contentType << "\r\n"
+           << "Connection: " << (close ? "close" : "keep-alive") << "\r\n"
+           << "Server: FRITZ!Box 7590 UPnP/1.0 AVM FRITZ!Box 7590 154.07.57\r\n";
+        for (const auto& h : res.headers) ss << h.first << ": " << h.second << "\r\n";
+        bool head = req.method == "HEAD";
+        if (opt.chunked && !head) {
+            ss << "Transfer-Encoding: chunked\r\n\r\n";
+            const size_t chunk = 1000;
+            for (size_t pos = 0; pos < res.body.size(); pos += chunk) {
+                std::string part = res.body.substr(pos, chunk);
+                char size[16];
+                snprintf(size, sizeof(size), "%zx\r\n", part.size());
+                ss << size << part << "\r\n";
+            }
+            ss << "0\r\n\r\n";
+        } else {
+            ss << "Content-Length: " << res.body.size() << "\r\n\r\n";
+            if (!head) ss << res.body;
+        }
+        if (!opt.record.empty()) record(req, ss.str());
+        if (!sendAll(c.fd, ss.str()) || close) return false;
+        req = Request();
+    }
+    return true;
+}
+
+#ifdef FAKE_ROUTER_TLS
+/* A self-signed certificate (P-256) for fritz.box and 127.0.0.1, like the one a FRITZ!Box makes for itself. */
+SSL_CTX* makeTlsContext() {
+    EVP_PKEY* key = nullptr;
+    EVP_PKEY_CTX* kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+    if (!kctx || EVP_PKEY_keygen_init(kctx) <= 0 || EVP_PKEY_CTX_set_ec_paramgen_curve_nid(kctx, NID_X9_62_prime256v1) <= 0
+            || EVP_PKEY_keygen(kctx, &key) <= 0) {
+        EVP_PKEY_CTX_free(kctx);
+        return nullptr;
+    }
+    EVP_PKEY_CTX_free(kctx);
+    X509* cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), (long) time(nullptr));
+    X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 10L * 365 * 24 * 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*) "fritz.box", -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509V3_CTX v3;
+    X509V3_set_ctx(&v3, cert, cert, nullptr, nullptr, 0);
+    X509_EXTENSION* san = X509V3_EXT_conf_nid(nullptr, &v3, NID_subject_alt_name, "DNS:fritz.box,IP:127.0.0.1");
+    if (san) {
+        X509_add_ext(cert, san, -1);
+        X509_EXTENSION_free(san);
+    }
+    X509_sign(cert, key, EVP_sha256());
+
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int mdLen = 0;
+    X509_digest(cert, EVP_sha256(), md, &mdLen);
+    std::string fingerprint;
+    for (unsigned int i = 0; i < mdLen; ++i) {
+        char hex[4];
+        snprintf(hex, sizeof(hex), i ? ":%02X" : "%02X", md[i]);
+        fingerprint += hex;
+    }
+    fprintf(stderr, "[fake_router] TLS certificate SHA-256 %s\n", fingerprint.c_str());
+    if (!opt.tlsCert.empty()) {
+        FILE* f = fopen(opt.tlsCert.c_str(), "w");
+        if (f) {
+            PEM_write_X509(f, cert);
+            fclose(f);
+        }
+    }
+
+    SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+    SSL_CTX_use_certificate(ctx, cert);
+    SSL_CTX_use_PrivateKey(ctx, key);
+    if (opt.tls12) SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+    // Sessions of TLS 1.2 are resumed by their ID (server cache), those of TLS 1.3 by tickets
+    static const unsigned char sidContext[] = "fake_router";
+    SSL_CTX_set_session_id_context(ctx, sidContext, sizeof(sidContext) - 1);
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return ctx;
+}
+
+/* Terminates one TLS connection and passes its bytes to and from the plain port, until either side closes. */
+void proxyTls(SSL_CTX* ctx, int fd) {
+    SSL* ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    int plain = -1;
+    if (SSL_accept(ssl) == 1) {
+        if (opt.verbose) {
+            std::lock_guard<std::mutex> lock(logMutex);
+            fprintf(stderr, "[fake_router] TLS %s handshake (%s)\n", SSL_get_version(ssl),
+                    SSL_session_reused(ssl) ? "resumed" : "full");
+        }
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t) opt.port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        plain = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(plain, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (connect(plain, (sockaddr*) &addr, sizeof(addr)) == 0) {
+            char buf[16384];
+            while (true) {
+                if (SSL_pending(ssl) == 0) {
+                    pollfd pfds[2] = {{fd, POLLIN, 0}, {plain, POLLIN, 0}};
+                    if (poll(pfds, 2, -1) < 0) continue;
+                    if (pfds[1].revents) {
+                        ssize_t n = recv(plain, buf, sizeof(buf), 0);
+                        if (n <= 0 || SSL_write(ssl, buf, (int) n) <= 0) break;
+                    }
+                    if (!pfds[0].revents) continue;
+                }
+                int n = SSL_read(ssl, buf, sizeof(buf));
+                if (n <= 0) {
+                    if (SSL_get_error(ssl, n) == SSL_ERROR_WANT_READ) continue;
+                    break;
+                }
+                if (!sendAll(plain, std::string(buf, (size_t) n))) break;
+            }
+        }
+        SSL_shutdown(ssl);
+    } else if (opt.verbose) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        fprintf(stderr, "[fake_router] TLS handshake failed\n");
+    }
+    SSL_free(ssl);
+    if (plain >= 0) close(plain);
+    close(fd);
+}
+
+/* Accepts the connections of the HTTPS front end, one thread each. */
+bool startTls() {
+    SSL_CTX* ctx = makeTlsContext();
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t) opt.tlsPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (!ctx || bind(lfd, (sockaddr*) &addr, sizeof(addr)) < 0 || listen(lfd, 16) < 0) {
+        ERR_print_errors_fp(stderr);
+        perror("[fake_router] TLS bind/listen");
+        return false;
+    }
+    fprintf(stderr, "[fake_router] HTTPS on 127.0.0.1:%d\n", opt.tlsPort);
+    std::thread([ctx, lfd]() {
+        while (true) {
+            int fd = accept(lfd, nullptr, nullptr);
+            if (fd < 0) continue;
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            std::thread(proxyTls, ctx, fd).detach();
+        }
+    }).detach();
+    return true;
+}
+#endif
+
+void usage(const char* argv0) {
+    fprintf(stderr,
+            "Usage: %s [--port N] [--user U] [--pass P] [--fixtures DIR] [--latency MS]\n"
+            "          [--connect-latency MS] [--hosts N] [--host-base N] [--no-keepalive] [--max-requests N]\n"
+            "          [--idle-timeout MS] [--chunked] [--no-etag]\n"
+            "          [--nonce-ttl S] [--record DIR] [--verbose]\n"
+            "          [--notify-interval MS] [--event-timeout S]\n"
+            "          [--tls-port N] [--tls-cert FILE] [--tls12]\n"
+            "          [--calls N] [--contacts N]\n", argv0);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) { usage(argv[0]); exit(2); }
+            return argv[++i];
+        };
+        if (a == "--port") opt.port = atoi(next().c_str());
+        else if (a == "--user") opt.user = next();
+        else if (a == "--pass") opt.pass = next();
+        else if (a == "--fixtures") opt.fixtures = next();
+        else if (a == "--latency") opt.latencyMs = atoi(next().c_str());
+        else if (a == "--connect-latency") opt.connectLatencyMs = atoi(next().c_str());
+        else if (a == "--idle-timeout") opt.idleTimeoutMs = atoi(next().c_str());
+        else if (a == "--hosts") opt.hosts = atoi(next().c_str());
+        else if (a == "--host-base") opt.hostBase = atoi(next().c_str());
+        else if (a == "--no-keepalive") opt.keepAlive = false;
+        else if (a == "--max-requests") opt.maxRequests = atoi(next().c_str());
+        else if (a == "--chunked") opt.chunked = true;
+        else if (a == "--no-etag") opt.etag = false;
+        else if (a == "--nonce-ttl") opt.nonceTtl = atoi(next().c_str());
+        else if (a == "--record") opt.record = next();
+        else if (a == "--verbose") opt.verbose = true;
+        else if (a == "--notify-interval") opt.notifyIntervalMs = atoi(next().c_str());
+        else if (a == "--event-timeout") opt.eventTimeout = atoi(next().c_str());
+        else if (a == "--tls-port") opt.tlsPort = atoi(next().c_str());
+        else if (a == "--tls-cert") opt.tlsCert = next();
+        else if (a == "--tls12") opt.tls12 = true;
+        else if (a == "--calls") opt.calls = atoi(next().c_str());
+        else if (a == "--contacts") opt.contacts = atoi(next().c_str());
+        else { usage(argv[0]); return 2; }
+    }
+    srand((unsigned) time(nullptr));
+    signal(SIGPIPE, SIG_IGN);
+    initHosts();
+    loadDescription();
+    if (controlUrls.empty()) {
+        fprintf(stderr, "[fake_router] no services found in %s/tr64desc.xml\n", opt.fixtures.c_str());
+        return 1;
+    }
+
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t) opt.port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(lfd, (sockaddr*) &addr, sizeof(addr)) < 0 || listen(lfd, 16) < 0) {
+        perror("[fake_router] bind/listen");
+        return 1;
+    }
+    fprintf(stderr, "[fake_router] listening on 127.0.0.1:%d (%zu services, %d hosts)\n", opt.port,
+            controlUrls.size(), opt.hosts);
+    if (opt.tlsPort > 0) {
+#ifdef FAKE_ROUTER_TLS
+        if (!startTls()) return 1;
+#else
+        fprintf(stderr, "[fake_router] --tls-port needs a build with OpenSSL\n");
+        return 1;
+#endif
+    }
+
+    std::vector<Connection> conns;
+    auto nextTick = std::chrono::steady_clock::now();
+    while (true) {
+        std::vector<pollfd> pfds;
+        pfds.push_back({lfd, POLLIN, 0});
+        for (const auto& c : conns) pfds.push_back({c.fd, POLLIN, 0});
+        int timeout = opt.idleTimeoutMs > 0 ? opt.idleTimeoutMs / 2 + 1 : -1;
+        if (!subscribers.empty() && opt.notifyIntervalMs > 0 && (timeout < 0 || timeout > opt.notifyIntervalMs)) {
+            timeout = opt.notifyIntervalMs;
+        }
+        if (poll(pfds.data(), pfds.size(), timeout) < 0) continue;
+        auto now = std::chrono::steady_clock::now();
+        if (pfds[0].revents & POLLIN) {
+            int fd = accept(lfd, nullptr, nullptr);
+            if (fd >= 0) {
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                conns.push_back({fd, std::string()});
+            }
+        }
+        for (size_t i = 1; i < pfds.size(); ++i) {
+            if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            Connection& c = conns[i - 1];
+            c.lastActive = now;
+            char buf[4096];
+            ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+            bool keep = n > 0;
+            if (keep) {
+                c.in.append(buf, (size_t) n);
+                keep = serve(c);
+            }
+            if (!keep) {
+                close(c.fd);
+                c.fd = -1;
+            }
+        }
+        if (opt.idleTimeoutMs > 0) {
+            // Like the real devices, drop kept-alive connections that stay idle too long
+            for (auto& c : conns) {
+                if (c.fd >= 0 && now - c.lastActive > std::chrono::milliseconds(opt.idleTimeoutMs)) {
+                    if (opt.verbose) fprintf(stderr, "[fake_router] closing idle connection\n");
+                    close(c.fd);
+                    c.fd = -1;
+                }
+            }
+        }
+        if (!subscribers.empty()) sendEvents(nextTick);
+        std::vector<Connection> open;
+        for (auto& c : conns) if (c.fd >= 0) open.push_back(std::move(c));
+        conns.swap(open);
+    }
+}
@@ -0,0 +1,661 @@
+/*
+ * tr064_cli.cpp
+ *
+ * Command line client for the native build of the library. Runs a single
+ * action (or a Home_Indicator-like WLAN sweep) against a device or the fake
+ * router, optionally repeated, and prints the per-action latency. Meant to
+ * be run under perf, heaptrack, valgrind etc. With --async, the action is
+ * run through TR064Async and the number of poll() calls is printed; with
+ * --batch, the sweep queries all associated devices in one TR064Batch.
+ * --host-table fetches the host list of the device in one request and
+ * checks the given MAC addresses against it. --cache-ttl puts a
+ * TR064ResponseCache with that default TTL in front of action(). An output
+ * with a type (?Name:int32, uint32, uint64, fixed2, bool, mac or text) makes
+ * the action decode all outputs into typed TR064Output bindings.
+ * --sweep --descriptors runs the sweep through action<Descriptor>() with the
+ * generated descriptors of tr064_descriptors.h. --describe lists the actions
+ * of the given services (default: all) from their SCPDs; --validate checks
+ * the action against the SCPD before sending it. --store FILE keeps the
+ * service table in FILE, so that the next init() only checks the device
+ * description with a HEAD request (--store-trust: sends no request at all).
+ * --session FILE saves the session (exportSession()) after the run and
+ * resumes it (importSession()) instead of init(), like a deep sleep wakeup.
+ * --metrics collects TR064Metrics and prints them in the Prometheus text
+ * format at the end. --events subscribes to the events of the given
+ * services (TR064Events) and prints the state variables the device sends
+ * for --duration ms; --listen sets the port of the listener (default: any).
+ * --locate looks for the given MAC addresses in the WLANs of the device and
+ * of each --mesh HOST:PORT (same credentials) through a TR064Mesh, and
+ * prints the latency per endpoint. --every MS runs the action periodically
+ * through a TR064Scheduler for --duration ms, registered --jobs times (the
+ * copies share their requests), within --rate requests per second.
+ * --tls connects through a TR064TlsTransport (default port 49443), pinning
+ * the certificate by its SHA-256 --fingerprint or by --ca FILE (PEM), or
+ * not at all with --insecure, and prints the full and resumed handshakes.
+ * Built with -DTR064_HEAP_STATS=ON, it prints the heap use of the last
+ * action per phase (TR064::heapStats()).
+ *
+ * Usage: tr064_cli [--host H] [--port P] [--user U] [--pass P] [--repeat N] [--interval MS]
+ *                  [--debug LEVEL] [--sweep] [--services] [--no-keepalive] [--async] [--batch]
+ *                  [--cache-ttl MS] [--host-table [MAC ...]] [--descriptors] [--validate]
+ *                  [--describe [Service ...]] [--store FILE [--store-trust]] [--session FILE] [--metrics]
+ *                  [--events Service ... [--listen PORT] [--duration MS]]
+ *                  [--locate MAC ... [--mesh HOST:PORT ...]] [--every MS [--jobs N] [--rate R]]
+ *                  [--tls [--fingerprint HEX] [--ca FILE] [--insecure]]
+ *                  [Service Action [Arg=Value ...] [?Output ...]]
+ *
+ * Example: tr064_cli Hosts:1 GetSpecificHostEntry NewMACAddress=02:00:00:00:00:01 ?NewActive ?NewHostName
+ *          tr064_cli Hosts:1 GetSpecificHostEntry NewMACAddress=02:00:00:00:00:01 ?NewActive:bool ?NewIPAddress:text
+ *
+ * MIT License, all text here must be included in any redistribution.
+ */
+
+#include <tr064.h>
+#include <tr064_descriptors.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Stats {
+    std::vector<unsigned long> samples;
+
+    void print(const char* label) const {
+        if (samples.empty()) return;
+        std::vector<unsigned long> s = samples;
+        std::sort(s.begin(), s.end());
+        unsigned long long sum = 0;
+        for (unsigned long v : s) sum += v;
+        printf("%-32s n=%-6zu min=%8luus p50=%8luus p99=%8luus max=%8luus avg=%8lluus\n", label, s.size(),
+               s.front(), s[s.size() / 2], s[(s.size() * 99) / 100], s.back(), sum / s.size());
+    }
+};
+
+void usage(const char* argv0) {
+    fprintf(stderr,
+            "Usage: %s [--host H] [--port P] [--user U] [--pass P] [--repeat N] [--interval MS] [--debug LEVEL] [--sweep] [--services] [--no-keepalive] [--async] [--batch]\n"
+            "          [--cache-ttl MS] [--host-table [MAC ...]] [--descriptors] [--validate] [--describe [Service ...]]\n"
+            "          [--store FILE [--store-trust]] [--session FILE] [--metrics]\n"
+            "          [--events Service ... [--listen PORT] [--duration MS]]\n"
+            "          [--locate MAC ... [--mesh HOST:PORT ...]] [--every MS [--jobs N] [--rate R]]\n"
+            "          [--tls [--fingerprint HEX] [--ca FILE] [--insecure]] [--static]\n"
+            "          [--calls | --phonebook ID | --messages TAM] [--max N] [--days N] [--since ID] [--quiet]\n"
+            "          [Service Action [Arg=Value ...] [?Output[:Type] ...]]\n", argv0);
+}
+
+/// Value of a typed output, see `binding()`.
+struct Typed {
+    std::string name;
+    std::string type;
+    int32_t i32;
+    uint32_t u32;
+    uint64_t u64;
+    bool b;
+    uint8_t mac[6];
+    char text[64];
+};
+
+bool binding(Typed& v, TR064Output& out) {
+    const char* n = v.name.c_str();
+    if (v.type == "int32") out = TR064Output::int32(n, &v.i32);
+    else if (v.type == "uint32") out = TR064Output::uint32(n, &v.u32);
+    else if (v.type == "uint64") out = TR064Output::uint64(n, &v.u64);
+    else if (v.type.compare(0, 5, "fixed") == 0) out = TR064Output::fixed(n, &v.i32, (uint8_t) atoi(v.type.c_str() + 5));
+    else if (v.type == "bool") out = TR064Output::boolean(n, &v.b);
+    else if (v.type == "mac") out = TR064Output::mac(n, v.mac);
+    else if (v.type == "text" || v.type.empty()) out = TR064Output::text(n, v.text, sizeof(v.text));
+    else return false;
+    return true;
+}
+
+void printTyped(const Typed& v, const TR064Output& out) {
+    static const char* const errors[] = {"ok", "missing", "invalid", "overflow", "truncated"};
+    printf("%s = ", v.name.c_str());
+    if (out.status != TR064_OUTPUT_OK && out.status != TR064_OUTPUT_TRUNCATED) {
+        printf("<%s>\n", errors[-out.status]);
+        return;
+    }
+    switch (out.type) {
+    case TR064Output::INT32: printf("%d", (int) v.i32); break;
+    case TR064Output::UINT32: printf("%u", (unsigned) v.u32); break;
+    case TR064Output::UINT64: printf("%llu", (unsigned long long) v.u64); break;
+    case TR064Output::FIXED: printf("%d (x10^-%u)", (int) v.i32, (unsigned) out.size); break;
+    case TR064Output::BOOL: printf("%s", v.b ? "true" : "false"); break;
+    case TR064Output::MAC:
+        printf("%02X:%02X:%02X:%02X:%02X:%02X", v.mac[0], v.mac[1], v.mac[2], v.mac[3], v.mac[4], v.mac[5]);
+        break;
+    default: printf("%s", v.text);
+    }
+    printf("%s\n", out.status == TR064_OUTPUT_TRUNCATED ? " <truncated>" : "");
+}
+
+bool printCall(const TR064Call& c, void* context) {
+    if (!*(bool*) context) {
+        printf("call %u: type %u %s -> %s \"%s\" %s %s %umin%s\n", (unsigned) c.id, (unsigned) c.type, c.caller, c.called,
+               c.name, c.device, c.date, (unsigned) c.duration, c.truncated ? " <truncated>" : "");
+    }
+    return true;
+}
+
+bool printContact(const TR064Contact& c, void* context) {
+    if (!*(bool*) context) {
+        printf("contact %u: %s%s", (unsigned) c.uniqueId, c.name, c.category ? " (important)" : "");
+        for (uint8_t i = 0; i < c.nNumbers; ++i) printf(" %s", c.numbers[i]);
+        printf("%s\n", c.truncated ? " <truncated>" : "");
+    }
+    return true;
+}
+
+bool printMessage(const TR064TamMessage& m, void* context) {
+    if (!*(bool*) context) {
+        printf("message %u: %s%s \"%s\" -> %s %s %umin %s%s\n", (unsigned) m.index, m.isNew ? "new " : "", m.number,
+               m.name, m.called, m.date, (unsigned) m.duration, m.path, m.truncated ? " <truncated>" : "");
+    }
+    return true;
+}
+
+void printEvent(const char* service, const char* variable, const char* value, void* context) {
+    printf("[%8lums] %s %s = %s\n", millis() - *(unsigned long*) context, service, variable, value);
+}
+
+/// Outputs of the jobs of --every, see `printRun()`.
+struct Runs {
+    unsigned long started;
+    std::vector<std::vector<String>> req;
+};
+
+void printRun(int job, int result, void* context) {
+    Runs& runs = *(Runs*) context;
+    const std::vector<String>& req = runs.req[job - 1];
+    printf("[%8lums] job %d: %s", millis() - runs.started, job, TR064Scheduler::errorToString(result));
+    for (size_t i = 0; i + 1 < req.size() && req[i].length() > 0; i += 2) printf(" %s=%s", req[i].c_str(), req[i + 1].c_str());
+    printf("\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    String host = "127.0.0.1", user = "admin", pass = "admin";
+    uint16_t port = 49000;
+    int repeat = 1, interval = 0, debug = TR064::DEBUG_NONE, cacheTtl = 0, listen = 0, duration = 5000;
+    int every = 0, jobs = 1, rate = -1;
+    bool sweep = false, listServices = false, keepAlive = true, async = false, batch = false, hostTable = false;
+    bool descriptors = false, describe = false, validate = false, storeTrust = false, metrics = false, events = false;
+    bool locate = false, tls = false, portSet = false, fixedSize = false, calls = false, quiet = false;
+    int phonebook = -1, messages = -1;
+    TR064ListFilter filter = {0, 0, 0};
+    std::vector<std::string> meshHosts;
+#if defined(TR064_TLS)
+    bool insecure = false;
+    const char* fingerprint = nullptr;
+    const char* caPath = nullptr;
+#endif
+    const char* storePath = nullptr;
+    const char* sessionPath = nullptr;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (a == "--host" && hasValue) host = argv[++i];
+        else if (a == "--port" && hasValue) port = (uint16_t) atoi(argv[++i]), portSet = true;
+        else if (a == "--user" && hasValue) user = argv[++i];
+        else if (a == "--pass" && hasValue) pass = argv[++i];
+        else if (a == "--repeat" && hasValue) repeat = atoi(argv[++i]);
+        else if (a == "--interval" && hasValue) interval = atoi(argv[++i]);
+        else if (a == "--debug" && hasValue) debug = atoi(argv[++i]);
+        else if (a == "--sweep") sweep = true;
+        else if (a == "--services") listServices = true;
+        else if (a == "--no-keepalive") keepAlive = false;
+        else if (a == "--async") async = true;
+        else if (a == "--batch") batch = true;
+        else if (a == "--host-table") hostTable = true;
+        else if (a == "--descriptors") descriptors = true;
+        else if (a == "--describe") describe = true;
+        else if (a == "--validate") validate = true;
+        else if (a == "--store" && hasValue) storePath = argv[++i];
+        else if (a == "--store-trust") storeTrust = true;
+        else if (a == "--session" && hasValue) sessionPath = argv[++i];
+        else if (a == "--metrics") metrics = true;
+        else if (a == "--events") events = true;
+        else if (a == "--listen" && hasValue) listen = atoi(argv[++i]);
+        else if (a == "--duration" && hasValue) duration = atoi(argv[++i]);
+        else if (a == "--locate") locate = true;
+        else if (a == "--every" && hasValue) every = atoi(argv[++i]);
+        else if (a == "--jobs" && hasValue) jobs = atoi(argv[++i]);
+        else if (a == "--rate" && hasValue) rate = atoi(argv[++i]);
+        else if (a == "--mesh" && hasValue) meshHosts.push_back(argv[++i]);
+        else if (a == "--cache-ttl" && hasValue) cacheTtl = atoi(argv[++i]);
+#if defined(TR064_TLS)
+        else if (a == "--tls") tls = true;
+        else if (a == "--fingerprint" && hasValue) fingerprint = argv[++i];
+        else if (a == "--ca" && hasValue) caPath = argv[++i];
+        else if (a == "--insecure") insecure = true;
+#else
+        else if (a == "--tls" || a == "--fingerprint" || a == "--ca" || a == "--insecure") {
+            printf("tls: not available (built without OpenSSL)\n");
+            return 2;
+        }
+#endif
+        else if (a == "--static") fixedSize = true;
+        else if (a == "--calls") calls = true;
+        else if (a == "--phonebook" && hasValue) phonebook = atoi(argv[++i]);
+        else if (a == "--messages" && hasValue) messages = atoi(argv[++i]);
+        else if (a == "--max" && hasValue) filter.max = (uint16_t) atoi(argv[++i]);
+        else if (a == "--days" && hasValue) filter.days = (uint16_t) atoi(argv[++i]);
+        else if (a == "--since" && hasValue) filter.id = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        else if (a == "--quiet") quiet = true;
+        else if (a.size() > 1 && a[0] == '-' && a[1] == '-') { usage(argv[0]); return 2; }
+        else positional.push_back(a);
+    }
+    bool lists = calls || phonebook >= 0 || messages >= 0;
+    if (!sweep && !listServices && !hostTable && !describe && !lists && positional.size() < (events || locate ? 1u : 2u)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (tls && !portSet) port = TR064_TLS_PORT;
+    // --static: the client of fixed size, which takes C string parameters
+    typedef TR064Static<64> StaticClient;
+    std::unique_ptr<TR064> plain;
+    std::unique_ptr<StaticClient> fixed;
+    if (fixedSize) fixed.reset(new StaticClient(port, host, user, pass));
+    else plain.reset(new TR064(port, host, user, pass));
+    TR064& connection = fixed ? *fixed : *plain;
+    connection.debug_level = debug;
+#if defined(TR064_TLS)
+    TR064TlsTransport secure;
+    if (tls) {
+        if (fingerprint && !secure.setFingerprint(fingerprint)) {
+            printf("tls: invalid fingerprint %s\n", fingerprint);
+            return 2;
+        }
+        if (caPath) {
+            FILE* f = fopen(caPath, "rb");
+            std::string pem;
+            char buf[1024];
+            size_t n;
+            while (f && (n = fread(buf, 1, sizeof(buf), f)) > 0) pem.append(buf, n);
+            if (f) fclose(f);
+            if (!secure.setCertificate(pem.c_str())) {
+                printf("tls: no certificate in %s\n", caPath);
+                return 2;
+            }
+        }
+        if (insecure) secure.setInsecure();
+        connection.setTransport(secure);
+    }
+    auto printTls = [&]() {
+        if (!tls) return;
+        const TR064TlsStats& t = secure.stats();
+        printf("tls: %u full handshakes (avg %lluus), %u resumed (avg %lluus), %u failures, %u rejected\n",
+               (unsigned) t.handshakes, (unsigned long long) (t.handshakes ? t.fullUs / t.handshakes : 0),
+               (unsigned) t.resumed, (unsigned long long) (t.resumed ? t.resumedUs / t.resumed : 0),
+               (unsigned) t.failures, (unsigned) t.rejected);
+    };
+#else
+    auto printTls = []() {};
+#endif
+    connection.setKeepAlive(keepAlive);
+    connection.setValidation(validate);
+    TR064FileStorage storage(storePath ? storePath : "");
+    if (storePath) {
+        connection.setStorage(&storage, storeTrust ? TR064_STORAGE_TRUST : TR064_STORAGE_CHECK);
+    }
+    static TR064Metrics collected;
+    if (metrics) {
+        connection.setMetrics(&collected);
+    }
+    TR064Async queue(connection);
+    TR064ResponseCache cache;
+    if (cacheTtl > 0) {
+        cache.setDefaultTTL((uint32_t) cacheTtl);
+        connection.setCache(&cache);
+    }
+    unsigned long polls = 0;
+
+    unsigned long start = micros();
+    TR064SessionState session;
+    FILE* sessionFile = sessionPath ? fopen(sessionPath, "rb") : nullptr;
+    bool resumed = sessionFile && fread(&session, sizeof(session), 1, sessionFile) == 1 && connection.importSession(session);
+    if (sessionFile) fclose(sessionFile);
+    // The other devices of --mesh, with the settings of the main connection
+    TR064Mesh mesh;
+    std::vector<std::unique_ptr<TR064>> peers;
+    if (locate) {
+        mesh.add(connection);
+        for (const std::string& m : meshHosts) {
+            size_t colon = m.rfind(':');
+            uint16_t p = colon == std::string::npos ? port : (uint16_t) atoi(m.c_str() + colon + 1);
+            peers.emplace_back(new TR064(p, String(m.substr(0, colon).c_str()), user, pass));
+            peers.back()->debug_level = debug;
+            peers.back()->setKeepAlive(keepAlive);
+            if (metrics) peers.back()->setMetrics(&collected);
+            if (mesh.add(*peers.back()) < 0) {
+                printf("mesh: more than %d endpoints\n", TR064_MESH_ENDPOINTS);
+                return 2;
+            }
+        }
+    }
+    if (!resumed && locate) mesh.init();
+    else if (!resumed) connection.init();
+    printf("%s: %luus, state %d\n", resumed ? "resume" : "init", micros() - start, connection.state());
+    if (fixed) {
+        printf("static: %zu bytes (%zu for %u of 64 services), %s\n", sizeof(StaticClient), StaticClient::storageSize(),
+               (unsigned) connection.services().size(), StaticClient::errorToString(fixed->lastError()));
+    }
+    if (connection.state() < 0) {
+        printTls();
+        return 1;
+    }
+    uint64_t staticAllocs = 0; // Allocations made by the actions of --static
+
+    bool ok = true;
+    if (locate) {
+        printf("mesh: %u endpoints, %u service registries, %zu bytes\n", mesh.size(), mesh.registries(), mesh.memoryUsage());
+        Stats stats;
+        for (int r = 0; r < repeat; ++r) {
+            if (r > 0 && interval > 0) delay(interval);
+            for (const std::string& mac : positional) {
+                TR064MeshAssociation found[4];
+                unsigned long t = micros();
+                int n = mesh.locate(mac.c_str(), found, 4);
+                stats.samples.push_back(micros() - t);
+                if (r > 0) continue;
+                if (n == 0) printf("%s: not associated\n", mac.c_str());
+                for (int i = 0; i < n && i < 4; ++i) {
+                    printf("%s: #%u %s WLANConfiguration:%u %s %u Mbit/s, signal %u%%\n", mac.c_str(), (unsigned) found[i].endpoint,
+                           mesh.host(found[i].endpoint),
+                           (unsigned) found[i].wlan, found[i].ip, (unsigned) found[i].speed, (unsigned) found[i].signal);
+                }
+            }
+        }
+        for (uint8_t i = 0; i < mesh.size(); ++i) {
+            const TR064MeshStats& e = mesh.stats(i);
+            printf("#%u %-20s requests=%-5u faults=%-5u failures=%-3u min=%8uus avg=%8uus max=%8uus\n", (unsigned) i, mesh.host(i),
+                   (unsigned) e.requests, (unsigned) e.faults, (unsigned) e.failures, (unsigned) e.minUs,
+                   (unsigned) e.averageUs(), (unsigned) e.maxUs);
+        }
+        stats.print("locate");
+    } else if (events) {
+        TR064Events subscriptions(connection);
+        if (!subscriptions.begin((uint16_t) listen)) {
+            printf("events: can not listen on port %d\n", listen);
+            return 1;
+        }
+        printf("events: callback %s\n", subscriptions.callbackURL());
+        unsigned long started = millis();
+        for (const std::string& name : positional) {
+            int handle = subscriptions.subscribe(name.c_str(), printEvent, &started);
+            if (handle < 0) printf("%s: %s\n", name.c_str(), TR064Events::errorToString(handle));
+            ok = handle > 0 && ok;
+        }
+        while (millis() - started < (unsigned long) duration) {
+            subscriptions.poll();
+            delay(5);
+        }
+        subscriptions.end();
+        const TR064EventStats& e = subscriptions.stats();
+        printf("events: %u notifications, %u variables, %u rejected, %u missed, %u subscribes, %u renewals, %u failures\n",
+               (unsigned) e.notifications, (unsigned) e.variables, (unsigned) e.rejected, (unsigned) e.missed,
+               (unsigned) e.subscribes, (unsigned) e.renewals, (unsigned) e.failures);
+    } else if (listServices) {
+        for (TR064Service s : connection.services()) {
+            printf("%-32s %s\n", s.name, s.controlURL);
+        }
+        printf("%u services, %zu bytes\n", connection.services().size(), connection.services().memoryUsage());
+    } else if (describe) {
+        std::vector<std::string> names = positional;
+        if (names.empty()) {
+            for (TR064Service s : connection.services()) names.push_back(s.name);
+        }
+        for (const std::string& name : names) {
+            unsigned long t = micros();
+            const TR064ServiceDescription* d = connection.describe(name.c_str());
+            if (!d) {
+                printf("%s: no description\n", name.c_str());
+                continue;
+            }
+            printf("%s: %u actions, %zu bytes, %luus\n", name.c_str(), d->actions(), d->memoryUsage(), micros() - t);
+            for (uint16_t i = 0; i < d->actions(); ++i) {
+                printf("  %s(", d->actionName(i));
+                for (uint8_t j = 0; j < d->arguments(i); ++j) {
+                    TR064ArgDescriptor arg = d->argument(i, j);
+                    printf("%s%s %s %s", j > 0 ? ", " : "", arg.direction == TR064_ARG_IN ? "in" : "out",
+                           TR064ServiceDescription::typeName(arg.type), arg.name);
+                }
+                printf(")\n");
+            }
+        }
+    } else if (lists) {
+        // The heap that streaming a list takes, whatever its length
+        Stats stats;
+        int n = 0;
+        int64_t peak = 0;
+        for (int r = 0; r < repeat; ++r) {
+            if (r > 0 && interval > 0) delay(interval);
+            bool silent = quiet || r > 0;
+            nativeHeap().peak = nativeHeap().current;
+            int64_t before = nativeHeap().current;
+            unsigned long t = micros();
+            if (calls) n = connection.fetchCallList(printCall, &silent, &filter);
+            else if (phonebook >= 0) n = connection.fetchPhonebook((uint16_t) phonebook, printContact, &silent, &filter);
+            else n = connection.fetchMessages((uint8_t) messages, printMessage, &silent, &filter);
+            unsigned long us = micros() - t;
+            peak = std::max(peak, nativeHeap().peak - before);
+            stats.samples.push_back(us);
+            ok = n >= 0 && ok;
+        }
+        printf("list: %d records, heap peak +%lld bytes\n", n, (long long) peak);
+        stats.print(calls ? "fetchCallList" : phonebook >= 0 ? "fetchPhonebook" : "fetchMessages");
+    } else if (hostTable) {
+        TR064HostTable table;
+        Stats stats;
+        for (int r = 0; r < repeat; ++r) {
+            if (r > 0 && interval > 0) delay(interval);
+            unsigned long t = micros();
+            ok = connection.fetchHosts(table) && ok;
+            stats.samples.push_back(micros() - t);
+        }
+        printf("%u hosts, %u active, %zu bytes\n", table.size(), table.activeCount(), table.memoryUsage());
+        for (const std::string& mac : positional) {
+            TR064Host h;
+            if (table.find(mac.c_str(), h)) {
+                printf("%s: %s %u.%u.%u.%u %s\n", mac.c_str(), h.active ? "active" : "inactive",
+                       h.ip[0], h.ip[1], h.ip[2], h.ip[3], h.name);
+            } else {
+                printf("%s: unknown\n", mac.c_str());
+            }
+        }
+        stats.print("fetchHosts");
+    } else if (sweep) {
+        // Same calls as getStatusOfAllWifi() in the Home_Indicator example
+        Stats total, perCall;
+        for (int r = 0; r < repeat; ++r) {
+            if (r > 0 && interval > 0) delay(interval);
+            unsigned long sweepStart = micros();
+            String params[][2] = {{}};
+            String req[][2] = {{"NewTotalAssociations", ""}};
+            unsigned long t = micros();
+            ok = connection.action("WLANConfiguration:1", "GetTotalAssociations", params, 0, req, 1) && ok;
+            perCall.samples.push_back(micros() - t);
+            int numDev = req[0][1].toInt();
+            if (batch && numDev > 0) {
+                static const char* const outputs[] = {"NewAssociatedDeviceAuthState", "NewAssociatedDeviceMACAddress",
+                                                      "NewAssociatedDeviceIPAddress"};
+                static char table[2048];
+                TR064Batch sweepBatch(connection, table, sizeof(table));
+                t = micros();
+                sweepBatch.addIndexed("WLANConfiguration:1", "GetGenericAssociatedDeviceInfo", "NewAssociatedDeviceIndex",
+                                      0, (uint16_t) numDev, outputs, 3);
+                ok = sweepBatch.run() == numDev && ok;
+                perCall.samples.push_back(micros() - t);
+                for (int i = 0; r == 0 && i < sweepBatch.rows(); ++i) {
+                    printf("%d:\t%s %s %s\n", i, sweepBatch.value(i, 1), sweepBatch.value(i, 2), sweepBatch.value(i, 0));
+                }
+                numDev = 0;
+            }
+            for (int i = 0; descriptors && i < numDev; ++i) {
+                typedef TR064Actions::WLANConfiguration1::GetGenericAssociatedDeviceInfo Info;
+                char mac[18], ip[16];
+                bool auth = false;
+                t = micros();
+                ok = connection.action<Info>(i, &mac, &ip, &auth) && ok;
+                perCall.samples.push_back(micros() - t);
+                if (r == 0) printf("%d:\t%s %s %d\n", i, mac, ip, auth ? 1 : 0);
+            }
+            for (int i = 0; !descriptors && i < numDev; ++i) {
+                String p[][2] = {{"NewAssociatedDeviceIndex", String(i)}};
+                String q[][2] = {{"NewAssociatedDeviceAuthState", ""}, {"NewAssociatedDeviceMACAddress", ""},
+                                 {"NewAssociatedDeviceIPAddress", ""}};
+                t = micros();
+                ok = connection.action("WLANConfiguration:1", "GetGenericAssociatedDeviceInfo", p, 1, q, 3) && ok;
+                perCall.samples.push_back(micros() - t);
+                if (r == 0) printf("%d:\t%s %s %s\n", i, q[1][1].c_str(), q[2][1].c_str(), q[0][1].c_str());
+            }
+            total.samples.push_back(micros() - sweepStart);
+        }
+        perCall.print("action");
+        total.print("sweep");
+    } else {
+        std::vector<std::pair<String, String>> in;
+        std::vector<String> out;
+        std::vector<Typed> typed;
+        bool useTyped = false;
+        for (size_t i = 2; i < positional.size(); ++i) {
+            const std::string& p = positional[i];
+            if (p[0] == '?') {
+                size_t colon = p.find(':');
+                out.push_back(String(p.substr(1, colon == std::string::npos ? std::string::npos : colon - 1).c_str()));
+                typed.push_back(Typed());
+                typed.back().name = out.back().c_str();
+                if (colon != std::string::npos) {
+                    typed.back().type = p.substr(colon + 1);
+                    useTyped = true;
+                }
+            } else {
+                size_t eq = p.find('=');
+                if (eq == std::string::npos) { usage(argv[0]); return 2; }
+                in.push_back(std::make_pair(String(p.substr(0, eq).c_str()), String(p.c_str() + eq + 1)));
+            }
+        }
+        std::vector<String> params(2 * (in.size() + 1)), req(2 * (out.size() + 1));
+        useTyped = (useTyped || fixed) && !async; // TR064Async only extracts Strings
+        std::vector<const char*> cparams(2 * (in.size() + 1));
+        for (size_t i = 0; i < in.size(); ++i) {
+            cparams[2 * i] = in[i].first.c_str();
+            cparams[2 * i + 1] = in[i].second.c_str();
+        }
+        std::vector<TR064Output> outputs(typed.size() + 1);
+        for (size_t i = 0; i < typed.size(); ++i) {
+            if (!binding(typed[i], outputs[i])) { usage(argv[0]); return 2; }
+        }
+        if (every > 0) {
+            TR064Scheduler scheduler(connection);
+            if (rate >= 0) scheduler.setRate((uint16_t) rate);
+            for (size_t i = 0; i < in.size(); ++i) {
+                params[2 * i] = in[i].first;
+                params[2 * i + 1] = in[i].second;
+            }
+            Runs runs;
+            runs.started = millis();
+            runs.req.assign(jobs, std::vector<String>(2 * (out.size() + 1)));
+            for (int j = 0; j < jobs; ++j) {
+                for (size_t i = 0; i < out.size(); ++i) runs.req[j][2 * i] = out[i];
+                int handle = scheduler.every((uint32_t) every, positional[0].c_str(), positional[1].c_str(),
+                                             (String(*)[2]) params.data(), (int) in.size(), (String(*)[2]) runs.req[j].data(),
+                                             (int) out.size(), printRun, &runs);
+                if (handle < 0) {
+                    printf("every: %s\n", TR064Scheduler::errorToString(handle));
+                    return 2;
+                }
+            }
+            while (millis() - runs.started < (unsigned long) duration || scheduler.busy()) {
+                scheduler.poll();
+                ++polls;
+                unsigned long idle = scheduler.idle();
+                delay(idle < 5 ? idle : 5);
+            }
+            const TR064SchedulerStats& e = scheduler.stats();
+            printf("scheduler: %u requests, %u runs, %u coalesced, %u throttled, %u failures, %ums max late, %lu polls\n",
+                   (unsigned) e.requests, (unsigned) e.runs, (unsigned) e.coalesced, (unsigned) e.throttled,
+                   (unsigned) e.failures, (unsigned) e.maxLateMs, polls);
+            ok = e.failures == 0 && ok;
+        }
+        Stats stats;
+        for (int r = 0; every == 0 && r < repeat; ++r) {
+            if (r > 0 && interval > 0) delay(interval);
+            for (size_t i = 0; i < in.size(); ++i) {
+                params[2 * i] = in[i].first;
+                params[2 * i + 1] = in[i].second;
+            }
+            for (size_t i = 0; i < out.size(); ++i) {
+                req[2 * i] = out[i];
+                req[2 * i + 1] = "";
+            }
+            unsigned long t = micros();
+            if (async) {
+                int handle = queue.beginAction(positional[0].c_str(), positional[1].c_str(), (String(*)[2]) params.data(),
+                                               (int) in.size(), (String(*)[2]) req.data(), (int) out.size());
+                while (queue.poll()) ++polls;
+                int result = handle > 0 ? queue.status(handle) : handle;
+                if (result != TR064_ASYNC_DONE) printf("async: %s\n", TR064Async::errorToString(result));
+                ok = result == TR064_ASYNC_DONE && ok;
+            } else if (fixed) {
+                uint64_t allocs = nativeHeap().allocs;
+                bool done = fixed->action(positional[0].c_str(), positional[1].c_str(), (const char* const(*)[2]) cparams.data(),
+                                          (int) in.size(), outputs.data(), (int) typed.size());
+                staticAllocs += nativeHeap().allocs - allocs;
+                if (r == 0) printf("static: first action %llu allocations\n", (unsigned long long) staticAllocs);
+                if (!done && r == 0) printf("static: %s\n", StaticClient::errorToString(fixed->lastError()));
+                ok = done && ok;
+            } else if (useTyped) {
+                ok = connection.action(positional[0].c_str(), positional[1].c_str(), (String(*)[2]) params.data(),
+                                       (int) in.size(), outputs.data(), (int) typed.size()) && ok;
+            } else {
+                ok = connection.action(positional[0].c_str(), positional[1].c_str(), (String(*)[2]) params.data(),
+                                       (int) in.size(), (String(*)[2]) req.data(), (int) out.size()) && ok;
+            }
+            stats.samples.push_back(micros() - t);
+        }
+        for (size_t i = 0; every == 0 && i < out.size(); ++i) {
+            if (useTyped) printTyped(typed[i], outputs[i]);
+            else printf("%s = %s\n", req[2 * i].c_str(), req[2 * i + 1].c_str());
+        }
+        stats.print(positional[1].c_str());
+        if (async) printf("async: %lu polls\n", polls);
+        if (fixed) printf("static: %llu allocations in %d actions\n", (unsigned long long) staticAllocs, repeat);
+    }
+    if (sessionPath && connection.exportSession(session)) {
+        sessionFile = fopen(sessionPath, "wb");
+        if (sessionFile) {
+            fwrite(&session, sizeof(session), 1, sessionFile);
+            fclose(sessionFile);
+        }
+        printf("session: %zu bytes, %u services\n", sizeof(session), session.nServices);
+    }
+    const TR064HttpStats& http = connection.httpStats();
+    printf("http: %u requests, %u connects, %u reuses, %u reconnects\n", (unsigned) http.requests,
+           (unsigned) http.connects, (unsigned) http.reuses, (unsigned) http.reconnects);
+    if (cacheTtl > 0) {
+        const TR064CacheStats& c = cache.stats();
+        printf("cache: %u hits, %u misses, %u stores, %u evictions, %u invalidations, %u entries\n", (unsigned) c.hits,
+               (unsigned) c.misses, (unsigned) c.stores, (unsigned) c.evictions, (unsigned) c.invalidations,
+               (unsigned) cache.size());
+    }
+    printTls();
+    const TR064AuthStats& auth = connection.authStats();
+    printf("auth: %u challenges, %u accepted, %u retries, %u failures\n", (unsigned) auth.challenges,
+           (unsigned) auth.accepted, (unsigned) auth.retries, (unsigned) auth.failures);
+    if (metrics) {
+        collected.writePrometheus(Serial);
+    }
+#if defined(TR064_HEAP_STATS)
+    printf("heap of the last action (%u measured):\n", (unsigned) connection.heapStats().actions);
+    connection.heapStats().print(Serial);
+#endif
+    printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""
+tr064_descriptors.py
+
+Generates src/tr064_descriptors.h: one compile-time descriptor per action of
+the device (see src/tr064_action.h), read from the device description
+(tr64desc.xml) and the SCPD files of its services. The source is either a
+device (http://fritz.box:49000, the description and the SCPD files do not
+need authentication) or a directory holding these files, e.g. the fixtures
+of the fake router.
+
+Usage: tr064_descriptors.py [-o FILE] [--service NAME ...] SOURCE
+
+Example: tr064_descriptors.py -o src/tr064_descriptors.h extras/native/fixtures
+
+MIT License, all text here must be included in any redistribution.
+"""
+
+import argparse
+import os
+import re
+import sys
+import urllib.request
+import xml.etree.ElementTree as ET
+
+SERVICE_PREFIX = "urn:dslforum-org:service:"
+
+TYPES = {
+    "string": "TR064_TYPE_STRING",
+    "boolean": "TR064_TYPE_BOOLEAN",
+    "ui1": "TR064_TYPE_UI1",
+    "ui2": "TR064_TYPE_UI2",
+    "ui4": "TR064_TYPE_UI4",
+    "ui8": "TR064_TYPE_UI8",
+    "i1": "TR064_TYPE_I1",
+    "i2": "TR064_TYPE_I2",
+    "i4": "TR064_TYPE_I4",
+    "i8": "TR064_TYPE_I8",
+    "dateTime": "TR064_TYPE_DATETIME",
+    "uuid": "TR064_TYPE_UUID",
+}
+
+
+def read(source, path):
+    """Returns the content of a file of the device or the directory, None if it is missing."""
+    try:
+        if re.match(r"https?://", source):
+            with urllib.request.urlopen(source.rstrip("/") + path, timeout=10) as r:
+                return r.read()
+        with open(os.path.join(source, path.lstrip("/")), "rb") as f:
+            return f.read()
+    except OSError:
+        return None
+
+
+def strip_ns(root):
+    for e in root.iter():
+        if "}" in e.tag:
+            e.tag = e.tag.split("}", 1)[1]
+    return root
+
+
+def text(e, tag):
+    c = e.find(tag)
+    return c.text.strip() if c is not None and c.text else ""
+
+
+def identifier(name):
+    """C++ identifier of a service or action name, e.g. X_AVM-DE_Homeauto:1 -> X_AVM_DE_Homeauto1."""
+    return re.sub(r"[^A-Za-z0-9_]", "_", name.replace(":", ""))
+
+
+def c_string(s):
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def parse_scpd(data):
+    """Returns [(action, [(argument, direction, type)])], inputs first."""
+    root = strip_ns(ET.fromstring(data))
+    types = {}
+    for v in root.iter("stateVariable"):
+        types[text(v, "name")] = text(v, "dataType")
+    actions = []
+    for a in root.iter("action"):
+        ins, outs = [], []
+        for arg in a.iter("argument"):
+            t = types.get(text(arg, "relatedStateVariable"), "string")
+            entry = (text(arg, "name"), text(arg, "direction"), TYPES.get(t, "TR064_TYPE_STRING"))
+            (ins if entry[1] == "in" else outs).append(entry)
+        actions.append((text(a, "name"), ins + outs))
+    return actions
+
+
+def descriptor(service, action, args):
+    ins = [a for a in args if a[1] == "in"]
+    outs = [a for a in args if a[1] != "in"]
+    urn = SERVICE_PREFIX + service
+    lines = []
+    summary = "`%s(%s)`" % (action, ", ".join(a[0] for a in ins))
+    if outs:
+        summary += " -> " + ", ".join(a[0] for a in outs)
+    lines.append("/// " + summary)
+    lines.append("struct %s {" % identifier(action))
+    lines.append("    typedef TR064Signature<%s> In;" % ", ".join(a[2] for a in ins))
+    lines.append("    typedef TR064Signature<%s> Out;" % ", ".join(a[2] for a in outs))
+    lines.append("    static constexpr TR064ActionInfo info() {")
+    lines.append("        return {%s, tr064HashConst(%s), %s," % (c_string(service), c_string(service), c_string(action)))
+    lines.append("                %s," % c_string(urn + "#" + action))
+    lines.append("                %s," % c_string('<s:Body><u:%s xmlns:u="%s">' % (action, urn)))
+    lines.append("                %s};" % c_string("</u:%s></s:Body></s:Envelope>" % action))
+    lines.append("    }")
+    lines.append("    static const TR064ArgDescriptor* arguments() {")
+    if args:
+        lines.append("        static const TR064ArgDescriptor args[] = {")
+        for name, direction, t in args:
+            lines.append("            {%s, %s, %s}," % (c_string(name), "TR064_ARG_IN" if direction == "in" else "TR064_ARG_OUT", t))
+        lines.append("        };")
+        lines.append("        return args;")
+    else:
+        lines.append("        return nullptr;")
+    lines.append("    }")
+    lines.append("};")
+    return lines
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generates the action descriptors of a TR-064 device.")
+    parser.add_argument("source", help="URL of the device (http://fritz.box:49000) or directory with tr64desc.xml and the SCPD files")
+    parser.add_argument("-o", "--output", help="header to write (default: standard output)")
+    parser.add_argument("--service", action="append", help="only this service, e.g. Hosts:1 (repeatable)")
+    opt = parser.parse_args()
+
+    desc = read(opt.source, "/tr64desc.xml")
+    if desc is None:
+        print("error: cannot read %s/tr64desc.xml" % opt.source, file=sys.stderr)
+        return 1
+    root = strip_ns(ET.fromstring(desc))
+    device = "%s (%s)" % (text(root.find("device"), "modelName"), text(root.find("systemVersion"), "Display"))
+
+    out = []
+    scpds = {}
+    skipped = []
+    for s in root.iter("service"):
+        service = text(s, "serviceType")
+        if service.startswith(SERVICE_PREFIX):
+            service = service[len(SERVICE_PREFIX):]
+        path = text(s, "SCPDURL")
+        if opt.service and service not in opt.service:
+            continue
+        if path not in scpds:
+            data = read(opt.source, path)
+            scpds[path] = parse_scpd(data) if data else None
+        if not scpds[path]:
+            skipped.append(service)
+            continue
+        out.append("")
+        out.append("/// `%s` (`%s`)" % (service, path))
+        out.append("namespace %s {" % identifier(service))
+        for action, args in scpds[path]:
+            out.append("")
+            out.extend(descriptor(service, action, args))
+        out.append("")
+        out.append("} // namespace %s" % identifier(service))
+
+    header = """/*!
+ * @file tr064_descriptors.h
+ *
+ * Descriptors of the actions of %s, generated from its SCPD files
+ * by extras/tools/tr064_descriptors.py. Do not edit; regenerate for other
+ * devices or firmware versions. Use with `TR064::action<Descriptor>()`, e.g.
+ * `tr064.action<TR064Actions::Hosts1::GetSpecificHostEntry>(mac, ...)`.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_descriptors_h
+#define tr064_descriptors_h
+
+#include "tr064_action.h"
+#include "tr064_services.h"
+
+namespace TR064Actions {
+""" % device
+    if skipped:
+        print("skipped (no SCPD): " + " ".join(skipped), file=sys.stderr)
+    result = header + "\n".join(out) + "\n\n} // namespace TR064Actions\n\n#endif\n"
+    if opt.output:
+        with open(opt.output, "w") as f:
+            f.write(result)
+    else:
+        sys.stdout.write(result)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
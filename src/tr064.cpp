@@ -17,7 +17,10 @@
  *
  * This library depends on:<ul>
  * <li>MD5Builder (versions for <a href="https://github.com/esp8266/Arduino/blob/master/cores/esp8266/MD5Builder.cpp" target="_blank">ESP8266</a>, <a href="https://github.com/espressif/arduino-esp32/blob/master/cores/esp32/MD5Builder.h" target="_blank">ESP32</a></li>)
- * <li><a href="https://github.com/esp8266/Arduino/tree/master/libraries/ESP8266HTTPClient" target="_blank">ESP8266HTTPClient</a> (ESP8266) or <a href="https://github.com/espressif/arduino-esp32/tree/master/libraries/HTTPClient" target="_blank">HTTPClient</a> (ESP32)</li></ul>
+ * <li><a href="https://github.com/esp8266/Arduino/tree/master/libraries/ESP8266WiFi" target="_blank">ESP8266WiFi</a> (ESP8266) or <a href="https://github.com/espressif/arduino-esp32/tree/master/libraries/WiFi" target="_blank">WiFi</a> (ESP32)</li></ul>
+ *
+ * The HTTP requests are sent through a `TR064Transport` (see tr064_transport.h),
+ * which makes it possible to build and profile the library natively on Linux.
  *
  * @section author Author
  *
@@ -32,6 +35,16 @@
 
 #include "tr064.h"
 
+/// Sink printing a request body, for debugging.
+class TR064PrintSink : public TR064ByteSink {
+    public:
+        explicit TR064PrintSink(Print& out) : _out(out) {}
+        bool write(const char* data, size_t len) override { _out.write((const uint8_t*) data, len); return true; }
+
+    private:
+        Print& _out;
+};
+
 
 /**************************************************************************/
 /*! 
@@ -54,6 +67,17 @@ TR064::TR064(uint16_t port, const String& ip, const String& user, const String&
     _pass = pass;
     debug_level = DEBUG_NONE;
     this->_state = TR064_NO_SERVICES;
+    _cache = nullptr;
+    _metrics = nullptr;
+    _log = &Serial;
+    _validate = false;
+    _storage = nullptr;
+    _storageMode = TR064_STORAGE_CHECK;
+    _servicesUnverified = false;
+    _fault = 0;
+    _nUsed = 0;
+    clearDescriptions();
+    http.setTransport(&_defaultTransport);
 }
 
 /**************************************************************************/
@@ -66,6 +90,17 @@ TR064::TR064(uint16_t port, const String& ip, const String& user, const String&
 TR064::TR064() {
    debug_level = DEBUG_NONE;
    this->_state = TR064_NO_SERVICES;
+   _cache = nullptr;
+   _metrics = nullptr;
+   _log = &Serial;
+   _validate = false;
+   _storage = nullptr;
+   _storageMode = TR064_STORAGE_CHECK;
+   _servicesUnverified = false;
+   _fault = 0;
+   _nUsed = 0;
+   clearDescriptions();
+   http.setTransport(&_defaultTransport);
 }
 
 
@@ -73,10 +108,17 @@ TR064::TR064() {
 /*!
     @brief  Initializes the library. Needs to be explicitly called.
             There should already be a working connection to the device.
+            If a storage is set (see `setStorage()`), the services are
+            loaded from it if possible, instead of reading the description
+            of the device.
 */
 /**************************************************************************/
 void TR064::init() {
+    if (loadServices()) {
+        return;
+    }
     delay(100); // TODO: REMOVE (after testing, that it still works!)
+    if (_metrics) _metrics->countDelay(100);
     // Get a list of all services and the associated urls        
     initServiceURLs();
 }
@@ -102,82 +144,527 @@ TR064& TR064::setServer(uint16_t port, const String& ip, const String& user, con
     this->_port = port;
     this->_user = user;
     this->_pass = pass;
+    _session.reset();
     return *this;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Fetches a list of all services and the associated URLs for internal use.
+    @brief  Replaces the transport (socket implementation) used to talk to
+            the device, e.g. to use a custom `Client` or to run natively.
+    @return Reference to this object
+
+    @param    transport
+                The transport to be used. It must outlive this object.
 */
 /**************************************************************************/
+TR064& TR064::setTransport(TR064Transport& transport) {
+    http.setTransport(&transport);
+    return *this;
+}
+
 /**************************************************************************/
-void TR064::initServiceURLs() {
-    /* TODO: We should give access to this data for users to inspect the
-     * possibilities of their device(s) - see #9 on Github.
-     */
+/*!
+    @brief  Enables or disables the persistent connection to the device
+            (default: enabled). With keep-alive, consecutive actions reuse
+            one TCP connection; it is reopened transparently if the device
+            closed it. See `httpStats()` for the reuse/reconnect counters.
+    @param    keepAlive
+                Whether to keep the connection open between requests.
+    @return Reference to this object.
+*/
+/**************************************************************************/
+TR064& TR064::setKeepAlive(bool keepAlive) {
+    http.setKeepAlive(keepAlive);
+    return *this;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Puts a cache in front of `action()`: responses of read-only
+            actions (`Get...`) are stored for the TTL configured in the
+            cache, identical calls within the TTL do not touch the network.
+            Other actions drop the cached responses of their service.
+    @param    cache
+                The cache (it must outlive this object) or `nullptr` to
+                disable caching.
+    @return Reference to this object.
+*/
+/**************************************************************************/
+TR064& TR064::setCache(TR064ResponseCache* cache) {
+    _cache = cache;
+    return *this;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Checks the actions and arguments passed to `action()` against
+            the description (SCPD) of the service before sending them.
+            Unknown actions or arguments are rejected without a request.
+            The description of a service is fetched the first time it is
+            used, see `describe()`.
+    @param    validate
+                Whether to check the calls.
+    @return Reference to this object.
+*/
+/**************************************************************************/
+TR064& TR064::setValidation(bool validate) {
+    _validate = validate;
+    return *this;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sets where the debug messages (see `debug_level`) are written
+            to, `Serial` by default. A `TR064LogBuffer` keeps them in RAM
+            instead, so that verbose logging does not block on the UART.
+    @param    out
+                The output (must outlive this object), `nullptr` to drop
+                all messages.
+    @return Reference to this object.
+*/
+/**************************************************************************/
+TR064& TR064::setLogOutput(Print* out) {
+    _log = out;
+    return *this;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Collects latency histograms and error counters of the actions
+            in `metrics`, see `TR064Metrics`. Several connections may share
+            one.
+    @param    metrics
+                The metrics (must outlive this object), `nullptr` to stop
+                collecting.
+    @return Reference to this object.
+*/
+/**************************************************************************/
+TR064& TR064::setMetrics(TR064Metrics* metrics) {
+    _metrics = metrics;
+    return *this;
+}
+
+#if defined(TR064_HEAP_STATS)
+/**************************************************************************/
+/*!
+    @brief  Replaces the probe that measures the heap for `heapStats()`,
+            e.g. by one that counts the allocations of a wrapped `malloc()`.
+    @param    probe
+                The probe (must outlive this object), `nullptr` for the
+                default `TR064SystemHeapProbe`.
+    @return Reference to this object.
+*/
+/**************************************************************************/
+TR064& TR064::setHeapProbe(TR064HeapProbe* probe) {
+    _heap.setProbe(probe);
+    return *this;
+}
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Keeps the services of the device in a storage, so that `init()`
+            does not have to read the description of the device (tens of
+            kilobytes) on every boot. Call before `init()`; the storage must
+            outlive this object.
+    @param    storage
+                The storage, e.g. a `TR064FileStorage`, or `nullptr`.
+    @param    mode
+                `TR064_STORAGE_CHECK` (default): `init()` checks with a HEAD
+                request whether the description changed since the services
+                were stored. `TR064_STORAGE_TRUST`: `init()` sends no
+                request; the description is read again when a call fails
+                with 404 or fault 401 (Invalid Action) or names an unknown
+                service.
+    @return Reference to this object.
+*/
+/**************************************************************************/
+TR064& TR064::setStorage(TR064Storage* storage, uint8_t mode) {
+    _storage = storage;
+    _storageMode = mode;
+    return *this;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the actions of a service and their arguments, as read
+            from its description (SCPD). The description is fetched the
+            first time; the last `TR064_SCPD_CACHE` descriptions are kept.
+            Services sharing a description (e.g. `WLANConfiguration:1`
+            to `3`) share it here as well.
+    @param    service
+                The name of the service, e.g. `Hosts:1`.
+    @return The description (valid until the next call of `describe()`,
+            `action()` with validation or `init()`) or `nullptr` if the
+            service is unknown or its description could not be read.
+*/
+/**************************************************************************/
+const TR064ServiceDescription* TR064::describe(const char* service) {
+    const char* url = state() >= TR064_SERVICES_LOADED ? _services.scpdURL(service) : nullptr;
+    if (!url || !*url) {
+        TR064_LOG(DEBUG_WARNING, "[TR064][describe]<Error> No description of service %s", service);
+        return nullptr;
+    }
+    DescriptionSlot* slot = &_descriptions[0];
+    for (uint8_t i = 0; i < TR064_SCPD_CACHE; ++i) {
+        DescriptionSlot& d = _descriptions[i];
+        if (d.url && strcmp(d.url, url) == 0) {
+            d.used = ++_descriptionClock;
+            return d.description.actions() > 0 ? &d.description : nullptr;
+        }
+        if (slot->url && (!d.url || d.used < slot->used)) {
+            slot = &d;
+        }
+    }
+    // Fetch it into the least recently used slot; a failure is remembered as an empty description
+    slot->url = url;
+    slot->used = ++_descriptionClock;
+    if (!httpRequest(url, nullptr, nullptr, true)) {
+        slot->description.clear();
+        TR064_LOG(DEBUG_ERROR, "[TR064][describe]<Error> Could not get %s", url);
+        return nullptr;
+    }
+    int result = slot->description.parse(http);
+    http.end();
+    if (result != TR064_XML_END) {
+        slot->description.clear();
+        TR064_LOG(DEBUG_ERROR, "[TR064][describe]<Error> Description incomplete: %s", url);
+        return nullptr;
+    }
+    TR064_LOG(DEBUG_INFO, "[TR064][describe] %s: %u actions, %lu bytes", url, (unsigned) slot->description.actions(),
+              (unsigned long) slot->description.memoryUsage());
+    return slot->description.actions() > 0 ? &slot->description : nullptr;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Adds each `<service>` of the device description (its
+            `serviceType`, `controlURL`, `SCPDURL` and `eventSubURL`) to the
+            registry of a `TR064`.
+*/
+/**************************************************************************/
+class TR064ServiceListHandler : public TR064XmlHandler {
+    public:
+        TR064ServiceListHandler(TR064& tr064) : _tr064(tr064) {
+            _serviceKey = _keys.add("service");
+            _typeKey = _keys.add("serviceType");
+            _urlKey = _keys.add("controlURL");
+            _scpdKey = _keys.add("SCPDURL");
+            _eventKey = _keys.add("eventSubURL");
+        }
 
+        const TR064XmlKeys& keys() const { return _keys; }
+
+        void onStart(int key) override {
+            if (key == _serviceKey) {
+                _type.clear();
+                _url.clear();
+                _scpd.clear();
+                _event.clear();
+            } else if (key == _typeKey) {
+                _type.clear();
+            } else if (key == _urlKey) {
+                _url.clear();
+            } else if (key == _scpdKey) {
+                _scpd.clear();
+            } else if (key == _eventKey) {
+                _event.clear();
+            }
+        }
+
+        void onText(int key, const char* text, size_t len) override {
+            if (key == _typeKey) {
+                _type.append(text, len);
+            } else if (key == _urlKey) {
+                _url.append(text, len);
+            } else if (key == _scpdKey) {
+                _scpd.append(text, len);
+            } else if (key == _eventKey) {
+                _event.append(text, len);
+            }
+        }
+
+        bool onEnd(int key) override {
+            if (key != _serviceKey) {
+                return true;
+            }
+            if (_type.len == 0 || _url.len == 0 || _type.truncated || _url.truncated) {
+                TR064_LOG_AT(_tr064, TR064::DEBUG_WARNING, "[TR064][initServiceURLs]<Error> Skipping incomplete service");
+                return true;
+            }
+            TR064_LOG_AT(_tr064, TR064::DEBUG_VERBOSE, "[TR064][initServiceURLs] readServiceName: %s @ readServiceUrl: %s",
+                         _type.text, _url.text);
+            // A truncated SCPD or event URL is dropped, the service just can not be described or subscribed to
+            if (!_tr064._services.add(_type.text, _url.text, _scpd.truncated ? "" : _scpd.text,
+                                      _event.truncated ? "" : _event.text)) {
+                TR064_LOG_AT(_tr064, TR064::DEBUG_ERROR, "[TR064][initServiceURLs]<Error> No room for service %s", _type.text);
+            }
+            return true;
+        }
+
+    private:
+        TR064& _tr064;
+        TR064XmlKeys _keys;
+        int _serviceKey, _typeKey, _urlKey, _scpdKey, _eventKey;
+        TR064XmlText<96> _type;
+        TR064XmlText<96> _url;
+        TR064XmlText<96> _scpd;
+        TR064XmlText<96> _event;
+};
+
+/**************************************************************************/
+/*!
+    @brief  Fetches a list of all services and the associated URLs. They can
+            be inspected through `services()`.
+*/
+/**************************************************************************/
+void TR064::initServiceURLs() {
     _state = TR064_NO_SERVICES;
-    if(httpRequest(_detectPage, "", "", true)){
-            deb_println("[TR064][initServiceURLs] get the Stream ", DEBUG_INFO);
-            int i = 0;
-            while (1) {
-                if (!http.connected()) {
-                    deb_println("[TR064][initServiceURLs] xmlTakeParam : http connection lost", DEBUG_INFO);
-                    break;                      
-                }
-                if (xmlTakeParam(_services[i][0], "serviceType")) {
-                    deb_print("[TR064][initServiceURLs] "+ String(i) + "\treadServiceName: "+ _services[i][0] , DEBUG_VERBOSE);
-                    if (xmlTakeParam(_services[i][1], "controlURL")) {
-                        deb_println(" @ readServiceUrl: "+ _services[i][1], DEBUG_VERBOSE);
-                        i++;
-                    } else {
-                        deb_println(" @ readServiceUrl: NOTFOUND", DEBUG_VERBOSE);
-                        break;
-                    }
-                } else {
-                    deb_println(" @ sErviceType: NOTFOUND", DEBUG_VERBOSE);
-                    break;
-                }
-            }            
-            deb_println("[TR064][initServiceURLs] message: reading done", DEBUG_INFO);                 
+    _servicesUnverified = false;
+    _nUsed = 0;
+    clearDescriptions();
+    _services.clear();
+    char validator[TR064_HTTP_VALIDATOR_BUFFER + 16];
+    if(httpRequest(_detectPage, nullptr, nullptr, true)){
+            TR064_LOG(DEBUG_INFO, "[TR064][initServiceURLs] get the Stream ");
+            descriptionValidator(validator, sizeof(validator));
+            TR064ServiceListHandler handler(*this);
+            TR064XmlTokenizer tokenizer(handler.keys(), handler);
+            if (tokenizer.scan(http) < 0) {
+                // A truncated list must neither be used nor stored, it would outlive the next boot
+                TR064_LOG(DEBUG_ERROR, "[TR064][initServiceURLs]<Error> http connection lost");
+                _services.clear();
+                http.close();
+                return;
+            }
+            _services.finish();
+            TR064_LOG(DEBUG_INFO, "[TR064][initServiceURLs] message: reading done, %u services", (unsigned) _services.size());
+            if (_services.overflowed()) {
+                // An incomplete list would make some actions fail later on, for no visible reason
+                TR064_LOG(DEBUG_ERROR, "[TR064][initServiceURLs]<Error> Service list does not fit, see TR064Static");
+                _state = TR064_SERVICES_OVERFLOW;
+                http.end();
+                return;
+            }
             
     } else {  
-        deb_println("[TR064][initServiceURLs]<Error> initServiceUrls failed", DEBUG_ERROR);  
+        TR064_LOG(DEBUG_ERROR, "[TR064][initServiceURLs]<Error> initServiceUrls failed");  
         return;      
     }
     _state = TR064_SERVICES_LOADED;
     http.end();
+    saveServices(validator);
 }
 
 /**************************************************************************/
 /*!
-    @brief  Generates and returns the XML-header for authentification.
-    @return The XML-header (as `String`).
+    @brief  Loads the services from the storage. In `TR064_STORAGE_CHECK`
+            mode, they are only used if the description of the device did
+            not change since they were stored (see `descriptionValidator()`),
+            which costs a HEAD request instead of downloading and parsing
+            the description.
+    @return true if the services were loaded.
 */
 /**************************************************************************/
-String TR064::generateAuthXML() {
-    String token;
-    if (_nonce == "") {
-        // If we do not have a nonce yet, we need to use a different header
-        token = "<s:Header><h:InitChallenge xmlns:h=\"http://soap-authentication.org/digest/2001/10/\" s:mustUnderstand=\"1\"><UserID>" + _user + "</UserID></h:InitChallenge ></s:Header>";
-    } else {
-        // Otherwise we produce an authorisation header
-        token = generateAuthToken();
-        token = "<s:Header><h:ClientAuth xmlns:h=\"http://soap-authentication.org/digest/2001/10/\" s:mustUnderstand=\"1\"><Nonce>" + _nonce + "</Nonce><Auth>" + token + "</Auth><UserID>" + _user + "</UserID><Realm>" + _realm + "</Realm></h:ClientAuth></s:Header>";
+bool TR064::loadServices() {
+    if (!_storage || !_storage->openRead()) {
+        return false;
+    }
+    char stored[TR064_HTTP_VALIDATOR_BUFFER + 16];
+    _nUsed = 0;
+    bool ok = _services.load(*_storage, stored, sizeof(stored));
+    _storage->close();
+    if (!ok) {
+        TR064_LOG(DEBUG_WARNING, "[TR064][loadServices]<Error> Stored services are invalid");
+        return false;
+    }
+    if (_storageMode == TR064_STORAGE_CHECK) {
+        char current[sizeof(stored)];
+        int httpCode = http.request(_ip.c_str(), _port, "HEAD", _detectPage, nullptr, nullptr);
+        ok = httpCode == TR064_HTTP_CODE_OK && descriptionValidator(current, sizeof(current)) && strcmp(current, stored) == 0;
+        http.end();
+        if (!ok) {
+            TR064_LOG(DEBUG_INFO, "[TR064][loadServices] The description of the device changed (or could not be checked)");
+            _services.clear();
+            return false;
+        }
+    }
+    TR064_LOG(DEBUG_INFO, "[TR064][loadServices] %u services loaded from the storage", (unsigned) _services.size());
+    clearDescriptions();
+    _servicesUnverified = _storageMode == TR064_STORAGE_TRUST;
+    _state = TR064_SERVICES_LOADED;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes the services to the storage, if one is set.
+    @param    validator
+                Identifies the version of the description they were read
+                from, see `descriptionValidator()`.
+*/
+/**************************************************************************/
+void TR064::saveServices(const char* validator) {
+    if (!_storage || _services.size() == 0) {
+        return;
+    }
+    bool ok = _storage->openWrite() && _services.save(*_storage, validator);
+    ok = _storage->close() && ok;
+    if (!ok) {
+        TR064_LOG(DEBUG_ERROR, "[TR064][saveServices]<Error> Could not store the services");
+        _storage->remove();
     }
-    return token;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Returns the authentification token based on the hashed secret and the last nonce.
-    @return The authentification token (as `String`).
+    @brief  Reads the description of the device again, if the services
+            were loaded from the storage without checking them
+            (`TR064_STORAGE_TRUST`) and a call suggests they are outdated.
+    @return true if the services were read again.
 */
 /**************************************************************************/
-String TR064::generateAuthToken() {
-    String token = md5String(_secretH + ":" + _nonce);
-    deb_println("[TR064][generateAuthToken] The auth token is '" + token + "'", DEBUG_INFO);
-    return token;
+bool TR064::refreshServices() {
+    if (!_servicesUnverified) {
+        return false;
+    }
+    TR064_LOG(DEBUG_INFO, "[TR064][refreshServices] Stored services seem outdated, reading the description");
+    // Keep track of the used services, for `exportSession()`
+    char used[TR064_SESSION_SERVICES][TR064_SESSION_NAME];
+    uint8_t nUsed = 0;
+    for (uint8_t i = 0; i < _nUsed; ++i) {
+        const char* name = _services[_used[i]].name;
+        if (strlen(name) < sizeof(used[0])) {
+            strcpy(used[nUsed++], name);
+        }
+    }
+    initServiceURLs();
+    for (uint8_t i = 0; i < nUsed; ++i) {
+        int index = _services.indexOf(used[i], tr064Hash(used[i], strlen(used[i])));
+        if (index >= 0) {
+            useService((uint16_t) index);
+        }
+    }
+    return state() >= TR064_SERVICES_LOADED;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Saves the state of the session before deep sleep: realm, hashed
+            secret and last nonce of the authentication, and the control
+            URLs of the (up to `TR064_SESSION_SERVICES`) most recently used
+            services. Call after the last action, so that the nonce is the
+            one the device expects next.
+    @param    session
+                Receives the state, e.g. to be written to the RTC memory.
+    @return false if there is nothing worth saving (no authentication
+            happened yet).
+*/
+/**************************************************************************/
+bool TR064::exportSession(TR064SessionState& session) {
+    memset(&session, 0, sizeof(session));
+    if (_session.secret()[0] == '\0') {
+        return false;
+    }
+    session.fingerprint = TR064SessionState::fingerprintOf(_ip.c_str(), _port, _user.c_str(), _pass.c_str());
+    snprintf(session.realm, sizeof(session.realm), "%s", _session.realm());
+    snprintf(session.nonce, sizeof(session.nonce), "%s", _session.nonce());
+    snprintf(session.secret, sizeof(session.secret), "%s", _session.secret());
+    for (uint8_t i = 0; i < _nUsed; ++i) {
+        TR064Service s = _services[_used[i]];
+        if (strlen(s.name) >= sizeof(session.services[0].name) || strlen(s.controlURL) >= sizeof(session.services[0].controlURL)) {
+            TR064_LOG(DEBUG_WARNING, "[TR064][exportSession] Service name or URL too long, not saved: %s", s.name);
+            continue;
+        }
+        TR064SessionState::Service& out = session.services[session.nServices++];
+        strcpy(out.name, s.name);
+        strcpy(out.controlURL, s.controlURL);
+    }
+    session.seal();
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Resumes a session saved by `exportSession()`, instead of
+            `init()`: no request is sent. Actions of the saved services
+            then need a single request (two if the nonce expired). Using
+            any other service reads the description of the device, like
+            `init()`.
+    @param    session
+                The saved state.
+    @return false if the state is invalid (e.g. the RTC memory after a
+            power cycle) or belongs to another server or other credentials;
+            call `init()` then.
+*/
+/**************************************************************************/
+bool TR064::importSession(const TR064SessionState& session) {
+    if (!session.valid()
+            || session.fingerprint != TR064SessionState::fingerprintOf(_ip.c_str(), _port, _user.c_str(), _pass.c_str())) {
+        TR064_LOG(DEBUG_INFO, "[TR064][importSession] Session state invalid or of another server");
+        return false;
+    }
+    _state = TR064_NO_SERVICES;
+    _nUsed = 0;
+    clearDescriptions();
+    _services.clear();
+    for (uint8_t i = 0; i < session.nServices; ++i) {
+        if (!_services.add(session.services[i].name, session.services[i].controlURL)) {
+            _services.clear();
+            return false;
+        }
+    }
+    _services.finish();
+    for (uint16_t i = 0; i < _services.size(); ++i) {
+        useService(i);
+    }
+    _session.restore(session.realm, session.secret, session.nonce);
+    // Any other service is looked up in the description, see `refreshServices()`
+    _servicesUnverified = true;
+    _state = TR064_SERVICES_LOADED;
+    return true;
+}
+
+/// Marks a service (index in `_services`) as the most recently used one, see `exportSession()`.
+void TR064::useService(uint16_t index) {
+    uint8_t i = 0;
+    while (i < _nUsed && _used[i] != index) ++i;
+    if (i == _nUsed) {
+        if (_nUsed < TR064_SESSION_SERVICES) {
+            _used[_nUsed++] = index;
+            return;
+        }
+        i = 0; // Drop the least recently used one
+    }
+    for (; i + 1 < _nUsed; ++i) {
+        _used[i] = _used[i + 1];
+    }
+    _used[_nUsed - 1] = index;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Identifies the version of the description of the device, from
+            the head of the response to a request of `_detectPage`: its
+            `ETag`, `Last-Modified` or, if the device sends neither, its
+            length.
+    @param    buf
+                Receives the validator (empty if there is none).
+    @param    len
+                Size of `buf`.
+    @return false if the response carries no validator.
+*/
+/**************************************************************************/
+bool TR064::descriptionValidator(char* buf, size_t len) {
+    if (http.validator()[0] != '\0') {
+        snprintf(buf, len, "%s", http.validator());
+    } else if (http.contentLength() >= 0) {
+        snprintf(buf, len, "length:%ld", http.contentLength());
+    } else {
+        buf[0] = '\0';
+    }
+    return buf[0] != '\0';
 }
 
 /**************************************************************************/
@@ -203,8 +690,8 @@ String TR064::generateAuthToken() {
 */
 /**************************************************************************/
 bool TR064::action(const String& service, const String& act, String params[][2], int nParam,  const String& url) {
-    deb_println("[TR064]", DEBUG_VERBOSE);
-    deb_println("[TR064][action] with parameters", DEBUG_VERBOSE);
+    TR064_LOG(DEBUG_VERBOSE, "[TR064]");
+    TR064_LOG(DEBUG_VERBOSE, "[TR064][action] with parameters");
     String req[][2] = {{}};
     if (action(service, act, params, nParam, req, 0, url)) {
         http.end();
@@ -243,60 +730,430 @@ bool TR064::action(const String& service, const String& act, String params[][2],
 */
 /**************************************************************************/
 bool TR064::action(const String& service, const String& act, String params[][2], int nParam, String (*req)[2], int nReq, const String& url) {
-    deb_println("[TR064][action] with extraction", DEBUG_VERBOSE);
-    
-    int tries = 0; // Keep track on the number of times we tried to request.
-    if (action_raw(service, act, params, nParam, url)) {
-        if (xmlTakeParam(req, nReq)) {
-            deb_println("[TR064][action] extraction complete.", DEBUG_VERBOSE);
-        } else {
-            return false;
-        }
-        deb_println("[TR064][action] Response status: "+ _status +", Tries: "+String(tries), DEBUG_INFO);
-        if (_status == "unauthenticated") {
-            
-            while (_status == "unauthenticated"  && (_nonce == "" || _realm == "") && tries <= 3) {
-                ++tries;
-                deb_println("[TR064][action] No nonce/realm found. Requesting...", DEBUG_INFO);
-                // TODO: Is this request supported by all devices or should we use a different one here?
-                String a[][2] = {{"NewAssociatedDeviceIndex", "1"}};
-                String wlanService = "WLANConfiguration:1", deviceInfo="GetGenericAssociatedDeviceInfo";
-                action_raw(wlanService, deviceInfo, a, 1, "/upnp/control/wlanconfig1");
-                
-                if (xmlTakeParam(req, nReq)) {
-                    deb_println("[TR064][action] extraction complete.", DEBUG_VERBOSE);
-                }
+    TR064_LOG(DEBUG_VERBOSE, "[TR064][action] with extraction");
+    const char* serviceName = TR064ServiceRegistry::stripPrefix(service.c_str());
+    if (_cache && TR064ResponseCache::cacheable(act.c_str())
+            && _cache->lookup(serviceName, act.c_str(), params, nParam, req, nReq)) {
+        TR064_LOG(DEBUG_INFO, "[TR064][action] Answered from the cache.");
+        return true;
+    }
+    bool ok = execute(service, act, params, nParam, req, nReq, nullptr, 0, url);
+    if (ok && _cache) {
+        _cache->store(serviceName, act.c_str(), params, nParam, req, nReq);
+    }
+    return ok;
+}
 
-                if (_nonce == "" || _realm == "") {
-                    ++tries;
-                    deb_println("[TR064][action]<Error> Nonce/realm request not successful!", DEBUG_ERROR);
-                    deb_println("[TR064][action]<Error> Retrying in 5s", DEBUG_ERROR);
-                    delay(5000);
-                }
-                http.end();                
-            }
-            if (tries >= 3) {
-                deb_println("[TR064][action]<error> Giving up the request ", DEBUG_ERROR);
-                http.end();
+/**************************************************************************/
+/*!
+    @brief  This function will call an action on the service of the device
+            with certain parameters and decode the requested outputs
+            straight into variables, without creating `String`s, e.g.
+            `TR064Output out[] = {TR064Output::int32("NewMultimeterPower", &power)}`.
+            Whether each value could be decoded is reported in its
+            `TR064Output::status`. The response cache is not used.
+    @param    service
+                The name of the service you want to adress.
+    @param    act
+                The action you want to perform on the service.
+    @param    params
+                A list of pairs of input parameters and values, e.g
+              `params[][2] = {{ "arg1", "value1" }, { "arg2", "value2" }}`.
+    @param    nParam
+                The number of input parameters you passed.
+    @param    outputs
+                The bindings of the output parameters.
+    @param    nOutputs
+                The number of output parameters you passed.
+    @param    url
+                The url you want to call.
+    @return success state of the call.
+*/
+/**************************************************************************/
+bool TR064::action(const String& service, const String& act, String params[][2], int nParam, TR064Output* outputs, int nOutputs, const String& url) {
+    TR064_LOG(DEBUG_VERBOSE, "[TR064][action] with typed outputs");
+    return execute(service, act, params, nParam, nullptr, 0, outputs, nOutputs, url);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Drops the cached responses of a service before an action that
+            may change its state (anything but `Get...`) is sent. Called by
+            every path that sends an action: `perform()`, `TR064Async` and
+            `TR064Batch`.
+    @param    service
+                The name of the service, without prefix.
+    @param    act
+                The action about to be sent.
+*/
+/**************************************************************************/
+void TR064::invalidateCache(const char* service, const char* act) {
+    if (_cache && !TR064ResponseCache::cacheable(act)) {
+        _cache->invalidate(service);
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sends the request of an action and extracts the outputs (into
+            `req` or `outputs`), obtaining a nonce first and repeating the
+            request if the nonce was rejected.
+    @return success state.
+*/
+/**************************************************************************/
+bool TR064::perform(const char* service, const char* act, TR064SoapEnvelope& envelope, const char* soapaction,
+                    const char* url, String (*req)[2], int nReq, TR064Output* outputs, int nOutputs) {
+    invalidateCache(service, act);
+    TR064ActionMetrics* metrics = _metrics ? _metrics->find(service, act) : nullptr;
+    bool reauth = false; // Repeating the request for the authentication
+    for (int tries = 0; ; ++tries) {
+        if (!_session.ready()) {
+            _heap.phase(TR064_HEAP_AUTH);
+            bool ready = initAuth();
+            observeRequest(metrics, false, 0);
+            if (!ready) {
+                TR064_LOG(DEBUG_ERROR, "[TR064][action]<error> Could not obtain nonce/realm ");
+                ++_session.stats().failures;
+                if (_metrics) _metrics->countCall(metrics, false);
                 return false;
             }
-            return action(service, act, params, nParam, req, nReq, url);
         }
-        deb_println("[TR064][action] Done.", DEBUG_INFO);
+        _heap.phase(reauth ? TR064_HEAP_AUTH : TR064_HEAP_ENVELOPE);
+        _session.prepare(envelope, _user.c_str());
+        _heap.phase(reauth ? TR064_HEAP_AUTH : TR064_HEAP_SEND);
+        bool sent = httpRequest(url, &envelope, soapaction, true);
+        _heap.phase(reauth ? TR064_HEAP_AUTH : TR064_HEAP_PARSE);
+        // The parse time is without the time spent waiting for the body
+        unsigned long parseStart = micros();
+        uint32_t waited = http.timing().receive;
+        bool ok = sent && (outputs ? xmlTakeOutputs(outputs, nOutputs) : xmlTakeParam(req, nReq));
+        uint32_t parseUs = (uint32_t) (micros() - parseStart) - (http.timing().receive - waited);
         http.end();
-        return true;
-        
+        observeRequest(metrics, sent, parseUs);
+        bool unknown = http.status() == TR064_HTTP_CODE_NOT_FOUND || _fault == TR064_CODE_UNKNOWNACTION;
+        if (!ok && unknown && url == _services.find(service) && refreshServices()) {
+            // The control URL was taken from stored services, which are outdated
+            url = findServiceURL(service);
+            continue;
+        }
+        if (!_session.rejected()) {
+            if (ok) {
+                TR064_LOG(DEBUG_INFO, "[TR064][action] Done.");
+            } else {
+                TR064_LOG(DEBUG_ERROR, "[TR064][action]<error> Request Failed ");
+            }
+            if (_metrics) _metrics->countCall(metrics, ok);
+            return ok;
+        }
+        // The nonce was not accepted (e.g. it expired); the response carried a new one
+        if (tries >= TR064_AUTH_MAX_RETRIES) {
+            TR064_LOG(DEBUG_ERROR, "[TR064][action]<error> Giving up the request ");
+            ++_session.stats().failures;
+            if (_metrics) _metrics->countCall(metrics, false);
+            return false;
+        }
+        TR064_LOG(DEBUG_INFO, "[TR064][action] Authentication rejected, retrying with a new nonce");
+        ++_session.stats().retries;
+        if (_metrics) _metrics->countReauth();
+        reauth = true;
     }
-    deb_println("[TR064][action]<error> Request Failed ", DEBUG_ERROR);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Calls an action described by a descriptor, see `action<Descriptor>()`.
+    @param    info
+                The names and request fragments of the action.
+    @param    args
+                The input arguments.
+    @param    nArgs
+                Number of input arguments.
+    @param    outputs
+                The bindings of the output parameters.
+    @param    nOutputs
+                Number of output parameters.
+    @return success state, false if an output could not be decoded.
+*/
+/**************************************************************************/
+bool TR064::execute(const TR064ActionInfo& info, const TR064SoapArg* args, uint8_t nArgs,
+                    TR064Output* outputs, int nOutputs) {
+    TR064_LOG(DEBUG_VERBOSE, "[TR064][action] from descriptor");
+    _heap.begin();
+    TR064SoapEnvelope envelope(info.service, info.action, args, nArgs);
+    envelope.setBody(info.bodyStart, info.bodyEnd);
+    bool ok = perform(info.service, info.action, envelope, info.soapAction, findServiceURL(info.service, info.serviceHash),
+                      nullptr, 0, outputs, nOutputs);
+    _heap.end();
+    if (!ok) {
+        return false;
+    }
+    for (int i = 0; i < nOutputs; ++i) {
+        if (!outputs[i].ok() && outputs[i].status != TR064_OUTPUT_TRUNCATED) {
+            TR064_LOG(DEBUG_ERROR, "[TR064][action]<error> Could not decode %s", outputs[i].name);
+            return false;
+        }
+    }
+    return true;
+}
+
+/// The path of a URL returned by the device, which is relative to the TR-064 port; scheme and host of an absolute URL are stripped.
+static const char* localPath(const char* url) {
+    const char* scheme = strstr(url, "://");
+    if (!scheme) {
+        return url;
+    }
+    const char* path = strchr(scheme + 3, '/');
+    return path ? path : "/";
+}
+
+/**************************************************************************/
+/*!
+    @brief  Fetches the list of all hosts known to the device with a single
+            request (FRITZ!Box: `Hosts:1` `X_AVM-DE_GetHostListPath`) instead
+            of one action per host. The list is streamed into a new
+            snapshot; `table` is only replaced if it was read completely.
+    @param    table
+                Receives the hosts, see `TR064HostTable::isActive()`.
+    @return success state.
+*/
+/**************************************************************************/
+bool TR064::fetchHosts(TR064HostTable& table) {
+    String params[][2] = {{}};
+    String req[][2] = {{"NewX_AVM-DE_HostListPath", ""}};
+    if (!action("Hosts:1", "X_AVM-DE_GetHostListPath", params, 0, req, 1) || req[0][1] == "") {
+        TR064_LOG(DEBUG_ERROR, "[TR064][fetchHosts]<Error> Could not get the path of the host list");
+        return false;
+    }
+    if (!httpRequest(localPath(req[0][1].c_str()), nullptr, nullptr, true)) {
+        TR064_LOG(DEBUG_ERROR, "[TR064][fetchHosts]<Error> Could not get the host list");
+        return false;
+    }
+    TR064HostTable snapshot;
+    int result = snapshot.parse(http);
     http.end();
-    return false;
+    if (result != TR064_XML_END) {
+        TR064_LOG(DEBUG_ERROR, "[TR064][fetchHosts]<Error> Host list incomplete");
+        return false;
+    }
+    TR064_LOG(DEBUG_INFO, "[TR064][fetchHosts] %u hosts, %lu bytes", (unsigned) snapshot.size(),
+              (unsigned long) snapshot.memoryUsage());
+    table.swap(snapshot);
+    return true;
 }
 
 /**************************************************************************/
 /*!
-    @brief  This function will call an action on the service of the device
-            with certain parameters, without error catching etc. Not
-            recommended for direct use.
+    @brief  Streams the call list (`X_AVM-DE_OnTel:1` `GetCallList`): each
+            call is passed to the callback as soon as it was read, newest
+            first, from a window of fixed size. To process only the calls
+            that are new since the last time, keep the highest `id` seen
+            and pass it in the filter.
+    @param    callback
+                Called for each call; returns false to stop reading.
+    @param    context
+                Passed to the callback.
+    @param    filter
+                `max`, `days` and `id`, sent to the device as query
+                parameters of the list, or `nullptr` for the whole list.
+    @return The number of calls passed to the callback or one of the
+            `TR064_LIST_ERROR_*` codes.
+*/
+/**************************************************************************/
+int TR064::fetchCallList(TR064CallCallback callback, void* context, const TR064ListFilter* filter) {
+    int result = openList("X_AVM-DE_OnTel:1", "GetCallList", nullptr, nullptr, "NewCallListURL", filter);
+    if (result < 0) {
+        return result;
+    }
+    int count = 0;
+    result = TR064ListParser::calls(http, filter, callback, context, count);
+    return closeList(result, count);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Streams a phonebook (`X_AVM-DE_OnTel:1` `GetPhonebook`), one
+            contact at a time, see `fetchCallList()`.
+    @param    id
+                The id of the phonebook (0 for the first one).
+    @param    callback
+                Called for each contact; returns false to stop reading.
+    @param    context
+                Passed to the callback.
+    @param    filter
+                Only `max` applies, or `nullptr`.
+    @return The number of contacts passed to the callback or one of the
+            `TR064_LIST_ERROR_*` codes.
+*/
+/**************************************************************************/
+int TR064::fetchPhonebook(uint16_t id, TR064ContactCallback callback, void* context, const TR064ListFilter* filter) {
+    char value[8];
+    snprintf(value, sizeof(value), "%u", (unsigned) id);
+    int result = openList("X_AVM-DE_OnTel:1", "GetPhonebook", "NewPhonebookID", value, "NewPhonebookURL", nullptr);
+    if (result < 0) {
+        return result;
+    }
+    int count = 0;
+    result = TR064ListParser::contacts(http, filter, callback, context, count);
+    return closeList(result, count);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Streams the messages of an answering machine
+            (`X_AVM-DE_TAM:1` `GetMessageList`), see `fetchCallList()`.
+    @param    tam
+                The index of the answering machine.
+    @param    callback
+                Called for each message; returns false to stop reading.
+    @param    context
+                Passed to the callback.
+    @param    filter
+                Only `max` applies, or `nullptr`.
+    @return The number of messages passed to the callback or one of the
+            `TR064_LIST_ERROR_*` codes.
+*/
+/**************************************************************************/
+int TR064::fetchMessages(uint8_t tam, TR064TamMessageCallback callback, void* context, const TR064ListFilter* filter) {
+    char value[4];
+    snprintf(value, sizeof(value), "%u", (unsigned) tam);
+    int result = openList("X_AVM-DE_TAM:1", "GetMessageList", "NewIndex", value, "NewURL", nullptr);
+    if (result < 0) {
+        return result;
+    }
+    int count = 0;
+    result = TR064ListParser::messages(http, filter, callback, context, count);
+    return closeList(result, count);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Asks the device for the URL of a list and starts to fetch it.
+            The URL is kept in a buffer of `TR064_LIST_URL` bytes on the
+            stack, no `String`s are created.
+    @param    service
+                The service, without the `urn:dslforum-org:service:` prefix.
+    @param    act
+                The action returning the URL.
+    @param    argName
+                The name of the only input argument, `nullptr` if none.
+    @param    argValue
+                Its value.
+    @param    output
+                The output argument holding the URL.
+    @param    filter
+                Query parameters to add to the URL (see
+                `TR064ListParser::addFilter()`), or `nullptr`.
+    @return 0 if the body of the list can be read from `http`, else
+            `TR064_LIST_ERROR_URL` or `TR064_LIST_ERROR_FETCH`.
+*/
+/**************************************************************************/
+int TR064::openList(const char* service, const char* act, const char* argName, const char* argValue, const char* output,
+                    const TR064ListFilter* filter) {
+    char url[TR064_LIST_URL];
+    TR064SoapArg arg = {argName, argValue};
+    TR064Output out = TR064Output::text(output, url, sizeof(url));
+    if (!execute(service, act, &arg, argName ? 1 : 0, nullptr, 0, &out, 1, nullptr) || !out.ok() || url[0] == '\0') {
+        TR064_LOG(DEBUG_ERROR, "[TR064][fetchList]<Error> Could not get the URL of %s %s", service, act);
+        return TR064_LIST_ERROR_URL;
+    }
+    if (!TR064ListParser::addFilter(url, sizeof(url), filter)) {
+        TR064_LOG(DEBUG_ERROR, "[TR064][fetchList]<Error> URL too long for the filter");
+        return TR064_LIST_ERROR_URL;
+    }
+    if (!httpRequest(localPath(url), nullptr, nullptr, true)) {
+        TR064_LOG(DEBUG_ERROR, "[TR064][fetchList]<Error> Could not get the list");
+        http.end();
+        return TR064_LIST_ERROR_FETCH;
+    }
+    return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Ends the request of a list after it was parsed.
+    @param    result
+                The result of the parser.
+    @param    count
+                The number of records passed on.
+    @return `count` or `TR064_LIST_ERROR_INCOMPLETE`.
+*/
+/**************************************************************************/
+int TR064::closeList(int result, int count) {
+    if (result == TR064_XML_STOPPED) {
+        // Reading the rest of a long list only to reuse the connection would take longer than a new one
+        http.close();
+    } else {
+        http.end();
+    }
+    if (result < 0) {
+        TR064_LOG(DEBUG_ERROR, "[TR064][fetchList]<Error> List incomplete after %d records: %s", count,
+                  TR064HttpClient::errorToString(result));
+        return TR064_LIST_ERROR_INCOMPLETE;
+    }
+    TR064_LOG(DEBUG_INFO, "[TR064][fetchList] %d records", count);
+    return count;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Obtains the realm and a first nonce from the device. Sends an
+            `InitChallenge` with `DeviceInfo:1#GetSecurityPort`, which every
+            TR-064 device implements and which needs no authentication.
+    @return success state.
+*/
+/**************************************************************************/
+bool TR064::initAuth() {
+    TR064_LOG(DEBUG_INFO, "[TR064][initAuth] No nonce/realm found. Requesting...");
+    ++_session.stats().challenges;
+    if (_metrics) _metrics->countChallenge();
+    const char* url = _services.find("DeviceInfo:1");
+    if (!url) {
+        url = "/upnp/control/deviceinfo";
+    }
+    TR064SoapEnvelope envelope("DeviceInfo:1", "GetSecurityPort");
+    envelope.setInitChallenge(_user.c_str());
+    bool ok = httpRequest(url, &envelope, "urn:dslforum-org:service:DeviceInfo:1#GetSecurityPort", true)
+        && xmlTakeParam(nullptr, 0);
+    http.end();
+    if (!ok || !_session.ready()) {
+        TR064_LOG(DEBUG_ERROR, "[TR064][initAuth]<Error> Nonce/realm request not successful!");
+        return false;
+    }
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Adds the durations of the last request (see
+            `TR064HttpClient::timing()`) to the metrics of an action.
+    @param    action
+                The metrics of the action, see `TR064Metrics::find()`.
+    @param    parsed
+                Whether the outputs were extracted from the response.
+    @param    parseUs
+                The time that took, without waiting for data.
+*/
+/**************************************************************************/
+void TR064::observeRequest(TR064ActionMetrics* action, bool parsed, uint32_t parseUs) {
+    if (!_metrics) return;
+    const TR064HttpTiming& t = http.timing();
+    if (t.connect > 0) {
+        _metrics->observe(action, TR064_METRICS_CONNECT, t.connect);
+    }
+    if (http.status() <= 0) {
+        return; // No response
+    }
+    _metrics->observe(action, TR064_METRICS_FIRST_BYTE, t.firstByte);
+    _metrics->observe(action, TR064_METRICS_RECEIVE, t.receive);
+    if (parsed) {
+        _metrics->observe(action, TR064_METRICS_PARSE, parseUs);
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Builds the request of an action from `String`s and sends it,
+            see `perform()`.
     @param    service
                 The name of the service you want to adress.
     @param    act
@@ -306,44 +1163,94 @@ bool TR064::action(const String& service, const String& act, String params[][2],
               `params[][2] = {{ "arg1", "value1" }, { "arg2", "value2" }}`.
     @param    nParam
                 The number of input parameters you passed (in `params`).
+    @param    req
+                The response parameters (if `outputs` is `nullptr`).
+    @param    nReq
+                The number of response parameters.
+    @param    outputs
+                The bindings of the output parameters.
+    @param    nOutputs
+                The number of output parameters.
     @param    url
                 The url you want to call.
     @return success state.
 */
 /**************************************************************************/
+bool TR064::execute(const String& service, const String& act, String params[][2], int nParam, String (*req)[2], int nReq,
+                    TR064Output* outputs, int nOutputs, const String& url) {
+    const char* serviceName = TR064ServiceRegistry::stripPrefix(service.c_str());
+    if (nParam > TR064_SOAP_MAX_ARGS) {
+        TR064_LOG(DEBUG_ERROR, "[TR064][action]<Error> Too many parameters");
+        return false;
+    }
+    if (_validate && !validate(serviceName, act.c_str(), params, nParam, req, nReq, outputs, nOutputs)) {
+        return false;
+    }
+    // Reference the request-parameters, the envelope is written straight to the connection
+    TR064SoapArg args[TR064_SOAP_MAX_ARGS];
+    for (int i = 0; i < nParam; ++i) {
+        args[i].name = params[i][0].c_str();
+        args[i].value = params[i][1].c_str();
+    }
+    return execute(serviceName, act.c_str(), args, (uint8_t) (nParam > 0 ? nParam : 0), req, nReq, outputs, nOutputs,
+                   url != "" ? url.c_str() : nullptr);
+}
 
-bool TR064::action_raw(const String& service, const String& act, String params[][2], int nParam, const String& url) {
-    // Generate the XML-envelop
-    String serviceName = cleanOldServiceName(service);
-    String xml = _requestStart + generateAuthXML() + "<s:Body><u:"+act+" xmlns:u=\"" + _servicePrefix + serviceName + "\">";
-    // Add request-parameters to XML
-    if (nParam > 0) {
-        for (uint16_t i=0; i<nParam; ++i) {
-            if (params[i][0] != "") {
-                deb_println("[TR064][action_raw] with parameter, "+params[i][0], DEBUG_VERBOSE);
-                deb_println("[TR064][action_raw] with parametervalue, "+params[i][1], DEBUG_VERBOSE);
-                xml += "<"+params[i][0]+">"+params[i][1]+"</"+params[i][0]+">";
-            }
+/**************************************************************************/
+/*!
+    @brief  Calls an action with arguments that are already referenced as
+            C strings (see `execute()` above and `TR064Static::action()`).
+    @param    service
+                The name of the service, without the `urn:dslforum-org:service:` prefix.
+    @param    act
+                The action you want to perform on the service.
+    @param    args
+                The input arguments.
+    @param    nArgs
+                Number of input arguments (at most `TR064_SOAP_MAX_ARGS`).
+    @param    req
+                The response parameters (if `outputs` is `nullptr`).
+    @param    nReq
+                The number of response parameters.
+    @param    outputs
+                The bindings of the output parameters.
+    @param    nOutputs
+                The number of output parameters.
+    @param    url
+                The url you want to call, `nullptr` for the control URL of
+                the service.
+    @return success state.
+*/
+/**************************************************************************/
+bool TR064::execute(const char* service, const char* act, const TR064SoapArg* args, uint8_t nArgs, String (*req)[2], int nReq,
+                    TR064Output* outputs, int nOutputs, const char* url) {
+    _heap.begin();
+    for (uint8_t i = 0; i < nArgs; ++i) {
+        if (args[i].name[0] != '\0') {
+            TR064_LOG(DEBUG_VERBOSE, "[TR064][action] with parameter, %s", args[i].name);
+            TR064_LOG(DEBUG_VERBOSE, "[TR064][action] with parametervalue, %s", args[i].value);
         }
     }
-    // Close the envelop
-    xml += "</u:" + act + "></s:Body></s:Envelope>";
-    
+    TR064SoapEnvelope envelope(service, act, args, nArgs);
+
     // The SOAPACTION-header is in the format service#action
-    String soapaction = _servicePrefix + serviceName+"#"+act;
-    
-    // Send the http-Request
-    if (url != "") {
-        return httpRequest(url, xml, soapaction, true);
-    } else {
-        return httpRequest(findServiceURL(_servicePrefix + serviceName), xml, soapaction, true);
+    char soapaction[TR064_SOAP_ACTION_BUFFER];
+    if (TR064SoapEnvelope::soapAction(soapaction, sizeof(soapaction), service, act) >= sizeof(soapaction)) {
+        TR064_LOG(DEBUG_ERROR, "[TR064][action]<Error> Service/action name too long");
+        _heap.end();
+        return false;
     }
+    bool ok = perform(service, act, envelope, soapaction, url ? url : findServiceURL(service),
+                      req, nReq, outputs, nOutputs);
+    _heap.end();
+    return ok;
 }
 
 /**************************************************************************/
 /*!
     @brief  Returns the State of Service Load
-    @return The State. TR064_NO_SERVICES / TR064_SERVICES_LOADED
+    @return The State. TR064_NO_SERVICES / TR064_SERVICES_LOADED /
+            TR064_SERVICES_OVERFLOW
 */
 /**************************************************************************/
 int TR064::state() {    
@@ -393,18 +1300,48 @@ String TR064::errorToString(int error)
 
 /**************************************************************************/
 /*!
-    @brief  Helper function, which deletes the prefix before the servicename.
-    @param    service
-                The name of the service you want to adress.
-    @return String servicename without prefix
+    @brief  Checks an action and the names of its arguments against the
+            description of the service, see `setValidation()`.
+    @return false if the service does not have the action or one of the
+            arguments; true if they are valid or can not be checked.
 */
 /**************************************************************************/
-String TR064::cleanOldServiceName(const String& service) {
-    deb_println("[TR064][cleanOldServiceName] searching for prefix in servicename: "+service, DEBUG_VERBOSE);
-    if (service.startsWith(_servicePrefix)) {
-        return service.substring(strlen(_servicePrefix));        
+bool TR064::validate(const char* service, const char* act, String params[][2], int nParam, String (*req)[2], int nReq,
+                     const TR064Output* outputs, int nOutputs) {
+    const TR064ServiceDescription* d = describe(service);
+    if (!d) {
+        return true;
+    }
+    int a = d->findAction(act);
+    if (a < 0) {
+        TR064_LOG(DEBUG_ERROR, "[TR064][action]<Error> Unknown action %s %s", service, act);
+        return false;
+    }
+    for (int i = 0; i < nParam; ++i) {
+        if (params[i][0] != "" && d->findArgument((uint16_t) a, params[i][0].c_str(), TR064_ARG_IN) < 0) {
+            TR064_LOG(DEBUG_ERROR, "[TR064][action]<Error> Unknown input argument %s", params[i][0].c_str());
+            return false;
+        }
     }
-    return service;
+    int n = outputs ? nOutputs : nReq;
+    for (int i = 0; i < n; ++i) {
+        const char* name = outputs ? outputs[i].name : req[i][0].c_str();
+        if (d->findArgument((uint16_t) a, name, TR064_ARG_OUT) < 0) {
+            TR064_LOG(DEBUG_ERROR, "[TR064][action]<Error> Unknown output argument %s", name);
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Drops the cached service descriptions (their URLs point into the service registry).
+void TR064::clearDescriptions() {
+    for (uint8_t i = 0; i < TR064_SCPD_CACHE; ++i) {
+        _descriptions[i].description.clear();
+        _descriptions[i].url = nullptr;
+        _descriptions[i].used = 0;
+    }
+    _descriptionClock = 0;
 }
 
 /**************************************************************************/
@@ -412,23 +1349,65 @@ String TR064::cleanOldServiceName(const String& service) {
     @brief  Helper function, which returns the (relative) URL for a service.
     @param    service
                 The name of the service you want to adress.
-    @return String containing the (relative) URL for a service
+    @return The (relative) URL for a service, empty if it is unknown
 */
 /**************************************************************************/
-String TR064::findServiceURL(const String& service) {
+const char* TR064::findServiceURL(const char* service) {
+    service = TR064ServiceRegistry::stripPrefix(service);
+    return findServiceURL(service, tr064Hash(service, strlen(service)));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the (relative) URL for a service among the loaded
+            services, without ever downloading the description. For the
+            queued and batched actions (`TR064Async`, `TR064Batch`), which
+            must not block and may share the connection with a request in
+            progress.
+    @param    service
+                The name of the service.
+    @return The (relative) URL for a service, empty if it is unknown
+*/
+/**************************************************************************/
+const char* TR064::knownServiceURL(const char* service) {
+    service = TR064ServiceRegistry::stripPrefix(service);
+    const char* url = findServiceURL(service, tr064Hash(service, strlen(service)), false);
+    if (url[0] == '\0' && _servicesUnverified) {
+        TR064_LOG(DEBUG_WARNING, "[TR064][findServiceURL] The services are from the storage, a blocking action reloads them");
+    }
+    return url;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the (relative) URL for a service, whose `tr064Hash()`
+            is known.
+    @param    service
+                The name of the service, without the `urn:dslforum-org:service:` prefix.
+    @param    hash
+                The hash of the name.
+    @param    refresh
+                Whether unverified services (see `refreshServices()`) may be
+                reloaded from the device if the service is not among them.
+    @return The (relative) URL for a service, empty if it is unknown
+*/
+/**************************************************************************/
+const char* TR064::findServiceURL(const char* service, uint32_t hash, bool refresh) {
     if (state() < TR064_SERVICES_LOADED) {
-        deb_println("[TR064][findServiceURL]<error> Services NOT Loaded. ", DEBUG_ERROR);
+        TR064_LOG(DEBUG_ERROR, "[TR064][findServiceURL]<error> Services NOT Loaded. ");
         return "";
     } else {
-    
-        deb_println("[TR064][findServiceURL] searching for service: "+service, DEBUG_VERBOSE);
-
-        for (uint16_t i=0; i < arr_len(_services); ++i) {            
-            if (service.equalsIgnoreCase(_services[i][0])) {
-                deb_println("[TR064][findServiceURL] found services: "+service+" = "+ _services[i][0]+" , "+ _services[i][1], DEBUG_VERBOSE);
-                return _services[i][1];
-            }
+        int index = _services.indexOf(service, hash);
+        if (index < 0 && refresh && refreshServices()) {
+            index = _services.indexOf(service, hash);
+        }
+        if (index >= 0) {
+            const char* url = _services[index].controlURL;
+            useService((uint16_t) index);
+            TR064_LOG(DEBUG_VERBOSE, "[TR064][findServiceURL] found services: %s , %s", service, url);
+            return url;
         }
+        TR064_LOG(DEBUG_WARNING, "[TR064][findServiceURL]<Error> Unknown service: %s", service);
     }
     return "";
 }
@@ -437,62 +1416,72 @@ String TR064::findServiceURL(const String& service) {
 /**************************************************************************/
 /*!
     @brief  Transmits a http-Request to the given url (relative to _ip on _port)
-            - if specified POSTs xml and adds soapaction as header field.
+            - if specified POSTs the body and adds soapaction as header field.
             - otherwise just GETs the url
     @param    url
                 The service URL
+    @param    body
+                The request body (e.g. a `TR064SoapEnvelope`) or `nullptr`
     @param    soapaction
                 The requested action
-    @param    xml
-                The request XML
     @param    retry
-                Should the request be repeated with a new nonce, if it fails?
+                Should the request be repeated (after 1s) if it failed before
+                the device could have seen it? Never after a timeout.
     @return success state.
 */
 /**************************************************************************/
-bool TR064::httpRequest(const String& url, const String& xml, const String& soapaction, bool retry) {
-    if (url=="") {
-        deb_println("[TR064][httpRequest] URL is empty, abort http request.", DEBUG_INFO);
+bool TR064::httpRequest(const char* url, const TR064RequestBody* body, const char* soapaction, bool retry) {
+    if (!url || url[0] == '\0') {
+        TR064_LOG(DEBUG_INFO, "[TR064][httpRequest] URL is empty, abort http request.");
         return false;
     }
-    deb_println("[TR064][httpRequest] prepare request to URL: http://" + _ip + ":" + _port + url, DEBUG_INFO);
-    http.setReuse(true);
-    http.begin(tr064client, _ip, _port, url);
-    
-    if (soapaction != "") {
-        http.addHeader("CONTENT-TYPE", "text/xml"); //; charset=\"utf-8\"
-        http.addHeader("SOAPACTION", soapaction);
-    }
+    TR064_LOG(DEBUG_INFO, "[TR064][httpRequest] prepare request to URL: http://%s:%u%s", _ip.c_str(), (unsigned) _port, url);
 
     int httpCode=0;
-    if (xml!= "") {
-        deb_println("[TR064][httpRequest] Posting XML:", DEBUG_INFO);
-        deb_println("[TR064][httpRequest] ---------------------------------", DEBUG_VERBOSE);
-        deb_println(xml, DEBUG_VERBOSE);
-        deb_println("[TR064][httpRequest] ---------------------------------\n", DEBUG_VERBOSE);
+    _fault = 0;
+    _session.beginResponse();
+    if (body) {
+        TR064_LOG(DEBUG_INFO, "[TR064][httpRequest] Posting XML:");
+        if (TR064_LOG_ENABLED(DEBUG_VERBOSE)) {
+            TR064_LOG(DEBUG_VERBOSE, "[TR064][httpRequest] ---------------------------------");
+            TR064PrintSink printer(*_log);
+            body->writeTo(printer);
+            _log->println();
+            TR064_LOG(DEBUG_VERBOSE, "[TR064][httpRequest] ---------------------------------\n");
+        }
         
-        httpCode = http.POST(xml);
-        deb_println("[TR064][httpRequest] POST... SOAPACTION: '" + soapaction + "'", DEBUG_VERBOSE);
+        httpCode = http.request(_ip.c_str(), _port, "POST", url, soapaction, body);
+        TR064_LOG(DEBUG_VERBOSE, "[TR064][httpRequest] POST... SOAPACTION: '%s'", soapaction);
     } else {
-        httpCode = http.GET();
-        deb_println("[TR064][httpRequest] GET...", DEBUG_VERBOSE);
+        httpCode = http.request(_ip.c_str(), _port, "GET", url, nullptr, nullptr);
+        TR064_LOG(DEBUG_VERBOSE, "[TR064][httpRequest] GET...");
     }
 
     // httpCode will be negative on error
-    deb_println("[TR064][httpRequest] Response code: " + String(httpCode), DEBUG_INFO);
+    if (_metrics) _metrics->countHttp(httpCode);
+    TR064_LOG(DEBUG_INFO, "[TR064][httpRequest] Response code: %d", httpCode);
     if (httpCode > 0) {
         // HTTP header has been send and Server response header has been handled
         
-        if (httpCode == HTTP_CODE_OK) {
+        if (httpCode == TR064_HTTP_CODE_OK) {
             return true;
         } else {
-            if (httpCode == HTTP_CODE_INTERNAL_SERVER_ERROR) { 
-                String req[][2] = {{"errorCode",""},{"errorDescription",""}};
-                if (xmlTakeParam(req, 2)) {                                
-                    if (req[0][1] != "") {
-                        deb_println("[TR064][httpRequest] <TR064> Failed, errorCode: '" + req[0][1]  + "'", DEBUG_VERBOSE);                    
-                        deb_println("[TR064][httpRequest] <TR064> Failed, message: '" + errorToString(req[0][1].toInt())  + "'", DEBUG_ERROR);
-                        deb_println("[TR064][httpRequest] <Error> Failed, description: '" + req[1][1] + "'", DEBUG_VERBOSE);
+            if (httpCode == TR064_HTTP_CODE_INTERNAL_SERVER_ERROR || httpCode == TR064_HTTP_CODE_SERVICE_UNAVAILABLE) {
+                // Faults (and rejected authentication) come with a challenge for the next request
+                int32_t code = 0;
+                char description[64];
+                TR064Output fault[] = {
+                    TR064Output::int32("errorCode", &code),
+                    TR064Output::text("errorDescription", description, sizeof(description)),
+                };
+                if (xmlTakeOutputs(fault, 2)) {
+                    if (fault[0].ok()) {
+                        _fault = code;
+                        if (_metrics) _metrics->countFault(_fault);
+                        TR064_LOG(DEBUG_VERBOSE, "[TR064][httpRequest] <TR064> Failed, errorCode: '%d'", _fault);
+                        TR064_LOG(DEBUG_ERROR, "[TR064][httpRequest] <TR064> Failed, message: '%s'", errorToString(_fault).c_str());
+                        TR064_LOG(DEBUG_VERBOSE, "[TR064][httpRequest] <Error> Failed, description: '%s'",
+                                  fault[1].status == TR064_OUTPUT_MISSING ? "" : description);
                     }
                 }
                     
@@ -504,17 +1493,24 @@ bool TR064::httpRequest(const String& url, const String& xml, const String& soap
         // Error
         // TODO: Proper error-handling? See also #12 on github
         
-        String httperr = http.errorToString(httpCode).c_str();
-
-        deb_println("[TR064][httpRequest]<Error> Failed, message: '" + httperr + "'", DEBUG_ERROR);
+        TR064_LOG(DEBUG_ERROR, "[TR064][httpRequest]<Error> Failed, message: '%s'", TR064HttpClient::errorToString(httpCode));
 
-        if (retry) {
-            _nonce = "";
-            deb_println("[TR064][httpRequest] <Error> Trying again in 1s.", DEBUG_ERROR);
+        // After a timeout or an invalid response, the device may have carried out the request already
+        bool unseen = httpCode == TR064_HTTP_ERROR_CONNECTION_FAILED || httpCode == TR064_HTTP_ERROR_SEND_FAILED
+            || http.retryable();
+        if (retry && unseen) {
+            TR064_LOG(DEBUG_ERROR, "[TR064][httpRequest] <Error> Trying again in 1s.");
             delay(1000);
-            return httpRequest(url, xml, soapaction, false);
+            if (_metrics) {
+                _metrics->countRetry();
+                _metrics->countDelay(1000);
+            }
+            // The body may reference the nonce, so it is only dropped if the retry fails as well. If
+            // that succeeded, the nonce is still valid or its response brings the next one.
+            return httpRequest(url, body, soapaction, false);
         } else {
-            deb_println("[TR064][httpRequest] <Error> Giving up.", DEBUG_ERROR);
+            TR064_LOG(DEBUG_ERROR, "[TR064][httpRequest] <Error> Giving up.");
+            _session.invalidate();
             return false;
         }
     }    
@@ -559,141 +1555,84 @@ String TR064::byte2hex(byte number) {
 
 /**************************************************************************/
 /*!
-    @brief  Extract the content of an XML element with a certain tag. It
-            tries with case-sensitive
-            matching first, but resorts to case-insensitive matching, when
-            failing.
-    @param    inStr
-                The XML from which to extract.
-    @param    needParam
-                The name of the XML tag, you want the content of.
-    @return success state.
+    @brief  Reads the body of the current response and decodes the requested
+            XML elements into the bound variables, see `TR064Output`.
+    @param    outputs
+                The bindings.
+    @param    nOutputs
+                Number of elements in `outputs`.
+    @return success state (false if the connection failed while reading).
 */
 /**************************************************************************/
-bool TR064::xmlTakeParam(String (*params)[2], int nParam) {
-    WiFiClient * stream = &tr064client;    
-    stream->Stream::setTimeout(40);
-    while (stream->connected()) {
-        if (!http.connected()) {
-            deb_println("[TR064][xmlTakeParam] http connection lost", DEBUG_INFO);
-            return false;                      
-        }
-        if (stream->find("<")) {
-            const String htmltag = stream->readStringUntil('>');
-            deb_println("[TR064][xmlTakeParam] htmltag: "+htmltag, DEBUG_VERBOSE);
-            const String value = stream->readStringUntil('<');
-            
-
-            if (nParam > 0) {
-                for (uint16_t i=0; i<nParam; ++i) {
-                    if(htmltag.equalsIgnoreCase(params[i][0])){
-                        params[i][1] = value; 
-                        deb_println("[TR064][action] found requestparameter: "+params[i][0]+" = "+params[i][1], DEBUG_VERBOSE);
-                    }   
-                }
-            }            
-            if (htmltag.equalsIgnoreCase("Nonce")) {
-                _nonce = value;
-                deb_println("[TR064][xmlTakeParam] Extracted the nonce '" + _nonce + "' from the last respuest.", DEBUG_INFO);
-            }  
-            if (_realm == "" && htmltag.equalsIgnoreCase("Realm")) {
-                _realm = value;
-                // Now we have everything to generate our hashed secret.
-                String secr = _user + ":" + _realm + ":" + _pass;
-                deb_println("[TR064][xmlTakeParam] Your secret is is '" + secr + "'", DEBUG_INFO);
-                _secretH = md5String(secr);
-                deb_println("[TR064][xmlTakeParam] Your hashed secret is '" + _secretH + "'", DEBUG_INFO);
-            }
-            if (htmltag.equalsIgnoreCase("Status")) {             
-                _status = value;
-                _status.toLowerCase();
-                deb_println("[TR064][xmlTakeParam] Response status: "+ _status , DEBUG_INFO);
-            }
-            if (htmltag.equalsIgnoreCase("errorCode")) {
-                deb_println("[TR064][xmlTakeParam] <TR064> Failed, errorCode: '" + value  + "'", DEBUG_VERBOSE);
-                deb_println("[TR064][xmlTakeParam] <TR064> Failed, message: '" + errorToString(value.toInt())  + "'", DEBUG_VERBOSE);
-            }
-            if (htmltag.equalsIgnoreCase("errorDescription")) {
-                deb_println("[TR064][xmlTakeParam] <TR064> Failed, errorDescription: " + value, DEBUG_VERBOSE);
-            }
-            
-        } else {
-            break;    
-        }
+bool TR064::xmlTakeOutputs(TR064Output* outputs, int nOutputs) {
+    if (nOutputs > TR064_XML_MAX_KEYS - 5) {
+        TR064_LOG(DEBUG_ERROR, "[TR064][xmlTakeOutputs]<Error> Too many parameters requested");
+        nOutputs = TR064_XML_MAX_KEYS - 5;
+    }
+    const char* names[TR064_XML_MAX_KEYS];
+    for (int i = 0; i < nOutputs; ++i) {
+        names[i] = outputs[i].name;
+    }
+    TR064OutputDecoder decoder;
+    decoder.begin(outputs, nOutputs);
+    TR064ResponseHandler handler(*this);
+    handler.begin(names, nOutputs, decoder);
+    TR064XmlTokenizer tokenizer(handler.keys(), handler);
+    int result = tokenizer.scan(http);
+    if (result < 0) {
+        TR064_LOG(DEBUG_ERROR, "[TR064][xmlTakeOutputs]<Error> Failed, message: '%s'", TR064HttpClient::errorToString(result));
+        return false;
     }
     return true;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Extract the content of an XML element with a certain tag. It
-            tries with case-sensitive
-            matching first, but resorts to case-insensitive matching, when
-            failing.
-    @param    inStr
-                The XML from which to extract.
-    @param    needParam
-                The name of the XML tag, you want the content of.
-    @return success state.
+    @brief  Reads the body of the current response and extracts the content
+            of the requested XML elements (case-insensitive). The body is
+            streamed through a `TR064XmlTokenizer`; only the requested values
+            are stored. Also picks up the authentication elements.
+    @param    params
+                Array of {element name, value} pairs. The values are filled in.
+    @param    nParam
+                Number of elements in `params`.
+    @return success state (false if the connection failed while reading).
 */
 /**************************************************************************/
-bool TR064::xmlTakeParam(String& value, const String& needParam) {
-    WiFiClient * stream = &tr064client;
-    stream->Stream::setTimeout(40);
-    while (stream->connected()) {
-        if (!http.connected()) {
-            deb_println("[TR064][xmlTakeParam] http connection lost", DEBUG_INFO);
-            return false;                      
-        }
-       
-        if (stream->find("<")) {
-            const String htmltag = stream->readStringUntil('>');
-           // deb_println("[TR064][xmlTakeParam] htmltag: "+htmltag, DEBUG_VERBOSE);
-            if (htmltag.equalsIgnoreCase(needParam)) {
-                value = stream->readStringUntil('<');                
-                break;
-            }       
-        } else {
-            return false;    
-        }
+bool TR064::xmlTakeParam(String (*params)[2], int nParam) {
+    if (nParam > TR064_XML_MAX_KEYS - 5) {
+        TR064_LOG(DEBUG_ERROR, "[TR064][xmlTakeParam]<Error> Too many parameters requested");
+        nParam = TR064_XML_MAX_KEYS - 5;
+    }
+    TR064ResponseHandler handler(*this, params, nParam);
+    TR064XmlTokenizer tokenizer(handler.keys(), handler);
+    int result = tokenizer.scan(http);
+    if (result < 0) {
+        TR064_LOG(DEBUG_ERROR, "[TR064][xmlTakeParam]<Error> Failed, message: '%s'", TR064HttpClient::errorToString(result));
+        return false;
     }
     return true;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Debug-print. Only prints the message if the debug level is high enough.
-    @param    message
-                The message to be conditionally printed.
-    @param    level
-                The minimally required debug level.
+    @brief  Formats a log line (printf style, into a buffer of
+            `TR064_LOG_BUFFER` bytes on the stack) and writes it to the log
+            output. Called through `TR064_LOG()`, which checks the level
+            before any argument is evaluated.
+    @param    format
+                The format, in flash (`PSTR()`).
 */
 /**************************************************************************/
-void TR064::deb_print(const String& message, int level) {
-    if (Serial) {
-        if (debug_level >= level) {
-            // where is location?
-            Serial.print(message);
-            //Serial.flush();
-        }
+void TR064::logLine(const char* format, ...) {
+    if (!_log) return;
+    char line[TR064_LOG_BUFFER];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf_P(line, sizeof(line), format, args);
+    va_end(args);
+    if (len >= (int) sizeof(line)) {
+        memcpy(line + sizeof(line) - 4, "...", 4);
     }
+    _log->println(line);
 }
-
-/**************************************************************************/
-/*!
-    @brief  Same as deb_print, but with a new line at the end.
-            Only prints the message if the debug level is high enough.
-    @param    message
-                The message to be conditionally printed.
-    @param    level
-                The minimally required debug level.
-*/
-/**************************************************************************/
-void TR064::deb_println(const String& message, int level) {
-    if (Serial) {
-        if (debug_level >= level) {
-            Serial.println(message);
-            //Serial.flush();
-        }
-    }
-}
\ No newline at end of file
@@ -9,7 +9,7 @@
  * 
  * This library depends on:
  *    MD5Builder
- *  ESP8266HTTPClient or HTTPClient, depending on the intended platform (ESP8266 or ESP32).
+ *  ESP8266WiFi or WiFi, depending on the intended platform (ESP8266 or ESP32).
  *
  * Written by René Vollmer "Aypac" in November 2016.
  *
@@ -27,15 +27,38 @@
 #if defined(ESP8266)
     //if(Serial) Serial.println(F("Version compiled for ESP8266."));
     #include <ESP8266WiFi.h>
-    #include <ESP8266HTTPClient.h>
 #elif defined(ESP32)
     //if(Serial) Serial.println(F("Version compiled for ESP32."));
     #include <WiFi.h>
-    #include <HTTPClient.h>
-
+#elif defined(TR064_NATIVE)
+    // Host build (Linux), see CMakeLists.txt
 #else
     //INCOMPATIBLE!
 #endif
+#include "tr064_transport.h"
+#include "tr064_http.h"
+#include "tr064_services.h"
+#include "tr064_xml.h"
+#include "tr064_soap.h"
+#include "tr064_auth.h"
+#include "tr064_response.h"
+#include "tr064_async.h"
+#include "tr064_batch.h"
+#include "tr064_hosts.h"
+#include "tr064_cache.h"
+#include "tr064_output.h"
+#include "tr064_action.h"
+#include "tr064_scpd.h"
+#include "tr064_storage.h"
+#include "tr064_session.h"
+#include "tr064_heap.h"
+#include "tr064_metrics.h"
+#include "tr064_log.h"
+#include "tr064_events.h"
+#include "tr064_mesh.h"
+#include "tr064_scheduler.h"
+#include "tr064_tls.h"
+#include "tr064_lists.h"
 
 /// HTTP codes see RFC7231
 typedef enum {
@@ -56,6 +79,7 @@ typedef enum {
 // Possible values for client.state()
 #define TR064_NO_SERVICES           -1 ///< No Service actions will not execute
 #define TR064_SERVICES_LOADED       0 ///< Service loaded
+#define TR064_SERVICES_OVERFLOW     -2 ///< The services did not fit into the fixed buffer of a `TR064Static`
 
 // Possible values for client.state()
 #define TR064_NO_SERVICES           -1
@@ -107,32 +131,85 @@ class TR064 {
         TR064& setServer(uint16_t port, const String& ip, const String& user, const String& pass);
         void init();
         int state();       
+        TR064& setTransport(TR064Transport& transport);
+        TR064& setKeepAlive(bool keepAlive);
+        TR064& setCache(TR064ResponseCache* cache);
+        TR064& setValidation(bool validate);
+        TR064& setStorage(TR064Storage* storage, uint8_t mode = TR064_STORAGE_CHECK);
+        TR064& setMetrics(TR064Metrics* metrics);
+        TR064& setLogOutput(Print* out);
+        bool exportSession(TR064SessionState& session);
+        bool importSession(const TR064SessionState& session);
+        const TR064HttpStats& httpStats() const { return http.stats(); }
+        const TR064AuthStats& authStats() const { return _session.stats(); }
+        const TR064ServiceRegistry& services() const { return _services; }
+        const TR064ServiceDescription* describe(const char* service);
+#if defined(TR064_HEAP_STATS)
+        /*!  @brief Heap use of the last `action()`, per phase. */
+        const TR064HeapStats& heapStats() const { return _heap.stats(); }
+        TR064& setHeapProbe(TR064HeapProbe* probe);
+#endif
         
         bool action(const String& service, const String& act, String params[][2] = {}, int nParam = 0,const String& url = "");
         //bool action(const String& service, const String& act, String params[][2], int nParam, const String& url = "");
         bool action(const String& service, const String& act, String params[][2], int nParam, String (*req)[2], int nReq, const String& url = "");
+        bool action(const String& service, const String& act, String params[][2], int nParam, TR064Output* outputs, int nOutputs, const String& url = "");
+        template <class Descriptor, class... Args> bool action(const Args&... args);
+        bool fetchHosts(TR064HostTable& table);
+        int fetchCallList(TR064CallCallback callback, void* context = nullptr, const TR064ListFilter* filter = nullptr);
+        int fetchPhonebook(uint16_t id, TR064ContactCallback callback, void* context = nullptr,
+                           const TR064ListFilter* filter = nullptr);
+        int fetchMessages(uint8_t tam, TR064TamMessageCallback callback, void* context = nullptr,
+                          const TR064ListFilter* filter = nullptr);
 
         String md5String(const String& s);
         String byte2hex(byte number);        
         int debug_level; ///< Available levels are `DEBUG_NONE`, `DEBUG_ERROR`, `DEBUG_WARNING`, `DEBUG_INFO`, and `DEBUG_VERBOSE`.
          
     private:
-        WiFiClient tr064client;
-        HTTPClient http;
+        friend class TR064ResponseHandler;
+        friend class TR064ServiceListHandler;
+        friend class TR064Async;
+        friend class TR064Batch;
+        friend class TR064Events;
+        friend class TR064Mesh;
+        friend class TR064Scheduler;
+        template <uint16_t, uint16_t, uint8_t> friend class TR064Static;
+
+        TR064DefaultTransport _defaultTransport;
+        TR064HttpClient http;
         
         //TODO: More consistent naming
         
         void initServiceURLs();
-        void deb_print(const String& message, int level);
-        void deb_println(const String& message, int level);
-        bool action_raw(const String& service,const String& act, String params[][2], int nParam, const String& url = "");
-        bool httpRequest(const String& url,  const String& xml, const  String& action, bool retry);
-        String generateAuthToken();
-        String generateAuthXML();
-        String findServiceURL(const String& service);
-        String cleanOldServiceName(const String& service);
+        bool loadServices();
+        void saveServices(const char* validator);
+        bool refreshServices();
+        bool descriptionValidator(char* buf, size_t len);
+        void useService(uint16_t index);
+        void observeRequest(TR064ActionMetrics* action, bool parsed, uint32_t parseUs);
+        void logLine(const char* format, ...) __attribute__((format(printf, 2, 3)));
+        bool httpRequest(const char* url, const TR064RequestBody* body, const char* soapaction, bool retry);
+        bool initAuth();
+        const char* findServiceURL(const char* service);
+        const char* findServiceURL(const char* service, uint32_t hash, bool refresh = true);
+        const char* knownServiceURL(const char* service);
+        bool execute(const String& service, const String& act, String params[][2], int nParam, String (*req)[2], int nReq,
+                     TR064Output* outputs, int nOutputs, const String& url);
+        bool execute(const char* service, const char* act, const TR064SoapArg* args, uint8_t nArgs, String (*req)[2], int nReq,
+                     TR064Output* outputs, int nOutputs, const char* url);
+        bool execute(const TR064ActionInfo& info, const TR064SoapArg* args, uint8_t nArgs, TR064Output* outputs, int nOutputs);
+        void invalidateCache(const char* service, const char* act);
+        bool perform(const char* service, const char* act, TR064SoapEnvelope& envelope, const char* soapaction,
+                     const char* url, String (*req)[2], int nReq, TR064Output* outputs, int nOutputs);
+        bool validate(const char* service, const char* act, String params[][2], int nParam, String (*req)[2], int nReq,
+                      const TR064Output* outputs, int nOutputs);
+        void clearDescriptions();
+        int openList(const char* service, const char* act, const char* argName, const char* argValue, const char* output,
+                     const TR064ListFilter* filter);
+        int closeList(int result, int count);
         bool xmlTakeParam(String (*params)[2], int nParam);
-        bool xmlTakeParam(String& value, const String& needParam);
+        bool xmlTakeOutputs(TR064Output* outputs, int nOutputs);
         static String errorToString(int error);
 
         int _state;
@@ -140,22 +217,65 @@ class TR064 {
         uint16_t _port;
         String _user;
         String _pass;
-        String _realm; // To be requested from the router
-        String _secretH; // To be generated
-        String _nonce = "";
-        String _status;
+        TR064AuthSession _session; ///< Realm, secret and rolling nonce of the authentication
+        TR064ResponseCache* _cache; ///< Optional cache of read-only actions, see `setCache()`
+        TR064Metrics* _metrics; ///< Optional latency and error metrics, see `setMetrics()`
+        Print* _log; ///< Output of the debug messages, see `setLogOutput()`
 
-        const char* const _requestStart = "<?xml version=\"1.0\"?><s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\" s:encodingStyle=\"http://schemas.xmlsoap.org/soap/encoding/\">";
         const char* const _detectPage = "/tr64desc.xml";
-        const char* const _servicePrefix = "urn:dslforum-org:service:";
         unsigned long lastOutActivity;
         unsigned long lastInActivity;
-        /* 
-    		* TODO: We should give access to this data for users to inspect the
-        * possibilities of their device(s) - see #9 on Github.
-        * TODO: Remove 100 services limits here
-        */
-        String _services[100][2];
+        TR064ServiceRegistry _services; ///< Services of the device, filled by `initServiceURLs()` or `loadServices()`
+        TR064Storage* _storage; ///< Optional storage of `_services`, see `setStorage()`
+        uint8_t _storageMode; ///< `TR064_STORAGE_CHECK` or `TR064_STORAGE_TRUST`
+        bool _servicesUnverified; ///< `_services` were loaded from `_storage` without asking the device
+        int _fault; ///< UPnP error code of the fault of the last request (0 if none)
+        uint16_t _used[TR064_SESSION_SERVICES]; ///< Indexes (in `_services`) of the used services, least recent first
+        uint8_t _nUsed;
+
+        /// A service description fetched by `describe()`.
+        struct DescriptionSlot {
+            TR064ServiceDescription description;
+            const char* url;    ///< SCPD URL (in `_services`), `nullptr` if the slot is empty
+            uint32_t used;      ///< Value of `_descriptionClock` when last used
+        };
+        DescriptionSlot _descriptions[TR064_SCPD_CACHE];
+        uint32_t _descriptionClock;
+        bool _validate; ///< Whether `action()` checks calls against the descriptions, see `setValidation()`
+        TR064HeapMeter _heap; ///< Heap use per phase of `action()` (empty without `TR064_HEAP_STATS`)
 };
 
-#endif
\ No newline at end of file
+/**************************************************************************/
+/*!
+    @brief  Calls an action described by a descriptor of
+            `tr064_descriptors.h`, e.g.
+            `tr064.action<TR064Actions::Hosts1::GetSpecificHostEntry>("AA:BB:CC:DD:EE:FF", nullptr, nullptr, nullptr, nullptr, &active)`.
+            All input arguments have to be passed, in the order of the
+            descriptor, followed by the outputs (pointers to variables, see
+            `TR064ArgValue`; `nullptr` skips an output, trailing outputs may
+            be left out). The number and the types of the arguments are
+            checked at compile time.
+    @param    args
+                The input values, followed by the output pointers.
+    @return success state: false if the call failed or an output was
+            missing or could not be decoded (text that was cut to the size
+            of its buffer is accepted).
+*/
+/**************************************************************************/
+template <class Descriptor, class... Args>
+bool TR064::action(const Args&... args) {
+    typedef typename Descriptor::In In;
+    typedef typename Descriptor::Out Out;
+    static_assert(sizeof...(Args) >= (size_t) In::size, "Too few arguments: all input arguments of the action are required");
+    static_assert(sizeof...(Args) <= (size_t) In::size + Out::size, "Too many arguments for the action");
+    static_assert(In::size <= TR064_SOAP_MAX_ARGS, "The action has more inputs than TR064_SOAP_MAX_ARGS");
+    static_assert(Out::size <= TR064_XML_MAX_KEYS - 5, "The action has more outputs than TR064_XML_MAX_KEYS allows");
+    constexpr TR064ActionInfo info = Descriptor::info();
+    TR064ActionCall<In::size, Out::size> call(Descriptor::arguments());
+    TR064ActionBinder<In, Out>::bind(call, args...);
+    return execute(info, call.args, call.nArgs, call.outputs, call.nOutputs);
+}
+
+#include "tr064_static.h"
+
+#endif
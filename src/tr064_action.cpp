@@ -0,0 +1,35 @@
+/*!
+ * @file tr064_action.cpp
+ *
+ * Compile-time descriptions of TR-064 actions.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_action.h"
+
+/**************************************************************************/
+/*!
+    @brief  Formats an integer argument.
+    @param    buf
+                Buffer of at least `TR064_ACTION_NUMBER` bytes.
+    @param    value
+                The absolute value.
+    @param    negative
+                Whether to prepend a minus sign.
+    @return The text (inside `buf`).
+*/
+/**************************************************************************/
+const char* tr064FormatNumber(char* buf, unsigned long long value, bool negative) {
+    char* p = buf + TR064_ACTION_NUMBER - 1;
+    *p = '\0';
+    do {
+        *--p = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    if (negative) {
+        *--p = '-';
+    }
+    return p;
+}
@@ -0,0 +1,244 @@
+/*!
+ * @file tr064_action.h
+ *
+ * Compile-time descriptions of TR-064 actions, as generated from the SCPD
+ * files of the device by `extras/tools/tr064_descriptors.py` (see
+ * `tr064_descriptors.h`). A descriptor carries the names, directions and
+ * types of the arguments as well as the SOAPACTION header and the constant
+ * parts of the envelope, so `TR064::action<Descriptor>(args...)` checks
+ * the number and the types of the arguments at compile time and does not
+ * format or hash any names at runtime.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_action_h
+#define tr064_action_h
+
+#include "Arduino.h"
+#include "tr064_soap.h"
+#include "tr064_output.h"
+
+// Data types of arguments (the `dataType` of the SCPD), see `TR064ArgDescriptor`
+#define TR064_TYPE_STRING       0  ///< `string` and all types without a dedicated code
+#define TR064_TYPE_BOOLEAN      1  ///< `boolean`
+#define TR064_TYPE_UI1          2  ///< `ui1`
+#define TR064_TYPE_UI2          3  ///< `ui2`
+#define TR064_TYPE_UI4          4  ///< `ui4`
+#define TR064_TYPE_UI8          5  ///< `ui8`
+#define TR064_TYPE_I1           6  ///< `i1`
+#define TR064_TYPE_I2           7  ///< `i2`
+#define TR064_TYPE_I4           8  ///< `i4`
+#define TR064_TYPE_I8           9  ///< `i8`
+#define TR064_TYPE_DATETIME     10 ///< `dateTime`
+#define TR064_TYPE_UUID         11 ///< `uuid`
+
+// Directions of arguments
+#define TR064_ARG_IN            0  ///< Input argument
+#define TR064_ARG_OUT           1  ///< Output argument
+
+#define TR064_ACTION_NUMBER     21 ///< Size of the buffer of a formatted integer argument
+
+/// One argument of an action, see `TR064ActionInfo`.
+struct TR064ArgDescriptor {
+    const char* name;   ///< Name of the argument, e.g. `NewMACAddress`
+    uint8_t direction;  ///< `TR064_ARG_IN` or `TR064_ARG_OUT`
+    uint8_t type;       ///< One of the `TR064_TYPE_*` codes
+};
+
+/**************************************************************************/
+/*!
+    @brief  The names of an action and the constant parts of its request,
+            precomputed by the generator.
+*/
+/**************************************************************************/
+struct TR064ActionInfo {
+    const char* service;        ///< Name of the service, e.g. `Hosts:1`
+    uint32_t serviceHash;       ///< `tr064Hash()` of the service name
+    const char* action;         ///< Name of the action
+    const char* soapAction;     ///< Value of the SOAPACTION header
+    const char* bodyStart;      ///< Start of the body of the envelope, up to the first argument
+    const char* bodyEnd;        ///< End of the body of the envelope
+};
+
+/// List of the argument types of an action, see the descriptors in `tr064_descriptors.h`.
+template <uint8_t... Types>
+struct TR064Signature {
+    enum { size = sizeof...(Types) };
+};
+
+const char* tr064FormatNumber(char* buf, unsigned long long value, bool negative);
+
+/**************************************************************************/
+/*!
+    @brief  Conversions shared by all types: an output may be skipped with
+            `nullptr` or read into a character buffer. A call of one of the
+            deleted templates means that a value does not match the type of
+            the argument.
+*/
+/**************************************************************************/
+struct TR064AnyValue {
+    template <class T> static const char* format(char* buf, T value) = delete;
+    template <class T> static bool output(TR064Output& out, const char* name, T target) = delete;
+
+    static bool output(TR064Output& out, const char* name, decltype(nullptr) target) {
+        (void) out; (void) name; (void) target;
+        return false;
+    }
+    template <size_t N> static bool output(TR064Output& out, const char* name, char (*target)[N]) {
+        out = TR064Output::text(name, *target, N);
+        return true;
+    }
+};
+
+/// Values of `string`, `dateTime` and `uuid` arguments: C strings and `String`s, a MAC address as output.
+struct TR064StringValue : TR064AnyValue {
+    using TR064AnyValue::format;
+    using TR064AnyValue::output;
+    static const char* format(char* buf, const char* value) { (void) buf; return value; }
+    static const char* format(char* buf, char* value) { (void) buf; return value; }
+    static const char* format(char* buf, const String& value) { (void) buf; return value.c_str(); }
+    static bool output(TR064Output& out, const char* name, uint8_t (*target)[6]) {
+        out = TR064Output::mac(name, *target);
+        return true;
+    }
+};
+
+/// Values of `boolean` arguments.
+struct TR064BooleanValue : TR064AnyValue {
+    using TR064AnyValue::format;
+    using TR064AnyValue::output;
+    static const char* format(char* buf, bool value) { (void) buf; return value ? "1" : "0"; }
+    static bool output(TR064Output& out, const char* name, bool* target) {
+        out = TR064Output::boolean(name, target);
+        return true;
+    }
+};
+
+/// Inputs of integer arguments: any integer type except `bool` and `char`.
+struct TR064IntegerValue : TR064AnyValue {
+    using TR064AnyValue::format;
+    static const char* format(char* buf, signed char value) { return formatSigned(buf, value); }
+    static const char* format(char* buf, short value) { return formatSigned(buf, value); }
+    static const char* format(char* buf, int value) { return formatSigned(buf, value); }
+    static const char* format(char* buf, long value) { return formatSigned(buf, value); }
+    static const char* format(char* buf, long long value) { return formatSigned(buf, value); }
+    static const char* format(char* buf, unsigned char value) { return tr064FormatNumber(buf, value, false); }
+    static const char* format(char* buf, unsigned short value) { return tr064FormatNumber(buf, value, false); }
+    static const char* format(char* buf, unsigned int value) { return tr064FormatNumber(buf, value, false); }
+    static const char* format(char* buf, unsigned long value) { return tr064FormatNumber(buf, value, false); }
+    static const char* format(char* buf, unsigned long long value) { return tr064FormatNumber(buf, value, false); }
+
+    private:
+        static const char* formatSigned(char* buf, long long value) {
+            return value < 0 ? tr064FormatNumber(buf, 0ull - (unsigned long long) value, true)
+                             : tr064FormatNumber(buf, (unsigned long long) value, false);
+        }
+};
+
+/// Values of `ui1`, `ui2` and `ui4` arguments.
+struct TR064UnsignedValue : TR064IntegerValue {
+    using TR064AnyValue::output;
+    static bool output(TR064Output& out, const char* name, uint32_t* target) {
+        out = TR064Output::uint32(name, target);
+        return true;
+    }
+    static bool output(TR064Output& out, const char* name, uint64_t* target) {
+        out = TR064Output::uint64(name, target);
+        return true;
+    }
+};
+
+/// Values of `ui8` arguments.
+struct TR064Unsigned64Value : TR064IntegerValue {
+    using TR064AnyValue::output;
+    static bool output(TR064Output& out, const char* name, uint64_t* target) {
+        out = TR064Output::uint64(name, target);
+        return true;
+    }
+};
+
+/// Values of `i1`, `i2` and `i4` arguments.
+struct TR064SignedValue : TR064IntegerValue {
+    using TR064AnyValue::output;
+    static bool output(TR064Output& out, const char* name, int32_t* target) {
+        out = TR064Output::int32(name, target);
+        return true;
+    }
+};
+
+/// Values of `i8` arguments (outputs only as text).
+struct TR064Signed64Value : TR064IntegerValue {
+    using TR064AnyValue::output;
+};
+
+/// The accepted values of an argument type.
+template <uint8_t Type> struct TR064ArgValue : TR064StringValue {};
+template <> struct TR064ArgValue<TR064_TYPE_BOOLEAN> : TR064BooleanValue {};
+template <> struct TR064ArgValue<TR064_TYPE_UI1> : TR064UnsignedValue {};
+template <> struct TR064ArgValue<TR064_TYPE_UI2> : TR064UnsignedValue {};
+template <> struct TR064ArgValue<TR064_TYPE_UI4> : TR064UnsignedValue {};
+template <> struct TR064ArgValue<TR064_TYPE_UI8> : TR064Unsigned64Value {};
+template <> struct TR064ArgValue<TR064_TYPE_I1> : TR064SignedValue {};
+template <> struct TR064ArgValue<TR064_TYPE_I2> : TR064SignedValue {};
+template <> struct TR064ArgValue<TR064_TYPE_I4> : TR064SignedValue {};
+template <> struct TR064ArgValue<TR064_TYPE_I8> : TR064Signed64Value {};
+
+/**************************************************************************/
+/*!
+    @brief  Arguments of one call of `TR064::action<Descriptor>()`, sized
+            to the action.
+*/
+/**************************************************************************/
+template <uint8_t NIn, uint8_t NOut>
+struct TR064ActionCall {
+    explicit TR064ActionCall(const TR064ArgDescriptor* arguments)
+        : arguments(arguments), nArgs(0), nOutputs(0), nextOutput(0) {}
+
+    const TR064ArgDescriptor* arguments;    // Inputs, then outputs
+    TR064SoapArg args[NIn > 0 ? NIn : 1];
+    char numbers[NIn > 0 ? NIn : 1][TR064_ACTION_NUMBER];
+    TR064Output outputs[NOut > 0 ? NOut : 1];
+    uint8_t nArgs;
+    uint8_t nOutputs;       // Bound outputs (not skipped)
+    uint8_t nextOutput;     // Outputs consumed
+};
+
+/// Binds the values passed to `TR064::action<Descriptor>()`, inputs first.
+template <class In, class Out> struct TR064ActionBinder;
+
+template <uint8_t Type, uint8_t... Types, class Out>
+struct TR064ActionBinder<TR064Signature<Type, Types...>, Out> {
+    template <class Call, class A, class... Rest>
+    static void bind(Call& call, const A& value, const Rest&... rest) {
+        TR064SoapArg& arg = call.args[call.nArgs];
+        arg.name = call.arguments[call.nArgs].name;
+        arg.value = TR064ArgValue<Type>::format(call.numbers[call.nArgs], value);
+        ++call.nArgs;
+        TR064ActionBinder<TR064Signature<Types...>, Out>::bind(call, rest...);
+    }
+};
+
+template <uint8_t Type, uint8_t... Types>
+struct TR064ActionBinder<TR064Signature<>, TR064Signature<Type, Types...> > {
+    template <class Call>
+    static void bind(Call& call) { (void) call; }
+
+    template <class Call, class A, class... Rest>
+    static void bind(Call& call, const A& target, const Rest&... rest) {
+        const char* name = call.arguments[call.nArgs + call.nextOutput++].name;
+        if (TR064ArgValue<Type>::output(call.outputs[call.nOutputs], name, target)) {
+            ++call.nOutputs;
+        }
+        TR064ActionBinder<TR064Signature<>, TR064Signature<Types...> >::bind(call, rest...);
+    }
+};
+
+template <>
+struct TR064ActionBinder<TR064Signature<>, TR064Signature<> > {
+    template <class Call>
+    static void bind(Call& call) { (void) call; }
+};
+
+#endif
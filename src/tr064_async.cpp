@@ -0,0 +1,474 @@
+/*!
+ * @file tr064_async.cpp
+ *
+ * Non-blocking execution of TR-064 actions.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_async.h"
+#include "tr064.h"
+
+/**************************************************************************/
+/*!
+    @brief  Creates an empty queue.
+    @param    tr064
+                The client whose connection, services and authentication
+                session are used. It must outlive this object.
+*/
+/**************************************************************************/
+TR064Async::TR064Async(TR064& tr064)
+    : _tr064(tr064), _nextHandle(1), _active(-1), _phase(START), _challenge(false),
+      _reconnected(false), _tries(0), _code(0), _deadline(0),
+      _handler(tr064), _tokenizer(_handler.keys(), _handler) {
+    for (int i = 0; i < TR064_ASYNC_QUEUE; ++i) {
+        _jobs[i].handle = 0;
+        _jobs[i].result = TR064_ASYNC_DONE;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Queues an action. Like `TR064::action()`, but returns at once;
+            the action is executed by the following calls of `poll()`.
+    @param    service
+                The name of the service you want to adress.
+    @param    act
+                The action you want to perform on the service.
+    @param    params
+                A list of pairs of input parameters and values. Must stay
+                valid until the action finished.
+    @param    nParam
+                The number of input parameters you passed.
+    @param    req
+                A list of pairs of response parameters and values, the
+                values are filled in. Must stay valid until the action finished.
+    @param    nReq
+                The number of response parameters you passed.
+    @param    callback
+                Called when the action finished (optional).
+    @param    context
+                Passed to the callback.
+    @param    url
+                The url you want to call (optional, looked up among the
+                loaded services by default, which are not reloaded from the
+                device here).
+    @return A handle (> 0) for `status()` and `cancel()` or a negative
+            `TR064_ASYNC_ERROR_*` code.
+*/
+/**************************************************************************/
+int TR064Async::beginAction(const String& service, const String& act, String params[][2], int nParam,
+                            String (*req)[2], int nReq, TR064AsyncCallback callback,
+                            void* context, const String& url) {
+    if (nParam > TR064_SOAP_MAX_ARGS || nReq > TR064_XML_MAX_KEYS - 5) {
+        TR064_LOG_AT(_tr064, TR064::DEBUG_ERROR, "[TR064][beginAction]<Error> Too many parameters");
+        return TR064_ASYNC_ERROR_ARGS;
+    }
+    Job* job = nullptr;
+    for (int i = 0; i < TR064_ASYNC_QUEUE; ++i) {
+        // Reuse the slot that finished first
+        Job& j = _jobs[i];
+        if (j.result != TR064_ASYNC_PENDING && (!job || j.handle < job->handle)) {
+            job = &j;
+        }
+    }
+    if (!job) {
+        TR064_LOG_AT(_tr064, TR064::DEBUG_WARNING, "[TR064][beginAction]<Error> Queue is full");
+        return TR064_ASYNC_ERROR_BUSY;
+    }
+
+    const char* serviceName = TR064ServiceRegistry::stripPrefix(service.c_str());
+    const char* serviceUrl = url != "" ? url.c_str() : _tr064.knownServiceURL(serviceName);
+    size_t serviceLen = strlen(serviceName);
+    size_t actionLen = act.length();
+    size_t urlLen = strlen(serviceUrl);
+    if (urlLen == 0 || serviceLen + actionLen + urlLen + 3 > sizeof(job->names)) {
+        TR064_LOG_AT(_tr064, TR064::DEBUG_ERROR, "[TR064][beginAction]<Error> Unknown service or too long names");
+        return TR064_ASYNC_ERROR_ARGS;
+    }
+    memcpy(job->names, serviceName, serviceLen + 1);
+    job->action = (uint8_t) (serviceLen + 1);
+    memcpy(job->names + job->action, act.c_str(), actionLen + 1);
+    job->url = (uint8_t) (job->action + actionLen + 1);
+    memcpy(job->names + job->url, serviceUrl, urlLen + 1);
+
+    job->params = params;
+    job->nParam = nParam > 0 ? nParam : 0;
+    job->req = req;
+    job->nReq = nReq > 0 ? nReq : 0;
+    job->callback = callback;
+    job->context = context;
+    job->result = TR064_ASYNC_PENDING;
+    job->handle = _nextHandle;
+    _nextHandle = _nextHandle == 0x7FFFFFFF ? 1 : _nextHandle + 1;
+    return job->handle;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Advances the queued actions; to be called from `loop()`. Never
+            waits for the device and parses at most `TR064_ASYNC_POLL_BYTES`
+            of a response per call. Finished actions report to their callback.
+    @return Whether actions are still pending.
+*/
+/**************************************************************************/
+bool TR064Async::poll() {
+    if (_active < 0 && !next()) {
+        return false;
+    }
+    TR064HttpClient& http = _tr064.http;
+    http.setNonBlocking(true);
+    size_t budget = TR064_ASYNC_POLL_BYTES;
+    while (_active >= 0 && step(budget)) {}
+    http.setNonBlocking(false);
+    return busy();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the state of an action.
+    @param    handle
+                The handle returned by `beginAction()`.
+    @return `TR064_ASYNC_PENDING`, `TR064_ASYNC_DONE` or a negative
+            `TR064_ASYNC_ERROR_*` code. The result is kept until the slot
+            of the action is reused by a later `beginAction()`.
+*/
+/**************************************************************************/
+int TR064Async::status(int handle) const {
+    const Job* job = find(handle);
+    return job ? job->result : TR064_ASYNC_ERROR_UNKNOWN;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Cancels a pending action. If its request is in progress, the
+            connection is closed. The callback is not called.
+    @return false if the action is unknown or already finished.
+*/
+/**************************************************************************/
+bool TR064Async::cancel(int handle) {
+    Job* job = find(handle);
+    if (!job || job->result != TR064_ASYNC_PENDING) {
+        return false;
+    }
+    if (_active >= 0 && job == &_jobs[_active]) {
+        _tr064.http.close();
+        _active = -1;
+    }
+    job->result = TR064_ASYNC_ERROR_CANCELLED;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Whether any action is queued or in progress.
+*/
+/**************************************************************************/
+bool TR064Async::busy() const {
+    for (int i = 0; i < TR064_ASYNC_QUEUE; ++i) {
+        if (_jobs[i].result == TR064_ASYNC_PENDING) return true;
+    }
+    return false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Converts a result of `status()` to a message.
+*/
+/**************************************************************************/
+const char* TR064Async::errorToString(int result) {
+    switch (result) {
+    case TR064_ASYNC_PENDING:
+        return "pending";
+    case TR064_ASYNC_DONE:
+        return "done";
+    case TR064_ASYNC_ERROR_BUSY:
+        return "queue full";
+    case TR064_ASYNC_ERROR_UNKNOWN:
+        return "unknown handle";
+    case TR064_ASYNC_ERROR_ARGS:
+        return "invalid arguments";
+    case TR064_ASYNC_ERROR_FAILED:
+        return "action failed";
+    case TR064_ASYNC_ERROR_AUTH:
+        return "authentication failed";
+    case TR064_ASYNC_ERROR_TIMEOUT:
+        return "timeout";
+    case TR064_ASYNC_ERROR_CONNECTION:
+        return "connection failed";
+    case TR064_ASYNC_ERROR_CANCELLED:
+        return "cancelled";
+    default:
+        return "";
+    }
+}
+
+// ----------------------------
+// ----- Helper-functions -----
+// ----------------------------
+
+TR064Async::Job* TR064Async::find(int handle) {
+    for (int i = 0; i < TR064_ASYNC_QUEUE; ++i) {
+        if (handle > 0 && _jobs[i].handle == handle) return &_jobs[i];
+    }
+    return nullptr;
+}
+
+const TR064Async::Job* TR064Async::find(int handle) const {
+    return const_cast<TR064Async*>(this)->find(handle);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Activates the oldest pending action.
+    @return false if there is none.
+*/
+/**************************************************************************/
+bool TR064Async::next() {
+    for (int i = 0; i < TR064_ASYNC_QUEUE; ++i) {
+        const Job& j = _jobs[i];
+        if (j.result == TR064_ASYNC_PENDING && (_active < 0 || j.handle < _jobs[_active].handle)) {
+            _active = i;
+        }
+    }
+    if (_active < 0) {
+        return false;
+    }
+    _phase = START;
+    _tries = 0;
+    _parseUs = 0;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Does the next step of the active action.
+    @param    budget
+                Number of response bytes that may still be parsed in this `poll()`.
+    @return Whether to continue, false if the action has to wait or finished.
+*/
+/**************************************************************************/
+bool TR064Async::step(size_t& budget) {
+    switch (_phase) {
+    case START:
+        // Without a nonce, the request is preceded by an `InitChallenge`
+        _challenge = !_tr064._session.ready();
+        if (_challenge) {
+            ++_tr064._session.stats().challenges;
+            if (_tr064._metrics) _tr064._metrics->countChallenge();
+        }
+        _reconnected = false;
+        return connect();
+    case CONNECT:
+        return connected(_tr064.http.pollConnect());
+    case HEAD:
+        return head();
+    case BODY:
+        return body(budget);
+    }
+    return false;
+}
+
+bool TR064Async::connect() {
+    _phase = CONNECT;
+    _deadline = millis() + _tr064.http.timeout();
+    return connected(_tr064.http.connect(_tr064._ip.c_str(), _tr064._port));
+}
+
+bool TR064Async::connected(int rc) {
+    if (rc == 0) {
+        return waiting();
+    }
+    if (rc < 0) {
+        TR064_LOG_AT(_tr064, TR064::DEBUG_ERROR, "[TR064][poll]<Error> Connection failed");
+        fail(TR064_ASYNC_ERROR_CONNECTION);
+        return false;
+    }
+    return send();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes the request (the action or the `InitChallenge`) to the
+            connection. The envelope is small and written at once.
+*/
+/**************************************************************************/
+bool TR064Async::send() {
+    const Job& job = _jobs[_active];
+    const char* service = job.names;
+    const char* action = job.names + job.action;
+    const char* url = job.names + job.url;
+    TR064SoapArg args[TR064_SOAP_MAX_ARGS];
+    uint8_t nArgs = 0;
+    if (_challenge) {
+        // `GetSecurityPort` needs no authentication, see `TR064::initAuth()`
+        service = "DeviceInfo:1";
+        action = "GetSecurityPort";
+        url = _tr064._services.find(service);
+        if (!url) {
+            url = "/upnp/control/deviceinfo";
+        }
+    } else {
+        _tr064.invalidateCache(service, action);
+        for (int i = 0; i < job.nParam; ++i) {
+            args[i].name = job.params[i][0].c_str();
+            args[i].value = job.params[i][1].c_str();
+        }
+        nArgs = (uint8_t) job.nParam;
+    }
+    TR064SoapEnvelope envelope(service, action, args, nArgs);
+    _tr064._session.prepare(envelope, _tr064._user.c_str());
+    char soapaction[TR064_SOAP_ACTION_BUFFER];
+    if (TR064SoapEnvelope::soapAction(soapaction, sizeof(soapaction), service, action) >= sizeof(soapaction)) {
+        fail(TR064_ASYNC_ERROR_ARGS);
+        return false;
+    }
+    TR064_LOG_AT(_tr064, TR064::DEBUG_INFO, "[TR064][poll] POST %s SOAPACTION: '%s'", url, soapaction);
+    _tr064._session.beginResponse();
+    if (_tr064.http.sendRequest("POST", url, soapaction, &envelope) < 0) {
+        return reconnect();
+    }
+    _phase = HEAD;
+    _deadline = millis() + _tr064.http.timeout();
+    return true;
+}
+
+bool TR064Async::head() {
+    int rc = _tr064.http.pollHead();
+    if (rc == TR064_HTTP_ERROR_WOULD_BLOCK) {
+        return waiting();
+    }
+    if (_tr064._metrics) _tr064._metrics->countHttp(rc);
+    if (rc < 0) {
+        return reconnect();
+    }
+    _code = rc;
+    _parseUs = 0;
+    const Job& job = _jobs[_active];
+    if (_code == TR064_HTTP_CODE_OK && !_challenge) {
+        _handler.begin(job.req, job.nReq);
+    } else {
+        // Only the challenge and the fault
+        _handler.begin(nullptr, 0);
+    }
+    _tokenizer.reset();
+    _phase = BODY;
+    return true;
+}
+
+bool TR064Async::body(size_t& budget) {
+    char buf[TR064_XML_CHUNK];
+    while (budget > 0) {
+        int n = _tr064.http.read((uint8_t*) buf, budget < sizeof(buf) ? budget : sizeof(buf));
+        if (n == TR064_HTTP_ERROR_WOULD_BLOCK) {
+            return waiting();
+        }
+        if (n < 0) {
+            TR064_LOG_AT(_tr064, TR064::DEBUG_ERROR, "[TR064][poll]<Error> Connection lost while reading");
+            fail(n == TR064_HTTP_ERROR_READ_TIMEOUT ? TR064_ASYNC_ERROR_TIMEOUT : TR064_ASYNC_ERROR_CONNECTION);
+            return false;
+        }
+        if (n == 0) {
+            return complete();
+        }
+        _deadline = millis() + _tr064.http.timeout();
+        unsigned long start = micros();
+        _tokenizer.feed(buf, (size_t) n);
+        _parseUs += micros() - start;
+        budget -= (size_t) n;
+    }
+    return false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Evaluates a completely read response: continues with the action
+            after a challenge, repeats it if the nonce was rejected or
+            finishes it.
+*/
+/**************************************************************************/
+bool TR064Async::complete() {
+    _tr064.http.end();
+    TR064Metrics* metrics = _tr064._metrics;
+    if (metrics) {
+        const Job& job = _jobs[_active];
+        _tr064.observeRequest(metrics->find(job.names, job.names + job.action), !_challenge, _parseUs);
+        if (_code != TR064_HTTP_CODE_OK && _handler.errorCode() > 0) {
+            metrics->countFault(_handler.errorCode());
+        }
+    }
+    TR064AuthSession& session = _tr064._session;
+    if (_challenge) {
+        if (_code != TR064_HTTP_CODE_OK || !session.ready()) {
+            TR064_LOG_AT(_tr064, TR064::DEBUG_ERROR, "[TR064][poll]<Error> Nonce/realm request not successful!");
+            ++session.stats().failures;
+            finish(TR064_ASYNC_ERROR_AUTH);
+            return false;
+        }
+        _phase = START;
+        return true;
+    }
+    if (session.rejected()) {
+        // The response carried a new nonce
+        if (_tries >= TR064_AUTH_MAX_RETRIES) {
+            TR064_LOG_AT(_tr064, TR064::DEBUG_ERROR, "[TR064][poll]<error> Giving up the request ");
+            ++session.stats().failures;
+            finish(TR064_ASYNC_ERROR_AUTH);
+            return false;
+        }
+        ++_tries;
+        ++session.stats().retries;
+        if (metrics) metrics->countReauth();
+        _phase = START;
+        return true;
+    }
+    finish(_code == TR064_HTTP_CODE_OK ? TR064_ASYNC_DONE : TR064_ASYNC_ERROR_FAILED);
+    return false;
+}
+
+/// Stops the current step until the next `poll()`, or fails it after the timeout.
+bool TR064Async::waiting() {
+    if ((long) (millis() - _deadline) >= 0) {
+        TR064_LOG_AT(_tr064, TR064::DEBUG_ERROR, "[TR064][poll]<Error> Timeout");
+        fail(TR064_ASYNC_ERROR_TIMEOUT);
+    }
+    return false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Handles a connection that failed before a response arrived: a
+            kept-alive connection may have been closed by the device, so the
+            request is repeated once on a new one.
+*/
+/**************************************************************************/
+bool TR064Async::reconnect() {
+    TR064HttpClient& http = _tr064.http;
+    if (_reconnected || !http.retryable()) {
+        TR064_LOG_AT(_tr064, TR064::DEBUG_ERROR, "[TR064][poll]<Error> Connection lost");
+        fail(TR064_ASYNC_ERROR_CONNECTION);
+        return false;
+    }
+    _reconnected = true;
+    http.reopen();
+    if (_tr064._metrics) _tr064._metrics->countRetry();
+    return connect();
+}
+
+void TR064Async::fail(int result) {
+    _tr064.http.close();
+    finish(result);
+}
+
+void TR064Async::finish(int result) {
+    Job& job = _jobs[_active];
+    if (_tr064._metrics) {
+        _tr064._metrics->countCall(_tr064._metrics->find(job.names, job.names + job.action), result == TR064_ASYNC_DONE);
+    }
+    _active = -1;
+    job.result = result;
+    if (job.callback) {
+        job.callback(job.handle, result, job.context);
+    }
+}
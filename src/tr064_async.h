@@ -0,0 +1,130 @@
+/*!
+ * @file tr064_async.h
+ *
+ * Non-blocking execution of TR-064 actions. Actions are queued with
+ * `TR064Async::beginAction()` and advanced by calling `poll()` from
+ * `loop()`; each call does a bounded amount of work and never waits for
+ * the device, so the sketch stays responsive while a request is in flight.
+ *
+ * The one exception is opening a new connection on ESP8266/ESP32: the
+ * `WiFiClient` cannot connect without waiting, so that `poll()` blocks for
+ * up to `TR064_WIFI_CONNECT_TIMEOUT` (see
+ * `TR064WiFiTransport::setConnectTimeout()`), or as long as `connect()` of
+ * a custom `Client`. With keep-alive (the default), this only happens for
+ * the first request and after the device closed the connection. The
+ * native transport connects without blocking.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_async_h
+#define tr064_async_h
+
+#include "Arduino.h"
+#include "tr064_xml.h"
+#include "tr064_response.h"
+
+#ifndef TR064_ASYNC_QUEUE
+#define TR064_ASYNC_QUEUE           4   ///< Maximal number of queued (and finished, not yet reused) actions
+#endif
+#ifndef TR064_ASYNC_NAMES
+#define TR064_ASYNC_NAMES           128 ///< Buffer per action for the copies of service, action and URL
+#endif
+#ifndef TR064_ASYNC_POLL_BYTES
+#define TR064_ASYNC_POLL_BYTES      512 ///< Maximal number of response bytes parsed by one `poll()`
+#endif
+
+// Results of an action, see `TR064Async::status()`
+#define TR064_ASYNC_PENDING             1  ///< Queued or in progress
+#define TR064_ASYNC_DONE                0  ///< Finished successfully, the output parameters are filled in
+#define TR064_ASYNC_ERROR_BUSY          -1 ///< The queue is full
+#define TR064_ASYNC_ERROR_UNKNOWN       -2 ///< Unknown (or already reused) handle
+#define TR064_ASYNC_ERROR_ARGS          -3 ///< Too many parameters, unknown service or too long names
+#define TR064_ASYNC_ERROR_FAILED        -4 ///< The device answered with an error
+#define TR064_ASYNC_ERROR_AUTH          -5 ///< The authentication failed
+#define TR064_ASYNC_ERROR_TIMEOUT       -6 ///< The device did not answer in time
+#define TR064_ASYNC_ERROR_CONNECTION    -7 ///< The connection failed or was lost
+#define TR064_ASYNC_ERROR_CANCELLED     -8 ///< Cancelled with `cancel()`
+
+class TR064;
+
+/// Called when an action finished, with its handle, its result (`TR064_ASYNC_DONE` or an error) and the user context.
+typedef void (*TR064AsyncCallback)(int handle, int result, void* context);
+
+/**************************************************************************/
+/*!
+    @brief  Queue of actions that are executed without blocking, one after
+            the other, on the connection of a `TR064`. Uses the same
+            authentication session, so sync and async actions share the
+            nonce.
+
+            The service, action and URL names are copied; the parameter
+            arrays are referenced and must stay valid until the action
+            finished. Blocking calls of the `TR064` must not be made while
+            `busy()`. Opening a connection may block on ESP8266/ESP32, see
+            tr064_async.h.
+*/
+/**************************************************************************/
+class TR064Async {
+    public:
+        explicit TR064Async(TR064& tr064);
+
+        int beginAction(const String& service, const String& act, String params[][2], int nParam,
+                        String (*req)[2], int nReq, TR064AsyncCallback callback = nullptr,
+                        void* context = nullptr, const String& url = "");
+        bool poll();
+        int status(int handle) const;
+        bool cancel(int handle);
+        bool busy() const;
+
+        static const char* errorToString(int result);
+
+    private:
+        enum Phase { START, CONNECT, HEAD, BODY };
+
+        struct Job {
+            int handle;                 // 0: slot never used
+            int result;                 // `TR064_ASYNC_PENDING` or the result
+            String (*params)[2];
+            int nParam;
+            String (*req)[2];
+            int nReq;
+            TR064AsyncCallback callback;
+            void* context;
+            uint8_t action;             // Offset of the action name in `names`
+            uint8_t url;                // Offset of the URL in `names`
+            char names[TR064_ASYNC_NAMES]; // Service, action and URL, each zero-terminated
+        };
+
+        Job* find(int handle);
+        const Job* find(int handle) const;
+        bool next();
+        bool step(size_t& budget);
+        bool connect();
+        bool connected(int rc);
+        bool send();
+        bool head();
+        bool body(size_t& budget);
+        bool complete();
+        bool waiting();
+        bool reconnect();
+        void fail(int result);
+        void finish(int result);
+
+        TR064& _tr064;
+        Job _jobs[TR064_ASYNC_QUEUE];
+        int _nextHandle;
+        int _active;                    // Index of the job in progress, -1 if none
+        Phase _phase;
+        bool _challenge;                // The current request obtains a nonce (`InitChallenge`)
+        bool _reconnected;              // The current request was already repeated on a new connection
+        uint8_t _tries;                 // Repetitions because the nonce was rejected
+        int _code;                      // HTTP status code of the current response
+        uint32_t _parseUs;              // Time spent parsing the current response (us), for `TR064Metrics`
+        unsigned long _deadline;        // `millis()` at which the current wait times out
+        TR064ResponseHandler _handler;
+        TR064XmlTokenizer _tokenizer;
+};
+
+#endif
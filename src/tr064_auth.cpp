@@ -0,0 +1,168 @@
+/*!
+ * @file tr064_auth.cpp
+ *
+ * Session of the SOAP digest authentication of TR-064.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_auth.h"
+#include <MD5Builder.h>
+
+/// Copies a string, truncating it to the buffer. @return false if it was truncated.
+static bool copyString(char* dest, size_t size, const char* src) {
+    size_t len = strlen(src);
+    bool fits = len < size;
+    if (!fits) len = size - 1;
+    memcpy(dest, src, len);
+    dest[len] = '\0';
+    return fits;
+}
+
+TR064AuthSession::TR064AuthSession() {
+    memset(&_stats, 0, sizeof(_stats));
+    reset();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Forgets realm, secret and nonce, e.g. after the credentials
+            changed. The counters are kept.
+*/
+/**************************************************************************/
+void TR064AuthSession::reset() {
+    _realm[0] = '\0';
+    _secret[0] = '\0';
+    _token[0] = '\0';
+    _rejected = false;
+    invalidate();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Forgets the nonce; the next request starts with a new challenge.
+*/
+/**************************************************************************/
+void TR064AuthSession::invalidate() {
+    _nonce[0] = '\0';
+}
+
+/**************************************************************************/
+/*!
+    @brief  To be called before a response is parsed.
+*/
+/**************************************************************************/
+void TR064AuthSession::beginResponse() {
+    _rejected = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Stores the nonce of a `Challenge` or `NextChallenge` header.
+            Each nonce is only valid for one request.
+*/
+/**************************************************************************/
+void TR064AuthSession::setNonce(const char* nonce) {
+    if (!copyString(_nonce, sizeof(_nonce), nonce)) {
+        // A truncated nonce is useless
+        _nonce[0] = '\0';
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Stores the realm of a challenge and derives the hashed secret
+            from it (only if the realm changed).
+    @param    realm
+                The realm sent by the device.
+    @param    user
+                The user name.
+    @param    pass
+                The password.
+*/
+/**************************************************************************/
+void TR064AuthSession::setRealm(const char* realm, const char* user, const char* pass) {
+    if (_secret[0] != '\0' && strcmp(_realm, realm) == 0) {
+        return;
+    }
+    if (!copyString(_realm, sizeof(_realm), realm)) {
+        _realm[0] = '\0';
+        _secret[0] = '\0';
+        return;
+    }
+    MD5Builder md5;
+    md5.begin();
+    md5.add((uint8_t*) user, strlen(user));
+    md5.add((uint8_t*) ":", 1);
+    md5.add((uint8_t*) _realm, strlen(_realm));
+    md5.add((uint8_t*) ":", 1);
+    md5.add((uint8_t*) pass, strlen(pass));
+    md5.calculate();
+    md5.getChars(_secret);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Evaluates the `Status` of a challenge (`Authenticated` or
+            `Unauthenticated`) and updates the counters.
+*/
+/**************************************************************************/
+void TR064AuthSession::setStatus(const char* status) {
+    if (strcasecmp(status, "Authenticated") == 0) {
+        _rejected = false;
+        ++_stats.accepted;
+    } else if (strcasecmp(status, "Unauthenticated") == 0) {
+        _rejected = true;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Restores the state of a previous session, e.g. after deep sleep
+            (see `TR064::importSession()`), without computing the secret.
+    @param    realm
+                The realm.
+    @param    secret
+                The hashed secret of the realm, see `secret()`.
+    @param    nonce
+                The last nonce, may be empty (or expired, the next request
+                then obtains a new one).
+*/
+/**************************************************************************/
+void TR064AuthSession::restore(const char* realm, const char* secret, const char* nonce) {
+    reset();
+    if (strlen(secret) != 32 || !copyString(_realm, sizeof(_realm), realm)) {
+        _realm[0] = '\0';
+        return;
+    }
+    memcpy(_secret, secret, sizeof(_secret));
+    setNonce(nonce);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Adds the authentication header to a request: `ClientAuth` with
+            the current nonce if the session is `ready()`, `InitChallenge`
+            otherwise. The device accepts each nonce once, its response
+            carries the next one.
+    @param    envelope
+                The request.
+    @param    user
+                The user name.
+*/
+/**************************************************************************/
+void TR064AuthSession::prepare(TR064SoapEnvelope& envelope, const char* user) {
+    if (!ready()) {
+        envelope.setInitChallenge(user);
+        return;
+    }
+    MD5Builder md5;
+    md5.begin();
+    md5.add((uint8_t*) _secret, 32);
+    md5.add((uint8_t*) ":", 1);
+    md5.add((uint8_t*) _nonce, strlen(_nonce));
+    md5.calculate();
+    md5.getChars(_token);
+    envelope.setClientAuth(user, _realm, _nonce, _token);
+}
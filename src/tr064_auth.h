@@ -0,0 +1,77 @@
+/*!
+ * @file tr064_auth.h
+ *
+ * Session of the SOAP digest authentication of TR-064. The device answers
+ * every request with a fresh nonce; the session keeps it (together with the
+ * realm and the hashed secret), so that each authenticated action needs a
+ * single round trip once the first challenge was obtained.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_auth_h
+#define tr064_auth_h
+
+#include "Arduino.h"
+#include "tr064_soap.h"
+
+#ifndef TR064_AUTH_REALM_BUFFER
+#define TR064_AUTH_REALM_BUFFER     48 ///< Longest realm that can be stored (including terminator)
+#endif
+#ifndef TR064_AUTH_NONCE_BUFFER
+#define TR064_AUTH_NONCE_BUFFER     40 ///< Longest nonce that can be stored (including terminator)
+#endif
+#ifndef TR064_AUTH_MAX_RETRIES
+#define TR064_AUTH_MAX_RETRIES      2  ///< How often a request is repeated with a new nonce
+#endif
+
+/// Counters of a `TR064AuthSession`, see `TR064::authStats()`.
+struct TR064AuthStats {
+    uint32_t challenges;    ///< Exchanges to obtain a (first) nonce and the realm
+    uint32_t accepted;      ///< Responses with status `Authenticated`
+    uint32_t retries;       ///< Requests repeated because the nonce was rejected
+    uint32_t failures;      ///< Requests given up after `TR064_AUTH_MAX_RETRIES`
+};
+
+/**************************************************************************/
+/*!
+    @brief  Realm, hashed secret and the rolling nonce of the digest
+            authentication. Fed from the `Challenge`/`NextChallenge`
+            headers of the responses, it fills in the header of the next
+            request (see `prepare()`).
+*/
+/**************************************************************************/
+class TR064AuthSession {
+    public:
+        TR064AuthSession();
+        void reset();
+        void invalidate();
+        /*!  @brief Whether a nonce and the secret are known, i.e. the next request can authenticate. */
+        bool ready() const { return _nonce[0] != '\0' && _secret[0] != '\0'; }
+        /*!  @brief Whether the device rejected the credentials of the last response. */
+        bool rejected() const { return _rejected; }
+
+        void beginResponse();
+        void setNonce(const char* nonce);
+        void setRealm(const char* realm, const char* user, const char* pass);
+        void setStatus(const char* status);
+        void prepare(TR064SoapEnvelope& envelope, const char* user);
+        void restore(const char* realm, const char* secret, const char* nonce);
+
+        const char* realm() const { return _realm; }
+        const char* nonce() const { return _nonce; }
+        const char* secret() const { return _secret; }
+        TR064AuthStats& stats() { return _stats; }
+        const TR064AuthStats& stats() const { return _stats; }
+
+    private:
+        char _realm[TR064_AUTH_REALM_BUFFER];
+        char _nonce[TR064_AUTH_NONCE_BUFFER];
+        char _secret[33];   // md5(user:realm:password), lowercase hex
+        char _token[33];    // md5(secret:nonce) of the last request
+        bool _rejected;
+        TR064AuthStats _stats;
+};
+
+#endif
@@ -0,0 +1,367 @@
+/*!
+ * @file tr064_batch.cpp
+ *
+ * Batches of TR-064 actions.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_batch.h"
+#include "tr064.h"
+
+/**************************************************************************/
+/*!
+    @brief  Stores the requested outputs of a response in the result table
+            of a `TR064Batch`. Each value is a record of the key (+1) and
+            the zero-terminated text; values that do not fit are dropped.
+*/
+/**************************************************************************/
+class TR064BatchWriter : public TR064XmlHandler {
+    public:
+        explicit TR064BatchWriter(TR064Batch& batch) : _batch(batch), _start(0), _dropping(false) {}
+
+        void onStart(int key) override {
+            _start = _batch._used;
+            char k = (char) (key + 1);
+            _dropping = !_batch.append(&k, 1);
+            if (_dropping) drop();
+        }
+
+        void onText(int key, const char* text, size_t len) override {
+            (void) key;
+            if (!_dropping && !_batch.append(text, len)) drop();
+        }
+
+        bool onEnd(int key) override {
+            (void) key;
+            if (!_dropping && !_batch.append("", 1)) drop();
+            _dropping = false;
+            return true;
+        }
+
+    private:
+        void drop() {
+            _batch._used = _start;
+            _batch._full = true;
+            _dropping = true;
+        }
+
+        TR064Batch& _batch;
+        size_t _start;
+        bool _dropping;
+};
+
+/**************************************************************************/
+/*!
+    @brief  Creates an empty batch.
+    @param    tr064
+                The client whose connection and session are used. Its
+                services must be loaded (see `TR064::init()`).
+    @param    buffer
+                Storage of the result table.
+    @param    size
+                Size of the buffer.
+*/
+/**************************************************************************/
+TR064Batch::TR064Batch(TR064& tr064, char* buffer, size_t size)
+    : _tr064(tr064), _buffer(buffer), _size(size < 0xFFFF ? size : 0xFFFF) {
+    clear();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Removes all calls and results.
+*/
+/**************************************************************************/
+void TR064Batch::clear() {
+    _used = 0;
+    _full = false;
+    _nCalls = 0;
+    _nRows = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Adds an action call. Its service URL is resolved here.
+    @param    service
+                The name of the service you want to adress.
+    @param    action
+                The action you want to perform on the service.
+    @param    args
+                The input arguments.
+    @param    nArgs
+                The number of input arguments.
+    @param    outputs
+                Names of the output parameters to store.
+    @param    nOutputs
+                The number of output parameters.
+    @return The index of the call or -1 if the batch is full, the service
+            is unknown or there are too many arguments.
+*/
+/**************************************************************************/
+int TR064Batch::add(const char* service, const char* action, const TR064SoapArg* args, uint8_t nArgs,
+                    const char* const* outputs, uint8_t nOutputs) {
+    if (_nCalls >= TR064_BATCH_MAX_CALLS || _nRows >= TR064_BATCH_MAX_ROWS
+            || nArgs > TR064_SOAP_MAX_ARGS - 1 || nOutputs > TR064_XML_MAX_KEYS - 5) {
+        TR064_LOG_AT(_tr064, TR064::DEBUG_ERROR, "[TR064][batch]<Error> Too many calls or parameters");
+        return -1;
+    }
+    service = TR064ServiceRegistry::stripPrefix(service);
+    const char* url = _tr064.knownServiceURL(service);
+    if (url[0] == '\0') {
+        return -1;
+    }
+    Call& c = _calls[_nCalls];
+    c.service = service;
+    c.action = action;
+    c.url = url;
+    c.args = args;
+    c.nArgs = nArgs;
+    c.indexArg = nullptr;
+    c.first = 0;
+    c.count = 1;
+    c.outputs = outputs;
+    c.nOutputs = nOutputs;
+    _nRows += 1;
+    return _nCalls++;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Adds a call of an action for a range of indices, e.g.
+            `GetGenericAssociatedDeviceInfo` for all associated devices.
+            Each index is one row of the result table.
+    @param    service
+                The name of the service you want to adress.
+    @param    action
+                The action you want to perform on the service.
+    @param    indexArg
+                Name of the index argument, e.g. `NewAssociatedDeviceIndex`.
+    @param    first
+                The first index.
+    @param    count
+                The number of indices.
+    @param    outputs
+                Names of the output parameters to store.
+    @param    nOutputs
+                The number of output parameters.
+    @return The index of the call or -1 if the batch is full or the service
+            is unknown.
+*/
+/**************************************************************************/
+int TR064Batch::addIndexed(const char* service, const char* action, const char* indexArg, uint16_t first,
+                           uint16_t count, const char* const* outputs, uint8_t nOutputs) {
+    if (count == 0 || count > TR064_BATCH_MAX_ROWS - _nRows) {
+        TR064_LOG_AT(_tr064, TR064::DEBUG_ERROR, "[TR064][batch]<Error> Too many rows");
+        return -1;
+    }
+    int index = add(service, action, nullptr, 0, outputs, nOutputs);
+    if (index < 0) {
+        return -1;
+    }
+    Call& c = _calls[index];
+    c.indexArg = indexArg;
+    c.first = first;
+    c.count = count;
+    _nRows += count - 1;
+    return index;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sends all requests, one after the other on one connection, and
+            fills the result table. A connection or authentication failure
+            aborts the batch; the remaining rows are `TR064_BATCH_NOT_RUN`.
+    @return The number of rows whose action succeeded.
+*/
+/**************************************************************************/
+int TR064Batch::run() {
+    _used = 0;
+    // One handler and tokenizer for all responses
+    TR064ResponseHandler handler(_tr064);
+    TR064XmlTokenizer tokenizer(handler.keys(), handler);
+    TR064BatchWriter writer(*this);
+    uint16_t row = 0;
+    int succeeded = 0;
+    bool aborted = false;
+    TR064Metrics* metrics = _tr064._metrics;
+    for (uint8_t i = 0; i < _nCalls; ++i) {
+        const Call& c = _calls[i];
+        TR064ActionMetrics* action = metrics ? metrics->find(c.service, c.action) : nullptr;
+        for (uint16_t n = 0; n < c.count; ++n, ++row) {
+            Row& r = _rows[row];
+            r.call = i;
+            r.offset = (uint16_t) _used;
+            r.length = 0;
+            if (aborted) {
+                r.status = TR064_BATCH_NOT_RUN;
+                continue;
+            }
+            char index[8];
+            snprintf(index, sizeof(index), "%u", (unsigned) (c.first + n));
+            int status = execute(c, index, handler, tokenizer, writer, action);
+            if (metrics) metrics->countCall(action, status == TR064_BATCH_OK);
+            r.status = (int16_t) status;
+            r.length = (uint16_t) (_used - r.offset);
+            if (status == TR064_BATCH_OK) {
+                ++succeeded;
+            } else if (status < 0 && status != TR064_BATCH_ERROR_SPACE) {
+                aborted = true;
+            }
+        }
+    }
+    TR064_LOG_AT(_tr064, TR064::DEBUG_INFO, "[TR064][batch] %d of %u actions succeeded, %lu bytes of results", succeeded,
+                 (unsigned) _nRows, (unsigned long) _used);
+    return succeeded;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns an output of a row.
+    @param    row
+                The row.
+    @param    output
+                Index of the output in the list passed to `add()`/`addIndexed()`.
+    @return The value, empty if the row failed or the response did not
+            contain it.
+*/
+/**************************************************************************/
+const char* TR064Batch::value(uint16_t row, uint8_t output) const {
+    if (row >= _nRows) {
+        return "";
+    }
+    const Row& r = _rows[row];
+    const char* p = _buffer + r.offset;
+    const char* end = p + r.length;
+    while (p < end) {
+        uint8_t key = (uint8_t) (*p - 1);
+        const char* text = p + 1;
+        if (key == output) {
+            return text;
+        }
+        p = text + strlen(text) + 1;
+    }
+    return "";
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns an output of a row by its name (case-insensitive).
+    @return The value, empty if it is unknown.
+*/
+/**************************************************************************/
+const char* TR064Batch::valueOf(uint16_t row, const char* output) const {
+    if (row >= _nRows) {
+        return "";
+    }
+    const Call& c = _calls[_rows[row].call];
+    for (uint8_t i = 0; i < c.nOutputs; ++i) {
+        if (strcasecmp(c.outputs[i], output) == 0) {
+            return value(row, i);
+        }
+    }
+    return "";
+}
+
+// ----------------------------
+// ----- Helper-functions -----
+// ----------------------------
+
+/**************************************************************************/
+/*!
+    @brief  Sends one request and stores its outputs, repeating it if the
+            nonce was rejected. Feeds the metrics of the client, if any,
+            as `TR064::perform()` does (except for the call itself, see
+            `run()`).
+    @return The status of the row.
+*/
+/**************************************************************************/
+int TR064Batch::execute(const Call& call, const char* index, TR064ResponseHandler& handler,
+                        TR064XmlTokenizer& tokenizer, TR064XmlHandler& writer, TR064ActionMetrics* action) {
+    TR064AuthSession& session = _tr064._session;
+    TR064HttpClient& http = _tr064.http;
+    TR064SoapArg args[TR064_SOAP_MAX_ARGS];
+    uint8_t nArgs = call.nArgs;
+    for (uint8_t i = 0; i < nArgs; ++i) {
+        args[i] = call.args[i];
+    }
+    if (call.indexArg) {
+        args[nArgs].name = call.indexArg;
+        args[nArgs].value = index;
+        ++nArgs;
+    }
+    char soapaction[TR064_SOAP_ACTION_BUFFER];
+    if (TR064SoapEnvelope::soapAction(soapaction, sizeof(soapaction), call.service, call.action) >= sizeof(soapaction)) {
+        return TR064_BATCH_ERROR_SPACE;
+    }
+    size_t start = _used;
+    _tr064.invalidateCache(call.service, call.action);
+
+    TR064Metrics* metrics = _tr064._metrics;
+    for (int tries = 0; ; ++tries) {
+        if (!session.ready()) {
+            bool ready = _tr064.initAuth();
+            _tr064.observeRequest(action, false, 0);
+            if (!ready) {
+                ++session.stats().failures;
+                return TR064_BATCH_ERROR_AUTH;
+            }
+        }
+        TR064SoapEnvelope envelope(call.service, call.action, args, nArgs);
+        session.prepare(envelope, _tr064._user.c_str());
+        session.beginResponse();
+        int code = http.request(_tr064._ip.c_str(), _tr064._port, "POST", call.url, soapaction, &envelope);
+        if (metrics) metrics->countHttp(code);
+        if (code < 0) {
+            TR064_LOG_AT(_tr064, TR064::DEBUG_ERROR, "[TR064][batch]<Error> Failed, message: '%s'", TR064HttpClient::errorToString(code));
+            _tr064.observeRequest(action, false, 0);
+            session.invalidate();
+            return code;
+        }
+        _used = start;
+        _full = false;
+        if (code == TR064_HTTP_CODE_OK) {
+            handler.begin(call.outputs, call.nOutputs, writer);
+        } else {
+            handler.begin(nullptr, 0);
+        }
+        tokenizer.reset();
+        // The parse time is without the time spent waiting for the body
+        unsigned long parseStart = micros();
+        uint32_t waited = http.timing().receive;
+        int rc = tokenizer.scan(http);
+        uint32_t parseUs = (uint32_t) (micros() - parseStart) - (http.timing().receive - waited);
+        http.end();
+        _tr064.observeRequest(action, rc >= 0, parseUs);
+        if (rc < 0) {
+            session.invalidate();
+            return rc;
+        }
+        if (metrics && code != TR064_HTTP_CODE_OK && handler.errorCode() > 0) {
+            metrics->countFault(handler.errorCode());
+        }
+        if (!session.rejected()) {
+            if (code == TR064_HTTP_CODE_OK) {
+                return _full ? TR064_BATCH_ERROR_SPACE : TR064_BATCH_OK;
+            }
+            return handler.errorCode() > 0 ? handler.errorCode() : code;
+        }
+        if (tries >= TR064_AUTH_MAX_RETRIES) {
+            ++session.stats().failures;
+            return TR064_BATCH_ERROR_AUTH;
+        }
+        ++session.stats().retries;
+        if (metrics) metrics->countReauth();
+    }
+}
+
+/// Appends data to the result table. @return false if it does not fit.
+bool TR064Batch::append(const char* data, size_t len) {
+    if (len > _size - _used) {
+        return false;
+    }
+    memcpy(_buffer + _used, data, len);
+    _used += len;
+    return true;
+}
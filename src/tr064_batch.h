@@ -0,0 +1,106 @@
+/*!
+ * @file tr064_batch.h
+ *
+ * Batches of TR-064 actions, e.g. the sweep over all entries of an indexed
+ * list (`GetGenericAssociatedDeviceInfo` for every index). The service URLs
+ * are resolved once when the calls are added; `run()` sends the requests
+ * back-to-back on the kept-alive, authenticated connection and stores the
+ * requested outputs in a compact table in a buffer of the caller.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_batch_h
+#define tr064_batch_h
+
+#include "Arduino.h"
+#include "tr064_soap.h"
+#include "tr064_response.h"
+
+#ifndef TR064_BATCH_MAX_CALLS
+#define TR064_BATCH_MAX_CALLS       8  ///< Maximal number of `add()`/`addIndexed()` calls of a batch
+#endif
+#ifndef TR064_BATCH_MAX_ROWS
+#define TR064_BATCH_MAX_ROWS        64 ///< Maximal number of requests (rows of the result table) of a batch
+#endif
+
+// Status of a row, see `TR064Batch::status()`. Positive values are the
+// `errorCode` of a fault (or the HTTP status code if there was none),
+// other negative values are `TR064_HTTP_ERROR_*` codes.
+#define TR064_BATCH_OK              0   ///< The action succeeded
+#define TR064_BATCH_NOT_RUN         -16 ///< The request was not sent (the batch was aborted)
+#define TR064_BATCH_ERROR_AUTH      -17 ///< The authentication failed
+#define TR064_BATCH_ERROR_SPACE     -18 ///< The buffer is too small for the outputs of this row
+
+class TR064;
+struct TR064ActionMetrics;
+
+/**************************************************************************/
+/*!
+    @brief  List of action calls that are executed together, with a table of
+            their results: one row per request, holding its status and the
+            requested outputs. All names, arguments and output lists are
+            referenced, not copied, and must stay valid until `run()` returned.
+*/
+/**************************************************************************/
+class TR064Batch {
+    public:
+        TR064Batch(TR064& tr064, char* buffer, size_t size);
+        void clear();
+
+        int add(const char* service, const char* action, const TR064SoapArg* args = nullptr, uint8_t nArgs = 0,
+                const char* const* outputs = nullptr, uint8_t nOutputs = 0);
+        int addIndexed(const char* service, const char* action, const char* indexArg, uint16_t first, uint16_t count,
+                       const char* const* outputs, uint8_t nOutputs);
+        int run();
+
+        /*!  @brief Number of rows (requests) of the batch. */
+        uint16_t rows() const { return _nRows; }
+        /*!  @brief Status of a row, `TR064_BATCH_OK` if the action succeeded. */
+        int status(uint16_t row) const { return row < _nRows ? _rows[row].status : TR064_BATCH_NOT_RUN; }
+        /*!  @brief Index of the call (the return value of `add()`/`addIndexed()`) that produced a row, -1 for an unknown row. */
+        int call(uint16_t row) const { return row < _nRows ? _rows[row].call : -1; }
+        const char* value(uint16_t row, uint8_t output) const;
+        const char* valueOf(uint16_t row, const char* output) const;
+        /*!  @brief Bytes of the buffer used by the result table. */
+        size_t used() const { return _used; }
+
+    private:
+        friend class TR064BatchWriter;
+
+        struct Call {
+            const char* service;
+            const char* action;
+            const char* url;
+            const TR064SoapArg* args;
+            const char* indexArg;       // nullptr: not indexed
+            const char* const* outputs;
+            uint16_t first;
+            uint16_t count;             // Number of requests (rows) of the call
+            uint8_t nArgs;
+            uint8_t nOutputs;
+        };
+        struct Row {
+            uint16_t offset;            // Start of the outputs in the buffer
+            uint16_t length;            // Bytes of the outputs in the buffer
+            int16_t status;
+            uint8_t call;
+        };
+
+        int execute(const Call& call, const char* index, TR064ResponseHandler& handler,
+                    TR064XmlTokenizer& tokenizer, TR064XmlHandler& writer, TR064ActionMetrics* action);
+        bool append(const char* data, size_t len);
+
+        TR064& _tr064;
+        char* _buffer;
+        size_t _size;
+        size_t _used;
+        bool _full;                     // The outputs of the current row did not fit
+        Call _calls[TR064_BATCH_MAX_CALLS];
+        uint8_t _nCalls;
+        Row _rows[TR064_BATCH_MAX_ROWS];
+        uint16_t _nRows;
+};
+
+#endif
@@ -0,0 +1,327 @@
+/*!
+ * @file tr064_cache.cpp
+ *
+ * Optional cache of the responses of read-only actions.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_cache.h"
+#include "tr064_services.h"
+#include "tr064_xml.h"
+
+/// Adds a zero-terminated string (including the terminator) to a hash.
+static uint32_t hashPart(uint32_t hash, const char* s) {
+    do {
+        hash = tr064HashStep(hash, *s);
+    } while (*s++ != '\0');
+    return hash;
+}
+
+/// Appends a zero-terminated string (including the terminator). @return The new end.
+static char* appendPart(char* dest, const char* s) {
+    size_t len = strlen(s) + 1;
+    memcpy(dest, s, len);
+    return dest + len;
+}
+
+/// Compares a stored string (ending before `end`) with `s`. @return The end of the stored string or `nullptr` if they differ.
+static const char* matchPart(const char* stored, const char* end, const char* s) {
+    if (!stored) return nullptr;
+    size_t len = strlen(s) + 1;
+    return (size_t) (end - stored) >= len && memcmp(stored, s, len) == 0 ? stored + len : nullptr;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Creates an empty cache. Nothing is cached until a TTL is set
+            (`setDefaultTTL()` or `setTTL()`).
+    @param    size
+                Size of the storage for keys and responses, in bytes (at
+                most 65535). It is allocated once.
+*/
+/**************************************************************************/
+TR064ResponseCache::TR064ResponseCache(size_t size) {
+    if (size > 0xFFFF) size = 0xFFFF;
+    _data = (char*) malloc(size);
+    _size = _data ? (uint16_t) size : 0;
+    _used = 0;
+    _count = 0;
+    _nRules = 0;
+    _defaultTtl = 0;
+    _clock = 0;
+    resetStats();
+}
+
+TR064ResponseCache::~TR064ResponseCache() {
+    free(_data);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sets the TTL of an action, overriding the default TTL.
+    @param    action
+                Name of the action. Not copied, must stay valid.
+    @param    ttl
+                Time to live of its responses in ms, 0 to not cache it.
+    @param    service
+                Name of the service (without `urn:dslforum-org:service:`
+                prefix), or `nullptr` for the action of any service. Not copied.
+    @return false if the action is not cacheable or there are too many rules.
+*/
+/**************************************************************************/
+bool TR064ResponseCache::setTTL(const char* action, uint32_t ttl, const char* service) {
+    if (!cacheable(action)) {
+        return false;
+    }
+    for (uint8_t i = 0; i < _nRules; ++i) {
+        Rule& r = _rules[i];
+        if (strcmp(r.action, action) == 0 && (r.service == service
+                || (r.service && service && strcmp(r.service, service) == 0))) {
+            r.ttl = ttl;
+            return true;
+        }
+    }
+    if (_nRules >= TR064_CACHE_RULES) {
+        return false;
+    }
+    Rule& r = _rules[_nRules++];
+    r.service = service;
+    r.action = action;
+    r.ttl = ttl;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the TTL of an action (in ms), 0 if it is not cached.
+            A rule for the service and action takes precedence over one for
+            the action only, which takes precedence over the default TTL.
+*/
+/**************************************************************************/
+uint32_t TR064ResponseCache::ttl(const char* service, const char* action) const {
+    if (!cacheable(action)) {
+        return 0;
+    }
+    const Rule* match = nullptr;
+    for (uint8_t i = 0; i < _nRules; ++i) {
+        const Rule& r = _rules[i];
+        if (strcmp(r.action, action) != 0) continue;
+        if (r.service && strcmp(r.service, service) == 0) return r.ttl;
+        if (!r.service) match = &r;
+    }
+    return match ? match->ttl : _defaultTtl;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Answers a call from the cache.
+    @param    service
+                Name of the service (without `urn:dslforum-org:service:` prefix).
+    @param    action
+                Name of the action.
+    @param    params
+                The input parameters.
+    @param    nParam
+                The number of input parameters.
+    @param    req
+                The requested output parameters, the values are filled in on a hit.
+    @param    nReq
+                The number of output parameters.
+    @return true on a hit, i.e. an unexpired response of the same call
+            containing all requested outputs was found.
+*/
+/**************************************************************************/
+bool TR064ResponseCache::lookup(const char* service, const char* action, String params[][2], int nParam,
+                                String (*req)[2], int nReq) {
+    if (ttl(service, action) == 0) {
+        return false;
+    }
+    uint32_t hash = hashPart(hashPart(TR064_HASH_INIT, service), action);
+    for (int i = 0; i < nParam; ++i) {
+        hash = hashPart(hashPart(hash, params[i][0].c_str()), params[i][1].c_str());
+    }
+    int index = find(hash, service, action, params, nParam);
+    if (index >= 0 && millis() - _entries[index].stored >= _entries[index].ttl) {
+        remove(index);
+        index = -1;
+    }
+    if (index < 0) {
+        ++_stats.misses;
+        return false;
+    }
+    Entry& e = _entries[index];
+    // All requested outputs must be stored, otherwise the call has to go to the device
+    const char* outputs = _data + e.offset + e.keyLen;
+    const char* values[TR064_XML_MAX_KEYS];
+    if (nReq > TR064_XML_MAX_KEYS) {
+        ++_stats.misses;
+        return false;
+    }
+    for (int i = 0; i < nReq; ++i) {
+        values[i] = nullptr;
+        const char* p = outputs;
+        for (uint8_t j = 0; j < e.nOutputs; ++j) {
+            const char* value = p + strlen(p) + 1;
+            if (strcasecmp(p, req[i][0].c_str()) == 0) {
+                values[i] = value;
+                break;
+            }
+            p = value + strlen(value) + 1;
+        }
+        if (!values[i]) {
+            ++_stats.misses;
+            return false;
+        }
+    }
+    for (int i = 0; i < nReq; ++i) {
+        req[i][1] = values[i];
+    }
+    e.used = ++_clock;
+    ++_stats.hits;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Stores the response of a successful call (if its action is
+            cacheable), evicting the least recently used entries if needed.
+            See `lookup()` for the parameters.
+*/
+/**************************************************************************/
+void TR064ResponseCache::store(const char* service, const char* action, String params[][2], int nParam,
+                               String (*req)[2], int nReq) {
+    uint32_t ttl = this->ttl(service, action);
+    if (ttl == 0 || nReq > 0xFF) {
+        return;
+    }
+    uint32_t hash = hashPart(hashPart(TR064_HASH_INIT, service), action);
+    size_t keyLen = strlen(service) + strlen(action) + 2;
+    for (int i = 0; i < nParam; ++i) {
+        hash = hashPart(hashPart(hash, params[i][0].c_str()), params[i][1].c_str());
+        keyLen += params[i][0].length() + params[i][1].length() + 2;
+    }
+    size_t length = keyLen;
+    for (int i = 0; i < nReq; ++i) {
+        length += req[i][0].length() + req[i][1].length() + 2;
+    }
+    int index = find(hash, service, action, params, nParam);
+    if (index >= 0) {
+        remove(index);
+    }
+    if (length > _size) {
+        return;
+    }
+    while (_count > 0 && (_count >= TR064_CACHE_ENTRIES || _used + length > _size)) {
+        uint8_t lru = 0;
+        for (uint8_t i = 1; i < _count; ++i) {
+            if (_entries[i].used < _entries[lru].used) lru = i;
+        }
+        remove(lru);
+        ++_stats.evictions;
+    }
+
+    Entry& e = _entries[_count++];
+    e.hash = hash;
+    e.stored = millis();
+    e.ttl = ttl;
+    e.used = ++_clock;
+    e.offset = _used;
+    e.keyLen = (uint16_t) keyLen;
+    e.length = (uint16_t) length;
+    e.nOutputs = (uint8_t) nReq;
+    char* p = _data + _used;
+    p = appendPart(appendPart(p, service), action);
+    for (int i = 0; i < nParam; ++i) {
+        p = appendPart(appendPart(p, params[i][0].c_str()), params[i][1].c_str());
+    }
+    for (int i = 0; i < nReq; ++i) {
+        p = appendPart(appendPart(p, req[i][0].c_str()), req[i][1].c_str());
+    }
+    _used += (uint16_t) length;
+    ++_stats.stores;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Drops all cached responses of a service, e.g. after an action
+            changed its state.
+    @param    service
+                Name of the service (without `urn:dslforum-org:service:` prefix).
+*/
+/**************************************************************************/
+void TR064ResponseCache::invalidate(const char* service) {
+    for (int i = _count - 1; i >= 0; --i) {
+        if (strcmp(_data + _entries[i].offset, service) == 0) {
+            remove(i);
+            ++_stats.invalidations;
+        }
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Drops all cached responses. The TTLs are kept.
+*/
+/**************************************************************************/
+void TR064ResponseCache::clear() {
+    _count = 0;
+    _used = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sets all counters of `stats()` to 0.
+*/
+/**************************************************************************/
+void TR064ResponseCache::resetStats() {
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Whether the responses of an action may be cached: only
+            read-only actions (`Get...`, `X_AVM-DE_Get...`) are.
+*/
+/**************************************************************************/
+bool TR064ResponseCache::cacheable(const char* action) {
+    if (strncmp(action, "X_AVM-DE_", 9) == 0) {
+        action += 9;
+    }
+    return strncmp(action, "Get", 3) == 0;
+}
+
+// ----------------------------
+// ----- Helper-functions -----
+// ----------------------------
+
+/// Looks up the entry of a call. @return Its index or -1.
+int TR064ResponseCache::find(uint32_t hash, const char* service, const char* action,
+                             String params[][2], int nParam) const {
+    for (uint8_t i = 0; i < _count; ++i) {
+        const Entry& e = _entries[i];
+        if (e.hash != hash) continue;
+        const char* end = _data + e.offset + e.keyLen;
+        const char* p = matchPart(matchPart(_data + e.offset, end, service), end, action);
+        for (int j = 0; p && j < nParam; ++j) {
+            p = matchPart(matchPart(p, end, params[j][0].c_str()), end, params[j][1].c_str());
+        }
+        if (p == end) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/// Removes an entry and closes the gap in the storage.
+void TR064ResponseCache::remove(int index) {
+    Entry removed = _entries[index];
+    memmove(_data + removed.offset, _data + removed.offset + removed.length,
+            _used - removed.offset - removed.length);
+    _used -= removed.length;
+    for (uint8_t i = 0; i < _count; ++i) {
+        if (_entries[i].offset > removed.offset) _entries[i].offset -= removed.length;
+    }
+    _entries[index] = _entries[--_count];
+}
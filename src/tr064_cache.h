@@ -0,0 +1,103 @@
+/*!
+ * @file tr064_cache.h
+ *
+ * Optional cache of the responses of read-only actions. Keyed by service,
+ * action and arguments, each entry lives for the TTL configured for its
+ * action; identical calls within the TTL are answered from memory. The
+ * memory is bounded, the least recently used entries are evicted first.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_cache_h
+#define tr064_cache_h
+
+#include "Arduino.h"
+
+#ifndef TR064_CACHE_SIZE
+#define TR064_CACHE_SIZE        1024 ///< Default size of the storage of a `TR064ResponseCache` (bytes)
+#endif
+#ifndef TR064_CACHE_ENTRIES
+#define TR064_CACHE_ENTRIES     16   ///< Maximal number of cached responses
+#endif
+#ifndef TR064_CACHE_RULES
+#define TR064_CACHE_RULES       8    ///< Maximal number of per-action TTLs
+#endif
+
+/// Counters of a `TR064ResponseCache`.
+struct TR064CacheStats {
+    uint32_t hits;          ///< Calls answered from the cache
+    uint32_t misses;        ///< Cacheable calls that went to the device
+    uint32_t stores;        ///< Responses stored
+    uint32_t evictions;     ///< Entries dropped to make room (not counting expired ones)
+    uint32_t invalidations; ///< Entries dropped because a state-changing action was called on their service
+};
+
+/**************************************************************************/
+/*!
+    @brief  LRU cache of action responses, see `TR064::setCache()`. Only
+            actions whose name starts with `Get` (or `X_AVM-DE_Get`) are
+            cached; any other action successfully called on a service drops
+            the cached responses of that service.
+*/
+/**************************************************************************/
+class TR064ResponseCache {
+    public:
+        explicit TR064ResponseCache(size_t size = TR064_CACHE_SIZE);
+        ~TR064ResponseCache();
+
+        void setDefaultTTL(uint32_t ttl) { _defaultTtl = ttl; }
+        bool setTTL(const char* action, uint32_t ttl, const char* service = nullptr);
+        uint32_t ttl(const char* service, const char* action) const;
+
+        bool lookup(const char* service, const char* action, String params[][2], int nParam,
+                    String (*req)[2], int nReq);
+        void store(const char* service, const char* action, String params[][2], int nParam,
+                   String (*req)[2], int nReq);
+        void invalidate(const char* service);
+        void clear();
+
+        const TR064CacheStats& stats() const { return _stats; }
+        void resetStats();
+        size_t memoryUsage() const { return _size; }
+        uint8_t size() const { return _count; }
+
+        static bool cacheable(const char* action);
+
+    private:
+        TR064ResponseCache(const TR064ResponseCache&);
+        TR064ResponseCache& operator=(const TR064ResponseCache&);
+
+        struct Entry {
+            uint32_t hash;      // Hash of the key
+            uint32_t stored;    // `millis()` when the response was stored
+            uint32_t ttl;
+            uint32_t used;      // Value of `_clock` when last used (LRU)
+            uint16_t offset;    // Start of key and outputs in `_data`
+            uint16_t keyLen;
+            uint16_t length;    // Length of key and outputs
+            uint8_t nOutputs;
+        };
+        struct Rule {
+            const char* service;    // nullptr: all services
+            const char* action;
+            uint32_t ttl;
+        };
+
+        int find(uint32_t hash, const char* service, const char* action, String params[][2], int nParam) const;
+        void remove(int index);
+
+        char* _data;
+        uint16_t _size;
+        uint16_t _used;
+        Entry _entries[TR064_CACHE_ENTRIES];
+        uint8_t _count;
+        Rule _rules[TR064_CACHE_RULES];
+        uint8_t _nRules;
+        uint32_t _defaultTtl;
+        uint32_t _clock;
+        TR064CacheStats _stats;
+};
+
+#endif
@@ -0,0 +1,623 @@
+/*!
+ * @file tr064_descriptors.h
+ *
+ * Descriptors of the actions of FRITZ!Box 7590 (154.07.57), generated from its SCPD files
+ * by extras/tools/tr064_descriptors.py. Do not edit; regenerate for other
+ * devices or firmware versions. Use with `TR064::action<Descriptor>()`, e.g.
+ * `tr064.action<TR064Actions::Hosts1::GetSpecificHostEntry>(mac, ...)`.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_descriptors_h
+#define tr064_descriptors_h
+
+#include "tr064_action.h"
+#include "tr064_services.h"
+
+namespace TR064Actions {
+
+/// `DeviceInfo:1` (`/deviceinfoSCPD.xml`)
+namespace DeviceInfo1 {
+
+/// `GetInfo()` -> NewManufacturerName, NewManufacturerOUI, NewModelName, NewDescription, NewProductClass, NewSerialNumber, NewSoftwareVersion, NewHardwareVersion, NewSpecVersion, NewProvisioningCode, NewUpTime, NewDeviceLog
+struct GetInfo {
+    typedef TR064Signature<> In;
+    typedef TR064Signature<TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_UI4, TR064_TYPE_STRING> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"DeviceInfo:1", tr064HashConst("DeviceInfo:1"), "GetInfo",
+                "urn:dslforum-org:service:DeviceInfo:1#GetInfo",
+                "<s:Body><u:GetInfo xmlns:u=\"urn:dslforum-org:service:DeviceInfo:1\">",
+                "</u:GetInfo></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewManufacturerName", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewManufacturerOUI", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewModelName", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewDescription", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewProductClass", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewSerialNumber", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewSoftwareVersion", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewHardwareVersion", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewSpecVersion", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewProvisioningCode", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewUpTime", TR064_ARG_OUT, TR064_TYPE_UI4},
+            {"NewDeviceLog", TR064_ARG_OUT, TR064_TYPE_STRING},
+        };
+        return args;
+    }
+};
+
+/// `GetSecurityPort()` -> NewSecurityPort
+struct GetSecurityPort {
+    typedef TR064Signature<> In;
+    typedef TR064Signature<TR064_TYPE_UI2> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"DeviceInfo:1", tr064HashConst("DeviceInfo:1"), "GetSecurityPort",
+                "urn:dslforum-org:service:DeviceInfo:1#GetSecurityPort",
+                "<s:Body><u:GetSecurityPort xmlns:u=\"urn:dslforum-org:service:DeviceInfo:1\">",
+                "</u:GetSecurityPort></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewSecurityPort", TR064_ARG_OUT, TR064_TYPE_UI2},
+        };
+        return args;
+    }
+};
+
+} // namespace DeviceInfo1
+
+/// `X_VoIP:1` (`/x_voipSCPD.xml`)
+namespace X_VoIP1 {
+
+/// `X_AVM-DE_DialNumber(NewX_AVM-DE_PhoneNumber)`
+struct X_AVM_DE_DialNumber {
+    typedef TR064Signature<TR064_TYPE_STRING> In;
+    typedef TR064Signature<> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"X_VoIP:1", tr064HashConst("X_VoIP:1"), "X_AVM-DE_DialNumber",
+                "urn:dslforum-org:service:X_VoIP:1#X_AVM-DE_DialNumber",
+                "<s:Body><u:X_AVM-DE_DialNumber xmlns:u=\"urn:dslforum-org:service:X_VoIP:1\">",
+                "</u:X_AVM-DE_DialNumber></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewX_AVM-DE_PhoneNumber", TR064_ARG_IN, TR064_TYPE_STRING},
+        };
+        return args;
+    }
+};
+
+} // namespace X_VoIP1
+
+/// `X_AVM-DE_TAM:1` (`/x_tamSCPD.xml`)
+namespace X_AVM_DE_TAM1 {
+
+/// `GetInfo(NewIndex)` -> NewEnable, NewName, NewTAMRunning, NewStick, NewStatus, NewCapacity
+struct GetInfo {
+    typedef TR064Signature<TR064_TYPE_UI2> In;
+    typedef TR064Signature<TR064_TYPE_BOOLEAN, TR064_TYPE_STRING, TR064_TYPE_BOOLEAN, TR064_TYPE_UI2, TR064_TYPE_UI2, TR064_TYPE_UI8> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"X_AVM-DE_TAM:1", tr064HashConst("X_AVM-DE_TAM:1"), "GetInfo",
+                "urn:dslforum-org:service:X_AVM-DE_TAM:1#GetInfo",
+                "<s:Body><u:GetInfo xmlns:u=\"urn:dslforum-org:service:X_AVM-DE_TAM:1\">",
+                "</u:GetInfo></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewIndex", TR064_ARG_IN, TR064_TYPE_UI2},
+            {"NewEnable", TR064_ARG_OUT, TR064_TYPE_BOOLEAN},
+            {"NewName", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewTAMRunning", TR064_ARG_OUT, TR064_TYPE_BOOLEAN},
+            {"NewStick", TR064_ARG_OUT, TR064_TYPE_UI2},
+            {"NewStatus", TR064_ARG_OUT, TR064_TYPE_UI2},
+            {"NewCapacity", TR064_ARG_OUT, TR064_TYPE_UI8},
+        };
+        return args;
+    }
+};
+
+/// `SetEnable(NewIndex, NewEnable)`
+struct SetEnable {
+    typedef TR064Signature<TR064_TYPE_UI2, TR064_TYPE_BOOLEAN> In;
+    typedef TR064Signature<> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"X_AVM-DE_TAM:1", tr064HashConst("X_AVM-DE_TAM:1"), "SetEnable",
+                "urn:dslforum-org:service:X_AVM-DE_TAM:1#SetEnable",
+                "<s:Body><u:SetEnable xmlns:u=\"urn:dslforum-org:service:X_AVM-DE_TAM:1\">",
+                "</u:SetEnable></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewIndex", TR064_ARG_IN, TR064_TYPE_UI2},
+            {"NewEnable", TR064_ARG_IN, TR064_TYPE_BOOLEAN},
+        };
+        return args;
+    }
+};
+
+} // namespace X_AVM_DE_TAM1
+
+/// `X_AVM-DE_Homeauto:1` (`/x_homeautoSCPD.xml`)
+namespace X_AVM_DE_Homeauto1 {
+
+/// `GetSpecificDeviceInfos(NewAIN)` -> NewDeviceId, NewFunctionBitMask, NewFirmwareVersion, NewManufacturer, NewProductName, NewDeviceName, NewPresent, NewMultimeterIsEnabled, NewMultimeterIsValid, NewMultimeterPower, NewMultimeterEnergy, NewTemperatureIsEnabled, NewTemperatureIsValid, NewTemperatureCelsius, NewTemperatureOffset, NewSwitchIsEnabled, NewSwitchIsValid, NewSwitchState, NewSwitchMode, NewSwitchLock
+struct GetSpecificDeviceInfos {
+    typedef TR064Signature<TR064_TYPE_STRING> In;
+    typedef TR064Signature<TR064_TYPE_UI2, TR064_TYPE_UI2, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_UI4, TR064_TYPE_UI4, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_I4, TR064_TYPE_I4, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_BOOLEAN> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"X_AVM-DE_Homeauto:1", tr064HashConst("X_AVM-DE_Homeauto:1"), "GetSpecificDeviceInfos",
+                "urn:dslforum-org:service:X_AVM-DE_Homeauto:1#GetSpecificDeviceInfos",
+                "<s:Body><u:GetSpecificDeviceInfos xmlns:u=\"urn:dslforum-org:service:X_AVM-DE_Homeauto:1\">",
+                "</u:GetSpecificDeviceInfos></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewAIN", TR064_ARG_IN, TR064_TYPE_STRING},
+            {"NewDeviceId", TR064_ARG_OUT, TR064_TYPE_UI2},
+            {"NewFunctionBitMask", TR064_ARG_OUT, TR064_TYPE_UI2},
+            {"NewFirmwareVersion", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewManufacturer", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewProductName", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewDeviceName", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewPresent", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewMultimeterIsEnabled", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewMultimeterIsValid", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewMultimeterPower", TR064_ARG_OUT, TR064_TYPE_UI4},
+            {"NewMultimeterEnergy", TR064_ARG_OUT, TR064_TYPE_UI4},
+            {"NewTemperatureIsEnabled", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewTemperatureIsValid", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewTemperatureCelsius", TR064_ARG_OUT, TR064_TYPE_I4},
+            {"NewTemperatureOffset", TR064_ARG_OUT, TR064_TYPE_I4},
+            {"NewSwitchIsEnabled", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewSwitchIsValid", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewSwitchState", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewSwitchMode", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewSwitchLock", TR064_ARG_OUT, TR064_TYPE_BOOLEAN},
+        };
+        return args;
+    }
+};
+
+/// `SetSwitch(NewAIN, NewSwitchState)`
+struct SetSwitch {
+    typedef TR064Signature<TR064_TYPE_STRING, TR064_TYPE_STRING> In;
+    typedef TR064Signature<> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"X_AVM-DE_Homeauto:1", tr064HashConst("X_AVM-DE_Homeauto:1"), "SetSwitch",
+                "urn:dslforum-org:service:X_AVM-DE_Homeauto:1#SetSwitch",
+                "<s:Body><u:SetSwitch xmlns:u=\"urn:dslforum-org:service:X_AVM-DE_Homeauto:1\">",
+                "</u:SetSwitch></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewAIN", TR064_ARG_IN, TR064_TYPE_STRING},
+            {"NewSwitchState", TR064_ARG_IN, TR064_TYPE_STRING},
+        };
+        return args;
+    }
+};
+
+} // namespace X_AVM_DE_Homeauto1
+
+/// `WLANConfiguration:1` (`/wlanconfigSCPD.xml`)
+namespace WLANConfiguration1 {
+
+/// `SetEnable(NewEnable)`
+struct SetEnable {
+    typedef TR064Signature<TR064_TYPE_BOOLEAN> In;
+    typedef TR064Signature<> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"WLANConfiguration:1", tr064HashConst("WLANConfiguration:1"), "SetEnable",
+                "urn:dslforum-org:service:WLANConfiguration:1#SetEnable",
+                "<s:Body><u:SetEnable xmlns:u=\"urn:dslforum-org:service:WLANConfiguration:1\">",
+                "</u:SetEnable></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewEnable", TR064_ARG_IN, TR064_TYPE_BOOLEAN},
+        };
+        return args;
+    }
+};
+
+/// `GetTotalAssociations()` -> NewTotalAssociations
+struct GetTotalAssociations {
+    typedef TR064Signature<> In;
+    typedef TR064Signature<TR064_TYPE_UI2> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"WLANConfiguration:1", tr064HashConst("WLANConfiguration:1"), "GetTotalAssociations",
+                "urn:dslforum-org:service:WLANConfiguration:1#GetTotalAssociations",
+                "<s:Body><u:GetTotalAssociations xmlns:u=\"urn:dslforum-org:service:WLANConfiguration:1\">",
+                "</u:GetTotalAssociations></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewTotalAssociations", TR064_ARG_OUT, TR064_TYPE_UI2},
+        };
+        return args;
+    }
+};
+
+/// `GetGenericAssociatedDeviceInfo(NewAssociatedDeviceIndex)` -> NewAssociatedDeviceMACAddress, NewAssociatedDeviceIPAddress, NewAssociatedDeviceAuthState, NewX_AVM-DE_Speed, NewX_AVM-DE_SignalStrength
+struct GetGenericAssociatedDeviceInfo {
+    typedef TR064Signature<TR064_TYPE_UI2> In;
+    typedef TR064Signature<TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_BOOLEAN, TR064_TYPE_UI4, TR064_TYPE_UI1> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"WLANConfiguration:1", tr064HashConst("WLANConfiguration:1"), "GetGenericAssociatedDeviceInfo",
+                "urn:dslforum-org:service:WLANConfiguration:1#GetGenericAssociatedDeviceInfo",
+                "<s:Body><u:GetGenericAssociatedDeviceInfo xmlns:u=\"urn:dslforum-org:service:WLANConfiguration:1\">",
+                "</u:GetGenericAssociatedDeviceInfo></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewAssociatedDeviceIndex", TR064_ARG_IN, TR064_TYPE_UI2},
+            {"NewAssociatedDeviceMACAddress", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewAssociatedDeviceIPAddress", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewAssociatedDeviceAuthState", TR064_ARG_OUT, TR064_TYPE_BOOLEAN},
+            {"NewX_AVM-DE_Speed", TR064_ARG_OUT, TR064_TYPE_UI4},
+            {"NewX_AVM-DE_SignalStrength", TR064_ARG_OUT, TR064_TYPE_UI1},
+        };
+        return args;
+    }
+};
+
+/// `GetSpecificAssociatedDeviceInfo(NewAssociatedDeviceMACAddress)` -> NewAssociatedDeviceIPAddress, NewAssociatedDeviceAuthState, NewX_AVM-DE_Speed, NewX_AVM-DE_SignalStrength
+struct GetSpecificAssociatedDeviceInfo {
+    typedef TR064Signature<TR064_TYPE_STRING> In;
+    typedef TR064Signature<TR064_TYPE_STRING, TR064_TYPE_BOOLEAN, TR064_TYPE_UI4, TR064_TYPE_UI1> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"WLANConfiguration:1", tr064HashConst("WLANConfiguration:1"), "GetSpecificAssociatedDeviceInfo",
+                "urn:dslforum-org:service:WLANConfiguration:1#GetSpecificAssociatedDeviceInfo",
+                "<s:Body><u:GetSpecificAssociatedDeviceInfo xmlns:u=\"urn:dslforum-org:service:WLANConfiguration:1\">",
+                "</u:GetSpecificAssociatedDeviceInfo></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewAssociatedDeviceMACAddress", TR064_ARG_IN, TR064_TYPE_STRING},
+            {"NewAssociatedDeviceIPAddress", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewAssociatedDeviceAuthState", TR064_ARG_OUT, TR064_TYPE_BOOLEAN},
+            {"NewX_AVM-DE_Speed", TR064_ARG_OUT, TR064_TYPE_UI4},
+            {"NewX_AVM-DE_SignalStrength", TR064_ARG_OUT, TR064_TYPE_UI1},
+        };
+        return args;
+    }
+};
+
+} // namespace WLANConfiguration1
+
+/// `WLANConfiguration:2` (`/wlanconfigSCPD.xml`)
+namespace WLANConfiguration2 {
+
+/// `SetEnable(NewEnable)`
+struct SetEnable {
+    typedef TR064Signature<TR064_TYPE_BOOLEAN> In;
+    typedef TR064Signature<> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"WLANConfiguration:2", tr064HashConst("WLANConfiguration:2"), "SetEnable",
+                "urn:dslforum-org:service:WLANConfiguration:2#SetEnable",
+                "<s:Body><u:SetEnable xmlns:u=\"urn:dslforum-org:service:WLANConfiguration:2\">",
+                "</u:SetEnable></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewEnable", TR064_ARG_IN, TR064_TYPE_BOOLEAN},
+        };
+        return args;
+    }
+};
+
+/// `GetTotalAssociations()` -> NewTotalAssociations
+struct GetTotalAssociations {
+    typedef TR064Signature<> In;
+    typedef TR064Signature<TR064_TYPE_UI2> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"WLANConfiguration:2", tr064HashConst("WLANConfiguration:2"), "GetTotalAssociations",
+                "urn:dslforum-org:service:WLANConfiguration:2#GetTotalAssociations",
+                "<s:Body><u:GetTotalAssociations xmlns:u=\"urn:dslforum-org:service:WLANConfiguration:2\">",
+                "</u:GetTotalAssociations></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewTotalAssociations", TR064_ARG_OUT, TR064_TYPE_UI2},
+        };
+        return args;
+    }
+};
+
+/// `GetGenericAssociatedDeviceInfo(NewAssociatedDeviceIndex)` -> NewAssociatedDeviceMACAddress, NewAssociatedDeviceIPAddress, NewAssociatedDeviceAuthState, NewX_AVM-DE_Speed, NewX_AVM-DE_SignalStrength
+struct GetGenericAssociatedDeviceInfo {
+    typedef TR064Signature<TR064_TYPE_UI2> In;
+    typedef TR064Signature<TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_BOOLEAN, TR064_TYPE_UI4, TR064_TYPE_UI1> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"WLANConfiguration:2", tr064HashConst("WLANConfiguration:2"), "GetGenericAssociatedDeviceInfo",
+                "urn:dslforum-org:service:WLANConfiguration:2#GetGenericAssociatedDeviceInfo",
+                "<s:Body><u:GetGenericAssociatedDeviceInfo xmlns:u=\"urn:dslforum-org:service:WLANConfiguration:2\">",
+                "</u:GetGenericAssociatedDeviceInfo></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewAssociatedDeviceIndex", TR064_ARG_IN, TR064_TYPE_UI2},
+            {"NewAssociatedDeviceMACAddress", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewAssociatedDeviceIPAddress", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewAssociatedDeviceAuthState", TR064_ARG_OUT, TR064_TYPE_BOOLEAN},
+            {"NewX_AVM-DE_Speed", TR064_ARG_OUT, TR064_TYPE_UI4},
+            {"NewX_AVM-DE_SignalStrength", TR064_ARG_OUT, TR064_TYPE_UI1},
+        };
+        return args;
+    }
+};
+
+/// `GetSpecificAssociatedDeviceInfo(NewAssociatedDeviceMACAddress)` -> NewAssociatedDeviceIPAddress, NewAssociatedDeviceAuthState, NewX_AVM-DE_Speed, NewX_AVM-DE_SignalStrength
+struct GetSpecificAssociatedDeviceInfo {
+    typedef TR064Signature<TR064_TYPE_STRING> In;
+    typedef TR064Signature<TR064_TYPE_STRING, TR064_TYPE_BOOLEAN, TR064_TYPE_UI4, TR064_TYPE_UI1> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"WLANConfiguration:2", tr064HashConst("WLANConfiguration:2"), "GetSpecificAssociatedDeviceInfo",
+                "urn:dslforum-org:service:WLANConfiguration:2#GetSpecificAssociatedDeviceInfo",
+                "<s:Body><u:GetSpecificAssociatedDeviceInfo xmlns:u=\"urn:dslforum-org:service:WLANConfiguration:2\">",
+                "</u:GetSpecificAssociatedDeviceInfo></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewAssociatedDeviceMACAddress", TR064_ARG_IN, TR064_TYPE_STRING},
+            {"NewAssociatedDeviceIPAddress", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewAssociatedDeviceAuthState", TR064_ARG_OUT, TR064_TYPE_BOOLEAN},
+            {"NewX_AVM-DE_Speed", TR064_ARG_OUT, TR064_TYPE_UI4},
+            {"NewX_AVM-DE_SignalStrength", TR064_ARG_OUT, TR064_TYPE_UI1},
+        };
+        return args;
+    }
+};
+
+} // namespace WLANConfiguration2
+
+/// `WLANConfiguration:3` (`/wlanconfigSCPD.xml`)
+namespace WLANConfiguration3 {
+
+/// `SetEnable(NewEnable)`
+struct SetEnable {
+    typedef TR064Signature<TR064_TYPE_BOOLEAN> In;
+    typedef TR064Signature<> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"WLANConfiguration:3", tr064HashConst("WLANConfiguration:3"), "SetEnable",
+                "urn:dslforum-org:service:WLANConfiguration:3#SetEnable",
+                "<s:Body><u:SetEnable xmlns:u=\"urn:dslforum-org:service:WLANConfiguration:3\">",
+                "</u:SetEnable></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewEnable", TR064_ARG_IN, TR064_TYPE_BOOLEAN},
+        };
+        return args;
+    }
+};
+
+/// `GetTotalAssociations()` -> NewTotalAssociations
+struct GetTotalAssociations {
+    typedef TR064Signature<> In;
+    typedef TR064Signature<TR064_TYPE_UI2> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"WLANConfiguration:3", tr064HashConst("WLANConfiguration:3"), "GetTotalAssociations",
+                "urn:dslforum-org:service:WLANConfiguration:3#GetTotalAssociations",
+                "<s:Body><u:GetTotalAssociations xmlns:u=\"urn:dslforum-org:service:WLANConfiguration:3\">",
+                "</u:GetTotalAssociations></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewTotalAssociations", TR064_ARG_OUT, TR064_TYPE_UI2},
+        };
+        return args;
+    }
+};
+
+/// `GetGenericAssociatedDeviceInfo(NewAssociatedDeviceIndex)` -> NewAssociatedDeviceMACAddress, NewAssociatedDeviceIPAddress, NewAssociatedDeviceAuthState, NewX_AVM-DE_Speed, NewX_AVM-DE_SignalStrength
+struct GetGenericAssociatedDeviceInfo {
+    typedef TR064Signature<TR064_TYPE_UI2> In;
+    typedef TR064Signature<TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_BOOLEAN, TR064_TYPE_UI4, TR064_TYPE_UI1> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"WLANConfiguration:3", tr064HashConst("WLANConfiguration:3"), "GetGenericAssociatedDeviceInfo",
+                "urn:dslforum-org:service:WLANConfiguration:3#GetGenericAssociatedDeviceInfo",
+                "<s:Body><u:GetGenericAssociatedDeviceInfo xmlns:u=\"urn:dslforum-org:service:WLANConfiguration:3\">",
+                "</u:GetGenericAssociatedDeviceInfo></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewAssociatedDeviceIndex", TR064_ARG_IN, TR064_TYPE_UI2},
+            {"NewAssociatedDeviceMACAddress", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewAssociatedDeviceIPAddress", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewAssociatedDeviceAuthState", TR064_ARG_OUT, TR064_TYPE_BOOLEAN},
+            {"NewX_AVM-DE_Speed", TR064_ARG_OUT, TR064_TYPE_UI4},
+            {"NewX_AVM-DE_SignalStrength", TR064_ARG_OUT, TR064_TYPE_UI1},
+        };
+        return args;
+    }
+};
+
+/// `GetSpecificAssociatedDeviceInfo(NewAssociatedDeviceMACAddress)` -> NewAssociatedDeviceIPAddress, NewAssociatedDeviceAuthState, NewX_AVM-DE_Speed, NewX_AVM-DE_SignalStrength
+struct GetSpecificAssociatedDeviceInfo {
+    typedef TR064Signature<TR064_TYPE_STRING> In;
+    typedef TR064Signature<TR064_TYPE_STRING, TR064_TYPE_BOOLEAN, TR064_TYPE_UI4, TR064_TYPE_UI1> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"WLANConfiguration:3", tr064HashConst("WLANConfiguration:3"), "GetSpecificAssociatedDeviceInfo",
+                "urn:dslforum-org:service:WLANConfiguration:3#GetSpecificAssociatedDeviceInfo",
+                "<s:Body><u:GetSpecificAssociatedDeviceInfo xmlns:u=\"urn:dslforum-org:service:WLANConfiguration:3\">",
+                "</u:GetSpecificAssociatedDeviceInfo></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewAssociatedDeviceMACAddress", TR064_ARG_IN, TR064_TYPE_STRING},
+            {"NewAssociatedDeviceIPAddress", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewAssociatedDeviceAuthState", TR064_ARG_OUT, TR064_TYPE_BOOLEAN},
+            {"NewX_AVM-DE_Speed", TR064_ARG_OUT, TR064_TYPE_UI4},
+            {"NewX_AVM-DE_SignalStrength", TR064_ARG_OUT, TR064_TYPE_UI1},
+        };
+        return args;
+    }
+};
+
+} // namespace WLANConfiguration3
+
+/// `Hosts:1` (`/hostsSCPD.xml`)
+namespace Hosts1 {
+
+/// `GetHostNumberOfEntries()` -> NewHostNumberOfEntries
+struct GetHostNumberOfEntries {
+    typedef TR064Signature<> In;
+    typedef TR064Signature<TR064_TYPE_UI2> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"Hosts:1", tr064HashConst("Hosts:1"), "GetHostNumberOfEntries",
+                "urn:dslforum-org:service:Hosts:1#GetHostNumberOfEntries",
+                "<s:Body><u:GetHostNumberOfEntries xmlns:u=\"urn:dslforum-org:service:Hosts:1\">",
+                "</u:GetHostNumberOfEntries></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewHostNumberOfEntries", TR064_ARG_OUT, TR064_TYPE_UI2},
+        };
+        return args;
+    }
+};
+
+/// `GetSpecificHostEntry(NewMACAddress)` -> NewIPAddress, NewAddressSource, NewLeaseTimeRemaining, NewInterfaceType, NewActive, NewHostName
+struct GetSpecificHostEntry {
+    typedef TR064Signature<TR064_TYPE_STRING> In;
+    typedef TR064Signature<TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_I4, TR064_TYPE_STRING, TR064_TYPE_BOOLEAN, TR064_TYPE_STRING> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"Hosts:1", tr064HashConst("Hosts:1"), "GetSpecificHostEntry",
+                "urn:dslforum-org:service:Hosts:1#GetSpecificHostEntry",
+                "<s:Body><u:GetSpecificHostEntry xmlns:u=\"urn:dslforum-org:service:Hosts:1\">",
+                "</u:GetSpecificHostEntry></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewMACAddress", TR064_ARG_IN, TR064_TYPE_STRING},
+            {"NewIPAddress", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewAddressSource", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewLeaseTimeRemaining", TR064_ARG_OUT, TR064_TYPE_I4},
+            {"NewInterfaceType", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewActive", TR064_ARG_OUT, TR064_TYPE_BOOLEAN},
+            {"NewHostName", TR064_ARG_OUT, TR064_TYPE_STRING},
+        };
+        return args;
+    }
+};
+
+/// `GetGenericHostEntry(NewIndex)` -> NewIPAddress, NewAddressSource, NewLeaseTimeRemaining, NewMACAddress, NewInterfaceType, NewActive, NewHostName
+struct GetGenericHostEntry {
+    typedef TR064Signature<TR064_TYPE_UI2> In;
+    typedef TR064Signature<TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_I4, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_BOOLEAN, TR064_TYPE_STRING> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"Hosts:1", tr064HashConst("Hosts:1"), "GetGenericHostEntry",
+                "urn:dslforum-org:service:Hosts:1#GetGenericHostEntry",
+                "<s:Body><u:GetGenericHostEntry xmlns:u=\"urn:dslforum-org:service:Hosts:1\">",
+                "</u:GetGenericHostEntry></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewIndex", TR064_ARG_IN, TR064_TYPE_UI2},
+            {"NewIPAddress", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewAddressSource", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewLeaseTimeRemaining", TR064_ARG_OUT, TR064_TYPE_I4},
+            {"NewMACAddress", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewInterfaceType", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewActive", TR064_ARG_OUT, TR064_TYPE_BOOLEAN},
+            {"NewHostName", TR064_ARG_OUT, TR064_TYPE_STRING},
+        };
+        return args;
+    }
+};
+
+/// `X_AVM-DE_GetHostListPath()` -> NewX_AVM-DE_HostListPath
+struct X_AVM_DE_GetHostListPath {
+    typedef TR064Signature<> In;
+    typedef TR064Signature<TR064_TYPE_STRING> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"Hosts:1", tr064HashConst("Hosts:1"), "X_AVM-DE_GetHostListPath",
+                "urn:dslforum-org:service:Hosts:1#X_AVM-DE_GetHostListPath",
+                "<s:Body><u:X_AVM-DE_GetHostListPath xmlns:u=\"urn:dslforum-org:service:Hosts:1\">",
+                "</u:X_AVM-DE_GetHostListPath></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewX_AVM-DE_HostListPath", TR064_ARG_OUT, TR064_TYPE_STRING},
+        };
+        return args;
+    }
+};
+
+} // namespace Hosts1
+
+/// `WANCommonInterfaceConfig:1` (`/wancommonifconfigSCPD.xml`)
+namespace WANCommonInterfaceConfig1 {
+
+/// `GetTotalBytesSent()` -> NewTotalBytesSent
+struct GetTotalBytesSent {
+    typedef TR064Signature<> In;
+    typedef TR064Signature<TR064_TYPE_UI4> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"WANCommonInterfaceConfig:1", tr064HashConst("WANCommonInterfaceConfig:1"), "GetTotalBytesSent",
+                "urn:dslforum-org:service:WANCommonInterfaceConfig:1#GetTotalBytesSent",
+                "<s:Body><u:GetTotalBytesSent xmlns:u=\"urn:dslforum-org:service:WANCommonInterfaceConfig:1\">",
+                "</u:GetTotalBytesSent></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewTotalBytesSent", TR064_ARG_OUT, TR064_TYPE_UI4},
+        };
+        return args;
+    }
+};
+
+/// `GetTotalBytesReceived()` -> NewTotalBytesReceived
+struct GetTotalBytesReceived {
+    typedef TR064Signature<> In;
+    typedef TR064Signature<TR064_TYPE_UI4> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"WANCommonInterfaceConfig:1", tr064HashConst("WANCommonInterfaceConfig:1"), "GetTotalBytesReceived",
+                "urn:dslforum-org:service:WANCommonInterfaceConfig:1#GetTotalBytesReceived",
+                "<s:Body><u:GetTotalBytesReceived xmlns:u=\"urn:dslforum-org:service:WANCommonInterfaceConfig:1\">",
+                "</u:GetTotalBytesReceived></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewTotalBytesReceived", TR064_ARG_OUT, TR064_TYPE_UI4},
+        };
+        return args;
+    }
+};
+
+/// `X_AVM-DE_GetOnlineMonitor(NewSyncGroupIndex)` -> NewTotalNumberSyncGroups, NewSyncgroupName, NewSyncgroupMode, Newmax_ds, Newmax_us, Newds_current_bps, Newmc_current_bps, Newus_current_bps
+struct X_AVM_DE_GetOnlineMonitor {
+    typedef TR064Signature<TR064_TYPE_UI4> In;
+    typedef TR064Signature<TR064_TYPE_UI4, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_UI4, TR064_TYPE_UI4, TR064_TYPE_STRING, TR064_TYPE_STRING, TR064_TYPE_STRING> Out;
+    static constexpr TR064ActionInfo info() {
+        return {"WANCommonInterfaceConfig:1", tr064HashConst("WANCommonInterfaceConfig:1"), "X_AVM-DE_GetOnlineMonitor",
+                "urn:dslforum-org:service:WANCommonInterfaceConfig:1#X_AVM-DE_GetOnlineMonitor",
+                "<s:Body><u:X_AVM-DE_GetOnlineMonitor xmlns:u=\"urn:dslforum-org:service:WANCommonInterfaceConfig:1\">",
+                "</u:X_AVM-DE_GetOnlineMonitor></s:Body></s:Envelope>"};
+    }
+    static const TR064ArgDescriptor* arguments() {
+        static const TR064ArgDescriptor args[] = {
+            {"NewSyncGroupIndex", TR064_ARG_IN, TR064_TYPE_UI4},
+            {"NewTotalNumberSyncGroups", TR064_ARG_OUT, TR064_TYPE_UI4},
+            {"NewSyncgroupName", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"NewSyncgroupMode", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"Newmax_ds", TR064_ARG_OUT, TR064_TYPE_UI4},
+            {"Newmax_us", TR064_ARG_OUT, TR064_TYPE_UI4},
+            {"Newds_current_bps", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"Newmc_current_bps", TR064_ARG_OUT, TR064_TYPE_STRING},
+            {"Newus_current_bps", TR064_ARG_OUT, TR064_TYPE_STRING},
+        };
+        return args;
+    }
+};
+
+} // namespace WANCommonInterfaceConfig1
+
+} // namespace TR064Actions
+
+#endif
@@ -0,0 +1,551 @@
+/*!
+ * @file tr064_events.cpp
+ *
+ * UPnP eventing (GENA) for the services of a TR-064 device.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_events.h"
+#include "tr064.h"
+
+/// Answers a NOTIFY request and closes the connection.
+static void respond(TR064Transport& connection, int code) {
+    const char* status = code == 200 ? "200 OK" : code == 412 ? "412 Precondition Failed" : "400 Bad Request";
+    char response[96];
+    int len = snprintf(response, sizeof(response), "HTTP/1.1 %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", status);
+    connection.write((const uint8_t*) response, (size_t) len);
+    connection.stop();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Creates the subscription manager, without subscriptions. The
+            listener is started by `begin()`.
+    @param    tr064
+                The client whose services and connection are used. It must
+                outlive this object.
+*/
+/**************************************************************************/
+TR064Events::TR064Events(TR064& tr064)
+    : _tr064(tr064), _listener(&_defaultListener), _started(false),
+      _tokenizer(_propertySet.keys(), _propertySet) {
+    _callback[0] = '\0';
+    _in.connection = nullptr;
+    _propertySet.tokenizer = &_tokenizer;
+    for (int i = 0; i < TR064_EVENTS_SUBSCRIPTIONS; ++i) {
+        _subscriptions[i].service[0] = '\0';
+        _subscriptions[i].sid[0] = '\0';
+    }
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Replaces the default listener (a `WiFiServer`, natively a POSIX
+            socket). Call it before `begin()`.
+    @param    listener
+                The listener, it must outlive this object.
+*/
+/**************************************************************************/
+TR064Events& TR064Events::setListener(TR064Listener& listener) {
+    _listener = &listener;
+    return *this;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Starts the listener for the NOTIFY requests of the device.
+    @param    port
+                The port to listen on (natively, 0 picks a free port).
+    @return success state.
+*/
+/**************************************************************************/
+bool TR064Events::begin(uint16_t port) {
+    _listener->end();
+    _started = false;
+    char ip[16];
+    if (!_listener->begin(port)) {
+        TR064_LOG_AT(_tr064, TR064::DEBUG_ERROR, "[TR064][events]<Error> Can not listen on port %u", (unsigned) port);
+        return false;
+    }
+    if (!_listener->localAddress(_tr064._ip.c_str(), ip, sizeof(ip))) {
+        TR064_LOG_AT(_tr064, TR064::DEBUG_ERROR, "[TR064][events]<Error> No local address to reach %s", _tr064._ip.c_str());
+        _listener->end();
+        return false;
+    }
+    snprintf(_callback, sizeof(_callback), "<http://%s:%u" TR064_EVENTS_PATH ">", ip, (unsigned) _listener->port());
+    TR064_LOG_AT(_tr064, TR064::DEBUG_INFO, "[TR064][events] Listening for events at %s", _callback);
+    _started = true;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Cancels all subscriptions and stops the listener.
+*/
+/**************************************************************************/
+void TR064Events::end() {
+    for (int i = 0; i < TR064_EVENTS_SUBSCRIPTIONS; ++i) {
+        unsubscribe(i + 1);
+    }
+    // The listener closes the accepted connection
+    _in.connection = nullptr;
+    _listener->end();
+    _started = false;
+    _callback[0] = '\0';
+}
+
+/**************************************************************************/
+/*!
+    @brief  Subscribes to the events of a service. The device sends the
+            current values of all evented variables right away and then
+            each change; the callback is called for each variable from
+            `poll()`.
+    @param    service
+                The name of the service, e.g. `X_AVM-DE_TAM:1`. Its
+                `eventSubURL` is taken from the device description.
+    @param    callback
+                Called with each state variable received.
+    @param    context
+                Passed to the callback.
+    @return A handle (> 0) for `unsubscribe()` or a negative
+            `TR064_EVENTS_ERROR_*` code.
+*/
+/**************************************************************************/
+int TR064Events::subscribe(const char* service, TR064EventCallback callback, void* context) {
+    if (!_started) {
+        return TR064_EVENTS_ERROR_NOT_STARTED;
+    }
+    const char* url = _tr064._services.eventSubURL(service);
+    if (!url || url[0] == '\0' || strlen(service) >= TR064_EVENTS_NAME) {
+        TR064_LOG_AT(_tr064, TR064::DEBUG_ERROR, "[TR064][subscribe]<Error> %s has no events", service);
+        return TR064_EVENTS_ERROR_NO_EVENTS;
+    }
+    for (int i = 0; i < TR064_EVENTS_SUBSCRIPTIONS; ++i) {
+        Subscription& s = _subscriptions[i];
+        if (s.service[0] != '\0') {
+            continue;
+        }
+        strcpy(s.service, service);
+        s.sid[0] = '\0';
+        s.callback = callback;
+        s.context = context;
+        if (!sendSubscribe(s)) {
+            s.service[0] = '\0';
+            return TR064_EVENTS_ERROR_REJECTED;
+        }
+        return i + 1;
+    }
+    return TR064_EVENTS_ERROR_FULL;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Cancels a subscription.
+    @param    handle
+                The handle returned by `subscribe()`.
+    @return false if the handle is unknown.
+*/
+/**************************************************************************/
+bool TR064Events::unsubscribe(int handle) {
+    if (handle < 1 || handle > TR064_EVENTS_SUBSCRIPTIONS || _subscriptions[handle - 1].service[0] == '\0') {
+        return false;
+    }
+    Subscription& s = _subscriptions[handle - 1];
+    if (s.sid[0] != '\0') {
+        sendUnsubscribe(s);
+    }
+    if (_in.connection && _in.subscription == &s) {
+        // Its callback must not be called any more
+        TR064_LOG_AT(_tr064, TR064::DEBUG_WARNING, "[TR064][notify]<Error> %s: unsubscribed during the request", s.service);
+        rejectNotify(412);
+    }
+    s.service[0] = '\0';
+    s.sid[0] = '\0';
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Whether a subscription is active, i.e. the device accepted it
+            (or its last renewal) and it was not cancelled. A lost
+            subscription is made again by `poll()`.
+*/
+/**************************************************************************/
+bool TR064Events::subscribed(int handle) const {
+    return handle >= 1 && handle <= TR064_EVENTS_SUBSCRIPTIONS && _subscriptions[handle - 1].sid[0] != '\0';
+}
+
+/**************************************************************************/
+/*!
+    @brief  Handles the NOTIFY requests that arrived (without waiting for
+            new ones or for the rest of one) and renews the subscriptions
+            that are due.
+*/
+/**************************************************************************/
+void TR064Events::poll() {
+    if (!_started) {
+        return;
+    }
+    // A request read in part is continued first, accepting another connection would close it
+    if (_in.connection) {
+        readNotify();
+    }
+    for (int i = 0; i < TR064_EVENTS_SUBSCRIPTIONS && !_in.connection; ++i) {
+        TR064Transport* connection = _listener->accept();
+        if (!connection) break;
+        beginNotify(*connection);
+        readNotify();
+    }
+    for (int i = 0; i < TR064_EVENTS_SUBSCRIPTIONS; ++i) {
+        Subscription& s = _subscriptions[i];
+        if (s.service[0] != '\0' && (long) (millis() - s.renewAt) >= 0) {
+            sendSubscribe(s);
+        }
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Translates a `TR064_EVENTS_ERROR_*` code into a string.
+*/
+/**************************************************************************/
+const char* TR064Events::errorToString(int error) {
+    switch (error) {
+    case TR064_EVENTS_ERROR_NOT_STARTED:
+        return "not started";
+    case TR064_EVENTS_ERROR_NO_EVENTS:
+        return "service has no events";
+    case TR064_EVENTS_ERROR_FULL:
+        return "no free subscription";
+    case TR064_EVENTS_ERROR_REJECTED:
+        return "subscription rejected";
+    default:
+        return "";
+    }
+}
+
+// ----------------------------
+// ----- Helper-functions -----
+// ----------------------------
+
+void TR064Events::ResponseHeaders::onHeader(const char* name, const char* value) {
+    if (strcasecmp(name, "SID") == 0) {
+        // A truncated id could not be renewed, it is dropped
+        if (strlen(value) < sizeof(sid)) strcpy(sid, value);
+    } else if (strcasecmp(name, "TIMEOUT") == 0 && strncasecmp(value, "Second-", 7) == 0) {
+        // "Second-infinite" leaves it at 0, i.e. the requested duration
+        timeout = strtoul(value + 7, nullptr, 10);
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Subscribes (or renews the subscription, if it has an id). A
+            renewal the device refuses because it forgot the subscription
+            is replaced by a new one. The next renewal is scheduled after
+            three quarters of the granted duration, a failed attempt is
+            repeated after `TR064_EVENTS_RETRY` ms.
+    @return success state.
+*/
+/**************************************************************************/
+bool TR064Events::sendSubscribe(Subscription& s) {
+    const char* url = _tr064._services.eventSubURL(s.service);
+    bool renewal = s.sid[0] != '\0';
+    char headers[TR064_EVENTS_SID + sizeof(_callback) + 48];
+    if (renewal) {
+        snprintf(headers, sizeof(headers), "SID: %s\r\nTIMEOUT: Second-%u\r\n", s.sid, (unsigned) TR064_EVENTS_TIMEOUT);
+    } else {
+        snprintf(headers, sizeof(headers), "CALLBACK: %s\r\nNT: upnp:event\r\nTIMEOUT: Second-%u\r\n", _callback,
+                 (unsigned) TR064_EVENTS_TIMEOUT);
+    }
+    int code = TR064_HTTP_ERROR_INVALID_RESPONSE;
+    ResponseHeaders response;
+    if (url && url[0] != '\0') {
+        TR064HttpClient& http = _tr064.http;
+        http.setHeaders(headers);
+        http.setHeaderHandler(&response);
+        code = http.request(_tr064._ip.c_str(), _tr064._port, "SUBSCRIBE", url, nullptr, nullptr, 0);
+        http.setHeaders(nullptr);
+        http.setHeaderHandler(nullptr);
+        if (code > 0) http.end();
+        if (_tr064._metrics) _tr064._metrics->countHttp(code);
+    }
+    if (renewal && code == 412) {
+        TR064_LOG_AT(_tr064, TR064::DEBUG_WARNING, "[TR064][subscribe] %s: subscription %s expired, subscribing again",
+                     s.service, s.sid);
+        s.sid[0] = '\0';
+        return sendSubscribe(s);
+    }
+    if (code != TR064_HTTP_CODE_OK || (!renewal && response.sid[0] == '\0')) {
+        ++_stats.failures;
+        s.renewAt = millis() + TR064_EVENTS_RETRY;
+        TR064_LOG_AT(_tr064, TR064::DEBUG_ERROR, "[TR064][subscribe]<Error> %s: %s failed (%d)", s.service,
+                     renewal ? "renewal" : "subscription", code);
+        return false;
+    }
+    if (renewal) {
+        ++_stats.renewals;
+    } else {
+        strcpy(s.sid, response.sid);
+        s.seq = 0;
+        ++_stats.subscribes;
+    }
+    uint32_t timeout = response.timeout;
+    if (timeout == 0 || timeout > TR064_EVENTS_TIMEOUT) timeout = TR064_EVENTS_TIMEOUT;
+    s.renewAt = millis() + timeout * 750UL;
+    TR064_LOG_AT(_tr064, TR064::DEBUG_INFO, "[TR064][subscribe] %s: %s %s for %lu s", s.service,
+                 renewal ? "renewed" : "subscribed", s.sid, (unsigned long) timeout);
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Cancels a subscription at the device (errors are ignored, the
+            subscription times out anyway).
+*/
+/**************************************************************************/
+void TR064Events::sendUnsubscribe(Subscription& s) {
+    const char* url = _tr064._services.eventSubURL(s.service);
+    if (!url || url[0] == '\0') {
+        return;
+    }
+    char headers[TR064_EVENTS_SID + 8];
+    snprintf(headers, sizeof(headers), "SID: %s\r\n", s.sid);
+    TR064HttpClient& http = _tr064.http;
+    http.setHeaders(headers);
+    int code = http.request(_tr064._ip.c_str(), _tr064._port, "UNSUBSCRIBE", url, nullptr, nullptr, 0);
+    http.setHeaders(nullptr);
+    if (code > 0) http.end();
+    TR064_LOG_AT(_tr064, TR064::DEBUG_INFO, "[TR064][unsubscribe] %s: %s (%d)", s.service, s.sid, code);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Starts reading a NOTIFY request from an accepted connection.
+            The request must arrive completely within
+            `TR064_EVENTS_READ_TIMEOUT` ms.
+*/
+/**************************************************************************/
+void TR064Events::beginNotify(TR064Transport& connection) {
+    _in.connection = &connection;
+    _in.state = NOTIFY_REQUEST;
+    _in.deadline = millis() + TR064_EVENTS_READ_TIMEOUT;
+    _in.subscription = nullptr;
+    _in.notify = false;
+    _in.hasSeq = false;
+    _in.seq = 0;
+    _in.remaining = -1;
+    _in.lineLen = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads what arrived of the current NOTIFY request, without
+            waiting. The rest is read by the next call.
+*/
+/**************************************************************************/
+void TR064Events::readNotify() {
+    uint8_t buf[128];
+    while (_in.connection) {
+        int n = _in.connection->read(buf, sizeof(buf), 0);
+        if (n > 0) {
+            consumeNotify((const char*) buf, (size_t) n);
+        } else if (n < 0 && _in.state == NOTIFY_BODY && _in.remaining < 0) {
+            // A body without length ends with the connection
+            finishNotify();
+        } else if (n < 0 || (long) (millis() - _in.deadline) >= 0) {
+            TR064_LOG_AT(_tr064, TR064::DEBUG_WARNING, "[TR064][notify]<Error> Incomplete request (%s)",
+                         n < 0 ? "connection lost" : "timeout");
+            rejectNotify(_in.state == NOTIFY_REQUEST ? 0 : 400);
+        } else {
+            return;
+        }
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Splits the bytes read into the lines of the head and the body.
+*/
+/**************************************************************************/
+void TR064Events::consumeNotify(const char* data, size_t len) {
+    const char* p = data;
+    const char* const end = data + len;
+    while (p < end && _in.connection) {
+        if (_in.state == NOTIFY_BODY) {
+            size_t n = end - p;
+            if (_in.remaining >= 0 && (long) n > _in.remaining) n = (size_t) _in.remaining;
+            _tokenizer.feed(p, n);
+            p += n;
+            if (_in.remaining >= 0 && (_in.remaining -= n) == 0) {
+                finishNotify();
+            }
+            continue;
+        }
+        char c = *p++;
+        if (c == '\n') {
+            _in.line[_in.lineLen] = '\0';
+            _in.lineLen = 0;
+            headLine();
+        } else if (c != '\r' && _in.lineLen < sizeof(_in.line) - 1) {
+            _in.line[_in.lineLen++] = c;
+        }
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Handles a line of the head (in `_in.line`). At its end, the
+            request is checked and its body is read, or it is rejected.
+*/
+/**************************************************************************/
+void TR064Events::headLine() {
+    char* line = _in.line;
+    if (_in.state == NOTIFY_REQUEST) {
+        if (line[0] == '\0') {
+            rejectNotify(0);
+            return;
+        }
+        _in.notify = strncmp(line, "NOTIFY ", 7) == 0;
+        _in.state = NOTIFY_HEADERS;
+        return;
+    }
+    if (line[0] != '\0') {
+        char* value = strchr(line, ':');
+        if (!value) return;
+        *value++ = '\0';
+        while (*value == ' ' || *value == '\t') ++value;
+        if (strcasecmp(line, "SID") == 0) {
+            _in.subscription = findSid(value);
+        } else if (strcasecmp(line, "SEQ") == 0) {
+            _in.seq = strtoul(value, nullptr, 10);
+            _in.hasSeq = true;
+        } else if (strcasecmp(line, "Content-Length") == 0) {
+            _in.remaining = atol(value);
+        }
+        return;
+    }
+    Subscription* s = _in.subscription;
+    if (!_in.notify || !s) {
+        TR064_LOG_AT(_tr064, TR064::DEBUG_WARNING, "[TR064][notify]<Error> Rejected %s request",
+                     !_in.notify ? "a malformed" : "an unknown");
+        rejectNotify(!_in.notify ? 400 : 412);
+        return;
+    }
+    if (_in.hasSeq) {
+        // 0 is the initial event of a (new) subscription
+        if (_in.seq != 0 && _in.seq > s->seq) {
+            _stats.missed += _in.seq - s->seq;
+            TR064_LOG_AT(_tr064, TR064::DEBUG_WARNING, "[TR064][notify] %s: missed %lu events", s->service,
+                         (unsigned long) (_in.seq - s->seq));
+        }
+        s->seq = _in.seq + 1;
+    }
+    _propertySet.begin(*s);
+    _tokenizer.reset();
+    _in.state = NOTIFY_BODY;
+    if (_in.remaining == 0) {
+        finishNotify();
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Answers the current NOTIFY request, whose body was read
+            completely.
+*/
+/**************************************************************************/
+void TR064Events::finishNotify() {
+    _stats.variables += _propertySet.variables;
+    ++_stats.notifications;
+    TR064_LOG_AT(_tr064, TR064::DEBUG_VERBOSE, "[TR064][notify] %s: %lu variables (SEQ %lu)", _in.subscription->service,
+                 (unsigned long) _propertySet.variables, (unsigned long) _in.seq);
+    respond(*_in.connection, 200);
+    _in.connection = nullptr;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Rejects the current NOTIFY request.
+    @param    code
+                The status code of the answer, 0 to close the connection
+                without one.
+*/
+/**************************************************************************/
+void TR064Events::rejectNotify(int code) {
+    if (_in.state == NOTIFY_BODY) {
+        // The variables of the part read were passed on
+        _stats.variables += _propertySet.variables;
+    }
+    ++_stats.rejected;
+    if (code) {
+        respond(*_in.connection, code);
+    } else {
+        _in.connection->stop();
+    }
+    _in.connection = nullptr;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Looks up a subscription by its id.
+    @return The subscription or `nullptr`.
+*/
+/**************************************************************************/
+TR064Events::Subscription* TR064Events::findSid(const char* sid) {
+    for (int i = 0; i < TR064_EVENTS_SUBSCRIPTIONS; ++i) {
+        Subscription& s = _subscriptions[i];
+        if (s.service[0] != '\0' && s.sid[0] != '\0' && strcmp(s.sid, sid) == 0) {
+            return &s;
+        }
+    }
+    return nullptr;
+}
+
+TR064Events::PropertySet::PropertySet()
+    : tokenizer(nullptr), variables(0), _subscription(nullptr), _leaf(false) {
+    _keys.addAny();
+    _name[0] = '\0';
+}
+
+/**************************************************************************/
+/*!
+    @brief  Starts a property set, e.g.
+            `<e:propertyset><e:property><Name>value</Name></e:property>...`,
+            for a subscription.
+*/
+/**************************************************************************/
+void TR064Events::PropertySet::begin(const Subscription& subscription) {
+    _subscription = &subscription;
+    variables = 0;
+    _leaf = false;
+}
+
+void TR064Events::PropertySet::onStart(int key) {
+    (void) key;
+    size_t len = tokenizer->nameLength();
+    memcpy(_name, tokenizer->name(), len);
+    _name[len] = '\0';
+    _value.clear();
+    _leaf = true;
+}
+
+void TR064Events::PropertySet::onText(int key, const char* text, size_t len) {
+    (void) key;
+    _value.append(text, len);
+}
+
+bool TR064Events::PropertySet::onEnd(int key) {
+    (void) key;
+    if (_leaf) {
+        ++variables;
+        if (_subscription->callback) {
+            _subscription->callback(_subscription->service, _name, _value.text, _subscription->context);
+        }
+    }
+    _leaf = false;
+    return true;
+}
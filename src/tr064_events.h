@@ -0,0 +1,180 @@
+/*!
+ * @file tr064_events.h
+ *
+ * UPnP eventing (GENA) for the services of a TR-064 device. Instead of
+ * polling a state with an action, the sketch subscribes to the service
+ * (`TR064Events::subscribe()`): the device then sends the changed state
+ * variables as NOTIFY requests to a small HTTP listener, and `poll()`
+ * passes them to a callback. Subscriptions are renewed before they time
+ * out and are made again if the device forgot them (e.g. after a reboot).
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_events_h
+#define tr064_events_h
+
+#include "Arduino.h"
+#include "tr064_transport.h"
+#include "tr064_http.h"
+#include "tr064_xml.h"
+
+#ifndef TR064_EVENTS_SUBSCRIPTIONS
+#define TR064_EVENTS_SUBSCRIPTIONS  4 ///< Maximal number of simultaneous subscriptions
+#endif
+#ifndef TR064_EVENTS_PORT
+#define TR064_EVENTS_PORT           49100 ///< Default port of the listener for the NOTIFY requests
+#endif
+#ifndef TR064_EVENTS_TIMEOUT
+#define TR064_EVENTS_TIMEOUT        1800 ///< Requested duration of a subscription (s), the device may grant less
+#endif
+#ifndef TR064_EVENTS_RETRY
+#define TR064_EVENTS_RETRY          30000 ///< Delay before a failed renewal is tried again (ms)
+#endif
+#ifndef TR064_EVENTS_READ_TIMEOUT
+#define TR064_EVENTS_READ_TIMEOUT   1000 ///< Longest time for a NOTIFY request to arrive completely (ms), over several `poll()` calls
+#endif
+#ifndef TR064_EVENTS_NAME
+#define TR064_EVENTS_NAME           40 ///< Longest service name (including terminator)
+#endif
+#ifndef TR064_EVENTS_SID
+#define TR064_EVENTS_SID            48 ///< Longest subscription id (`SID`) kept (including terminator)
+#endif
+#ifndef TR064_EVENTS_VALUE
+#define TR064_EVENTS_VALUE          128 ///< Longest value passed to the callback (including terminator), longer ones are truncated
+#endif
+
+#define TR064_EVENTS_PATH           "/tr064/events" ///< Path of the callback URL
+
+// Negative return values of `TR064Events::subscribe()`
+#define TR064_EVENTS_ERROR_NOT_STARTED  -1 ///< `begin()` was not called or failed
+#define TR064_EVENTS_ERROR_NO_EVENTS    -2 ///< The service is unknown or has no `eventSubURL`
+#define TR064_EVENTS_ERROR_FULL         -3 ///< All `TR064_EVENTS_SUBSCRIPTIONS` slots are in use
+#define TR064_EVENTS_ERROR_REJECTED     -4 ///< The device did not accept the subscription
+
+class TR064;
+
+/// Called for each state variable of a NOTIFY, with the service (as passed to `subscribe()`), the variable, its value and the user context.
+typedef void (*TR064EventCallback)(const char* service, const char* variable, const char* value, void* context);
+
+/// Counters of a `TR064Events`, see `TR064Events::stats()`.
+struct TR064EventStats {
+    uint32_t notifications; ///< NOTIFY requests accepted
+    uint32_t variables;     ///< State variables passed to the callbacks
+    uint32_t rejected;      ///< NOTIFY requests refused (unknown subscription, malformed)
+    uint32_t missed;        ///< NOTIFYs lost, according to the gaps in their sequence numbers
+    uint32_t subscribes;    ///< Subscriptions made (including the ones made again)
+    uint32_t renewals;      ///< Subscriptions renewed
+    uint32_t failures;      ///< Failed subscriptions and renewals
+};
+
+/**************************************************************************/
+/*!
+    @brief  Subscriptions to the events of the services of a `TR064`, and
+            the listener receiving them. `poll()` has to be called
+            regularly, e.g. from `loop()`: it handles the NOTIFY requests
+            that arrived and renews the subscriptions in time. It does not
+            wait for a NOTIFY request: one that did not arrive completely is
+            read on by the next calls. The
+            (un)subscriptions and renewals are blocking requests on the
+            connection of the `TR064`, so `poll()` must not be called while
+            a `TR064Async` is `busy()`.
+*/
+/**************************************************************************/
+class TR064Events {
+    public:
+        explicit TR064Events(TR064& tr064);
+        TR064Events& setListener(TR064Listener& listener);
+        bool begin(uint16_t port = TR064_EVENTS_PORT);
+        void end();
+        int subscribe(const char* service, TR064EventCallback callback, void* context = nullptr);
+        bool unsubscribe(int handle);
+        bool subscribed(int handle) const;
+        void poll();
+        const char* callbackURL() const { return _callback; }
+        const TR064EventStats& stats() const { return _stats; }
+
+        static const char* errorToString(int error);
+
+    private:
+        struct Subscription {
+            char service[TR064_EVENTS_NAME]; // Empty if the slot is free
+            char sid[TR064_EVENTS_SID];      // Empty while not subscribed
+            TR064EventCallback callback;
+            void* context;
+            uint32_t seq;                    // Next expected sequence number
+            unsigned long renewAt;           // `millis()` at which to renew (or retry)
+        };
+
+        /// Takes the `SID` and `TIMEOUT` of the response to a SUBSCRIBE.
+        class ResponseHeaders : public TR064HttpHeaderHandler {
+            public:
+                ResponseHeaders() : timeout(0) { sid[0] = '\0'; }
+                void onHeader(const char* name, const char* value) override;
+
+                char sid[TR064_EVENTS_SID];
+                uint32_t timeout;
+        };
+
+        /// Passes the state variables of a property set (every element without child elements) to the callback.
+        class PropertySet : public TR064XmlHandler {
+            public:
+                PropertySet();
+                void begin(const Subscription& subscription);
+                const TR064XmlKeys& keys() const { return _keys; }
+
+                void onStart(int key) override;
+                void onText(int key, const char* text, size_t len) override;
+                bool onEnd(int key) override;
+
+                const TR064XmlTokenizer* tokenizer; // The tokenizer fed with the property set, for the element names
+                uint32_t variables;             // Variables passed to the callback
+
+            private:
+                TR064XmlKeys _keys;
+                const Subscription* _subscription;
+                bool _leaf;                     // No child element since the last start tag
+                char _name[TR064_XML_MAX_NAME + 1];
+                TR064XmlText<TR064_EVENTS_VALUE> _value;
+        };
+
+        enum NotifyState { NOTIFY_REQUEST, NOTIFY_HEADERS, NOTIFY_BODY };
+
+        /// The NOTIFY request being read, kept across `poll()` calls.
+        struct Incoming {
+            TR064Transport* connection;         // `nullptr` if none
+            NotifyState state;
+            unsigned long deadline;             // `millis()` by which the request must be complete
+            Subscription* subscription;         // Of the `SID` header
+            bool notify;                        // The request line is a NOTIFY
+            bool hasSeq;
+            uint32_t seq;
+            long remaining;                     // Bytes left in the body, -1 if it ends with the connection
+            uint16_t lineLen;
+            char line[TR064_HTTP_LINE_BUFFER];  // Line of the head being read
+        };
+
+        bool sendSubscribe(Subscription& s);
+        void sendUnsubscribe(Subscription& s);
+        void beginNotify(TR064Transport& connection);
+        void readNotify();
+        void consumeNotify(const char* data, size_t len);
+        void headLine();
+        void finishNotify();
+        void rejectNotify(int code);
+        Subscription* findSid(const char* sid);
+
+        TR064& _tr064;
+        TR064DefaultListener _defaultListener;
+        TR064Listener* _listener;
+        bool _started;
+        char _callback[64];         // `CALLBACK` header value, e.g. `<http://192.168.178.20:49100/tr064/events>`
+        Subscription _subscriptions[TR064_EVENTS_SUBSCRIPTIONS];
+        TR064EventStats _stats;
+        Incoming _in;
+        PropertySet _propertySet;
+        TR064XmlTokenizer _tokenizer;
+};
+
+#endif
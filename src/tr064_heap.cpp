@@ -0,0 +1,161 @@
+/*!
+ * @file tr064_heap.cpp
+ *
+ * Optional heap instrumentation of `TR064::action()`.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_heap.h"
+
+#if defined(TR064_HEAP_STATS)
+
+#if defined(ESP8266)
+
+void TR064SystemHeapProbe::sample(TR064HeapSample& s) {
+    s.allocs = 0;
+    s.bytes = 0;
+    s.freeHeap = ESP.getFreeHeap();
+    s.minFreeHeap = s.freeHeap;
+    s.maxBlock = ESP.getMaxFreeBlockSize();
+}
+
+#elif defined(ESP32)
+
+void TR064SystemHeapProbe::sample(TR064HeapSample& s) {
+    s.allocs = 0;
+    s.bytes = 0;
+    s.freeHeap = ESP.getFreeHeap();
+    s.minFreeHeap = s.freeHeap;
+    s.maxBlock = ESP.getMaxAllocHeap();
+}
+
+#elif defined(TR064_NATIVE)
+
+void TR064SystemHeapProbe::sample(TR064HeapSample& s) {
+    NativeHeapCounters& heap = nativeHeap();
+    s.allocs = (uint32_t) heap.allocs;
+    s.bytes = (uint32_t) heap.bytes;
+    s.freeHeap = (uint32_t) (TR064_HEAP_NATIVE_SIZE - heap.current);
+    s.minFreeHeap = (uint32_t) (TR064_HEAP_NATIVE_SIZE - heap.peak);
+    s.maxBlock = 0;
+    heap.peak = heap.current;
+}
+
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Name of a phase, e.g. "envelope" for `TR064_HEAP_ENVELOPE`.
+*/
+/**************************************************************************/
+const char* TR064HeapStats::phaseName(uint8_t phase) {
+    switch (phase) {
+        case TR064_HEAP_ENVELOPE: return "envelope";
+        case TR064_HEAP_SEND: return "send";
+        case TR064_HEAP_PARSE: return "parse";
+        case TR064_HEAP_AUTH: return "auth";
+    }
+    return "?";
+}
+
+/// Prints one line of `TR064HeapStats::print()`.
+static void printPhase(Print& out, const char* name, const TR064HeapPhase& p) {
+    out.printf("%-9s %2u x %5lu allocs %7lu B, retained %6ld B, peak %6ld B", name, (unsigned) p.entries,
+               (unsigned long) p.allocs, (unsigned long) p.bytes, (long) p.retained, (long) p.peak);
+    if (p.maxBlockBefore || p.maxBlockAfter) {
+        out.printf(", max block %lu -> %lu", (unsigned long) p.maxBlockBefore, (unsigned long) p.maxBlockAfter);
+    }
+    out.println();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Prints the phases of the last action (those that were entered)
+            and the whole action, one per line.
+    @param    out
+                Where to print to, e.g. `Serial`.
+*/
+/**************************************************************************/
+void TR064HeapStats::print(Print& out) const {
+    for (uint8_t i = 0; i < TR064_HEAP_PHASES; ++i) {
+        if (phases[i].entries > 0) {
+            printPhase(out, phaseName(i), phases[i]);
+        }
+    }
+    printPhase(out, "action", action);
+}
+
+TR064HeapMeter::TR064HeapMeter() : _probe(&_system), _phase(-1) {
+    memset(&_stats, 0, sizeof(_stats));
+    memset(&_start, 0, sizeof(_start));
+    memset(&_last, 0, sizeof(_last));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Starts measuring an action, in its envelope phase. Clears the
+            statistics of the previous action.
+*/
+/**************************************************************************/
+void TR064HeapMeter::begin() {
+    uint32_t actions = _stats.actions;
+    memset(&_stats, 0, sizeof(_stats));
+    _stats.actions = actions + 1;
+    _probe->sample(_start);
+    _last = _start;
+    open(_stats.action, _start);
+    _phase = TR064_HEAP_ENVELOPE;
+    open(_stats.phases[_phase], _start);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Ends the current phase of the action and enters another one
+            (nothing happens if it is the current one).
+*/
+/**************************************************************************/
+void TR064HeapMeter::phase(uint8_t phase) {
+    if (_phase < 0 || _phase == phase || phase >= TR064_HEAP_PHASES) return;
+    TR064HeapSample now;
+    _probe->sample(now);
+    close(_stats.phases[_phase], _last, now);
+    _last = now;
+    _phase = phase;
+    open(_stats.phases[_phase], now);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Ends the current phase and the action.
+*/
+/**************************************************************************/
+void TR064HeapMeter::end() {
+    if (_phase < 0) return;
+    TR064HeapSample now;
+    _probe->sample(now);
+    close(_stats.phases[_phase], _last, now);
+    close(_stats.action, _start, now);
+    _phase = -1;
+}
+
+void TR064HeapMeter::open(TR064HeapPhase& p, const TR064HeapSample& now) {
+    if (p.entries++ == 0) {
+        p.maxBlockBefore = now.maxBlock;
+    }
+}
+
+void TR064HeapMeter::close(TR064HeapPhase& p, const TR064HeapSample& from, const TR064HeapSample& now) {
+    p.allocs += now.allocs - from.allocs;
+    p.bytes += now.bytes - from.bytes;
+    p.retained += (int32_t) (from.freeHeap - now.freeHeap);
+    int32_t peak = (int32_t) (from.freeHeap - now.minFreeHeap);
+    if (peak > p.peak) p.peak = peak;
+    // The low-water mark of this phase also counts for the whole action
+    peak = (int32_t) (_start.freeHeap - now.minFreeHeap);
+    if (peak > _stats.action.peak) _stats.action.peak = peak;
+    p.maxBlockAfter = now.maxBlock;
+}
+
+#endif
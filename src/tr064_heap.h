@@ -0,0 +1,147 @@
+/*!
+ * @file tr064_heap.h
+ *
+ * Optional heap instrumentation of `TR064::action()`, compiled in with
+ * `-DTR064_HEAP_STATS` (e.g. `build_flags` in PlatformIO). For the last
+ * action it records, per phase (building the envelope, sending the request,
+ * parsing the response, extra round trips for the authentication), the
+ * allocations, the allocated bytes, the heap kept and the peak heap use,
+ * and the largest free block before and after. That attributes
+ * fragmentation to the actions causing it and shows whether paths that
+ * should not allocate (e.g. descriptor actions) stay that way.
+ * Without the flag, `TR064HeapMeter` is empty and costs nothing.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_heap_h
+#define tr064_heap_h
+
+#include "Arduino.h"
+
+// Phases of an action
+#define TR064_HEAP_ENVELOPE     0 ///< Binding the arguments, signing the envelope
+#define TR064_HEAP_SEND         1 ///< Connecting, writing the request, reading the response head
+#define TR064_HEAP_PARSE        2 ///< Reading the response body into the outputs
+#define TR064_HEAP_AUTH         3 ///< Requesting a nonce and repeating a rejected request
+#define TR064_HEAP_PHASES       4
+
+#ifndef TR064_HEAP_NATIVE_SIZE
+#define TR064_HEAP_NATIVE_SIZE  0x40000000ul ///< Heap size the native build pretends, to report a free heap
+#endif
+
+#if defined(TR064_HEAP_STATS)
+
+/**************************************************************************/
+/*!
+    @brief  State of the heap at one point in time. Values a probe cannot
+            measure are 0.
+*/
+/**************************************************************************/
+struct TR064HeapSample {
+    uint32_t allocs;        ///< Allocations so far
+    uint32_t bytes;         ///< Bytes allocated so far
+    uint32_t freeHeap;      ///< Free heap
+    uint32_t minFreeHeap;   ///< Lowest free heap since the previous sample
+    uint32_t maxBlock;      ///< Largest free block
+};
+
+/**************************************************************************/
+/*!
+    @brief  Measures the heap. The defaults (`TR064SystemHeapProbe`) cannot
+            count allocations on the ESP8266/ESP32 and only see the free
+            heap at the phase boundaries; a sketch that wraps `malloc()`
+            (`-Wl,--wrap=malloc`) or enables the statistics of its heap can
+            provide a more detailed probe, see `TR064::setHeapProbe()`.
+*/
+/**************************************************************************/
+class TR064HeapProbe {
+    public:
+        virtual ~TR064HeapProbe() {}
+        /*!  @brief Takes a sample and restarts the low-water mark of the free heap. */
+        virtual void sample(TR064HeapSample& s) = 0;
+};
+
+/**************************************************************************/
+/*!
+    @brief  Default probe: `ESP.getFreeHeap()` and the largest free block
+            on the ESP8266/ESP32; the interposed allocator of the native
+            core (`nativeHeap()`) in the native build, which counts all
+            allocations but has no largest block.
+*/
+/**************************************************************************/
+class TR064SystemHeapProbe : public TR064HeapProbe {
+    public:
+        void sample(TR064HeapSample& s) override;
+};
+
+/**************************************************************************/
+/*!
+    @brief  Heap use of one phase of an action (or of the whole action).
+*/
+/**************************************************************************/
+struct TR064HeapPhase {
+    uint16_t entries;       ///< How often the phase was entered (0: not at all)
+    uint32_t allocs;        ///< Allocations
+    uint32_t bytes;         ///< Bytes allocated
+    int32_t retained;       ///< Free heap before minus after (positive: the phase kept memory)
+    int32_t peak;           ///< Largest drop of the free heap below its level when the phase was entered
+    uint32_t maxBlockBefore; ///< Largest free block when the phase was first entered
+    uint32_t maxBlockAfter; ///< Largest free block when the phase was last left
+};
+
+/**************************************************************************/
+/*!
+    @brief  Heap use of the last action, see `TR064::heapStats()`.
+*/
+/**************************************************************************/
+struct TR064HeapStats {
+    TR064HeapPhase phases[TR064_HEAP_PHASES]; ///< Indexed by `TR064_HEAP_ENVELOPE` etc.
+    TR064HeapPhase action;  ///< The whole action
+    uint32_t actions;       ///< Actions measured since the start
+
+    void print(Print& out) const;
+    static const char* phaseName(uint8_t phase);
+};
+
+/**************************************************************************/
+/*!
+    @brief  Splits an action into phases and samples the heap at their
+            boundaries.
+*/
+/**************************************************************************/
+class TR064HeapMeter {
+    public:
+        TR064HeapMeter();
+        void setProbe(TR064HeapProbe* probe) { _probe = probe ? probe : &_system; }
+        const TR064HeapStats& stats() const { return _stats; }
+        void begin();
+        void phase(uint8_t phase);
+        void end();
+
+    private:
+        void open(TR064HeapPhase& p, const TR064HeapSample& now);
+        void close(TR064HeapPhase& p, const TR064HeapSample& from, const TR064HeapSample& now);
+
+        TR064SystemHeapProbe _system;
+        TR064HeapProbe* _probe;
+        TR064HeapStats _stats;
+        TR064HeapSample _start;     // When the action began
+        TR064HeapSample _last;      // When the current phase began
+        int8_t _phase;              // Current phase, -1 outside of an action
+};
+
+#else
+
+/// Heap instrumentation disabled (`TR064_HEAP_STATS` not defined).
+class TR064HeapMeter {
+    public:
+        void begin() {}
+        void phase(uint8_t) {}
+        void end() {}
+};
+
+#endif
+
+#endif
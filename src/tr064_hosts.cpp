@@ -0,0 +1,422 @@
+/*!
+ * @file tr064_hosts.cpp
+ *
+ * Snapshot of the hosts known to the device.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_hosts.h"
+#include "tr064_xml.h"
+
+/**************************************************************************/
+/*!
+    @brief  Adds each `<Item>` of a host list (`MACAddress`, `IPAddress`,
+            `Active`, `HostName`) to a `TR064HostTable`.
+*/
+/**************************************************************************/
+class TR064HostListHandler : public TR064XmlHandler {
+    public:
+        explicit TR064HostListHandler(TR064HostTable& table) : _table(table), _failed(false) {
+            _itemKey = _keys.add("Item");
+            _macKey = _keys.add("MACAddress");
+            _ipKey = _keys.add("IPAddress");
+            _activeKey = _keys.add("Active");
+            _nameKey = _keys.add("HostName");
+        }
+
+        const TR064XmlKeys& keys() const { return _keys; }
+        bool failed() const { return _failed; }
+
+        void onStart(int key) override {
+            if (key == _itemKey) {
+                _mac.clear();
+                _ip.clear();
+                _active.clear();
+                _name.clear();
+            } else if (key == _macKey) {
+                _mac.clear();
+            } else if (key == _ipKey) {
+                _ip.clear();
+            } else if (key == _activeKey) {
+                _active.clear();
+            } else if (key == _nameKey) {
+                _name.clear();
+            }
+        }
+
+        void onText(int key, const char* text, size_t len) override {
+            if (key == _macKey) {
+                _mac.append(text, len);
+            } else if (key == _ipKey) {
+                _ip.append(text, len);
+            } else if (key == _activeKey) {
+                _active.append(text, len);
+            } else if (key == _nameKey) {
+                _name.append(text, len);
+            }
+        }
+
+        bool onEnd(int key) override {
+            if (key != _itemKey) {
+                return true;
+            }
+            uint8_t mac[6];
+            uint8_t ip[4] = {0, 0, 0, 0};
+            if (!TR064HostTable::parseMac(_mac.text, mac)) {
+                // Hosts without MAC address (e.g. VPN clients) can not be looked up
+                return true;
+            }
+            TR064HostTable::parseIPv4(_ip.text, ip);
+            if (!_table.add(mac, ip, atoi(_active.text) != 0, _name.text)) {
+                _failed = true;
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        TR064HostTable& _table;
+        bool _failed;
+        TR064XmlKeys _keys;
+        int _itemKey, _macKey, _ipKey, _activeKey, _nameKey;
+        TR064XmlText<18> _mac;
+        TR064XmlText<16> _ip;
+        TR064XmlText<4> _active;
+        TR064XmlText<64> _name;
+};
+
+TR064HostTable::TR064HostTable() {
+    _arena = nullptr;
+    _arenaLen = 0;
+    _arenaCap = 0;
+    _entries = nullptr;
+    _count = 0;
+    _capacity = 0;
+    _sorted = true;
+}
+
+TR064HostTable::~TR064HostTable() {
+    clear();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Removes all hosts and releases the memory.
+*/
+/**************************************************************************/
+void TR064HostTable::clear() {
+    free(_arena);
+    free(_entries);
+    _arena = nullptr;
+    _arenaLen = 0;
+    _arenaCap = 0;
+    _entries = nullptr;
+    _count = 0;
+    _capacity = 0;
+    _sorted = true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Adds a host. Call `finish()` after the last host was added.
+    @param    mac
+                The MAC address.
+    @param    ip
+                The IPv4 address.
+    @param    active
+                Whether the host is connected.
+    @param    name
+                The host name.
+    @return false if the host could not be stored (out of memory).
+*/
+/**************************************************************************/
+bool TR064HostTable::add(const uint8_t mac[6], const uint8_t ip[4], bool active, const char* name) {
+    if (_count == 0xFFFF) return false;
+    if (_count == _capacity) {
+        uint16_t capacity = _capacity ? (_capacity < 0x8000 ? 2 * _capacity : 0xFFFF) : 16;
+        Entry* entries = (Entry*) realloc(_entries, capacity * sizeof(Entry));
+        if (!entries) return false;
+        _entries = entries;
+        _capacity = capacity;
+    }
+    int nameOffset = intern(name ? name : "");
+    if (nameOffset < 0) return false;
+    Entry& e = _entries[_count++];
+    memcpy(e.mac, mac, 6);
+    memcpy(e.ip, ip, 4);
+    e.active = active ? 1 : 0;
+    e.name = (uint16_t) nameOffset;
+    _sorted = _sorted && (_count == 1 || memcmp(_entries[_count - 2].mac, mac, 6) <= 0);
+    return true;
+}
+
+template<typename T>
+static void swapValues(T& a, T& b) {
+    T tmp = a;
+    a = b;
+    b = tmp;
+}
+
+static const uint8_t noIp[4] = {0, 0, 0, 0};
+
+static int compareEntries(const void* a, const void* b) {
+    // The MAC address is the first member of an entry
+    return memcmp(a, b, 6);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sorts the hosts by their MAC address, merges hosts listed more
+            than once and shrinks the storage to the number of hosts.
+            A device can list a MAC address twice (e.g. an inactive LAN and
+            an active WLAN entry); the merged host is active if any of them
+            is, and takes the address and name of the active one.
+*/
+/**************************************************************************/
+void TR064HostTable::finish() {
+    if (!_sorted) {
+        qsort(_entries, _count, sizeof(Entry), compareEntries);
+        _sorted = true;
+    }
+    uint16_t n = 0;
+    for (uint16_t i = 0; i < _count; ++i) {
+        const Entry& e = _entries[i];
+        if (n == 0 || memcmp(_entries[n - 1].mac, e.mac, 6) != 0) {
+            _entries[n++] = e;
+            continue;
+        }
+        Entry& kept = _entries[n - 1];
+        bool takeOver = e.active && !kept.active;
+        if (memcmp(e.ip, noIp, 4) != 0 && (takeOver || memcmp(kept.ip, noIp, 4) == 0)) {
+            memcpy(kept.ip, e.ip, 4);
+        }
+        if (_arena[e.name] != '\0' && (takeOver || _arena[kept.name] == '\0')) {
+            kept.name = e.name;
+        }
+        kept.active |= e.active;
+    }
+    _count = n;
+    if (_arenaLen > 0 && _arenaLen < _arenaCap) {
+        char* arena = (char*) realloc(_arena, _arenaLen);
+        if (arena) {
+            _arena = arena;
+            _arenaCap = _arenaLen;
+        }
+    }
+    if (_count > 0 && _count < _capacity) {
+        Entry* entries = (Entry*) realloc(_entries, _count * sizeof(Entry));
+        if (entries) {
+            _entries = entries;
+            _capacity = _count;
+        }
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Replaces the content of the table by a host list (the file of
+            `X_AVM-DE_GetHostListPath`), read in chunks from `source`.
+    @return `TR064_XML_END` on success, `TR064_XML_STOPPED` if memory ran
+            out or the negative error of the source.
+*/
+/**************************************************************************/
+int TR064HostTable::parse(TR064ByteSource& source) {
+    clear();
+    TR064HostListHandler handler(*this);
+    TR064XmlTokenizer tokenizer(handler.keys(), handler);
+    int result = tokenizer.scan(source);
+    finish();
+    return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Exchanges the content of two tables, e.g. to replace a snapshot
+            only after the new one was read completely.
+*/
+/**************************************************************************/
+void TR064HostTable::swap(TR064HostTable& other) {
+    swapValues(_arena, other._arena);
+    swapValues(_arenaLen, other._arenaLen);
+    swapValues(_arenaCap, other._arenaCap);
+    swapValues(_entries, other._entries);
+    swapValues(_count, other._count);
+    swapValues(_capacity, other._capacity);
+    swapValues(_sorted, other._sorted);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Looks up a host by its MAC address.
+    @param    mac
+                The MAC address.
+    @param    host
+                Receives the host.
+    @return false if the host is unknown.
+*/
+/**************************************************************************/
+bool TR064HostTable::find(const uint8_t mac[6], TR064Host& host) const {
+    int i = indexOf(mac);
+    if (i < 0) return false;
+    host = (*this)[(uint16_t) i];
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Looks up a host by its MAC address in text form (`AA:BB:CC:DD:EE:FF`).
+    @return false if the host is unknown.
+*/
+/**************************************************************************/
+bool TR064HostTable::find(const char* mac, TR064Host& host) const {
+    uint8_t m[6];
+    return parseMac(mac, m) && find(m, host);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Whether a host is known and connected.
+*/
+/**************************************************************************/
+bool TR064HostTable::isActive(const uint8_t mac[6]) const {
+    int i = indexOf(mac);
+    return i >= 0 && _entries[i].active;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Whether a host (MAC address in text form, `AA:BB:CC:DD:EE:FF`)
+            is known and connected.
+*/
+/**************************************************************************/
+bool TR064HostTable::isActive(const char* mac) const {
+    uint8_t m[6];
+    return parseMac(mac, m) && isActive(m);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the number of connected hosts.
+*/
+/**************************************************************************/
+uint16_t TR064HostTable::activeCount() const {
+    uint16_t n = 0;
+    for (uint16_t i = 0; i < _count; ++i) {
+        n += _entries[i].active;
+    }
+    return n;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the host with the given index (0 to `size()`-1), in
+            the order of their MAC addresses.
+*/
+/**************************************************************************/
+TR064Host TR064HostTable::operator[](uint16_t index) const {
+    const Entry& e = _entries[index];
+    TR064Host h;
+    memcpy(h.mac, e.mac, 6);
+    memcpy(h.ip, e.ip, 4);
+    h.active = e.active != 0;
+    h.name = _arena + e.name;
+    return h;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the number of heap bytes used by the table.
+*/
+/**************************************************************************/
+size_t TR064HostTable::memoryUsage() const {
+    return _arenaCap + _capacity * sizeof(Entry);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Parses a MAC address (`AA:BB:CC:DD:EE:FF`, `-` is accepted as
+            separator as well).
+    @return success state.
+*/
+/**************************************************************************/
+bool TR064HostTable::parseMac(const char* text, uint8_t mac[6]) {
+    for (int i = 0; i < 6; ++i) {
+        uint8_t b = 0;
+        for (int j = 0; j < 2; ++j) {
+            char c = *text++;
+            uint8_t v;
+            if (c >= '0' && c <= '9') v = c - '0';
+            else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+            else return false;
+            b = (uint8_t) (b << 4 | v);
+        }
+        mac[i] = b;
+        char sep = *text++;
+        if (i < 5 ? sep != ':' && sep != '-' : sep != '\0') return false;
+    }
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Parses an IPv4 address in dotted notation.
+    @return success state.
+*/
+/**************************************************************************/
+bool TR064HostTable::parseIPv4(const char* text, uint8_t ip[4]) {
+    for (int i = 0; i < 4; ++i) {
+        if (*text < '0' || *text > '9') return false;
+        unsigned v = 0;
+        while (*text >= '0' && *text <= '9') {
+            v = v * 10 + (unsigned) (*text++ - '0');
+            if (v > 255) return false;
+        }
+        ip[i] = (uint8_t) v;
+        if (*text++ != (i < 3 ? '.' : '\0')) return false;
+    }
+    return true;
+}
+
+// ----------------------------
+// ----- Helper-functions -----
+// ----------------------------
+
+/// Binary search for a MAC address. @return The index or -1.
+int TR064HostTable::indexOf(const uint8_t mac[6]) const {
+    int lo = 0, hi = (int) _count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int c = memcmp(_entries[mid].mac, mac, 6);
+        if (c == 0) return mid;
+        if (c < 0) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Copies a string into the arena.
+    @return Its offset or -1 if out of memory.
+*/
+/**************************************************************************/
+int TR064HostTable::intern(const char* s) {
+    size_t len = strlen(s) + 1;
+    if ((size_t) _arenaLen + len > 0xFFFF) return -1;
+    if (_arenaLen + len > _arenaCap) {
+        size_t cap = _arenaCap ? 2 * (size_t) _arenaCap : 256;
+        while (cap < _arenaLen + len) cap *= 2;
+        if (cap > 0xFFFF) cap = 0xFFFF;
+        char* arena = (char*) realloc(_arena, cap);
+        if (!arena) return -1;
+        _arena = arena;
+        _arenaCap = (uint16_t) cap;
+    }
+    memcpy(_arena + _arenaLen, s, len);
+    int offset = _arenaLen;
+    _arenaLen += (uint16_t) len;
+    return offset;
+}
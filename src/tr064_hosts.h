@@ -0,0 +1,82 @@
+/*!
+ * @file tr064_hosts.h
+ *
+ * Snapshot of the hosts known to the device. FRITZ!Box devices offer the
+ * whole host list as one XML file (`Hosts:1` `X_AVM-DE_GetHostListPath`);
+ * it is fetched with a single GET (see `TR064::fetchHosts()`), streamed
+ * through the tokenizer and kept as a compact table sorted by MAC address,
+ * so that presence checks are answered locally.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_hosts_h
+#define tr064_hosts_h
+
+#include "Arduino.h"
+#include "tr064_transport.h"
+
+/// One host of a `TR064HostTable`.
+struct TR064Host {
+    uint8_t mac[6];     ///< MAC address
+    uint8_t ip[4];      ///< IPv4 address, all 0 if it has none
+    bool active;        ///< Whether the host is connected
+    const char* name;   ///< Host name (empty if unknown)
+};
+
+/**************************************************************************/
+/*!
+    @brief  Compact table of hosts, keyed by their (binary) MAC address.
+            The host names are interned in a single arena; lookups are a
+            binary search. Memory is sized to the number of hosts found.
+*/
+/**************************************************************************/
+class TR064HostTable {
+    public:
+        TR064HostTable();
+        ~TR064HostTable();
+
+        void clear();
+        bool add(const uint8_t mac[6], const uint8_t ip[4], bool active, const char* name);
+        void finish();
+        int parse(TR064ByteSource& source);
+        void swap(TR064HostTable& other);
+
+        bool find(const uint8_t mac[6], TR064Host& host) const;
+        bool find(const char* mac, TR064Host& host) const;
+        bool isActive(const uint8_t mac[6]) const;
+        bool isActive(const char* mac) const;
+
+        uint16_t size() const { return _count; }
+        uint16_t activeCount() const;
+        TR064Host operator[](uint16_t index) const;
+        size_t memoryUsage() const;
+
+        static bool parseMac(const char* text, uint8_t mac[6]);
+        static bool parseIPv4(const char* text, uint8_t ip[4]);
+
+    private:
+        TR064HostTable(const TR064HostTable&);
+        TR064HostTable& operator=(const TR064HostTable&);
+
+        struct Entry {
+            uint8_t mac[6];
+            uint8_t ip[4];
+            uint8_t active;
+            uint16_t name;       // Offset of the host name in the arena
+        };
+
+        int indexOf(const uint8_t mac[6]) const;
+        int intern(const char* s);
+
+        char* _arena;
+        uint16_t _arenaLen;
+        uint16_t _arenaCap;
+        Entry* _entries;
+        uint16_t _count;
+        uint16_t _capacity;
+        bool _sorted;
+};
+
+#endif
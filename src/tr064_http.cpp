@@ -0,0 +1,657 @@
+/*!
+ * @file tr064_http.cpp
+ *
+ * Minimal HTTP/1.1 client of the TR-064 library.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_http.h"
+
+/// A request body that is already in memory.
+class TR064MemoryBody : public TR064RequestBody {
+    public:
+        TR064MemoryBody(const char* data, size_t len) : _data(data), _len(len) {}
+        size_t length() const override { return _len; }
+        bool writeTo(TR064ByteSink& sink) const override { return sink.write(_data, _len); }
+
+    private:
+        const char* _data;
+        size_t _len;
+};
+
+/**************************************************************************/
+/*!
+    @brief  Creates a client without transport, see `setTransport()`.
+*/
+/**************************************************************************/
+TR064HttpClient::TR064HttpClient() {
+    _transport = nullptr;
+    _timeout = TR064_HTTP_TIMEOUT;
+    _keepAlive = true;
+    _reusable = false;
+    _received = false;
+    _lost = false;
+    _serverClose = false;
+    _host[0] = '\0';
+    _port = 0;
+    resetStats();
+    memset(&_timing, 0, sizeof(_timing));
+    _mark = 0;
+    _headers = nullptr;
+    _headerHandler = nullptr;
+    _head = false;
+    _chunked = false;
+    _bodyDone = true;
+    _chunkState = CHUNK_SIZE;
+    _headState = HEAD_DONE;
+    _status = 0;
+    _lineLen = 0;
+    _nonBlocking = false;
+    _connecting = false;
+    _reused = false;
+    _contentLength = -1;
+    _remaining = -1;
+    _rxPos = 0;
+    _rxLen = 0;
+    _txLen = 0;
+    _line[0] = '\0';
+    _validator[0] = '\0';
+    _etag = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sets the transport used for all following requests. An open
+            connection of the previous transport is closed.
+    @param    transport
+                The transport, it must outlive this client.
+*/
+/**************************************************************************/
+void TR064HttpClient::setTransport(TR064Transport* transport) {
+    if (_transport && _transport != transport) {
+        close();
+    }
+    _transport = transport;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Enables or disables persistent connections (default: enabled).
+            Disabling closes a kept-alive connection.
+*/
+/**************************************************************************/
+void TR064HttpClient::setKeepAlive(bool keepAlive) {
+    _keepAlive = keepAlive;
+    if (!keepAlive && _reusable) {
+        close();
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sets all counters of `stats()` to 0.
+*/
+/**************************************************************************/
+void TR064HttpClient::resetStats() {
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sends a request and reads the status line and headers of the
+            response. The body can then be read with `read()`.
+    @param    host
+                Host name or IP of the device.
+    @param    port
+                Port of the device.
+    @param    method
+                HTTP method, e.g. `GET` or `POST`.
+    @param    url
+                The (relative) URL to request.
+    @param    soapaction
+                Value of the SOAPACTION header, if not empty the body is sent as `text/xml`.
+    @param    body
+                The request body (may be `nullptr` if `bodyLen` is 0).
+    @param    bodyLen
+                Length of the request body.
+    @return The HTTP status code or a negative `TR064_HTTP_ERROR_*` code.
+*/
+/**************************************************************************/
+int TR064HttpClient::request(const char* host, uint16_t port, const char* method, const char* url,
+                             const char* soapaction, const char* body, size_t bodyLen) {
+    TR064MemoryBody memoryBody(body, bodyLen);
+    return request(host, port, method, url, soapaction, bodyLen > 0 ? &memoryBody : nullptr);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sends a request whose body is streamed into the send buffer and
+            reads the status line and headers of the response.
+    @param    host
+                Host name or IP of the device.
+    @param    port
+                Port of the device.
+    @param    method
+                HTTP method, e.g. `GET` or `POST`.
+    @param    url
+                The (relative) URL to request.
+    @param    soapaction
+                Value of the SOAPACTION header, if not empty the body is sent as `text/xml`.
+    @param    body
+                The request body or `nullptr`.
+    @return The HTTP status code or a negative `TR064_HTTP_ERROR_*` code.
+*/
+/**************************************************************************/
+int TR064HttpClient::request(const char* host, uint16_t port, const char* method, const char* url,
+                             const char* soapaction, const TR064RequestBody* body) {
+    bool nonBlocking = _nonBlocking;
+    _nonBlocking = false;
+    int code = connect(host, port);
+    if (code > 0) {
+        code = sendRequest(method, url, soapaction, body);
+        if (code == 0) code = readHead();
+        if (code < 0 && retryable()) {
+            // The device closed the kept-alive connection before it answered, try once more on a new one
+            reopen();
+            code = connect(host, port);
+            if (code > 0) {
+                code = sendRequest(method, url, soapaction, body);
+                if (code == 0) code = readHead();
+            }
+        }
+    }
+    if (code < 0) {
+        close();
+    }
+    _nonBlocking = nonBlocking;
+    return code;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Opens the connection for the next request, or reuses the
+            kept-alive one. Without non-blocking mode, this waits until the
+            connection is established.
+    @param    host
+                Host name or IP of the device.
+    @param    port
+                Port of the device.
+    @return 1 if connected, 0 if the connection is still being
+            established (see `pollConnect()`) or a negative error code.
+*/
+/**************************************************************************/
+int TR064HttpClient::connect(const char* host, uint16_t port) {
+    if (!_transport) {
+        return TR064_HTTP_ERROR_NO_TRANSPORT;
+    }
+    _reused = false;
+    _status = 0;
+    memset(&_timing, 0, sizeof(_timing));
+    _mark = micros();
+    if (_reusable && _port == port && strcmp(_host, host) == 0) {
+        if (_transport->connected()) {
+            _reused = true;
+            ++_stats.reuses;
+            return 1;
+        }
+        // Closed by the device while idle
+        ++_stats.reconnects;
+    }
+
+    close();
+    bool started = _nonBlocking ? _transport->beginConnect(host, port) : _transport->connect(host, port);
+    if (!started) {
+        return TR064_HTTP_ERROR_CONNECTION_FAILED;
+    }
+    ++_stats.connects;
+    size_t hostLen = strlen(host);
+    if (hostLen < sizeof(_host)) {
+        memcpy(_host, host, hostLen + 1);
+    } else {
+        _host[0] = '\0'; // Too long to be remembered, the connection is not reused
+    }
+    _port = port;
+    _connecting = _nonBlocking;
+    if (!_nonBlocking) {
+        _timing.connect = micros() - _mark;
+        return 1;
+    }
+    return pollConnect();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Checks whether the connection started by `connect()` is
+            established, without waiting.
+    @return 1 if connected, 0 if still pending or a negative error code.
+*/
+/**************************************************************************/
+int TR064HttpClient::pollConnect() {
+    if (!_connecting) {
+        return _transport && _transport->connected() ? 1 : TR064_HTTP_ERROR_CONNECTION_FAILED;
+    }
+    int rc = _transport->pollConnect();
+    if (rc == 0) {
+        return 0;
+    }
+    _connecting = false;
+    if (rc < 0) {
+        close();
+        return TR064_HTTP_ERROR_CONNECTION_FAILED;
+    }
+    _timing.connect = micros() - _mark;
+    return 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Whether the current request failed on a reused connection
+            because the connection could not be written or was closed before
+            any response arrived, i.e. it can safely be repeated on a new
+            one. A request that ran into the read timeout is not: the device
+            may have carried it out already.
+*/
+/**************************************************************************/
+bool TR064HttpClient::retryable() const {
+    return _reused && !_received && _lost;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Closes the failed, reused connection, see `retryable()`. The next
+            `connect()` opens a new one.
+*/
+/**************************************************************************/
+void TR064HttpClient::reopen() {
+    ++_stats.reconnects;
+    _reused = false;
+    close();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads the next bytes of the response body. Returns as soon as
+            some data is available.
+    @param    buf
+                Buffer to read into.
+    @param    len
+                Size of the buffer.
+    @return The number of bytes read, 0 at the end of the body or a
+            negative `TR064_HTTP_ERROR_*` code.
+*/
+/**************************************************************************/
+int TR064HttpClient::read(uint8_t* buf, size_t len) {
+    size_t total = 0;
+    while (total < len && !_bodyDone) {
+        if (_chunked && _remaining == 0) {
+            if (total > 0 && _rxPos >= _rxLen) break;
+            int rc = readChunkSize();
+            if (rc < 0) return total > 0 ? (int) total : rc;
+            continue;
+        }
+        if (_rxPos >= _rxLen) {
+            if (total > 0) break;
+            int rc = fill();
+            if (rc < 0) {
+                if (rc == TR064_HTTP_ERROR_CONNECTION_LOST && !_chunked && _remaining < 0) {
+                    // Body without length, delimited by the end of the connection
+                    _bodyDone = true;
+                    break;
+                }
+                return rc;
+            }
+        }
+        size_t n = _rxLen - _rxPos;
+        if (n > len - total) n = len - total;
+        if (_remaining >= 0 && (long) n > _remaining) n = (size_t) _remaining;
+        memcpy(buf + total, _rx + _rxPos, n);
+        _rxPos += n;
+        total += n;
+        if (_remaining >= 0) {
+            _remaining -= (long) n;
+            if (!_chunked && _remaining == 0) _bodyDone = true;
+        }
+    }
+    return (int) total;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Whether there is (possibly) more body data to read.
+*/
+/**************************************************************************/
+bool TR064HttpClient::available() {
+    return _transport && !_bodyDone;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Finishes the current request. With keep-alive, the rest of the
+            body is read and discarded so that the connection can take the
+            next request; otherwise (or if that fails) it is closed.
+*/
+/**************************************************************************/
+void TR064HttpClient::end() {
+    if (_reusable) {
+        return;
+    }
+    if (_keepAlive && !_serverClose && _host[0] != '\0' && _transport && drain()) {
+        _reusable = true;
+        _txLen = 0;
+        return;
+    }
+    close();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Finishes the current request and closes the connection.
+*/
+/**************************************************************************/
+void TR064HttpClient::close() {
+    if (_transport) {
+        _transport->stop();
+    }
+    _connecting = false;
+    _reusable = false;
+    _host[0] = '\0';
+    _bodyDone = true;
+    _rxPos = 0;
+    _rxLen = 0;
+    _txLen = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Converts a negative return code of `request()` to a message.
+    @param    error
+                The error code.
+    @return The message.
+*/
+/**************************************************************************/
+const char* TR064HttpClient::errorToString(int error) {
+    switch (error) {
+    case TR064_HTTP_ERROR_CONNECTION_FAILED:
+        return "connection failed";
+    case TR064_HTTP_ERROR_SEND_FAILED:
+        return "send failed";
+    case TR064_HTTP_ERROR_CONNECTION_LOST:
+        return "connection lost";
+    case TR064_HTTP_ERROR_READ_TIMEOUT:
+        return "read timeout";
+    case TR064_HTTP_ERROR_INVALID_RESPONSE:
+        return "invalid response";
+    case TR064_HTTP_ERROR_NO_TRANSPORT:
+        return "no transport";
+    case TR064_HTTP_ERROR_WOULD_BLOCK:
+        return "no data yet";
+    default:
+        return "";
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Appends data to the send buffer (part of the request body).
+            The buffer is sent whenever it is full.
+    @return success state.
+*/
+/**************************************************************************/
+bool TR064HttpClient::write(const char* data, size_t len) {
+    while (len > 0) {
+        if (_txLen == sizeof(_tx) && !flush()) return false;
+        size_t n = sizeof(_tx) - _txLen;
+        if (n > len) n = len;
+        memcpy(_tx + _txLen, data, n);
+        _txLen += n;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// ----------------------------
+// ----- Helper-functions -----
+// ----------------------------
+
+/**************************************************************************/
+/*!
+    @brief  Writes a request to the connection opened by `connect()`. The
+            response is read with `pollHead()` and `read()`.
+    @return 0 on success or `TR064_HTTP_ERROR_SEND_FAILED`.
+*/
+/**************************************************************************/
+int TR064HttpClient::sendRequest(const char* method, const char* url, const char* soapaction,
+                                 const TR064RequestBody* body) {
+    _rxPos = 0;
+    _rxLen = 0;
+    _txLen = 0;
+    _lineLen = 0;
+    _reusable = false;
+    _received = false;
+    _lost = false;
+    _serverClose = !_keepAlive;
+    _headState = HEAD_STATUS;
+    _status = 0;
+    _chunked = false;
+    _chunkState = CHUNK_SIZE;
+    _bodyDone = false;
+    _contentLength = -1;
+    _remaining = -1;
+    _head = strcmp(method, "HEAD") == 0;
+    _validator[0] = '\0';
+    _etag = false;
+    ++_stats.requests;
+    _mark = micros();
+
+    char number[24];
+    bool ok = write(method) && write(" ") && write(url) && write(" HTTP/1.1\r\nHost: ")
+        && write(_host);
+    snprintf(number, sizeof(number), ":%u\r\n", (unsigned) _port);
+    ok = ok && write(number) && write("User-Agent: TR064\r\nConnection: ")
+        && write(_keepAlive ? "keep-alive\r\n" : "close\r\n");
+    if (soapaction && soapaction[0] != '\0') {
+        ok = ok && write("Content-Type: text/xml; charset=\"utf-8\"\r\nSOAPACTION: ")
+            && write(soapaction) && write("\r\n");
+    }
+    if (_headers) {
+        ok = ok && write(_headers);
+    }
+    if (body) {
+        snprintf(number, sizeof(number), "%lu", (unsigned long) body->length());
+        ok = ok && write("Content-Length: ") && write(number) && write("\r\n");
+    }
+    ok = ok && write("\r\n") && (!body || body->writeTo(*this)) && flush();
+    return ok ? 0 : TR064_HTTP_ERROR_SEND_FAILED;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads the status line and the headers of the response, as far
+            as data is available in non-blocking mode.
+    @return The HTTP status code, `TR064_HTTP_ERROR_WOULD_BLOCK` if the head
+            is not complete yet or another negative error code.
+*/
+/**************************************************************************/
+int TR064HttpClient::pollHead() {
+    if (_headState == HEAD_DONE) {
+        return _status;
+    }
+    return readHead();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads and discards the rest of the response body.
+    @return true if the body was read completely (and nothing else was
+            received), i.e. the connection can be reused.
+*/
+/**************************************************************************/
+bool TR064HttpClient::drain() {
+    if (!_bodyDone && !_chunked && _remaining < 0) {
+        // Body delimited by the end of the connection
+        return false;
+    }
+    uint8_t buf[64];
+    int n;
+    while ((n = read(buf, sizeof(buf))) > 0) {}
+    return n == 0 && _bodyDone && _rxPos >= _rxLen;
+}
+
+bool TR064HttpClient::flush() {
+    if (_txLen == 0) return true;
+    size_t n = _transport->write(_tx, _txLen);
+    bool ok = n == _txLen;
+    _txLen = 0;
+    if (!ok) _lost = true;
+    return ok;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Refills the receive buffer if it is empty.
+    @return The number of buffered bytes or a negative error code.
+*/
+/**************************************************************************/
+int TR064HttpClient::fill() {
+    if (_rxPos < _rxLen) return _rxLen - _rxPos;
+    unsigned long start = micros();
+    int n = _transport->read(_rx, sizeof(_rx), _nonBlocking ? 0 : _timeout);
+    if (n > 0) {
+        if (_received) {
+            _timing.receive += micros() - start;
+        } else {
+            _timing.firstByte = micros() - _mark;
+        }
+        _received = true;
+        _rxPos = 0;
+        _rxLen = (uint16_t) n;
+        return n;
+    }
+    if (n == 0) {
+        return _nonBlocking ? TR064_HTTP_ERROR_WOULD_BLOCK : TR064_HTTP_ERROR_READ_TIMEOUT;
+    }
+    _lost = true;
+    return TR064_HTTP_ERROR_CONNECTION_LOST;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads one CRLF terminated line into `_line` (without the line
+            ending, truncated to the buffer size).
+    @return The length of the line or a negative error code.
+*/
+/**************************************************************************/
+int TR064HttpClient::readLine() {
+    while (true) {
+        int rc = fill();
+        if (rc < 0) return rc;  // The partial line is kept for the next call
+        char c = (char) _rx[_rxPos++];
+        if (c == '\n') break;
+        if (c != '\r' && _lineLen < sizeof(_line) - 1) _line[_lineLen++] = c;
+    }
+    int len = _lineLen;
+    _line[len] = '\0';
+    _lineLen = 0;
+    return len;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads the status line and the headers of a response.
+    @return The HTTP status code or a negative error code.
+*/
+/**************************************************************************/
+int TR064HttpClient::readHead() {
+    int len;
+    if (_headState == HEAD_STATUS) {
+        len = readLine();
+        if (len < 0) return len;
+        const char* sp = strchr(_line, ' ');
+        if (strncmp(_line, "HTTP/1.", 7) != 0 || !sp) return TR064_HTTP_ERROR_INVALID_RESPONSE;
+        _status = atoi(sp + 1);
+        if (strncmp(_line, "HTTP/1.0", 8) == 0) {
+            _serverClose = true;
+        }
+        _headState = HEAD_FIELDS;
+    }
+
+    while ((len = readLine()) > 0) {
+        char* value = strchr(_line, ':');
+        if (!value) continue;
+        *value++ = '\0';
+        while (*value == ' ' || *value == '\t') ++value;
+        if (strcasecmp(_line, "Content-Length") == 0) {
+            _contentLength = atol(value);
+        } else if (strcasecmp(_line, "Transfer-Encoding") == 0) {
+            _chunked = strncasecmp(value, "chunked", 7) == 0;
+        } else if (strcasecmp(_line, "Connection") == 0) {
+            if (strncasecmp(value, "close", 5) == 0) {
+                _serverClose = true;
+            } else if (_keepAlive && strncasecmp(value, "keep-alive", 10) == 0) {
+                _serverClose = false;
+            }
+        } else if (strcasecmp(_line, "ETag") == 0 || (!_etag && strcasecmp(_line, "Last-Modified") == 0)) {
+            // Identifies the version of the resource, see `validator()`
+            size_t valueLen = strlen(value);
+            if (valueLen < sizeof(_validator)) {
+                memcpy(_validator, value, valueLen + 1);
+                _etag = _line[0] == 'E' || _line[0] == 'e';
+            }
+        }
+        if (_headerHandler) {
+            _headerHandler->onHeader(_line, value);
+        }
+    }
+    if (len < 0) return len;
+    _headState = HEAD_DONE;
+
+    if (_head || _status == 204 || _status == 304) {
+        _bodyDone = true;
+    } else if (_chunked) {
+        _remaining = 0;
+    } else if (_contentLength >= 0) {
+        _remaining = _contentLength;
+        _bodyDone = _contentLength == 0;
+    } else {
+        // The body ends with the connection
+        _serverClose = true;
+    }
+    return _status;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads the size line of the next chunk (and the trailer after the
+            last one).
+    @return 0 on success or a negative error code.
+*/
+/**************************************************************************/
+int TR064HttpClient::readChunkSize() {
+    int len;
+    if (_chunkState == CHUNK_CRLF) {
+        // End of the data of the previous chunk
+        if ((len = readLine()) != 0) {
+            return len < 0 ? len : TR064_HTTP_ERROR_INVALID_RESPONSE;
+        }
+        _chunkState = CHUNK_SIZE;
+    }
+    if (_chunkState == CHUNK_SIZE) {
+        if ((len = readLine()) < 0) return len;
+        char* end = nullptr;
+        _remaining = strtol(_line, &end, 16);
+        if (end == _line || _remaining < 0) return TR064_HTTP_ERROR_INVALID_RESPONSE;
+        if (_remaining > 0) {
+            _chunkState = CHUNK_CRLF;
+            return 0;
+        }
+        _chunkState = CHUNK_TRAILER;
+    }
+    // Skip the (usually empty) trailer
+    while ((len = readLine()) > 0) {}
+    if (len < 0) return len;
+    _bodyDone = true;
+    return 0;
+}
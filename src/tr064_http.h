@@ -0,0 +1,198 @@
+/*!
+ * @file tr064_http.h
+ *
+ * Minimal HTTP/1.1 client of the TR-064 library. It writes requests to and
+ * reads responses (including chunked bodies) from a `TR064Transport`.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_http_h
+#define tr064_http_h
+
+#include "Arduino.h"
+#include "tr064_transport.h"
+
+#ifndef TR064_HTTP_RX_BUFFER
+#define TR064_HTTP_RX_BUFFER        256 ///< Size of the receive buffer (bytes)
+#endif
+#ifndef TR064_HTTP_TX_BUFFER
+#define TR064_HTTP_TX_BUFFER        256 ///< Size of the send buffer (bytes)
+#endif
+#ifndef TR064_HTTP_LINE_BUFFER
+#define TR064_HTTP_LINE_BUFFER      128 ///< Longest status/header line kept (longer ones are truncated)
+#endif
+#ifndef TR064_HTTP_HOST_BUFFER
+#define TR064_HTTP_HOST_BUFFER      64 ///< Longest host name a kept-alive connection is remembered for
+#endif
+#ifndef TR064_HTTP_VALIDATOR_BUFFER
+#define TR064_HTTP_VALIDATOR_BUFFER 48 ///< Longest `ETag`/`Last-Modified` value kept (longer ones are dropped)
+#endif
+#ifndef TR064_HTTP_TIMEOUT
+#define TR064_HTTP_TIMEOUT          5000 ///< Default read timeout (ms)
+#endif
+
+#define TR064_HTTP_CODE_OK                      200
+#define TR064_HTTP_CODE_NOT_FOUND               404
+#define TR064_HTTP_CODE_INTERNAL_SERVER_ERROR   500
+#define TR064_HTTP_CODE_SERVICE_UNAVAILABLE     503
+
+// Negative return values of `TR064HttpClient::request()`
+#define TR064_HTTP_ERROR_CONNECTION_FAILED  -1 ///< Could not connect to the device
+#define TR064_HTTP_ERROR_SEND_FAILED        -2 ///< Writing the request failed
+#define TR064_HTTP_ERROR_CONNECTION_LOST    -3 ///< The connection closed unexpectedly
+#define TR064_HTTP_ERROR_READ_TIMEOUT       -4 ///< No response within the timeout
+#define TR064_HTTP_ERROR_INVALID_RESPONSE   -5 ///< The response could not be parsed
+#define TR064_HTTP_ERROR_NO_TRANSPORT       -6 ///< No transport set
+#define TR064_HTTP_ERROR_WOULD_BLOCK        -7 ///< Non-blocking mode: no data yet, try again later
+
+/// Connection counters of a `TR064HttpClient`, see `TR064HttpClient::stats()`.
+struct TR064HttpStats {
+    uint32_t requests;      ///< Requests sent
+    uint32_t connects;      ///< New connections opened (including reconnects)
+    uint32_t reuses;        ///< Requests sent on a kept-alive connection
+    uint32_t reconnects;    ///< Kept-alive connections found closed (or failing) and reopened
+};
+
+/// Durations (microseconds) of the last request, see `TR064HttpClient::timing()`.
+struct TR064HttpTiming {
+    uint32_t connect;       ///< Opening the connection (0 if a kept-alive one was reused)
+    uint32_t firstByte;     ///< From sending the request to the first byte of the response
+    uint32_t receive;       ///< Waiting for the rest of the response (head and body)
+};
+
+/**************************************************************************/
+/*!
+    @brief  Body of a request that is written in pieces, straight into the
+            send buffer. Its length must be known in advance.
+*/
+/**************************************************************************/
+class TR064RequestBody {
+    public:
+        virtual ~TR064RequestBody() {}
+        /*!  @brief Number of bytes `writeTo()` will write. */
+        virtual size_t length() const = 0;
+        /*!  @brief Writes the body to `sink`. @return success state. */
+        virtual bool writeTo(TR064ByteSink& sink) const = 0;
+};
+
+/**************************************************************************/
+/*!
+    @brief  Receives the header fields of the responses of a
+            `TR064HttpClient`, see `TR064HttpClient::setHeaderHandler()`.
+*/
+/**************************************************************************/
+class TR064HttpHeaderHandler {
+    public:
+        virtual ~TR064HttpHeaderHandler() {}
+        /*!  @brief A header field (the value without leading white space, truncated
+             to `TR064_HTTP_LINE_BUFFER` together with the name). */
+        virtual void onHeader(const char* name, const char* value) = 0;
+};
+
+/**************************************************************************/
+/*!
+    @brief  HTTP/1.1 client on top of a `TR064Transport`. One request is
+            active at a time; its body is read with `read()`. By default
+            the connection is kept alive between requests: `end()` drains
+            the rest of the body and the next request to the same host
+            reuses the socket (or reconnects, if the device closed it).
+
+            `request()` blocks until the head of the response arrived. In
+            non-blocking mode the steps can be driven one by one instead
+            (`connect()`/`pollConnect()`, `sendRequest()`, `pollHead()`,
+            `read()`), which return `TR064_HTTP_ERROR_WOULD_BLOCK` (or 0
+            while connecting) instead of waiting.
+*/
+/**************************************************************************/
+class TR064HttpClient : public TR064ByteSource, public TR064ByteSink {
+    public:
+        TR064HttpClient();
+        void setTransport(TR064Transport* transport);
+        TR064Transport* transport() { return _transport; }
+        void setTimeout(uint32_t timeout) { _timeout = timeout; }
+        uint32_t timeout() const { return _timeout; }
+        void setNonBlocking(bool nonBlocking) { _nonBlocking = nonBlocking; }
+        void setKeepAlive(bool keepAlive);
+        bool keepAlive() const { return _keepAlive; }
+        const TR064HttpStats& stats() const { return _stats; }
+        void resetStats();
+        const TR064HttpTiming& timing() const { return _timing; }
+        /*!  @brief Additional header lines (each ending with CRLF) of the following requests, `nullptr` for none. */
+        void setHeaders(const char* headers) { _headers = headers; }
+        /*!  @brief Receives the header fields of the following responses, `nullptr` for none. */
+        void setHeaderHandler(TR064HttpHeaderHandler* handler) { _headerHandler = handler; }
+
+        int request(const char* host, uint16_t port, const char* method, const char* url,
+                    const char* soapaction, const char* body, size_t bodyLen);
+        int request(const char* host, uint16_t port, const char* method, const char* url,
+                    const char* soapaction, const TR064RequestBody* body);
+        int connect(const char* host, uint16_t port);
+        int pollConnect();
+        int sendRequest(const char* method, const char* url, const char* soapaction,
+                        const TR064RequestBody* body);
+        int pollHead();
+        bool retryable() const;
+        void reopen();
+        int read(uint8_t* buf, size_t len) override;
+        bool write(const char* data, size_t len) override;
+        bool available();
+        void end();
+        void close();
+        long contentLength() const { return _contentLength; }
+        int status() const { return _status; }
+        const char* validator() const { return _validator; }
+        static const char* errorToString(int error);
+
+    private:
+        bool write(const char* str) { return write(str, strlen(str)); }
+        bool flush();
+        int fill();
+        int readLine();
+        int readHead();
+        int readChunkSize();
+        bool drain();
+
+        enum HeadState { HEAD_STATUS, HEAD_FIELDS, HEAD_DONE };
+        enum ChunkState { CHUNK_SIZE, CHUNK_CRLF, CHUNK_TRAILER };
+
+        TR064Transport* _transport;
+        uint32_t _timeout;
+        bool _nonBlocking;      // Never wait for data, see `TR064_HTTP_ERROR_WOULD_BLOCK`
+        bool _connecting;       // A connection is being established
+        bool _reused;           // The current request runs on a kept-alive connection
+        bool _keepAlive;        // Ask for persistent connections
+        bool _reusable;         // The open connection can take the next request
+        bool _received;         // Data was received for the current request
+        bool _lost;             // The connection failed for the current request (not just a timeout)
+        bool _serverClose;      // The response announced `Connection: close`
+        char _host[TR064_HTTP_HOST_BUFFER]; // Peer of the open connection
+        uint16_t _port;
+        TR064HttpStats _stats;
+        TR064HttpTiming _timing;
+        unsigned long _mark;    // micros() when connecting/sending started
+        const char* _headers;   // Additional header lines, see `setHeaders()`
+        TR064HttpHeaderHandler* _headerHandler;
+
+        bool _head;             // HEAD request: the response has no body
+        bool _chunked;          // Body uses chunked transfer encoding
+        bool _bodyDone;         // The whole body has been consumed
+        HeadState _headState;   // Progress of reading the head
+        int _status;            // HTTP status code of the response
+        ChunkState _chunkState; // Progress of reading the chunk framing
+        long _contentLength;    // -1 if unknown
+        long _remaining;        // Bytes left in the body/current chunk, -1 if unknown
+
+        uint8_t _rx[TR064_HTTP_RX_BUFFER];
+        uint16_t _rxPos;
+        uint16_t _rxLen;
+        uint8_t _tx[TR064_HTTP_TX_BUFFER];
+        uint16_t _txLen;
+        char _validator[TR064_HTTP_VALIDATOR_BUFFER]; // `ETag` (preferred) or `Last-Modified` of the response
+        bool _etag;             // `_validator` holds an `ETag`
+        char _line[TR064_HTTP_LINE_BUFFER];
+        uint16_t _lineLen;      // Length of the (partial) line in `_line`
+};
+
+#endif
@@ -0,0 +1,351 @@
+/*!
+ * @file tr064_lists.cpp
+ *
+ * Streaming of call lists, phonebooks and answering machine messages.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_lists.h"
+#include "tr064_xml.h"
+
+#define TR064_LIST_FIELDS           12 ///< Most fields of a record
+
+/**************************************************************************/
+/*!
+    @brief  Collects the fields of one record of a list (`<Call>` etc.)
+            into a fixed window and passes it on at its end tag. Each field
+            is bound to a buffer of the record or of the handler; a buffer
+            that is already filled (by an alias, e.g. `Caller` and
+            `CallerNumber`) is not overwritten.
+*/
+/**************************************************************************/
+class TR064RecordHandler : public TR064XmlHandler {
+    public:
+        const TR064XmlKeys& keys() const { return _keys; }
+        /*!  @brief Number of records passed on. */
+        int count() const { return _count; }
+
+        void onStart(int key) override {
+            if (key == _recordKey) {
+                for (uint8_t i = 0; i < _keys.size(); ++i) {
+                    if (_fields[i].target) _fields[i].target[0] = '\0';
+                }
+                begin();
+                return;
+            }
+            // Only fields with an empty buffer collect text
+            Field& f = _fields[key];
+            _len = f.target && f.target[0] == '\0' ? 0 : -1;
+        }
+
+        void onText(int key, const char* text, size_t len) override {
+            Field& f = _fields[key];
+            if (!f.target || _len < 0) {
+                return;
+            }
+            if (len > f.size - 1 - (size_t) _len) {
+                len = f.size - 1 - (size_t) _len;
+                *_truncated = true;
+            }
+            memcpy(f.target + _len, text, len);
+            _len += (int) len;
+            f.target[_len] = '\0';
+        }
+
+        bool onEnd(int key) override {
+            if (key != _recordKey) {
+                fieldEnd(key);
+                _len = -1;
+                return true;
+            }
+            if (!accept()) {
+                return true;
+            }
+            ++_count;
+            return deliver() && (_max == 0 || _count < _max);
+        }
+
+    protected:
+        TR064RecordHandler(const char* record, const TR064ListFilter* filter) : _truncated(nullptr), _count(0), _len(-1) {
+            _recordKey = _keys.add(record);
+            _fields[_recordKey].target = nullptr;
+            _max = filter ? filter->max : 0;
+        }
+
+        /// Binds an element to a buffer. @return The key of the element.
+        int field(const char* name, char* target, size_t size) {
+            int key = _keys.add(name);
+            _fields[key].target = target;
+            _fields[key].size = (uint16_t) size;
+            target[0] = '\0';
+            return key;
+        }
+
+        /*!  @brief Start of a record, after the bound buffers were cleared. */
+        virtual void begin() = 0;
+        /*!  @brief End of a field of the record. */
+        virtual void fieldEnd(int key) { (void) key; }
+        /*!  @brief Whether the record passes the filter. */
+        virtual bool accept() { return true; }
+        /*!  @brief Passes the record on. @return false to stop. */
+        virtual bool deliver() = 0;
+
+        bool* _truncated;       // Flag of the record, set if a text is cut off
+
+    private:
+        struct Field {
+            char* target;       // `nullptr` for the record itself
+            uint16_t size;
+        };
+
+        TR064XmlKeys _keys;
+        Field _fields[TR064_LIST_FIELDS + 1];
+        int _recordKey;
+        int _count;
+        uint16_t _max;
+        int _len;               // Length of the text in the current field, -1 if it is not collected
+};
+
+/// Passes each `<Call>` of a call list on as a `TR064Call`.
+class TR064CallHandler : public TR064RecordHandler {
+    public:
+        TR064CallHandler(const TR064ListFilter* filter, TR064CallCallback callback, void* context)
+                : TR064RecordHandler("Call", filter), _callback(callback), _context(context) {
+            _minId = filter ? filter->id : 0;
+            _truncated = &_call.truncated;
+            field("Id", _id, sizeof(_id));
+            field("Type", _type, sizeof(_type));
+            field("Caller", _call.caller, sizeof(_call.caller));
+            field("CallerNumber", _call.caller, sizeof(_call.caller));
+            field("Called", _call.called, sizeof(_call.called));
+            field("CalledNumber", _call.called, sizeof(_call.called));
+            field("Name", _call.name, sizeof(_call.name));
+            field("Device", _call.device, sizeof(_call.device));
+            field("Date", _call.date, sizeof(_call.date));
+            field("Duration", _duration, sizeof(_duration));
+        }
+
+    protected:
+        void begin() override {
+            _call.truncated = false;
+        }
+
+        bool accept() override {
+            _call.id = (uint32_t) strtoul(_id, nullptr, 10);
+            return _call.id > _minId;
+        }
+
+        bool deliver() override {
+            _call.type = (uint8_t) atoi(_type);
+            _call.duration = TR064ListParser::parseDuration(_duration);
+            return _callback(_call, _context);
+        }
+
+    private:
+        TR064CallCallback _callback;
+        void* _context;
+        uint32_t _minId;
+        TR064Call _call;
+        char _id[12];
+        char _type[4];
+        char _duration[12];
+};
+
+/// Passes each `<contact>` of a phonebook on as a `TR064Contact`.
+class TR064ContactHandler : public TR064RecordHandler {
+    public:
+        TR064ContactHandler(const TR064ListFilter* filter, TR064ContactCallback callback, void* context)
+                : TR064RecordHandler("contact", filter), _callback(callback), _context(context) {
+            _truncated = &_contact.truncated;
+            field("uniqueid", _id, sizeof(_id));
+            field("category", _category, sizeof(_category));
+            field("realName", _contact.name, sizeof(_contact.name));
+            _numberKey = field("number", _number, sizeof(_number));
+        }
+
+    protected:
+        void begin() override {
+            _contact.nNumbers = 0;
+            _contact.truncated = false;
+        }
+
+        void fieldEnd(int key) override {
+            if (key != _numberKey || _number[0] == '\0') {
+                return;
+            }
+            if (_contact.nNumbers < TR064_CONTACT_NUMBERS) {
+                strcpy(_contact.numbers[_contact.nNumbers++], _number);
+            } else {
+                _contact.truncated = true;
+            }
+            // Free for the next number
+            _number[0] = '\0';
+        }
+
+        bool deliver() override {
+            _contact.uniqueId = (uint32_t) strtoul(_id, nullptr, 10);
+            _contact.category = (uint8_t) atoi(_category);
+            return _callback(_contact, _context);
+        }
+
+    private:
+        TR064ContactCallback _callback;
+        void* _context;
+        int _numberKey;
+        TR064Contact _contact;
+        char _id[12];
+        char _category[4];
+        char _number[TR064_LIST_NUMBER];
+};
+
+/// Passes each `<Message>` of a message list on as a `TR064TamMessage`.
+class TR064TamMessageHandler : public TR064RecordHandler {
+    public:
+        TR064TamMessageHandler(const TR064ListFilter* filter, TR064TamMessageCallback callback, void* context)
+                : TR064RecordHandler("Message", filter), _callback(callback), _context(context) {
+            _truncated = &_message.truncated;
+            field("Index", _index, sizeof(_index));
+            field("Tam", _tam, sizeof(_tam));
+            field("New", _new, sizeof(_new));
+            field("Number", _message.number, sizeof(_message.number));
+            field("Called", _message.called, sizeof(_message.called));
+            field("Name", _message.name, sizeof(_message.name));
+            field("Date", _message.date, sizeof(_message.date));
+            field("Duration", _duration, sizeof(_duration));
+            field("Path", _message.path, sizeof(_message.path));
+        }
+
+    protected:
+        void begin() override {
+            _message.truncated = false;
+        }
+
+        bool deliver() override {
+            _message.index = (uint16_t) atoi(_index);
+            _message.tam = (uint8_t) atoi(_tam);
+            _message.isNew = atoi(_new) != 0;
+            _message.duration = TR064ListParser::parseDuration(_duration);
+            return _callback(_message, _context);
+        }
+
+    private:
+        TR064TamMessageCallback _callback;
+        void* _context;
+        TR064TamMessage _message;
+        char _index[8];
+        char _tam[4];
+        char _new[4];
+        char _duration[12];
+};
+
+/**************************************************************************/
+/*!
+    @brief  Reads a call list (the file of `GetCallList`).
+    @param    source
+                The file, e.g. the body of a response.
+    @param    filter
+                The filter (`max`, `id`; `days` is left to the device) or
+                `nullptr`.
+    @param    callback
+                Called for each call.
+    @param    context
+                Passed to the callback.
+    @param    count
+                Receives the number of calls passed to the callback.
+    @return `TR064_XML_END`, `TR064_XML_STOPPED` or the negative error of
+            the source.
+*/
+/**************************************************************************/
+int TR064ListParser::calls(TR064ByteSource& source, const TR064ListFilter* filter, TR064CallCallback callback,
+                           void* context, int& count) {
+    TR064CallHandler handler(filter, callback, context);
+    TR064XmlTokenizer tokenizer(handler.keys(), handler);
+    int result = tokenizer.scan(source);
+    count = handler.count();
+    return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads a phonebook (the file of `GetPhonebook`), see `calls()`.
+            Of the filter, only `max` applies.
+*/
+/**************************************************************************/
+int TR064ListParser::contacts(TR064ByteSource& source, const TR064ListFilter* filter, TR064ContactCallback callback,
+                              void* context, int& count) {
+    TR064ContactHandler handler(filter, callback, context);
+    TR064XmlTokenizer tokenizer(handler.keys(), handler);
+    int result = tokenizer.scan(source);
+    count = handler.count();
+    return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads the messages of an answering machine (the file of
+            `GetMessageList`), see `calls()`. Of the filter, only `max`
+            applies.
+*/
+/**************************************************************************/
+int TR064ListParser::messages(TR064ByteSource& source, const TR064ListFilter* filter, TR064TamMessageCallback callback,
+                              void* context, int& count) {
+    TR064TamMessageHandler handler(filter, callback, context);
+    TR064XmlTokenizer tokenizer(handler.keys(), handler);
+    int result = tokenizer.scan(source);
+    count = handler.count();
+    return result;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Appends the filter to the URL of a call list, as the query
+            parameters `max`, `days` and `id` the device understands.
+    @param    url
+                The URL, zero-terminated.
+    @param    size
+                Size of the buffer of the URL.
+    @param    filter
+                The filter or `nullptr`.
+    @return false if the URL would not fit (it is left as it was).
+*/
+/**************************************************************************/
+bool TR064ListParser::addFilter(char* url, size_t size, const TR064ListFilter* filter) {
+    if (!filter) {
+        return true;
+    }
+    size_t len = strlen(url);
+    size_t pos = len;
+    const char* names[] = {"max", "days", "id"};
+    uint32_t values[] = {filter->max, filter->days, filter->id};
+    for (int i = 0; i < 3; ++i) {
+        if (values[i] == 0) {
+            continue;
+        }
+        char separator = strchr(url, '?') ? '&' : '?';
+        int n = snprintf(url + pos, size - pos, "%c%s=%lu", separator, names[i], (unsigned long) values[i]);
+        if (n < 0 || (size_t) n >= size - pos) {
+            url[len] = '\0';
+            return false;
+        }
+        pos += (size_t) n;
+    }
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Parses a duration of a list (`h:mm`).
+    @return The duration in minutes.
+*/
+/**************************************************************************/
+uint16_t TR064ListParser::parseDuration(const char* text) {
+    char* end;
+    unsigned long hours = strtoul(text, &end, 10);
+    if (*end != ':') {
+        return (uint16_t) hours;
+    }
+    unsigned long minutes = hours * 60 + strtoul(end + 1, nullptr, 10);
+    return minutes > 0xFFFF ? 0xFFFF : (uint16_t) minutes;
+}
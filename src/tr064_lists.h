@@ -0,0 +1,118 @@
+/*!
+ * @file tr064_lists.h
+ *
+ * Streaming of the lists a FRITZ!Box offers as files: the call list
+ * (`X_AVM-DE_OnTel:1` `GetCallList`), the phonebooks (`GetPhonebook`) and
+ * the messages of an answering machine (`X_AVM-DE_TAM:1`
+ * `GetMessageList`). The action only returns the URL of the file, which
+ * can be hundreds of kilobytes; it is fetched with a GET on the same
+ * connection (see `TR064::fetchCallList()` etc.), streamed through the
+ * tokenizer, and each `<Call>`, `<contact>` or `<Message>` is handed to a
+ * callback as soon as its end tag was read. Only one record is held at a
+ * time, in a window of fixed size, so the memory used does not depend on
+ * the length of the list.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_lists_h
+#define tr064_lists_h
+
+#include "Arduino.h"
+#include "tr064_transport.h"
+
+#ifndef TR064_LIST_URL
+#define TR064_LIST_URL              256 ///< Size of the buffer for the URL of a list, including the filters
+#endif
+#ifndef TR064_LIST_NUMBER
+#define TR064_LIST_NUMBER           32 ///< Size of a phone number in a record (including terminator)
+#endif
+#ifndef TR064_LIST_NAME
+#define TR064_LIST_NAME             48 ///< Size of a name in a record (including terminator)
+#endif
+#ifndef TR064_LIST_PATH
+#define TR064_LIST_PATH             96 ///< Size of the path of a recording in a record (including terminator)
+#endif
+#ifndef TR064_CONTACT_NUMBERS
+#define TR064_CONTACT_NUMBERS       4 ///< Most numbers kept per contact
+#endif
+
+// Negative return values of `TR064::fetchCallList()`, `fetchPhonebook()` and `fetchMessages()`
+#define TR064_LIST_ERROR_URL        -1 ///< The action failed, or its URL was empty or too long for `TR064_LIST_URL`
+#define TR064_LIST_ERROR_FETCH      -2 ///< The list could not be fetched
+#define TR064_LIST_ERROR_INCOMPLETE -3 ///< The connection failed while the list was read
+
+/// Filters of a list, see `TR064::fetchCallList()`. All 0: the whole list.
+struct TR064ListFilter {
+    uint16_t max;   ///< Most records; sent to the device (call list) and enforced while parsing
+    uint16_t days;  ///< Call list: only the calls of that many days, sent to the device
+    uint32_t id;    ///< Call list: only calls with a higher `Id`, sent to the device and enforced while parsing
+};
+
+/// One call of the call list.
+struct TR064Call {
+    uint32_t id;                        ///< Unique, increasing id of the call
+    uint8_t type;                       ///< 1 incoming, 2 missed, 3 outgoing, 9 active incoming, 10 rejected, 11 active outgoing
+    uint16_t duration;                  ///< Duration (minutes)
+    char caller[TR064_LIST_NUMBER];     ///< Number of the caller (own number for outgoing calls)
+    char called[TR064_LIST_NUMBER];     ///< Number called (own number for incoming calls)
+    char name[TR064_LIST_NAME];         ///< Name of the other party, if it is in a phonebook
+    char device[TR064_LIST_NAME];       ///< Telephone that took or made the call
+    char date[16];                      ///< `dd.mm.yy hh:mm`
+    bool truncated;                     ///< A text did not fit and was cut off
+};
+
+/// One contact of a phonebook.
+struct TR064Contact {
+    uint32_t uniqueId;                  ///< Id of the contact in the phonebook
+    uint8_t category;                   ///< 1 if the contact is marked important
+    uint8_t nNumbers;                   ///< Numbers kept in `numbers`
+    char name[TR064_LIST_NAME];         ///< Name of the contact
+    char numbers[TR064_CONTACT_NUMBERS][TR064_LIST_NUMBER]; ///< Phone numbers (their types are not kept)
+    bool truncated;                     ///< A text did not fit, or there were more than `TR064_CONTACT_NUMBERS` numbers
+};
+
+/// One message of an answering machine.
+struct TR064TamMessage {
+    uint16_t index;                     ///< Index of the message, e.g. for `DeleteMessage`
+    uint8_t tam;                        ///< Index of the answering machine
+    bool isNew;                         ///< Whether the message was not listened to yet
+    uint16_t duration;                  ///< Duration (minutes)
+    char number[TR064_LIST_NUMBER];     ///< Number of the caller
+    char called[TR064_LIST_NUMBER];     ///< Own number that was called
+    char name[TR064_LIST_NAME];         ///< Name of the caller, if it is in a phonebook
+    char date[16];                      ///< `dd.mm.yy hh:mm`
+    char path[TR064_LIST_PATH];         ///< Path of the recording
+    bool truncated;                     ///< A text did not fit and was cut off
+};
+
+/// Called for each call of the list, with the user context. @return false to stop reading the list.
+typedef bool (*TR064CallCallback)(const TR064Call& call, void* context);
+/// Called for each contact of the phonebook, with the user context. @return false to stop reading the list.
+typedef bool (*TR064ContactCallback)(const TR064Contact& contact, void* context);
+/// Called for each message of the answering machine, with the user context. @return false to stop reading the list.
+typedef bool (*TR064TamMessageCallback)(const TR064TamMessage& message, void* context);
+
+/**************************************************************************/
+/*!
+    @brief  Parsers of the list files, reading from any byte source (see
+            `TR064::fetchCallList()` for the files of the device). Each
+            returns `TR064_XML_END`, `TR064_XML_STOPPED` (by the callback
+            or the `max` of the filter) or the negative error of the
+            source, and counts the records passed to the callback.
+*/
+/**************************************************************************/
+class TR064ListParser {
+    public:
+        static int calls(TR064ByteSource& source, const TR064ListFilter* filter, TR064CallCallback callback,
+                         void* context, int& count);
+        static int contacts(TR064ByteSource& source, const TR064ListFilter* filter, TR064ContactCallback callback,
+                            void* context, int& count);
+        static int messages(TR064ByteSource& source, const TR064ListFilter* filter, TR064TamMessageCallback callback,
+                            void* context, int& count);
+        static bool addFilter(char* url, size_t size, const TR064ListFilter* filter);
+        static uint16_t parseDuration(const char* text);
+};
+
+#endif
@@ -0,0 +1,97 @@
+/*!
+ * @file tr064_log.cpp
+ *
+ * Ring buffer of log messages in RAM.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_log.h"
+
+/**************************************************************************/
+/*!
+    @brief  Creates an empty log buffer.
+    @param    buffer
+                Memory of the ring buffer, must outlive this object.
+    @param    size
+                Size of `buffer`.
+*/
+/**************************************************************************/
+TR064LogBuffer::TR064LogBuffer(char* buffer, size_t size) : _buffer(buffer), _size(size) {
+    clear();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Appends a byte, dropping the oldest message if the buffer is
+            full.
+*/
+/**************************************************************************/
+size_t TR064LogBuffer::write(uint8_t c) {
+    if (_size == 0) return 0;
+    if (_len == _size) {
+        char dropped;
+        do {
+            dropped = _buffer[_start];
+            _start = (_start + 1) % _size;
+            --_len;
+        } while (_len > 0 && dropped != '\n');
+        ++_dropped;
+    }
+    _buffer[(_start + _len) % _size] = (char) c;
+    ++_len;
+    return 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Removes the oldest byte from the buffer.
+    @return The byte, -1 if the buffer is empty.
+*/
+/**************************************************************************/
+int TR064LogBuffer::read() {
+    if (_len == 0) return -1;
+    uint8_t c = (uint8_t) _buffer[_start];
+    _start = (_start + 1) % _size;
+    --_len;
+    return c;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Moves buffered messages to another output.
+    @param    out
+                Where to write to, e.g. `Serial`.
+    @param    max
+                At most that many bytes, e.g. `Serial.availableForWrite()`
+                so that the call does not block.
+    @return The number of bytes written.
+*/
+/**************************************************************************/
+size_t TR064LogBuffer::printTo(Print& out, size_t max) {
+    size_t total = 0;
+    while (_len > 0 && total < max) {
+        // The contiguous part up to the end of the buffer
+        size_t n = _size - _start;
+        if (n > _len) n = _len;
+        if (n > max - total) n = max - total;
+        size_t written = out.write((const uint8_t*) _buffer + _start, n);
+        _start = (_start + written) % _size;
+        _len -= written;
+        total += written;
+        if (written < n) break;
+    }
+    return total;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Drops all buffered messages and resets `dropped()`.
+*/
+/**************************************************************************/
+void TR064LogBuffer::clear() {
+    _start = 0;
+    _len = 0;
+    _dropped = 0;
+}
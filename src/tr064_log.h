@@ -0,0 +1,73 @@
+/*!
+ * @file tr064_log.h
+ *
+ * Debug messages of the library. `TR064_LOG()` formats a message printf
+ * style into a buffer on the stack, and only if its level is enabled, both
+ * at build time (`TR064_LOG_LEVEL`, e.g. `-DTR064_LOG_LEVEL=1` keeps only
+ * the errors and removes all other messages from the binary) and at run
+ * time (`TR064::debug_level`). The arguments are not evaluated otherwise.
+ * The messages go to `Serial` or any other `Print`, e.g. a
+ * `TR064LogBuffer` in RAM, see `TR064::setLogOutput()`.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_log_h
+#define tr064_log_h
+
+#include "Arduino.h"
+
+#ifndef TR064_LOG_LEVEL
+#define TR064_LOG_LEVEL     4 ///< Highest level compiled in: 0 none, 1 errors, 2 warnings, 3 info, 4 verbose (see `TR064::LoggingLevels`)
+#endif
+#ifndef TR064_LOG_BUFFER
+#define TR064_LOG_BUFFER    192 ///< Longest message (including terminator), longer ones are truncated with "..."
+#endif
+
+/// Whether messages of `level` are written by the `TR064` object `tr064`.
+#define TR064_LOG_ENABLED_AT(tr064, level) \
+    ((level) <= TR064_LOG_LEVEL && (tr064).debug_level >= (level) && (tr064)._log)
+
+/// Writes a message (printf style, the format is kept in flash) of the `TR064` object `tr064`.
+#define TR064_LOG_AT(tr064, level, format, ...) \
+    do { \
+        if (TR064_LOG_ENABLED_AT(tr064, level)) (tr064).logLine(PSTR(format), ##__VA_ARGS__); \
+    } while (0)
+
+/// `TR064_LOG_ENABLED_AT()` within the members of `TR064`.
+#define TR064_LOG_ENABLED(level) TR064_LOG_ENABLED_AT(*this, level)
+
+/// `TR064_LOG_AT()` within the members of `TR064`.
+#define TR064_LOG(level, format, ...) TR064_LOG_AT(*this, level, format, ##__VA_ARGS__)
+
+/**************************************************************************/
+/*!
+    @brief  Ring buffer of log messages in RAM, a `Print` for
+            `TR064::setLogOutput()`. Writing never blocks: when the buffer
+            is full, the oldest messages are dropped. The sketch forwards
+            the messages when it has time, e.g. in `loop()`:
+            `logs.printTo(Serial, Serial.availableForWrite())`.
+*/
+/**************************************************************************/
+class TR064LogBuffer : public Print {
+    public:
+        TR064LogBuffer(char* buffer, size_t size);
+        size_t write(uint8_t c) override;
+        using Print::write;
+
+        size_t available() const { return _len; }
+        int read();
+        size_t printTo(Print& out, size_t max = (size_t) -1);
+        void clear();
+        uint32_t dropped() const { return _dropped; }
+
+    private:
+        char* _buffer;
+        size_t _size;
+        size_t _start;      // Oldest byte
+        size_t _len;        // Bytes in the buffer
+        uint32_t _dropped;  // Messages dropped because the buffer was full
+};
+
+#endif
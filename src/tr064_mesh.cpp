@@ -0,0 +1,287 @@
+/*!
+ * @file tr064_mesh.cpp
+ *
+ * Several TR-064 devices as one.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_mesh.h"
+#include "tr064.h"
+
+/**************************************************************************/
+/*!
+    @brief  Creates a mesh without endpoints.
+*/
+/**************************************************************************/
+TR064Mesh::TR064Mesh() : _count(0) {
+}
+
+/**************************************************************************/
+/*!
+    @brief  Adds an endpoint. Its server and credentials have to be set
+            (see `TR064::setServer()`); other settings (transport, storage,
+            metrics, ...) stay those of the endpoint.
+    @param    endpoint
+                The client of the device. It must outlive this object.
+    @return The index of the endpoint or -1 if `TR064_MESH_ENDPOINTS` are
+            already added.
+*/
+/**************************************************************************/
+int TR064Mesh::add(TR064& endpoint) {
+    if (_count >= TR064_MESH_ENDPOINTS) {
+        return -1;
+    }
+    Endpoint& e = _endpoints[_count];
+    e.tr064 = &endpoint;
+    memset(&e.stats, 0, sizeof(e.stats));
+    return _count++;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Initializes all endpoints (see `TR064::init()`), one after the
+            other. An endpoint whose services turn out to be identical to
+            those of an earlier endpoint releases its copy and uses the
+            services of the earlier one. Services loaded from a storage
+            without checking them (`TR064_STORAGE_TRUST`) are not shared,
+            as they may be read again later, nor are services kept in a
+            fixed buffer (`TR064Static`).
+    @return The number of endpoints whose services were loaded.
+*/
+/**************************************************************************/
+uint8_t TR064Mesh::init() {
+    // Reading the services of an owner again must not leave others pointing to the old ones
+    for (uint8_t i = 0; i < _count; ++i) {
+        TR064& t = *_endpoints[i].tr064;
+        if (t._services.shared()) {
+            t._services.clear();
+            t._state = TR064_NO_SERVICES;
+        }
+    }
+    uint8_t loaded = 0;
+    for (uint8_t i = 0; i < _count; ++i) {
+        TR064& t = *_endpoints[i].tr064;
+        t.init();
+        if (t.state() < TR064_SERVICES_LOADED) {
+            TR064_LOG_AT(t, TR064::DEBUG_ERROR, "[TR064][mesh]<Error> Endpoint %u (%s) has no services", (unsigned) i, t._ip.c_str());
+            continue;
+        }
+        ++loaded;
+        if (t._servicesUnverified || t._services.fixed()) {
+            continue;
+        }
+        for (uint8_t j = 0; j < i; ++j) {
+            TR064& owner = *_endpoints[j].tr064;
+            if (owner.state() >= TR064_SERVICES_LOADED && !owner._servicesUnverified && !owner._services.shared()
+                    && t._services.sameAs(owner._services)) {
+                TR064_LOG_AT(t, TR064::DEBUG_INFO, "[TR064][mesh] Endpoint %u (%s) shares the services of endpoint %u",
+                             (unsigned) i, t._ip.c_str(), (unsigned) j);
+                t.clearDescriptions();
+                t._services.share(owner._services);
+                break;
+            }
+        }
+    }
+    return loaded;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Calls an action on every endpoint that offers the service.
+    @param    service
+                The name of the service. A trailing `*` matches all
+                instances, e.g. `WLANConfiguration:*` calls the action of
+                `WLANConfiguration:1`, `WLANConfiguration:2` etc.
+    @param    action
+                The action to call.
+    @param    params
+                A list of pairs of input parameters and values, the same
+                for all calls.
+    @param    nParam
+                The number of input parameters.
+    @param    outputs
+                The bindings of the output parameters, filled in anew by
+                each call.
+    @param    nOutputs
+                The number of output parameters.
+    @param    callback
+                Called after each successful call, with the outputs of
+                that endpoint.
+    @param    context
+                Passed to the callback.
+    @return The number of successful calls.
+*/
+/**************************************************************************/
+int TR064Mesh::each(const char* service, const char* action, String params[][2], int nParam,
+                    TR064Output* outputs, int nOutputs, TR064MeshCallback callback, void* context) {
+    service = TR064ServiceRegistry::stripPrefix(service);
+    size_t len = strlen(service);
+    bool instances = len > 0 && service[len - 1] == '*';
+    int succeeded = 0;
+    for (uint8_t i = 0; i < _count; ++i) {
+        TR064& t = *_endpoints[i].tr064;
+        if (t.state() < TR064_SERVICES_LOADED) {
+            continue;
+        }
+        if (!instances) {
+            if (t._services.find(service) && call(i, service, action, params, nParam, outputs, nOutputs)) {
+                ++succeeded;
+                if (callback) callback(i, service, outputs, nOutputs, context);
+            }
+            continue;
+        }
+        for (uint16_t k = 0; k < t._services.size(); ++k) {
+            // Copied, a call may read the services again
+            char name[48];
+            const char* s = t._services[k].name;
+            if (strncasecmp(s, service, len - 1) != 0 || strlen(s) >= sizeof(name)) {
+                continue;
+            }
+            strcpy(name, s);
+            if (call(i, name, action, params, nParam, outputs, nOutputs)) {
+                ++succeeded;
+                if (callback) callback(i, name, outputs, nOutputs, context);
+            }
+        }
+    }
+    return succeeded;
+}
+
+/// Collects the results of `TR064Mesh::locate()`, strongest signal first.
+struct TR064MeshLocator {
+    TR064MeshAssociation* results;
+    uint8_t max;
+    uint8_t stored;
+    int found;
+    TR064MeshAssociation current;   // Bound to the outputs
+};
+
+static void collectAssociation(uint8_t endpoint, const char* service, const TR064Output* outputs, int nOutputs, void* context) {
+    (void) nOutputs;
+    TR064MeshLocator& l = *(TR064MeshLocator*) context;
+    ++l.found;
+    TR064MeshAssociation a = l.current;
+    a.endpoint = endpoint;
+    const char* instance = strrchr(service, ':');
+    a.wlan = instance ? (uint8_t) atoi(instance + 1) : 0;
+    if (!outputs[0].ok()) a.ip[0] = '\0';
+    if (!outputs[1].ok()) a.speed = 0;
+    if (!outputs[2].ok()) a.signal = 0;
+    uint8_t pos = l.stored;
+    while (pos > 0 && l.results[pos - 1].signal < a.signal) --pos;
+    if (pos >= l.max) {
+        return;
+    }
+    uint8_t last = l.stored < l.max ? l.stored : l.max - 1;
+    for (uint8_t i = last; i > pos; --i) {
+        l.results[i] = l.results[i - 1];
+    }
+    l.results[pos] = a;
+    if (l.stored < l.max) ++l.stored;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Looks for a device in the WLANs of all endpoints
+            (`GetSpecificAssociatedDeviceInfo` of every
+            `WLANConfiguration` service). While roaming, a device may
+            briefly show up at more than one endpoint.
+    @param    mac
+                MAC address of the device, e.g. `AA:BB:CC:DD:EE:FF`.
+    @param    results
+                Receives the associations, strongest signal first.
+    @param    max
+                Size of `results`.
+    @return The number of associations found, which may be more than
+            `max`; 0 if the device is not associated anywhere.
+*/
+/**************************************************************************/
+int TR064Mesh::locate(const char* mac, TR064MeshAssociation* results, uint8_t max) {
+    TR064MeshLocator l;
+    l.results = results;
+    l.max = max;
+    l.stored = 0;
+    l.found = 0;
+    memset(&l.current, 0, sizeof(l.current));
+    String params[][2] = {{"NewAssociatedDeviceMACAddress", mac}};
+    TR064Output outputs[] = {
+        TR064Output::text("NewAssociatedDeviceIPAddress", l.current.ip, sizeof(l.current.ip)),
+        TR064Output::uint32("NewX_AVM-DE_Speed", &l.current.speed),
+        TR064Output::uint32("NewX_AVM-DE_SignalStrength", &l.current.signal),
+    };
+    each("WLANConfiguration:*", "GetSpecificAssociatedDeviceInfo", params, 1, outputs, 3, collectAssociation, &l);
+    return l.found;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the IP address (or host name) of an endpoint.
+*/
+/**************************************************************************/
+const char* TR064Mesh::host(uint8_t index) const {
+    return _endpoints[index].tr064->_ip.c_str();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the number of service registries kept by the endpoints,
+            i.e. the endpoints whose services are loaded and not shared.
+*/
+/**************************************************************************/
+uint8_t TR064Mesh::registries() const {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < _count; ++i) {
+        const TR064ServiceRegistry& services = _endpoints[i].tr064->_services;
+        if (services.size() > 0 && !services.shared()) ++n;
+    }
+    return n;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the number of heap bytes used by the service registries
+            of all endpoints (shared ones counted once).
+*/
+/**************************************************************************/
+size_t TR064Mesh::memoryUsage() const {
+    size_t total = 0;
+    for (uint8_t i = 0; i < _count; ++i) {
+        total += _endpoints[i].tr064->_services.memoryUsage();
+    }
+    return total;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Resets the requests and latencies of all endpoints.
+*/
+/**************************************************************************/
+void TR064Mesh::resetStats() {
+    for (uint8_t i = 0; i < _count; ++i) {
+        memset(&_endpoints[i].stats, 0, sizeof(_endpoints[i].stats));
+    }
+}
+
+/// Calls an action on one endpoint and records its latency.
+bool TR064Mesh::call(uint8_t index, const char* service, const char* action, String params[][2], int nParam,
+                     TR064Output* outputs, int nOutputs) {
+    TR064& t = *_endpoints[index].tr064;
+    TR064MeshStats& stats = _endpoints[index].stats;
+    unsigned long start = micros();
+    bool ok = t.action(service, action, params, nParam, outputs, nOutputs);
+    uint32_t us = (uint32_t) (micros() - start);
+    ++stats.requests;
+    if (!ok && t._fault == 0) {
+        ++stats.failures;
+        return false;
+    }
+    if (!ok) ++stats.faults;
+    bool first = stats.requests - stats.failures == 1;
+    stats.lastUs = us;
+    stats.totalUs += us;
+    if (first || us < stats.minUs) stats.minUs = us;
+    if (us > stats.maxUs) stats.maxUs = us;
+    return ok;
+}
@@ -0,0 +1,99 @@
+/*!
+ * @file tr064_mesh.h
+ *
+ * Several TR-064 devices as one, e.g. a FRITZ!Box mesh with its repeaters.
+ * Each endpoint is a `TR064` of the sketch, with its own connection and
+ * authentication session; endpoints of the same model share one service
+ * registry instead of keeping a copy each. A query is fanned out to all
+ * endpoints (`each()`, `locate()`), the results are merged, and the
+ * latency of every endpoint is tracked.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_mesh_h
+#define tr064_mesh_h
+
+#include "Arduino.h"
+#include "tr064_output.h"
+
+#ifndef TR064_MESH_ENDPOINTS
+#define TR064_MESH_ENDPOINTS        4 ///< Maximal number of endpoints of a `TR064Mesh`
+#endif
+
+class TR064;
+
+/// Requests and latency of one endpoint, see `TR064Mesh::stats()`.
+struct TR064MeshStats {
+    uint32_t requests;  ///< Requests sent by `each()` and `locate()`
+    uint32_t faults;    ///< Requests answered with an error (e.g. "no such entry")
+    uint32_t failures;  ///< Requests without a valid answer (connection, authentication)
+    uint32_t lastUs;    ///< Duration of the last answered request (us)
+    uint32_t minUs;     ///< Shortest answered request (us)
+    uint32_t maxUs;     ///< Longest answered request (us)
+    uint64_t totalUs;   ///< Sum of the durations of the answered requests (us)
+
+    /*!  @brief Mean duration of the answered requests (us), 0 if there were none. */
+    uint32_t averageUs() const {
+        uint32_t answered = requests - failures;
+        return answered ? (uint32_t) (totalUs / answered) : 0;
+    }
+};
+
+/// A WLAN association found by `TR064Mesh::locate()`.
+struct TR064MeshAssociation {
+    uint8_t endpoint;   ///< Index of the endpoint the device is associated with
+    uint8_t wlan;       ///< Instance of the `WLANConfiguration` service, e.g. 2 for `WLANConfiguration:2`
+    char ip[16];        ///< IPv4 address of the device (empty if unknown)
+    uint32_t speed;     ///< Link speed (Mbit/s), 0 if unknown
+    uint32_t signal;    ///< Signal strength (%), 0 if unknown
+};
+
+/// Called by `TR064Mesh::each()` for each successful call, with the endpoint, the service, the decoded outputs and the user context.
+typedef void (*TR064MeshCallback)(uint8_t endpoint, const char* service, const TR064Output* outputs, int nOutputs, void* context);
+
+/**************************************************************************/
+/*!
+    @brief  Fans out actions to the `TR064`s of several devices. The
+            endpoints are added with `add()` and initialized together with
+            `init()` (instead of calling their own `init()`), which lets
+            endpoints with identical services share the registry of the
+            first one. The requests are sent one endpoint after the other,
+            on the kept-alive connection of each.
+*/
+/**************************************************************************/
+class TR064Mesh {
+    public:
+        TR064Mesh();
+        int add(TR064& endpoint);
+        uint8_t init();
+        int each(const char* service, const char* action, String params[][2], int nParam,
+                 TR064Output* outputs, int nOutputs, TR064MeshCallback callback, void* context = nullptr);
+        int locate(const char* mac, TR064MeshAssociation* results, uint8_t max);
+
+        /*!  @brief Number of endpoints. */
+        uint8_t size() const { return _count; }
+        /*!  @brief The endpoint with the given index (0 to `size()`-1). */
+        TR064& operator[](uint8_t index) { return *_endpoints[index].tr064; }
+        const char* host(uint8_t index) const;
+        uint8_t registries() const;
+        size_t memoryUsage() const;
+        /*!  @brief Requests and latency of an endpoint. */
+        const TR064MeshStats& stats(uint8_t index) const { return _endpoints[index].stats; }
+        void resetStats();
+
+    private:
+        struct Endpoint {
+            TR064* tr064;
+            TR064MeshStats stats;
+        };
+
+        bool call(uint8_t index, const char* service, const char* action, String params[][2], int nParam,
+                  TR064Output* outputs, int nOutputs);
+
+        Endpoint _endpoints[TR064_MESH_ENDPOINTS];
+        uint8_t _count;
+};
+
+#endif
@@ -0,0 +1,198 @@
+/*!
+ * @file tr064_metrics.cpp
+ *
+ * Latency and error metrics of the actions of a `TR064` connection.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_metrics.h"
+
+/**************************************************************************/
+/*!
+    @brief  Upper bound (us) of a finite bucket.
+*/
+/**************************************************************************/
+uint32_t TR064Histogram::bound(uint8_t bucket) {
+    return (uint32_t) TR064_METRICS_BUCKET_BASE << bucket;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Adds a duration to the histogram.
+    @param    us
+                The duration in microseconds.
+*/
+/**************************************************************************/
+void TR064Histogram::observe(uint32_t us) {
+    uint8_t i = 0;
+    while (i < TR064_METRICS_BUCKETS && us > bound(i)) {
+        ++i;
+    }
+    ++buckets[i];
+    ++count;
+    sum += us;
+}
+
+TR064Metrics::TR064Metrics() {
+    reset();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Clears all metrics.
+*/
+/**************************************************************************/
+void TR064Metrics::reset() {
+    memset(&_data, 0, sizeof(_data));
+    strcpy(_data.actions[TR064_METRICS_ACTIONS].service, "other");
+    strcpy(_data.actions[TR064_METRICS_ACTIONS].action, "other");
+}
+
+/**************************************************************************/
+/*!
+    @brief  The metrics of a service/action, created on its first use. If
+            all slots are taken, the shared "other" slot.
+*/
+/**************************************************************************/
+TR064ActionMetrics* TR064Metrics::find(const char* service, const char* action) {
+    for (uint8_t i = 0; i < TR064_METRICS_ACTIONS; ++i) {
+        TR064ActionMetrics& a = _data.actions[i];
+        if (a.service[0] == '\0') {
+            snprintf(a.service, sizeof(a.service), "%s", service);
+            snprintf(a.action, sizeof(a.action), "%s", action);
+            return &a;
+        }
+        if (strncmp(a.service, service, sizeof(a.service) - 1) == 0
+                && strncmp(a.action, action, sizeof(a.action) - 1) == 0) {
+            return &a;
+        }
+    }
+    return &_data.actions[TR064_METRICS_ACTIONS];
+}
+
+/**************************************************************************/
+/*!
+    @brief  Adds the duration of a phase of a request of an action.
+    @param    action
+                See `find()`.
+    @param    phase
+                `TR064_METRICS_CONNECT`, `TR064_METRICS_FIRST_BYTE`,
+                `TR064_METRICS_RECEIVE` or `TR064_METRICS_PARSE`.
+    @param    us
+                The duration in microseconds.
+*/
+/**************************************************************************/
+void TR064Metrics::observe(TR064ActionMetrics* action, uint8_t phase, uint32_t us) {
+    if (action && phase < TR064_METRICS_PHASES) {
+        action->phases[phase].observe(us);
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Counts a finished call of an action.
+*/
+/**************************************************************************/
+void TR064Metrics::countCall(TR064ActionMetrics* action, bool ok) {
+    if (!action) return;
+    ++action->calls;
+    if (!ok) ++action->failures;
+}
+
+void TR064Metrics::count(TR064CodeCount* codes, int code) {
+    for (uint8_t i = 0; i < TR064_METRICS_CODES; ++i) {
+        if (codes[i].count == 0) {
+            codes[i].code = code;
+        }
+        if (codes[i].code == code) {
+            ++codes[i].count;
+            return;
+        }
+    }
+    ++_data.otherCodes;
+}
+
+/// Prints a duration in microseconds as seconds.
+static void printSeconds(Print& out, uint64_t us) {
+    out.printf("%lu.%06lu", (unsigned long) (us / 1000000u), (unsigned long) (us % 1000000u));
+}
+
+/// Prints the `# HELP` and `# TYPE` lines of a metric.
+static void printHeader(Print& out, const char* name, const char* type, const char* help) {
+    out.printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static const char* const phaseNames[TR064_METRICS_PHASES] = {"connect", "first_byte", "receive", "parse"};
+
+/**************************************************************************/
+/*!
+    @brief  Writes the metrics in the Prometheus text exposition format
+            (version 0.0.4), e.g. as the response to a scrape of
+            `/metrics` (`Content-Type: text/plain; version=0.0.4`).
+    @param    out
+                Where to write to, e.g. the `WiFiClient` of the request.
+*/
+/**************************************************************************/
+void TR064Metrics::writePrometheus(Print& out) const {
+    printHeader(out, "tr064_action_calls_total", "counter", "Calls of a TR-064 action.");
+    for (uint8_t i = 0; i <= TR064_METRICS_ACTIONS; ++i) {
+        const TR064ActionMetrics& a = _data.actions[i];
+        if (a.calls == 0) continue;
+        out.printf("tr064_action_calls_total{service=\"%s\",action=\"%s\"} %lu\n", a.service, a.action,
+                   (unsigned long) a.calls);
+    }
+    printHeader(out, "tr064_action_failures_total", "counter", "Failed calls of a TR-064 action.");
+    for (uint8_t i = 0; i <= TR064_METRICS_ACTIONS; ++i) {
+        const TR064ActionMetrics& a = _data.actions[i];
+        if (a.calls == 0) continue;
+        out.printf("tr064_action_failures_total{service=\"%s\",action=\"%s\"} %lu\n", a.service, a.action,
+                   (unsigned long) a.failures);
+    }
+    printHeader(out, "tr064_request_phase_seconds", "histogram", "Duration of a phase of the requests of a TR-064 action.");
+    for (uint8_t i = 0; i <= TR064_METRICS_ACTIONS; ++i) {
+        const TR064ActionMetrics& a = _data.actions[i];
+        for (uint8_t p = 0; p < TR064_METRICS_PHASES; ++p) {
+            const TR064Histogram& h = a.phases[p];
+            if (h.count == 0) continue;
+            uint32_t cumulative = 0;
+            for (uint8_t b = 0; b <= TR064_METRICS_BUCKETS; ++b) {
+                cumulative += h.buckets[b];
+                out.printf("tr064_request_phase_seconds_bucket{service=\"%s\",action=\"%s\",phase=\"%s\",le=\"",
+                           a.service, a.action, phaseNames[p]);
+                if (b < TR064_METRICS_BUCKETS) {
+                    printSeconds(out, TR064Histogram::bound(b));
+                } else {
+                    out.print("+Inf");
+                }
+                out.printf("\"} %lu\n", (unsigned long) cumulative);
+            }
+            out.printf("tr064_request_phase_seconds_sum{service=\"%s\",action=\"%s\",phase=\"%s\"} ", a.service,
+                       a.action, phaseNames[p]);
+            printSeconds(out, h.sum);
+            out.printf("\ntr064_request_phase_seconds_count{service=\"%s\",action=\"%s\",phase=\"%s\"} %lu\n",
+                       a.service, a.action, phaseNames[p], (unsigned long) h.count);
+        }
+    }
+    printHeader(out, "tr064_retries_total", "counter", "Requests repeated after a transport error.");
+    out.printf("tr064_retries_total %lu\n", (unsigned long) _data.retries);
+    printHeader(out, "tr064_auth_challenges_total", "counter", "Nonces requested from the device.");
+    out.printf("tr064_auth_challenges_total %lu\n", (unsigned long) _data.challenges);
+    printHeader(out, "tr064_auth_retries_total", "counter", "Requests repeated because the nonce was rejected.");
+    out.printf("tr064_auth_retries_total %lu\n", (unsigned long) _data.reauths);
+    printHeader(out, "tr064_delay_seconds_total", "counter", "Time spent waiting in delay().");
+    out.print("tr064_delay_seconds_total ");
+    printSeconds(out, (uint64_t) _data.delayMs * 1000u);
+    out.print("\n");
+    printHeader(out, "tr064_http_responses_total", "counter", "HTTP status codes (negative: transport errors).");
+    for (uint8_t i = 0; i < TR064_METRICS_CODES && _data.http[i].count > 0; ++i) {
+        out.printf("tr064_http_responses_total{code=\"%d\"} %lu\n", _data.http[i].code, (unsigned long) _data.http[i].count);
+    }
+    printHeader(out, "tr064_faults_total", "counter", "UPnP error codes of the faults returned by the device.");
+    for (uint8_t i = 0; i < TR064_METRICS_CODES && _data.faults[i].count > 0; ++i) {
+        out.printf("tr064_faults_total{code=\"%d\"} %lu\n", _data.faults[i].code, (unsigned long) _data.faults[i].count);
+    }
+    printHeader(out, "tr064_codes_dropped_total", "counter", "Codes not counted because all slots were taken.");
+    out.printf("tr064_codes_dropped_total %lu\n", (unsigned long) _data.otherCodes);
+}
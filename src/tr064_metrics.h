@@ -0,0 +1,114 @@
+/*!
+ * @file tr064_metrics.h
+ *
+ * Latency and error metrics of the actions of a `TR064` connection, see
+ * `TR064::setMetrics()`. For each service/action, the time of each phase of
+ * its requests (connecting, waiting for the first byte, receiving the rest,
+ * parsing) is sorted into histograms with fixed, logarithmic buckets;
+ * counters cover the retries, the authentication, the delays, the HTTP
+ * status codes and the TR-064 error codes. All of it lives in fixed-size
+ * arrays, nothing is allocated. The values can be read as a struct
+ * (`snapshot()`) or written in the Prometheus text format
+ * (`writePrometheus()`), e.g. for a `/metrics` page of the sketch.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_metrics_h
+#define tr064_metrics_h
+
+#include "Arduino.h"
+
+#ifndef TR064_METRICS_ACTIONS
+#define TR064_METRICS_ACTIONS       4 ///< Number of service/action pairs with their own histograms (more share one, "other")
+#endif
+#ifndef TR064_METRICS_CODES
+#define TR064_METRICS_CODES         8 ///< Number of distinct HTTP status and TR-064 error codes counted (each)
+#endif
+#ifndef TR064_METRICS_NAME
+#define TR064_METRICS_NAME          32 ///< Longest service or action name kept (including terminator)
+#endif
+
+#define TR064_METRICS_BUCKETS       15 ///< Finite buckets of a histogram, see `TR064_METRICS_BUCKET_BASE`
+#define TR064_METRICS_BUCKET_BASE   250 ///< Upper bound of the first bucket (us), each further one doubles it (up to 4.096 s)
+
+// Phases of a request
+#define TR064_METRICS_CONNECT       0 ///< Opening the connection (0 if a kept-alive one was reused)
+#define TR064_METRICS_FIRST_BYTE    1 ///< From sending the request to the first byte of the response
+#define TR064_METRICS_RECEIVE       2 ///< Waiting for the rest of the response
+#define TR064_METRICS_PARSE         3 ///< Extracting the outputs (without waiting for data)
+#define TR064_METRICS_PHASES        4
+
+/// Durations of one phase, in buckets of `TR064_METRICS_BUCKET_BASE` * 2^i microseconds.
+struct TR064Histogram {
+    uint32_t buckets[TR064_METRICS_BUCKETS + 1]; ///< Per bucket (not cumulative), the last one is unbounded
+    uint32_t count;         ///< Observations
+    uint64_t sum;           ///< Sum of all observations (us)
+
+    void observe(uint32_t us);
+    static uint32_t bound(uint8_t bucket);
+};
+
+/// Requests and histograms of one service/action.
+struct TR064ActionMetrics {
+    char service[TR064_METRICS_NAME];   ///< Empty if the slot is unused, "other" for the overflow
+    char action[TR064_METRICS_NAME];
+    uint32_t calls;         ///< Calls of the action
+    uint32_t failures;      ///< Calls that failed
+    TR064Histogram phases[TR064_METRICS_PHASES]; ///< Indexed by `TR064_METRICS_CONNECT` etc.
+};
+
+/// A code and how often it occurred.
+struct TR064CodeCount {
+    int code;
+    uint32_t count;
+};
+
+/**************************************************************************/
+/*!
+    @brief  All metrics, see `TR064Metrics::snapshot()`.
+*/
+/**************************************************************************/
+struct TR064MetricsSnapshot {
+    TR064ActionMetrics actions[TR064_METRICS_ACTIONS + 1]; ///< The last one collects all further actions
+    uint32_t retries;       ///< Requests repeated after a transport error
+    uint32_t challenges;    ///< Nonces requested (`InitChallenge`)
+    uint32_t reauths;       ///< Requests repeated because the nonce was rejected
+    uint32_t delayMs;       ///< Time spent in `delay()` by the library (ms)
+    TR064CodeCount http[TR064_METRICS_CODES];   ///< HTTP status codes (negative: `TR064_HTTP_ERROR_*`)
+    TR064CodeCount faults[TR064_METRICS_CODES]; ///< UPnP `errorCode`s of the faults
+    uint32_t otherCodes;    ///< Codes that did not fit into `http` or `faults`
+};
+
+/**************************************************************************/
+/*!
+    @brief  Collects the metrics of one or more `TR064` connections, see
+            `TR064::setMetrics()`. About 2 KB with the default sizes,
+            best a global variable.
+*/
+/**************************************************************************/
+class TR064Metrics {
+    public:
+        TR064Metrics();
+        void reset();
+        const TR064MetricsSnapshot& snapshot() const { return _data; }
+        void writePrometheus(Print& out) const;
+
+        TR064ActionMetrics* find(const char* service, const char* action);
+        void observe(TR064ActionMetrics* action, uint8_t phase, uint32_t us);
+        void countCall(TR064ActionMetrics* action, bool ok);
+        void countRetry() { ++_data.retries; }
+        void countChallenge() { ++_data.challenges; }
+        void countReauth() { ++_data.reauths; }
+        void countDelay(uint32_t ms) { _data.delayMs += ms; }
+        void countHttp(int code) { count(_data.http, code); }
+        void countFault(int code) { count(_data.faults, code); }
+
+    private:
+        void count(TR064CodeCount* codes, int code);
+
+        TR064MetricsSnapshot _data;
+};
+
+#endif
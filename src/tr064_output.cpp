@@ -0,0 +1,229 @@
+/*!
+ * @file tr064_output.cpp
+ *
+ * Typed output parameters of actions.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_output.h"
+#include "tr064_hosts.h"
+
+static TR064Output binding(const char* name, void* target, uint8_t type, uint16_t size) {
+    TR064Output out;
+    out.name = name;
+    out.target = target;
+    out.size = size;
+    out.type = type;
+    out.status = TR064_OUTPUT_MISSING;
+    return out;
+}
+
+/*!  @brief Binds a signed 32 bit integer. */
+TR064Output TR064Output::int32(const char* name, int32_t* target) {
+    return binding(name, target, INT32, 0);
+}
+
+/*!  @brief Binds an unsigned 32 bit integer. */
+TR064Output TR064Output::uint32(const char* name, uint32_t* target) {
+    return binding(name, target, UINT32, 0);
+}
+
+/*!  @brief Binds an unsigned 64 bit integer, e.g. the 64 bit byte counters of `WANCommonInterfaceConfig`. */
+TR064Output TR064Output::uint64(const char* name, uint64_t* target) {
+    return binding(name, target, UINT64, 0);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Binds a decimal number, stored as integer in units of
+            10^-`decimals`: with 2 decimals, `21.5` is stored as 2150.
+            Further fraction digits are cut off.
+*/
+/**************************************************************************/
+TR064Output TR064Output::fixed(const char* name, int32_t* target, uint8_t decimals) {
+    return binding(name, target, FIXED, decimals);
+}
+
+/*!  @brief Binds a boolean (`1`/`0`, `true`/`false`, `on`/`off`, `yes`/`no`, `enabled`/`disabled`). */
+TR064Output TR064Output::boolean(const char* name, bool* target) {
+    return binding(name, target, BOOL, 0);
+}
+
+/*!  @brief Binds a MAC address (`AA:BB:CC:DD:EE:FF`) to 6 bytes. */
+TR064Output TR064Output::mac(const char* name, uint8_t* target) {
+    return binding(name, target, MAC, 0);
+}
+
+/*!  @brief Binds a character buffer. Longer text is truncated (and flagged). */
+TR064Output TR064Output::text(const char* name, char* target, size_t size) {
+    return binding(name, target, TEXT, (uint16_t) (size < 0xFFFF ? size : 0xFFFF));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Prepares the decoder for the next response. The status of all
+            outputs is set to `TR064_OUTPUT_MISSING`.
+*/
+/**************************************************************************/
+void TR064OutputDecoder::begin(TR064Output* outputs, int nOutputs) {
+    _outputs = outputs;
+    _nOutputs = nOutputs;
+    for (int i = 0; i < nOutputs; ++i) {
+        outputs[i].status = TR064_OUTPUT_MISSING;
+    }
+}
+
+void TR064OutputDecoder::onStart(int key) {
+    (void) key;
+    _value = 0;
+    _len = 0;
+    _decimals = 0;
+    _negative = false;
+    _fraction = false;
+    _trailing = false;
+    _error = TR064_OUTPUT_OK;
+}
+
+void TR064OutputDecoder::onText(int key, const char* text, size_t len) {
+    TR064Output& out = _outputs[key];
+    if (out.type == TR064Output::TEXT) {
+        char* buf = (char*) out.target;
+        size_t n = len;
+        if (out.size == 0) {
+            _error = TR064_OUTPUT_TRUNCATED;
+            return;
+        }
+        if (n > (size_t) (out.size - 1 - _len)) {
+            n = out.size - 1 - _len;
+            _error = TR064_OUTPUT_TRUNCATED;
+        }
+        memcpy(buf + _len, text, n);
+        _len += (uint16_t) n;
+        return;
+    }
+    for (size_t i = 0; i < len && _error == TR064_OUTPUT_OK; ++i) {
+        char c = text[i];
+        bool space = c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        if (space) {
+            // Whitespace around the value is ignored
+            _trailing = _len > 0 || _negative;
+            continue;
+        }
+        if (_trailing) {
+            _error = TR064_OUTPUT_INVALID;
+        } else if (out.type == TR064Output::BOOL || out.type == TR064Output::MAC) {
+            if (_len < sizeof(_word) - 1) {
+                _word[_len++] = c;
+            } else {
+                _error = TR064_OUTPUT_INVALID;
+            }
+        } else {
+            digit(out, c);
+        }
+    }
+}
+
+bool TR064OutputDecoder::onEnd(int key) {
+    TR064Output& out = _outputs[key];
+    if (out.type == TR064Output::TEXT) {
+        if (out.size > 0) {
+            ((char*) out.target)[_len] = '\0';
+        }
+        out.status = _error;
+        return true;
+    }
+    if (_error == TR064_OUTPUT_OK && _len == 0) {
+        _error = TR064_OUTPUT_INVALID;
+    }
+    if (_error != TR064_OUTPUT_OK) {
+        out.status = _error;
+        return true;
+    }
+    switch (out.type) {
+    case TR064Output::INT32:
+    case TR064Output::FIXED:
+        if (out.type == TR064Output::FIXED) {
+            // Scale to the number of decimals
+            for (; _decimals < out.size; ++_decimals) {
+                if (_value > 0x80000000ull) break;
+                _value *= 10;
+            }
+        }
+        if (_decimals < out.size || _value > (_negative ? 0x80000000ull : 0x7FFFFFFFull)) {
+            out.status = TR064_OUTPUT_OVERFLOW;
+            return true;
+        }
+        *(int32_t*) out.target = _negative ? (int32_t) (0 - _value) : (int32_t) _value;
+        break;
+    case TR064Output::UINT32:
+        if (_negative || _value > 0xFFFFFFFFull) {
+            out.status = _negative ? TR064_OUTPUT_INVALID : TR064_OUTPUT_OVERFLOW;
+            return true;
+        }
+        *(uint32_t*) out.target = (uint32_t) _value;
+        break;
+    case TR064Output::UINT64:
+        if (_negative) {
+            out.status = TR064_OUTPUT_INVALID;
+            return true;
+        }
+        *(uint64_t*) out.target = _value;
+        break;
+    case TR064Output::BOOL: {
+        _word[_len] = '\0';
+        static const char* const yes[] = {"1", "true", "on", "yes", "enabled"};
+        static const char* const no[] = {"0", "false", "off", "no", "disabled"};
+        for (uint8_t i = 0; i < 5; ++i) {
+            if (strcasecmp(_word, yes[i]) == 0 || strcasecmp(_word, no[i]) == 0) {
+                *(bool*) out.target = strcasecmp(_word, yes[i]) == 0;
+                out.status = TR064_OUTPUT_OK;
+                return true;
+            }
+        }
+        out.status = TR064_OUTPUT_INVALID;
+        return true;
+    }
+    case TR064Output::MAC: {
+        // Parsed into a copy, as it may fail halfway
+        uint8_t mac[6];
+        _word[_len] = '\0';
+        if (!TR064HostTable::parseMac(_word, mac)) {
+            out.status = TR064_OUTPUT_INVALID;
+            return true;
+        }
+        memcpy(out.target, mac, sizeof(mac));
+        break;
+    }
+    }
+    out.status = TR064_OUTPUT_OK;
+    return true;
+}
+
+/// Decodes one character of a number.
+void TR064OutputDecoder::digit(TR064Output& out, char c) {
+    if (c == '-' && _len == 0 && !_negative && out.type != TR064Output::UINT64 && out.type != TR064Output::UINT32) {
+        _negative = true;
+        return;
+    }
+    if (c == '.' && out.type == TR064Output::FIXED && !_fraction) {
+        _fraction = true;
+        return;
+    }
+    if (c < '0' || c > '9') {
+        _error = TR064_OUTPUT_INVALID;
+        return;
+    }
+    ++_len;
+    if (_fraction) {
+        if (_decimals >= out.size) return; // Cut off
+        ++_decimals;
+    }
+    uint8_t d = (uint8_t) (c - '0');
+    if (_value > (0xFFFFFFFFFFFFFFFFull - d) / 10) {
+        _error = TR064_OUTPUT_OVERFLOW;
+        return;
+    }
+    _value = _value * 10 + d;
+}
@@ -0,0 +1,88 @@
+/*!
+ * @file tr064_output.h
+ *
+ * Typed output parameters of actions. Instead of a `String` per value, the
+ * caller binds each output to a variable (integer, 64 bit byte counter,
+ * fixed-point number, boolean, MAC address or character buffer); the value
+ * is decoded while the response is scanned, without intermediate copies.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_output_h
+#define tr064_output_h
+
+#include "Arduino.h"
+#include "tr064_xml.h"
+
+// Status of an output, see `TR064Output::status`
+#define TR064_OUTPUT_OK             0  ///< The value was decoded
+#define TR064_OUTPUT_MISSING        -1 ///< The response did not contain the element
+#define TR064_OUTPUT_INVALID        -2 ///< The text is not a value of the type
+#define TR064_OUTPUT_OVERFLOW       -3 ///< The value does not fit into the type
+#define TR064_OUTPUT_TRUNCATED      -4 ///< The text was cut to the size of the buffer
+
+/**************************************************************************/
+/*!
+    @brief  Binding of one output parameter of an action to a variable,
+            created with one of the static functions, e.g.
+            `TR064Output::int32("NewMultimeterPower", &power)`. The variable
+            is only written if the value could be decoded (text buffers are
+            always terminated).
+*/
+/**************************************************************************/
+struct TR064Output {
+    /// Type of the bound variable.
+    enum Type { INT32, UINT32, UINT64, FIXED, BOOL, MAC, TEXT };
+
+    const char* name;   ///< Name of the output parameter, e.g. `NewTotalBytesSent`
+    void* target;       ///< The bound variable
+    uint16_t size;      ///< Size of a text buffer, number of decimals of a fixed-point number
+    uint8_t type;       ///< The `Type`
+    int8_t status;      ///< `TR064_OUTPUT_OK` or the error of the last call
+
+    /*!  @brief Whether the value was decoded. */
+    bool ok() const { return status == TR064_OUTPUT_OK; }
+
+    static TR064Output int32(const char* name, int32_t* target);
+    static TR064Output uint32(const char* name, uint32_t* target);
+    static TR064Output uint64(const char* name, uint64_t* target);
+    static TR064Output fixed(const char* name, int32_t* target, uint8_t decimals);
+    static TR064Output boolean(const char* name, bool* target);
+    static TR064Output mac(const char* name, uint8_t* target);
+    static TR064Output text(const char* name, char* target, size_t size);
+};
+
+/**************************************************************************/
+/*!
+    @brief  Decodes the text of the elements bound by `TR064Output`s, as it
+            is scanned. Used as target of a `TR064ResponseHandler`.
+*/
+/**************************************************************************/
+class TR064OutputDecoder : public TR064XmlHandler {
+    public:
+        TR064OutputDecoder() : _outputs(nullptr), _nOutputs(0) {}
+        void begin(TR064Output* outputs, int nOutputs);
+
+        void onStart(int key) override;
+        void onText(int key, const char* text, size_t len) override;
+        bool onEnd(int key) override;
+
+    private:
+        void digit(TR064Output& out, char c);
+
+        TR064Output* _outputs;
+        int _nOutputs;
+        // State of the value being decoded
+        uint64_t _value;
+        uint16_t _len;          // Characters stored (text), digits read (numbers)
+        uint8_t _decimals;      // Fraction digits read (fixed-point)
+        bool _negative;
+        bool _fraction;         // After the decimal point
+        bool _trailing;         // After the value (only whitespace may follow)
+        int8_t _error;
+        char _word[18];         // Text of a boolean or MAC address
+};
+
+#endif
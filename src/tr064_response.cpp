@@ -0,0 +1,178 @@
+/*!
+ * @file tr064_response.cpp
+ *
+ * Handler for the SOAP responses of TR-064 actions.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_response.h"
+#include "tr064.h"
+
+static_assert(TR064_XML_MAX_KEYS <= 64, "The requested elements are tracked in a 64 bit mask");
+
+/**************************************************************************/
+/*!
+    @brief  Creates a handler without requested parameters, see `begin()`.
+*/
+/**************************************************************************/
+TR064ResponseHandler::TR064ResponseHandler(TR064& tr064) : _tr064(tr064) {
+    begin(nullptr, 0);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Creates a handler for one response.
+    @param    tr064
+                The client whose session receives the authentication elements.
+    @param    params
+                Array of {element name, value} pairs. The values are filled in.
+    @param    nParam
+                Number of elements in `params`.
+*/
+/**************************************************************************/
+TR064ResponseHandler::TR064ResponseHandler(TR064& tr064, String (*params)[2], int nParam) : _tr064(tr064) {
+    begin(params, nParam);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Prepares the handler for the next response.
+    @param    params
+                Array of {element name, value} pairs. The values are filled in.
+                It must stay valid until the response was read.
+    @param    nParam
+                Number of elements in `params`.
+*/
+/**************************************************************************/
+void TR064ResponseHandler::begin(String (*params)[2], int nParam) {
+    _params = params;
+    _target = nullptr;
+    _nParam = nParam;
+    _scratchLen = 0;
+    _errorCode.clear();
+    // Keys of the requested parameters are their index, followed by the internal ones
+    _keys.clear();
+    for (int i = 0; i < nParam; ++i) {
+        _keys.add(params[i][0].c_str());
+    }
+    addInternalKeys();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Prepares the handler for the next response, passing the
+            requested elements on to another handler.
+    @param    names
+                The names of the requested elements. Their index is the key
+                reported to `target`. Must stay valid until the response was read.
+    @param    nNames
+                Number of elements in `names`.
+    @param    target
+                Receives the events of the requested elements.
+*/
+/**************************************************************************/
+void TR064ResponseHandler::begin(const char* const* names, int nNames, TR064XmlHandler& target) {
+    _params = nullptr;
+    _target = &target;
+    _nParam = nNames;
+    _scratchLen = 0;
+    _errorCode.clear();
+    _keys.clear();
+    for (int i = 0; i < nNames; ++i) {
+        _keys.add(names[i]);
+    }
+    addInternalKeys();
+}
+
+void TR064ResponseHandler::addInternalKeys() {
+    _pending = 0;
+    for (int i = 0; i < _nParam; ++i) {
+        _pending |= (uint64_t) 1 << i;
+    }
+    _nonceKey = _keys.add("Nonce");
+    _realmKey = _keys.add("Realm");
+    _statusKey = _keys.add("Status");
+    _errorCodeKey = _keys.add("errorCode");
+    _errorDescriptionKey = _keys.add("errorDescription");
+}
+
+void TR064ResponseHandler::onStart(int key) {
+    if (key < _nParam && _target) {
+        _target->onStart(key);
+    } else if (key < _nParam) {
+        _params[key][1] = "";
+        _scratchLen = 0;
+    } else {
+        text(key)->clear();
+    }
+}
+
+void TR064ResponseHandler::onText(int key, const char* text, size_t len) {
+    if (key < _nParam && _target) {
+        _target->onText(key, text, len);
+        return;
+    }
+    if (key >= _nParam) {
+        this->text(key)->append(text, len);
+        return;
+    }
+    // Collect the value in the scratch buffer and append it in few, large pieces
+    while (len > 0) {
+        size_t n = sizeof(_scratch) - 1 - _scratchLen;
+        if (n > len) n = len;
+        memcpy(_scratch + _scratchLen, text, n);
+        _scratchLen += n;
+        text += n;
+        len -= n;
+        if (_scratchLen == sizeof(_scratch) - 1) flush(key);
+    }
+}
+
+bool TR064ResponseHandler::onEnd(int key) {
+    if (key < _nParam) {
+        bool more = true;
+        if (_target) {
+            more = _target->onEnd(key);
+        } else {
+            flush(key);
+            TR064_LOG_AT(_tr064, TR064::DEBUG_VERBOSE, "[TR064][action] found requestparameter: %s = %s", _params[key][0].c_str(),
+                         _params[key][1].c_str());
+        }
+        // The authentication elements are in the header, before the outputs: the rest can be skipped
+        _pending &= ~((uint64_t) 1 << key);
+        return more && _pending != 0;
+    } else if (key == _nonceKey) {
+        _tr064._session.setNonce(_nonce.text);
+        TR064_LOG_AT(_tr064, TR064::DEBUG_INFO, "[TR064][xmlTakeParam] Extracted the nonce '%s' from the last response.", _nonce.text);
+    } else if (key == _realmKey) {
+        // Now we have everything to generate our hashed secret.
+        _tr064._session.setRealm(_realm.text, _tr064._user.c_str(), _tr064._pass.c_str());
+    } else if (key == _statusKey) {
+        _tr064._session.setStatus(_status.text);
+        TR064_LOG_AT(_tr064, TR064::DEBUG_INFO, "[TR064][xmlTakeParam] Response status: %s", _status.text);
+    } else if (key == _errorCodeKey) {
+        TR064_LOG_AT(_tr064, TR064::DEBUG_VERBOSE, "[TR064][xmlTakeParam] <TR064> Failed, errorCode: '%s'", _errorCode.text);
+        TR064_LOG_AT(_tr064, TR064::DEBUG_VERBOSE, "[TR064][xmlTakeParam] <TR064> Failed, message: '%s'",
+                     TR064::errorToString(atoi(_errorCode.text)).c_str());
+    } else if (key == _errorDescriptionKey) {
+        TR064_LOG_AT(_tr064, TR064::DEBUG_VERBOSE, "[TR064][xmlTakeParam] <TR064> Failed, errorDescription: %s", _errorDescription.text);
+    }
+    return true;
+}
+
+void TR064ResponseHandler::flush(int key) {
+    if (_scratchLen == 0) return;
+    _scratch[_scratchLen] = '\0';
+    _params[key][1] += _scratch;
+    _scratchLen = 0;
+}
+
+TR064XmlText<64>* TR064ResponseHandler::text(int key) {
+    if (key == _nonceKey) return &_nonce;
+    if (key == _realmKey) return &_realm;
+    if (key == _statusKey) return &_status;
+    if (key == _errorCodeKey) return &_errorCode;
+    return &_errorDescription;
+}
@@ -0,0 +1,64 @@
+/*!
+ * @file tr064_response.h
+ *
+ * Handler for the SOAP responses of TR-064 actions: collects the requested
+ * output parameters and feeds the authentication elements (`Nonce`,
+ * `Realm`, `Status`) into the session of a `TR064`.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_response_h
+#define tr064_response_h
+
+#include "Arduino.h"
+#include "tr064_xml.h"
+
+class TR064;
+
+/**************************************************************************/
+/*!
+    @brief  Collects the requested output parameters and the authentication
+            elements (`Nonce`, `Realm`, `Status`) and faults of a SOAP
+            response, see `TR064::xmlTakeParam()`. Can be reused for
+            several responses, see `begin()`. The requested elements are
+            either stored in `String`s or passed on to another handler.
+            Once all of them were read, the scan stops
+            (`TR064_XML_STOPPED`) and the rest of the body is left to
+            `TR064HttpClient::end()`.
+*/
+/**************************************************************************/
+class TR064ResponseHandler : public TR064XmlHandler {
+    public:
+        explicit TR064ResponseHandler(TR064& tr064);
+        TR064ResponseHandler(TR064& tr064, String (*params)[2], int nParam);
+        void begin(String (*params)[2], int nParam);
+        void begin(const char* const* names, int nNames, TR064XmlHandler& target);
+        /*!  @brief The `errorCode` of a fault response, 0 if there was none. */
+        int errorCode() const { return atoi(_errorCode.text); }
+
+        const TR064XmlKeys& keys() const { return _keys; }
+
+        void onStart(int key) override;
+        void onText(int key, const char* text, size_t len) override;
+        bool onEnd(int key) override;
+
+    private:
+        void addInternalKeys();
+        void flush(int key);
+        TR064XmlText<64>* text(int key);
+
+        TR064& _tr064;
+        String (*_params)[2];
+        TR064XmlHandler* _target;  // Receives the requested elements instead of `_params`
+        int _nParam;
+        uint64_t _pending;         // Requested elements not read yet, the scan stops when none is left
+        TR064XmlKeys _keys;
+        int _nonceKey, _realmKey, _statusKey, _errorCodeKey, _errorDescriptionKey;
+        char _scratch[64];
+        size_t _scratchLen;
+        TR064XmlText<64> _nonce, _realm, _status, _errorCode, _errorDescription;
+};
+
+#endif
@@ -0,0 +1,438 @@
+/*!
+ * @file tr064_scheduler.cpp
+ *
+ * Periodic polling of TR-064 actions without `delay()`.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_scheduler.h"
+#include "tr064.h"
+
+/**************************************************************************/
+/*!
+    @brief  Creates a scheduler without jobs, with the default request
+            budget (`TR064_SCHEDULER_RATE`, `TR064_SCHEDULER_BURST`) and
+            jitter (`TR064_SCHEDULER_JITTER`).
+    @param    tr064
+                The client whose connection is used. It must outlive this
+                object.
+*/
+/**************************************************************************/
+TR064Scheduler::TR064Scheduler(TR064& tr064)
+    : _tr064(tr064), _async(tr064), _nHeap(0), _handle(0), _leader(-1), _rate(TR064_SCHEDULER_RATE),
+      _burst(TR064_SCHEDULER_BURST), _jitter(TR064_SCHEDULER_JITTER), _tokens(TR064_SCHEDULER_BURST * 1000u),
+      _refilled(millis()), _throttled(false) {
+    for (int i = 0; i < TR064_SCHEDULER_JOBS; ++i) {
+        _jobs[i].service = nullptr;
+        _jobs[i].heap = -1;
+        _jobs[i].running = false;
+    }
+    _random = (uint32_t) micros() ^ (uint32_t) (uintptr_t) this;
+    if (_random == 0) _random = 1;
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Adds a job that calls an action periodically. The first run is
+            due within the jitter of the interval (immediately without
+            jitter).
+    @param    intervalMs
+                Time between two runs (ms), apart from the jitter.
+    @param    service
+                The name of the service.
+    @param    action
+                The action to call.
+    @param    params
+                A list of pairs of input parameters and values.
+    @param    nParam
+                The number of input parameters.
+    @param    req
+                A list of pairs of response parameters and values, the
+                values are filled in by each run.
+    @param    nReq
+                The number of response parameters.
+    @param    callback
+                Called after each run (optional).
+    @param    context
+                Passed to the callback.
+    @return A handle (> 0) of the job or a negative
+            `TR064_SCHEDULER_ERROR_*` code.
+*/
+/**************************************************************************/
+int TR064Scheduler::every(uint32_t intervalMs, const char* service, const char* action, String params[][2], int nParam,
+                          String (*req)[2], int nReq, TR064SchedulerCallback callback, void* context) {
+    if (intervalMs == 0 || nParam > TR064_SOAP_MAX_ARGS || nReq > TR064_XML_MAX_KEYS - 5) {
+        return TR064_SCHEDULER_ERROR_ARGS;
+    }
+    int slot = 0;
+    while (slot < TR064_SCHEDULER_JOBS && _jobs[slot].service) ++slot;
+    if (slot == TR064_SCHEDULER_JOBS) {
+        return TR064_SCHEDULER_ERROR_FULL;
+    }
+    Job& job = _jobs[slot];
+    job.service = service;
+    job.action = action;
+    job.params = params;
+    job.nParam = (int8_t) (nParam > 0 ? nParam : 0);
+    job.req = req;
+    job.nReq = (int8_t) (nReq > 0 ? nReq : 0);
+    job.callback = callback;
+    job.context = context;
+    job.interval = intervalMs;
+    job.failures = 0;
+    job.running = false;
+    // Jobs added together do not start together
+    int32_t offset = jitter(intervalMs);
+    job.deadline = millis() + (unsigned long) (offset < 0 ? -offset : offset);
+    push((uint8_t) slot);
+    return slot + 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Removes a job. If its request is in progress and no other job
+            shares it, the request is cancelled.
+    @return false if the handle is unknown.
+*/
+/**************************************************************************/
+bool TR064Scheduler::remove(int job) {
+    if (job <= 0 || job > TR064_SCHEDULER_JOBS || !_jobs[job - 1].service) {
+        return false;
+    }
+    Job& j = _jobs[job - 1];
+    if (j.heap >= 0) {
+        removeAt((uint8_t) j.heap);
+    }
+    if (j.running && _leader == job - 1) {
+        // The outputs of the request go to the arrays of this job
+        _async.cancel(_handle);
+        _handle = 0;
+        _leader = -1;
+        for (int i = 0; i < TR064_SCHEDULER_JOBS; ++i) {
+            if (_jobs[i].running && i != job - 1) {
+                _jobs[i].running = false;
+                _jobs[i].deadline = millis();
+                push((uint8_t) i);
+            }
+        }
+    }
+    j.running = false;
+    j.service = nullptr;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Makes a job due now, e.g. after a button was pressed. Still
+            subject to the request budget.
+    @return false if the handle is unknown or the job is running.
+*/
+/**************************************************************************/
+bool TR064Scheduler::runNow(int job) {
+    if (job <= 0 || job > TR064_SCHEDULER_JOBS || !_jobs[job - 1].service || _jobs[job - 1].heap < 0) {
+        return false;
+    }
+    Job& j = _jobs[job - 1];
+    j.deadline = millis();
+    siftUp((uint8_t) j.heap);
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sets the budget of requests sent to the device: a token bucket
+            refilled with `perSecond` requests per second, holding at most
+            `burst` requests.
+    @param    perSecond
+                Requests per second, 0 for no limit.
+    @param    burst
+                Requests that may be sent back-to-back (at least 1).
+    @return Reference to this object
+*/
+/**************************************************************************/
+TR064Scheduler& TR064Scheduler::setRate(uint16_t perSecond, uint8_t burst) {
+    _rate = perSecond;
+    _burst = burst > 0 ? burst : 1;
+    if (_tokens > _burst * 1000u) _tokens = _burst * 1000u;
+    return *this;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sets the jitter of the intervals: each run is due up to that
+            percentage of the interval earlier or later.
+    @param    percent
+                0 (no jitter) to 50.
+    @return Reference to this object
+*/
+/**************************************************************************/
+TR064Scheduler& TR064Scheduler::setJitter(uint8_t percent) {
+    _jitter = percent > 50 ? 50 : percent;
+    return *this;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Advances the request in progress and starts the next due job,
+            if the request budget allows; to be called from `loop()`. Never
+            waits for the device. Finished runs report to their callbacks.
+    @return Whether a request is in progress.
+*/
+/**************************************************************************/
+bool TR064Scheduler::poll() {
+    if (_handle > 0) {
+        _async.poll();
+        int result = _async.status(_handle);
+        if (result == TR064_ASYNC_PENDING) {
+            return true;
+        }
+        complete(result, millis());
+    }
+    unsigned long now = millis();
+    if (_nHeap == 0 || (long) (_jobs[_heap[0]].deadline - now) > 0) {
+        return busy();
+    }
+    if (start(now)) {
+        _async.poll();
+    }
+    return busy();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the time until the next job is due and the request
+            budget allows it (ms), e.g. to sleep that long. 0 if a request
+            is in progress or a job is due, `(unsigned long) -1` if there
+            are no jobs.
+*/
+/**************************************************************************/
+unsigned long TR064Scheduler::idle() const {
+    if (_handle > 0) return 0;
+    if (_nHeap == 0) return (unsigned long) -1;
+    unsigned long now = millis();
+    long due = (long) (_jobs[_heap[0]].deadline - now);
+    long wait = 0;
+    uint32_t elapsed = (uint32_t) (now - _refilled);
+    if (_rate > 0 && elapsed < 1000 && _tokens + elapsed * _rate < 1000) {
+        // The budget as `refill()` would compute it now
+        wait = (long) ((1000 - _tokens - elapsed * _rate + _rate - 1) / _rate);
+    }
+    if (due < wait) due = wait;
+    return due > 0 ? (unsigned long) due : 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the number of failed runs of a job in a row, which
+            stretches its interval (see `TR064_SCHEDULER_BACKOFF_MAX`).
+*/
+/**************************************************************************/
+uint8_t TR064Scheduler::failures(int job) const {
+    return job > 0 && job <= TR064_SCHEDULER_JOBS && _jobs[job - 1].service ? _jobs[job - 1].failures : 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Converts a negative return value of `every()`, or a result
+            passed to a callback, to a message.
+*/
+/**************************************************************************/
+const char* TR064Scheduler::errorToString(int error) {
+    switch (error) {
+    case TR064_SCHEDULER_ERROR_FULL:
+        return "too many jobs";
+    case TR064_SCHEDULER_ERROR_ARGS:
+        return "invalid arguments";
+    default:
+        return TR064Async::errorToString(error);
+    }
+}
+
+/// Starts the request of the earliest job, together with the jobs due soon that ask the same.
+bool TR064Scheduler::start(unsigned long now) {
+    refill(now);
+    if (_rate > 0 && _tokens < 1000) {
+        if (!_throttled) ++_stats.throttled;
+        _throttled = true;
+        return false;
+    }
+    _throttled = false;
+    uint8_t leader = _heap[0];
+    Job& lead = _jobs[leader];
+    uint32_t late = (uint32_t) (now - lead.deadline);
+    if (late > _stats.maxLateMs) _stats.maxLateMs = late;
+    removeAt(0);
+    lead.running = true;
+    _leader = (int8_t) leader;
+    for (int i = 0; i < TR064_SCHEDULER_JOBS; ++i) {
+        Job& j = _jobs[i];
+        if (j.heap >= 0 && (long) (j.deadline - now) <= TR064_SCHEDULER_COALESCE && sameRequest(lead, j)) {
+            removeAt((uint8_t) j.heap);
+            j.running = true;
+        }
+    }
+    _handle = _async.beginAction(lead.service, lead.action, lead.params, lead.nParam, lead.req, lead.nReq);
+    if (_handle <= 0) {
+        int error = _handle;
+        _handle = 0;
+        complete(error, now);
+        return false;
+    }
+    if (_rate > 0) _tokens -= 1000;
+    ++_stats.requests;
+    return true;
+}
+
+/// Passes the result of the request to the jobs that shared it and schedules their next runs.
+void TR064Scheduler::complete(int result, unsigned long now) {
+    _handle = 0;
+    int8_t leader = _leader;
+    _leader = -1;
+    bool ok = result == TR064_ASYNC_DONE;
+    if (!ok) {
+        TR064_LOG_AT(_tr064, TR064::DEBUG_WARNING, "[TR064][scheduler] %s %s failed: %s", _jobs[leader].service,
+                     _jobs[leader].action, TR064Async::errorToString(result));
+    }
+    // The outputs go to the others before any callback may remove the leader
+    for (int i = 0; ok && i < TR064_SCHEDULER_JOBS; ++i) {
+        Job& j = _jobs[i];
+        for (int k = 0; j.running && i != leader && k < j.nReq; ++k) {
+            for (int m = 0; m < _jobs[leader].nReq; ++m) {
+                if (_jobs[leader].req[m][0] == j.req[k][0]) {
+                    j.req[k][1] = _jobs[leader].req[m][1];
+                    break;
+                }
+            }
+        }
+    }
+    // The leader first
+    for (int n = 0; n < TR064_SCHEDULER_JOBS; ++n) {
+        int i = n == 0 ? leader : (n <= leader ? n - 1 : n);
+        Job& j = _jobs[i];
+        if (!j.running) {
+            continue;
+        }
+        j.running = false;
+        ++_stats.runs;
+        if (i != leader) ++_stats.coalesced;
+        if (!ok) ++_stats.failures;
+        reschedule(j, ok, now);
+        if (j.callback) j.callback(i + 1, result, j.context);
+    }
+}
+
+/// Schedules the next run of a job: one interval (plus jitter) after the last deadline, or later after failures.
+void TR064Scheduler::reschedule(Job& job, bool ok, unsigned long now) {
+    if (ok) {
+        job.failures = 0;
+        job.deadline += job.interval + jitter(job.interval);
+        if ((long) (job.deadline - now) < 0) {
+            // Far behind (e.g. throttled): no catching up
+            job.deadline = now + job.interval / 2;
+        }
+    } else {
+        if (job.failures < 0xFF) ++job.failures;
+        uint32_t limit = job.interval > TR064_SCHEDULER_BACKOFF_MAX ? job.interval : TR064_SCHEDULER_BACKOFF_MAX;
+        uint32_t delay = job.interval;
+        for (uint8_t i = 1; i < job.failures && delay < limit; ++i) {
+            delay = delay > limit / 2 ? limit : 2 * delay;
+        }
+        if (delay > limit) delay = limit;
+        job.deadline = now + delay + jitter(delay);
+        TR064_LOG_AT(_tr064, TR064::DEBUG_INFO, "[TR064][scheduler] %s %s: %u failures, next try in %lu ms", job.service,
+                     job.action, (unsigned) job.failures, (unsigned long) (job.deadline - now));
+    }
+    push((uint8_t) (&job - _jobs));
+}
+
+/// Whether a job can take the outputs of the request of `leader`: same action and inputs, outputs a subset.
+bool TR064Scheduler::sameRequest(const Job& leader, const Job& other) const {
+    if (strcasecmp(TR064ServiceRegistry::stripPrefix(leader.service), TR064ServiceRegistry::stripPrefix(other.service)) != 0
+            || strcmp(leader.action, other.action) != 0 || leader.nParam != other.nParam) {
+        return false;
+    }
+    for (int i = 0; i < other.nParam; ++i) {
+        if (leader.params[i][0] != other.params[i][0] || leader.params[i][1] != other.params[i][1]) return false;
+    }
+    for (int k = 0; k < other.nReq; ++k) {
+        int m = 0;
+        while (m < leader.nReq && leader.req[m][0] != other.req[k][0]) ++m;
+        if (m == leader.nReq) return false;
+    }
+    return true;
+}
+
+/// Adds the requests earned since the last refill to the budget.
+void TR064Scheduler::refill(unsigned long now) {
+    uint32_t elapsed = (uint32_t) (now - _refilled);
+    _refilled = now;
+    if (_rate == 0) return;
+    uint32_t full = _burst * 1000u;
+    if (elapsed >= full || elapsed * _rate >= full - _tokens) {
+        _tokens = full;
+    } else {
+        _tokens += elapsed * _rate;
+    }
+}
+
+/// Random offset of up to `_jitter` percent of an interval, either way.
+int32_t TR064Scheduler::jitter(uint32_t interval) {
+    uint32_t span = (uint32_t) ((uint64_t) interval * _jitter / 100);
+    if (span == 0) return 0;
+    // xorshift32
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+    return (int32_t) (_random % (2 * span + 1)) - (int32_t) span;
+}
+
+// Binary min-heap of the waiting jobs, by deadline (wrap-around safe)
+
+bool TR064Scheduler::before(uint8_t a, uint8_t b) const {
+    return (long) (_jobs[a].deadline - _jobs[b].deadline) < 0;
+}
+
+void TR064Scheduler::place(uint8_t pos, uint8_t slot) {
+    _heap[pos] = slot;
+    _jobs[slot].heap = (int8_t) pos;
+}
+
+void TR064Scheduler::push(uint8_t slot) {
+    place(_nHeap, slot);
+    siftUp(_nHeap++);
+}
+
+void TR064Scheduler::removeAt(uint8_t pos) {
+    _jobs[_heap[pos]].heap = -1;
+    if (--_nHeap == pos) return;
+    place(pos, _heap[_nHeap]);
+    siftUp(pos);
+    siftDown((uint8_t) _jobs[_heap[pos]].heap);
+}
+
+void TR064Scheduler::siftUp(uint8_t pos) {
+    uint8_t slot = _heap[pos];
+    while (pos > 0) {
+        uint8_t parent = (uint8_t) ((pos - 1) / 2);
+        if (!before(slot, _heap[parent])) break;
+        place(pos, _heap[parent]);
+        pos = parent;
+    }
+    place(pos, slot);
+}
+
+void TR064Scheduler::siftDown(uint8_t pos) {
+    uint8_t slot = _heap[pos];
+    while (true) {
+        uint8_t child = (uint8_t) (2 * pos + 1);
+        if (child >= _nHeap) break;
+        if (child + 1 < _nHeap && before(_heap[child + 1], _heap[child])) ++child;
+        if (!before(_heap[child], slot)) break;
+        place(pos, _heap[child]);
+        pos = child;
+    }
+    place(pos, slot);
+}
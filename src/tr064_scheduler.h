@@ -0,0 +1,136 @@
+/*!
+ * @file tr064_scheduler.h
+ *
+ * Periodic polling of TR-064 actions without `delay()`. The sketch
+ * registers jobs (action, arguments, interval, callback) with a
+ * `TR064Scheduler` and calls its `poll()` from `loop()`. The jobs are kept
+ * in a heap ordered by their deadlines; the intervals get some jitter so
+ * that jobs do not stay in lockstep, jobs asking the same at about the same
+ * time share one request, a token bucket limits the requests per second
+ * sent to the device, and a job that failed backs off exponentially.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_scheduler_h
+#define tr064_scheduler_h
+
+#include "Arduino.h"
+#include "tr064_async.h"
+
+#ifndef TR064_SCHEDULER_JOBS
+#define TR064_SCHEDULER_JOBS        8 ///< Maximal number of jobs of a `TR064Scheduler`
+#endif
+#ifndef TR064_SCHEDULER_RATE
+#define TR064_SCHEDULER_RATE        4 ///< Default budget of requests per second, see `TR064Scheduler::setRate()`
+#endif
+#ifndef TR064_SCHEDULER_BURST
+#define TR064_SCHEDULER_BURST       4 ///< Default number of requests that may be sent back-to-back
+#endif
+#ifndef TR064_SCHEDULER_JITTER
+#define TR064_SCHEDULER_JITTER      10 ///< Default jitter of the intervals (percent, either way)
+#endif
+#ifndef TR064_SCHEDULER_COALESCE
+#define TR064_SCHEDULER_COALESCE    250 ///< Jobs due within that many ms of a request asking the same share it
+#endif
+#ifndef TR064_SCHEDULER_BACKOFF_MAX
+#define TR064_SCHEDULER_BACKOFF_MAX 300000 ///< Longest delay of a failing job (ms), unless its interval is longer
+#endif
+
+// Negative return values of `TR064Scheduler::every()`
+#define TR064_SCHEDULER_ERROR_FULL  -1 ///< All `TR064_SCHEDULER_JOBS` slots are in use
+#define TR064_SCHEDULER_ERROR_ARGS  -2 ///< Too many parameters or an interval of 0
+
+class TR064;
+
+/// Counters of a `TR064Scheduler`, see `TR064Scheduler::stats()`.
+struct TR064SchedulerStats {
+    uint32_t requests;  ///< Requests sent
+    uint32_t runs;      ///< Runs of jobs (including the ones sharing a request)
+    uint32_t coalesced; ///< Runs that shared the request of another job
+    uint32_t throttled; ///< Times a due job had to wait for the request budget
+    uint32_t failures;  ///< Runs that failed (and made the job back off)
+    uint32_t maxLateMs; ///< Longest time a job was started after its deadline (ms)
+};
+
+/// Called after each run of a job, with its handle, the result (`TR064_ASYNC_DONE` or a `TR064_ASYNC_ERROR_*` code) and the user context. The outputs are in the `req` array of the job.
+typedef void (*TR064SchedulerCallback)(int job, int result, void* context);
+
+/**************************************************************************/
+/*!
+    @brief  Runs actions periodically on the connection of a `TR064`,
+            through a `TR064Async`: `poll()` never waits for the device,
+            and one request is in progress at a time. The names, parameter
+            and output arrays of a job are referenced, not copied, and must
+            stay valid while it is scheduled. Blocking calls of the `TR064`
+            must not be made while `busy()`.
+*/
+/**************************************************************************/
+class TR064Scheduler {
+    public:
+        explicit TR064Scheduler(TR064& tr064);
+
+        int every(uint32_t intervalMs, const char* service, const char* action, String params[][2], int nParam,
+                  String (*req)[2], int nReq, TR064SchedulerCallback callback, void* context = nullptr);
+        bool remove(int job);
+        bool runNow(int job);
+        TR064Scheduler& setRate(uint16_t perSecond, uint8_t burst = TR064_SCHEDULER_BURST);
+        TR064Scheduler& setJitter(uint8_t percent);
+        bool poll();
+        /*!  @brief Whether a request is in progress. */
+        bool busy() const { return _handle > 0; }
+        unsigned long idle() const;
+        uint8_t failures(int job) const;
+        const TR064SchedulerStats& stats() const { return _stats; }
+
+        static const char* errorToString(int error);
+
+    private:
+        struct Job {
+            const char* service;        // nullptr: slot is free
+            const char* action;
+            String (*params)[2];
+            String (*req)[2];
+            TR064SchedulerCallback callback;
+            void* context;
+            uint32_t interval;
+            unsigned long deadline;     // `millis()` at which the job is due
+            int8_t nParam;
+            int8_t nReq;
+            uint8_t failures;           // Failed runs in a row
+            int8_t heap;                // Position in `_heap`, -1 while running or free
+            bool running;               // Runs with the request in progress
+        };
+
+        bool start(unsigned long now);
+        void complete(int result, unsigned long now);
+        void reschedule(Job& job, bool ok, unsigned long now);
+        bool sameRequest(const Job& leader, const Job& other) const;
+        void refill(unsigned long now);
+        int32_t jitter(uint32_t interval);
+        bool before(uint8_t a, uint8_t b) const;
+        void push(uint8_t slot);
+        void removeAt(uint8_t pos);
+        void siftUp(uint8_t pos);
+        void siftDown(uint8_t pos);
+        void place(uint8_t pos, uint8_t slot);
+
+        TR064& _tr064;
+        TR064Async _async;
+        Job _jobs[TR064_SCHEDULER_JOBS];
+        uint8_t _heap[TR064_SCHEDULER_JOBS]; // Slots of the waiting jobs, earliest deadline first
+        uint8_t _nHeap;
+        int _handle;                    // Handle (in `_async`) of the request in progress, 0 if none
+        int8_t _leader;                 // Slot of the job whose request is in progress
+        uint16_t _rate;                 // Requests per second
+        uint8_t _burst;
+        uint8_t _jitter;                // Percent
+        uint32_t _tokens;               // Request budget, in 1/1000 requests
+        unsigned long _refilled;        // `millis()` of the last refill
+        bool _throttled;                // The earliest job waits for the budget
+        uint32_t _random;               // State of the jitter generator (xorshift)
+        TR064SchedulerStats _stats;
+};
+
+#endif
@@ -0,0 +1,419 @@
+/*!
+ * @file tr064_scpd.cpp
+ *
+ * Index of the actions of a service, compiled from its SCPD.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_scpd.h"
+#include "tr064_services.h"
+#include "tr064_xml.h"
+
+static const char* const typeNames[] = {"string", "boolean", "ui1", "ui2", "ui4", "ui8",
+                                        "i1", "i2", "i4", "i8", "dateTime", "uuid"};
+
+/**************************************************************************/
+/*!
+    @brief  Adds the actions (`<action>`), their arguments (`<argument>`)
+            and the types of the state variables (`<stateVariable>`) of an
+            SCPD to a `TR064ServiceDescription`.
+*/
+/**************************************************************************/
+class TR064ScpdHandler : public TR064XmlHandler {
+    public:
+        explicit TR064ScpdHandler(TR064ServiceDescription& description)
+            : _description(description), _context(NONE), _failed(false) {
+            _actionKey = _keys.add("action");
+            _argumentKey = _keys.add("argument");
+            _variableKey = _keys.add("stateVariable");
+            _nameKey = _keys.add("name");
+            _directionKey = _keys.add("direction");
+            _relatedKey = _keys.add("relatedStateVariable");
+            _typeKey = _keys.add("dataType");
+        }
+
+        const TR064XmlKeys& keys() const { return _keys; }
+        bool failed() const { return _failed; }
+
+        void onStart(int key) override {
+            if (key == _actionKey) {
+                _context = ACTION;
+            } else if (key == _argumentKey) {
+                _context = ARGUMENT;
+                _direction.clear();
+                _related.clear();
+            } else if (key == _variableKey) {
+                _context = VARIABLE;
+                _type.clear();
+            } else if (key == _nameKey) {
+                _name.clear();
+            } else if (key == _directionKey) {
+                _direction.clear();
+            } else if (key == _relatedKey) {
+                _related.clear();
+            } else if (key == _typeKey) {
+                _type.clear();
+            }
+        }
+
+        void onText(int key, const char* text, size_t len) override {
+            if (key == _nameKey) {
+                _name.append(text, len);
+            } else if (key == _directionKey) {
+                _direction.append(text, len);
+            } else if (key == _relatedKey) {
+                _related.append(text, len);
+            } else if (key == _typeKey) {
+                _type.append(text, len);
+            }
+        }
+
+        bool onEnd(int key) override {
+            bool ok = true;
+            if (key == _nameKey && _context == ACTION) {
+                // The name of the action precedes its argument list
+                ok = _description.addAction(_name.text);
+            } else if (key == _argumentKey) {
+                uint8_t direction = strcmp(_direction.text, "in") == 0 ? TR064_ARG_IN : TR064_ARG_OUT;
+                ok = _description.addArgument(_name.text, direction, _related.text);
+                _context = ACTION;
+            } else if (key == _actionKey) {
+                _context = NONE;
+            } else if (key == _variableKey) {
+                ok = _description.addVariable(_name.text, TR064ServiceDescription::typeCode(_type.text));
+                _context = NONE;
+            }
+            _failed = _failed || !ok;
+            return ok;
+        }
+
+    private:
+        enum Context { NONE, ACTION, ARGUMENT, VARIABLE };
+
+        TR064ServiceDescription& _description;
+        TR064XmlKeys _keys;
+        int _actionKey, _argumentKey, _variableKey, _nameKey, _directionKey, _relatedKey, _typeKey;
+        Context _context;
+        bool _failed;
+        TR064XmlText<64> _name;
+        TR064XmlText<4> _direction;
+        TR064XmlText<64> _related;
+        TR064XmlText<12> _type;
+};
+
+TR064ServiceDescription::TR064ServiceDescription() {
+    _arena = nullptr;
+    _arenaLen = 0;
+    _arenaCap = 0;
+    _actions = nullptr;
+    _nActions = 0;
+    _actionCap = 0;
+    _args = nullptr;
+    _nArgs = 0;
+    _argCap = 0;
+    _vars = nullptr;
+    _nVars = 0;
+    _varCap = 0;
+    _argVars = nullptr;
+}
+
+TR064ServiceDescription::~TR064ServiceDescription() {
+    clear();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Removes all actions and releases the memory.
+*/
+/**************************************************************************/
+void TR064ServiceDescription::clear() {
+    free(_arena);
+    free(_actions);
+    free(_args);
+    free(_vars);
+    free(_argVars);
+    _arena = nullptr;
+    _arenaLen = 0;
+    _arenaCap = 0;
+    _actions = nullptr;
+    _nActions = 0;
+    _actionCap = 0;
+    _args = nullptr;
+    _nArgs = 0;
+    _argCap = 0;
+    _vars = nullptr;
+    _nVars = 0;
+    _varCap = 0;
+    _argVars = nullptr;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Replaces the content by the actions of an SCPD, read in chunks
+            from `source`.
+    @return `TR064_XML_END` on success, `TR064_XML_STOPPED` if memory ran
+            out or the negative error of the source.
+*/
+/**************************************************************************/
+int TR064ServiceDescription::parse(TR064ByteSource& source) {
+    clear();
+    TR064ScpdHandler handler(*this);
+    TR064XmlTokenizer tokenizer(handler.keys(), handler);
+    int result = tokenizer.scan(source);
+    finish();
+    return result;
+}
+
+template<typename T>
+static void swapValues(T& a, T& b) {
+    T tmp = a;
+    a = b;
+    b = tmp;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Exchanges the content of two descriptions, e.g. to replace one
+            only after the new one was read completely.
+*/
+/**************************************************************************/
+void TR064ServiceDescription::swap(TR064ServiceDescription& other) {
+    swapValues(_arena, other._arena);
+    swapValues(_arenaLen, other._arenaLen);
+    swapValues(_arenaCap, other._arenaCap);
+    swapValues(_actions, other._actions);
+    swapValues(_nActions, other._nActions);
+    swapValues(_actionCap, other._actionCap);
+    swapValues(_args, other._args);
+    swapValues(_nArgs, other._nArgs);
+    swapValues(_argCap, other._argCap);
+    swapValues(_vars, other._vars);
+    swapValues(_nVars, other._nVars);
+    swapValues(_varCap, other._varCap);
+    swapValues(_argVars, other._argVars);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the name of an action (0 to `actions()`-1).
+*/
+/**************************************************************************/
+const char* TR064ServiceDescription::actionName(uint16_t action) const {
+    return _arena + _actions[action].name;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Looks up an action by its name (case-insensitive).
+    @return The index of the action or -1 if the service has no such action.
+*/
+/**************************************************************************/
+int TR064ServiceDescription::findAction(const char* name) const {
+    uint32_t hash = tr064Hash(name, strlen(name));
+    for (uint16_t i = 0; i < _nActions; ++i) {
+        if (_actions[i].hash == hash && strcasecmp(_arena + _actions[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the number of arguments of an action.
+*/
+/**************************************************************************/
+uint8_t TR064ServiceDescription::arguments(uint16_t action) const {
+    return _actions[action].nArgs;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns an argument of an action (0 to `arguments()`-1), in the
+            order of the SCPD.
+*/
+/**************************************************************************/
+TR064ArgDescriptor TR064ServiceDescription::argument(uint16_t action, uint8_t index) const {
+    const Argument& a = _args[_actions[action].firstArg + index];
+    TR064ArgDescriptor d;
+    d.name = _arena + a.name;
+    d.direction = a.direction;
+    d.type = a.type;
+    return d;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Looks up an argument of an action by its name and direction.
+    @param    action
+                Index of the action.
+    @param    name
+                Name of the argument (case-sensitive, like on the device).
+    @param    direction
+                `TR064_ARG_IN` or `TR064_ARG_OUT`.
+    @return The index of the argument or -1 if the action has no such argument.
+*/
+/**************************************************************************/
+int TR064ServiceDescription::findArgument(uint16_t action, const char* name, uint8_t direction) const {
+    const Action& a = _actions[action];
+    for (uint8_t i = 0; i < a.nArgs; ++i) {
+        const Argument& arg = _args[a.firstArg + i];
+        if (arg.direction == direction && strcmp(_arena + arg.name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the number of heap bytes used by the description.
+*/
+/**************************************************************************/
+size_t TR064ServiceDescription::memoryUsage() const {
+    return _arenaCap + _actionCap * sizeof(Action) + _argCap * sizeof(Argument);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the `TR064_TYPE_*` code of an SCPD `dataType`; types
+            without a code of their own (e.g. `bin.base64`) are strings.
+*/
+/**************************************************************************/
+uint8_t TR064ServiceDescription::typeCode(const char* dataType) {
+    for (uint8_t i = 0; i < sizeof(typeNames) / sizeof(typeNames[0]); ++i) {
+        if (strcmp(dataType, typeNames[i]) == 0) return i;
+    }
+    return TR064_TYPE_STRING;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the SCPD `dataType` of a `TR064_TYPE_*` code.
+*/
+/**************************************************************************/
+const char* TR064ServiceDescription::typeName(uint8_t type) {
+    return type < sizeof(typeNames) / sizeof(typeNames[0]) ? typeNames[type] : typeNames[TR064_TYPE_STRING];
+}
+
+// ----------------------------
+// ----- Helper-functions -----
+// ----------------------------
+
+/// Doubles the capacity of an array if it is full. @return false if out of memory.
+template<typename T>
+bool TR064ServiceDescription::grow(T*& array, uint16_t count, uint16_t& capacity) {
+    if (count < capacity) return true;
+    if (capacity >= 0x8000) return false;
+    uint16_t cap = capacity ? 2 * capacity : 16;
+    T* grown = (T*) realloc(array, cap * sizeof(T));
+    if (!grown) return false;
+    array = grown;
+    capacity = cap;
+    return true;
+}
+
+bool TR064ServiceDescription::addAction(const char* name) {
+    if (!grow(_actions, _nActions, _actionCap)) return false;
+    int offset = intern(name);
+    if (offset < 0) return false;
+    Action& a = _actions[_nActions++];
+    a.hash = tr064Hash(name, strlen(name));
+    a.name = (uint16_t) offset;
+    a.firstArg = _nArgs;
+    a.nArgs = 0;
+    return true;
+}
+
+bool TR064ServiceDescription::addArgument(const char* name, uint8_t direction, const char* variable) {
+    if (_nActions == 0 || _actions[_nActions - 1].nArgs == 0xFF) return false;
+    uint16_t cap = _argCap;
+    if (!grow(_args, _nArgs, _argCap)) return false;
+    if (_argCap != cap) {
+        uint32_t* vars = (uint32_t*) realloc(_argVars, _argCap * sizeof(uint32_t));
+        if (!vars) return false;
+        _argVars = vars;
+    }
+    int offset = intern(name);
+    if (offset < 0) return false;
+    Argument& a = _args[_nArgs];
+    a.name = (uint16_t) offset;
+    a.direction = direction;
+    a.type = TR064_TYPE_STRING;
+    _argVars[_nArgs++] = tr064Hash(variable, strlen(variable));
+    ++_actions[_nActions - 1].nArgs;
+    return true;
+}
+
+bool TR064ServiceDescription::addVariable(const char* name, uint8_t type) {
+    if (!grow(_vars, _nVars, _varCap)) return false;
+    Variable& v = _vars[_nVars++];
+    v.hash = tr064Hash(name, strlen(name));
+    v.type = type;
+    return true;
+}
+
+/// Resolves the types of the arguments, releases the state variables and shrinks the storage.
+void TR064ServiceDescription::finish() {
+    for (uint16_t i = 0; i < _nArgs; ++i) {
+        for (uint16_t j = 0; j < _nVars; ++j) {
+            if (_vars[j].hash == _argVars[i]) {
+                _args[i].type = _vars[j].type;
+                break;
+            }
+        }
+    }
+    free(_vars);
+    free(_argVars);
+    _vars = nullptr;
+    _nVars = 0;
+    _varCap = 0;
+    _argVars = nullptr;
+    if (_arenaLen > 0 && _arenaLen < _arenaCap) {
+        char* arena = (char*) realloc(_arena, _arenaLen);
+        if (arena) {
+            _arena = arena;
+            _arenaCap = _arenaLen;
+        }
+    }
+    if (_nActions > 0 && _nActions < _actionCap) {
+        Action* actions = (Action*) realloc(_actions, _nActions * sizeof(Action));
+        if (actions) {
+            _actions = actions;
+            _actionCap = _nActions;
+        }
+    }
+    if (_nArgs > 0 && _nArgs < _argCap) {
+        Argument* args = (Argument*) realloc(_args, _nArgs * sizeof(Argument));
+        if (args) {
+            _args = args;
+            _argCap = _nArgs;
+        }
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Copies a string into the arena.
+    @return Its offset or -1 if out of memory.
+*/
+/**************************************************************************/
+int TR064ServiceDescription::intern(const char* s) {
+    size_t len = strlen(s) + 1;
+    if ((size_t) _arenaLen + len > 0xFFFF) return -1;
+    if (_arenaLen + len > _arenaCap) {
+        size_t cap = _arenaCap ? 2 * (size_t) _arenaCap : 256;
+        while (cap < _arenaLen + len) cap *= 2;
+        if (cap > 0xFFFF) cap = 0xFFFF;
+        char* arena = (char*) realloc(_arena, cap);
+        if (!arena) return -1;
+        _arena = arena;
+        _arenaCap = (uint16_t) cap;
+    }
+    memcpy(_arena + _arenaLen, s, len);
+    int offset = _arenaLen;
+    _arenaLen += (uint16_t) len;
+    return offset;
+}
@@ -0,0 +1,98 @@
+/*!
+ * @file tr064_scpd.h
+ *
+ * Index of the actions of a service and their arguments, compiled from the
+ * service description (SCPD) of the device. The descriptions are fetched
+ * lazily, the first time a service is described (see `TR064::describe()`),
+ * so that actions and arguments can be checked locally and tools can list
+ * what the device supports.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_scpd_h
+#define tr064_scpd_h
+
+#include "Arduino.h"
+#include "tr064_transport.h"
+#include "tr064_action.h"
+
+#ifndef TR064_SCPD_CACHE
+#define TR064_SCPD_CACHE        4 ///< Number of service descriptions kept by a `TR064` instance
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Compact, read-only (after `parse()`) index of the actions of one
+            service: names are interned in a single arena, each argument
+            takes 4 bytes. Memory is sized to the actions actually found.
+*/
+/**************************************************************************/
+class TR064ServiceDescription {
+    public:
+        TR064ServiceDescription();
+        ~TR064ServiceDescription();
+
+        void clear();
+        int parse(TR064ByteSource& source);
+        void swap(TR064ServiceDescription& other);
+
+        /*!  @brief Number of actions of the service. */
+        uint16_t actions() const { return _nActions; }
+        const char* actionName(uint16_t action) const;
+        int findAction(const char* name) const;
+        uint8_t arguments(uint16_t action) const;
+        TR064ArgDescriptor argument(uint16_t action, uint8_t index) const;
+        int findArgument(uint16_t action, const char* name, uint8_t direction) const;
+        size_t memoryUsage() const;
+
+        static uint8_t typeCode(const char* dataType);
+        static const char* typeName(uint8_t type);
+
+    private:
+        friend class TR064ScpdHandler;
+
+        TR064ServiceDescription(const TR064ServiceDescription&);
+        TR064ServiceDescription& operator=(const TR064ServiceDescription&);
+
+        struct Action {
+            uint32_t hash;          // Case-folded hash of the name
+            uint16_t name;          // Offset of the name in the arena
+            uint16_t firstArg;
+            uint8_t nArgs;
+        };
+        struct Argument {
+            uint16_t name;          // Offset of the name in the arena
+            uint8_t direction;
+            uint8_t type;
+        };
+        struct Variable {
+            uint32_t hash;          // Case-folded hash of the name
+            uint8_t type;
+        };
+
+        bool addAction(const char* name);
+        bool addArgument(const char* name, uint8_t direction, const char* variable);
+        bool addVariable(const char* name, uint8_t type);
+        void finish();
+        int intern(const char* s);
+        template<typename T> static bool grow(T*& array, uint16_t count, uint16_t& capacity);
+
+        char* _arena;
+        uint16_t _arenaLen;
+        uint16_t _arenaCap;
+        Action* _actions;
+        uint16_t _nActions;
+        uint16_t _actionCap;
+        Argument* _args;
+        uint16_t _nArgs;
+        uint16_t _argCap;
+        // Only while parsing: the state variables and the variable of each argument
+        Variable* _vars;
+        uint16_t _nVars;
+        uint16_t _varCap;
+        uint32_t* _argVars;
+};
+
+#endif
@@ -0,0 +1,571 @@
+/*!
+ * @file tr064_services.cpp
+ *
+ * Registry of the services offered by a TR-064 device.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_services.h"
+
+static const char servicePrefix[] = "urn:dslforum-org:service:";
+
+/**************************************************************************/
+/*!
+    @brief  Case-folded FNV-1a hash, used for all case-insensitive lookups
+            of the library.
+    @param    s
+                The string to hash (does not need to be terminated).
+    @param    len
+                Length of the string.
+    @return The hash.
+*/
+/**************************************************************************/
+uint32_t tr064Hash(const char* s, size_t len) {
+    uint32_t h = TR064_HASH_INIT;
+    for (size_t i = 0; i < len; ++i) {
+        h = tr064HashStep(h, s[i]);
+    }
+    return h;
+}
+
+TR064ServiceRegistry::TR064ServiceRegistry() {
+    _arena = nullptr;
+    _arenaLen = 0;
+    _arenaCap = 0;
+    _entries = nullptr;
+    _count = 0;
+    _capacity = 0;
+    _index = nullptr;
+    _indexSize = 0;
+    _shared = false;
+    _fixed = false;
+    _overflowed = false;
+}
+
+TR064ServiceRegistry::~TR064ServiceRegistry() {
+    clear();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Removes all services and releases the memory (unless it is
+            shared with another registry or a fixed buffer).
+*/
+/**************************************************************************/
+void TR064ServiceRegistry::clear() {
+    _overflowed = false;
+    if (_fixed) {
+        // The buffer stays, see `useStorage()`
+        _arenaLen = 0;
+        _count = 0;
+        _index = nullptr;
+        _indexSize = 0;
+        return;
+    }
+    if (!_shared) {
+        free(_arena);
+        free(_entries);
+        free(_index);
+    }
+    _shared = false;
+    _arena = nullptr;
+    _arenaLen = 0;
+    _arenaCap = 0;
+    _entries = nullptr;
+    _count = 0;
+    _capacity = 0;
+    _index = nullptr;
+    _indexSize = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Adds a service. Duplicates are ignored. Call `finish()` after the
+            last service was added.
+    @param    name
+                Name of the service, with or without the `urn:dslforum-org:service:` prefix.
+    @param    controlURL
+                The control URL of the service.
+    @param    scpdURL
+                The URL of the service description (SCPD).
+    @param    eventSubURL
+                The URL event subscriptions of the service are sent to.
+    @return false if the service could not be stored (out of memory or
+            the fixed buffer is full, see `overflowed()`).
+*/
+/**************************************************************************/
+bool TR064ServiceRegistry::add(const char* name, const char* controlURL, const char* scpdURL, const char* eventSubURL) {
+    name = stripPrefix(name);
+    if (find(name)) {
+        return true;
+    }
+    if (_shared) {
+        // The services of the owner stay as they are
+        clear();
+    }
+    if (_index) {
+        // Adding to a finished registry: the index is rebuilt by the next finish()
+        if (!_fixed) free(_index);
+        _index = nullptr;
+        _indexSize = 0;
+    }
+    if (_count == _capacity) {
+        uint16_t capacity = _capacity ? 2 * _capacity : 16;
+        Entry* entries = _fixed ? nullptr : (Entry*) realloc(_entries, capacity * sizeof(Entry));
+        if (!entries) {
+            _overflowed = true;
+            return false;
+        }
+        _entries = entries;
+        _capacity = capacity;
+    }
+    int nameOffset = intern(name);
+    int urlOffset = nameOffset < 0 ? -1 : intern(controlURL);
+    int scpdOffset = urlOffset < 0 ? -1 : intern(scpdURL ? scpdURL : "");
+    // The event URL mostly equals the control URL, it is stored once then
+    int eventOffset = scpdOffset < 0 ? -1
+        : eventSubURL && strcmp(eventSubURL, controlURL) == 0 ? urlOffset : intern(eventSubURL ? eventSubURL : "");
+    if (eventOffset < 0) {
+        _overflowed = true;
+        return false;
+    }
+    Entry& e = _entries[_count++];
+    e.name = (uint16_t) nameOffset;
+    e.controlURL = (uint16_t) urlOffset;
+    e.scpdURL = (uint16_t) scpdOffset;
+    e.eventSubURL = (uint16_t) eventOffset;
+    e.hash = tr064Hash(name, strlen(name));
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Shrinks the storage to the number of services and builds the
+            hash index.
+    @return false if the index could not be allocated (lookups still work,
+            but are linear).
+*/
+/**************************************************************************/
+bool TR064ServiceRegistry::finish() {
+    if (_shared) {
+        return _index != nullptr;
+    }
+    if (_fixed) {
+        // The index has its place behind the entries
+        _index = (uint16_t*) (_entries + _capacity);
+        _indexSize = (uint16_t) indexSize(_count);
+        memset(_index, 0, _indexSize * sizeof(uint16_t));
+        for (uint16_t i = 0; i < _count; ++i) {
+            uint16_t slot = _entries[i].hash & (_indexSize - 1);
+            while (_index[slot]) slot = (slot + 1) & (_indexSize - 1);
+            _index[slot] = i + 1;
+        }
+        return true;
+    }
+    if (_arenaLen > 0 && _arenaLen < _arenaCap) {
+        char* arena = (char*) realloc(_arena, _arenaLen);
+        if (arena) {
+            _arena = arena;
+            _arenaCap = _arenaLen;
+        }
+    }
+    if (_count > 0 && _count < _capacity) {
+        Entry* entries = (Entry*) realloc(_entries, _count * sizeof(Entry));
+        if (entries) {
+            _entries = entries;
+            _capacity = _count;
+        }
+    }
+    free(_index);
+    _index = nullptr;
+    _indexSize = (uint16_t) indexSize(_count);
+    _index = (uint16_t*) calloc(_indexSize, sizeof(uint16_t));
+    if (!_index) {
+        _indexSize = 0;
+        return false;
+    }
+    for (uint16_t i = 0; i < _count; ++i) {
+        uint16_t slot = _entries[i].hash & (_indexSize - 1);
+        while (_index[slot]) slot = (slot + 1) & (_indexSize - 1);
+        _index[slot] = i + 1;
+    }
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Looks up the control URL of a service (case-insensitive).
+    @param    name
+                Name of the service, with or without the `urn:dslforum-org:service:` prefix.
+    @return The control URL or `nullptr` if the service is unknown.
+*/
+/**************************************************************************/
+const char* TR064ServiceRegistry::find(const char* name) const {
+    name = stripPrefix(name);
+    return find(name, tr064Hash(name, strlen(name)));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Looks up the control URL of a service whose hash is known, e.g.
+            precomputed with `tr064HashConst()`.
+    @param    name
+                Name of the service, without the `urn:dslforum-org:service:` prefix.
+    @param    hash
+                `tr064Hash()` of the name.
+    @return The control URL or `nullptr` if the service is unknown.
+*/
+/**************************************************************************/
+const char* TR064ServiceRegistry::find(const char* name, uint32_t hash) const {
+    int i = indexOf(name, hash);
+    return i < 0 ? nullptr : _arena + _entries[i].controlURL;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Looks up the URL of the description (SCPD) of a service.
+    @param    name
+                Name of the service, with or without the `urn:dslforum-org:service:` prefix.
+    @return The URL, empty if the device did not announce one, or `nullptr`
+            if the service is unknown.
+*/
+/**************************************************************************/
+const char* TR064ServiceRegistry::scpdURL(const char* name) const {
+    name = stripPrefix(name);
+    int i = indexOf(name, tr064Hash(name, strlen(name)));
+    return i < 0 ? nullptr : _arena + _entries[i].scpdURL;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Looks up the URL event subscriptions of a service are sent to.
+    @param    name
+                Name of the service, with or without the `urn:dslforum-org:service:` prefix.
+    @return The URL, empty if the service has no events, or `nullptr` if
+            the service is unknown.
+*/
+/**************************************************************************/
+const char* TR064ServiceRegistry::eventSubURL(const char* name) const {
+    name = stripPrefix(name);
+    int i = indexOf(name, tr064Hash(name, strlen(name)));
+    return i < 0 ? nullptr : _arena + _entries[i].eventSubURL;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the service with the given index (0 to `size()`-1).
+*/
+/**************************************************************************/
+TR064Service TR064ServiceRegistry::operator[](uint16_t index) const {
+    TR064Service s;
+    s.name = _arena + _entries[index].name;
+    s.controlURL = _arena + _entries[index].controlURL;
+    s.scpdURL = _arena + _entries[index].scpdURL;
+    s.eventSubURL = _arena + _entries[index].eventSubURL;
+    return s;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the number of heap bytes used by the registry (0 in a
+            fixed buffer).
+*/
+/**************************************************************************/
+size_t TR064ServiceRegistry::memoryUsage() const {
+    if (_shared || _fixed) return 0;
+    return _arenaCap + _capacity * sizeof(Entry) + _indexSize * sizeof(uint16_t);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Compares the services (names and URLs, in order) with those of
+            another registry.
+    @return true if both hold the same services.
+*/
+/**************************************************************************/
+bool TR064ServiceRegistry::sameAs(const TR064ServiceRegistry& other) const {
+    if (_count != other._count) return false;
+    if (_arena == other._arena) return true;
+    for (uint16_t i = 0; i < _count; ++i) {
+        TR064Service a = (*this)[i];
+        TR064Service b = other[i];
+        if (strcmp(a.name, b.name) != 0 || strcmp(a.controlURL, b.controlURL) != 0
+                || strcmp(a.scpdURL, b.scpdURL) != 0 || strcmp(a.eventSubURL, b.eventSubURL) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Releases the own services and uses those of another registry
+            instead, without copying them, e.g. for several devices of the
+            same model (see `sameAs()`). Adding or loading services ends the
+            sharing. A registry in a fixed buffer keeps its own services.
+    @param    owner
+                The registry holding the services. It must neither be
+                changed nor destroyed while it is shared.
+*/
+/**************************************************************************/
+void TR064ServiceRegistry::share(const TR064ServiceRegistry& owner) {
+    if (&owner == this || _fixed) return;
+    clear();
+    _arena = owner._arena;
+    _arenaLen = owner._arenaLen;
+    _arenaCap = owner._arenaCap;
+    _entries = owner._entries;
+    _count = owner._count;
+    _capacity = owner._capacity;
+    _index = owner._index;
+    _indexSize = owner._indexSize;
+    _shared = true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Keeps the registry in a buffer of fixed size instead of the
+            heap: the services, the hash index and the interned names and
+            URLs. Services that do not fit are not added and reported by
+            `overflowed()`. Removes all services.
+    @param    storage
+                The buffer, aligned for `uint32_t`, see `storageSize()`.
+                It must outlive the registry.
+    @param    size
+                Size of the buffer in bytes.
+    @param    maxServices
+                Most services the buffer is to take; the rest of the buffer
+                (after the entries and the index) holds the strings.
+    @return false if the buffer is too small for `maxServices`.
+*/
+/**************************************************************************/
+bool TR064ServiceRegistry::useStorage(void* storage, size_t size, uint16_t maxServices) {
+    size_t fixedPart = storageSize(maxServices, 0);
+    if (!storage || maxServices == 0 || size <= fixedPart) {
+        return false;
+    }
+    _fixed = false;
+    clear();
+    _fixed = true;
+    _entries = (Entry*) storage;
+    _capacity = maxServices;
+    _arena = (char*) storage + fixedPart;
+    _arenaCap = (uint16_t) (size - fixedPart > 0xFFFF ? 0xFFFF : size - fixedPart);
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Skips the `urn:dslforum-org:service:` prefix of a service name.
+*/
+/**************************************************************************/
+const char* TR064ServiceRegistry::stripPrefix(const char* name) {
+    const size_t len = sizeof(servicePrefix) - 1;
+    return strncmp(name, servicePrefix, len) == 0 ? name + len : name;
+}
+
+static const char imageMagic[3] = {'T', 'R', 'S'};
+
+/// Writes an image, keeping a checksum (plain FNV-1a) of everything written.
+struct TR064ImageWriter {
+    TR064ByteSink& sink;
+    uint32_t hash;
+    bool ok;
+
+    explicit TR064ImageWriter(TR064ByteSink& sink) : sink(sink), hash(TR064_HASH_INIT), ok(true) {}
+    void put(const void* data, size_t len) {
+        const uint8_t* p = (const uint8_t*) data;
+        for (size_t i = 0; i < len; ++i) hash = (hash ^ p[i]) * 16777619u;
+        ok = ok && sink.write((const char*) data, len);
+    }
+    void put16(uint16_t v) { uint8_t b[2] = {(uint8_t) v, (uint8_t) (v >> 8)}; put(b, 2); }
+};
+
+/// Reads an image written by `TR064ImageWriter`.
+struct TR064ImageReader {
+    TR064ByteSource& source;
+    uint32_t hash;
+    bool ok;
+
+    explicit TR064ImageReader(TR064ByteSource& source) : source(source), hash(TR064_HASH_INIT), ok(true) {}
+    void get(void* data, size_t len) {
+        uint8_t* p = (uint8_t*) data;
+        size_t n = 0;
+        while (ok && n < len) {
+            int r = source.read(p + n, len - n);
+            if (r <= 0) ok = false;
+            else n += r;
+        }
+        if (!ok) {
+            memset(data, 0, len);
+            return;
+        }
+        for (size_t i = 0; i < len; ++i) hash = (hash ^ p[i]) * 16777619u;
+    }
+    uint16_t get16() { uint8_t b[2]; get(b, 2); return (uint16_t) (b[0] | (b[1] << 8)); }
+};
+
+/**************************************************************************/
+/*!
+    @brief  Writes the services in a compact binary image, which `load()`
+            reads back without parsing the description of the device.
+    @param    sink
+                Where to write the image, e.g. a `TR064Storage`.
+    @param    validator
+                Identifies the version of the description the services were
+                read from (stored with the image, at most 255 characters).
+    @return success state.
+*/
+/**************************************************************************/
+bool TR064ServiceRegistry::save(TR064ByteSink& sink, const char* validator) const {
+    size_t validatorLen = strlen(validator);
+    if (validatorLen > 0xFF) return false;
+    TR064ImageWriter w(sink);
+    uint8_t head[5] = {(uint8_t) imageMagic[0], (uint8_t) imageMagic[1], (uint8_t) imageMagic[2],
+                       TR064_SERVICES_IMAGE_VERSION, (uint8_t) validatorLen};
+    w.put(head, sizeof(head));
+    w.put(validator, validatorLen);
+    w.put16(_count);
+    w.put16(_arenaLen);
+    for (uint16_t i = 0; i < _count && w.ok; ++i) {
+        w.put16(_entries[i].name);
+        w.put16(_entries[i].controlURL);
+        w.put16(_entries[i].scpdURL);
+        w.put16(_entries[i].eventSubURL);
+    }
+    w.put(_arena, _arenaLen);
+    uint32_t sum = w.hash;
+    uint8_t tail[4] = {(uint8_t) sum, (uint8_t) (sum >> 8), (uint8_t) (sum >> 16), (uint8_t) (sum >> 24)};
+    w.put(tail, sizeof(tail));
+    return w.ok;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Replaces the services with an image written by `save()`. The
+            image is checked completely (version, bounds, checksum) before
+            it is used.
+    @param    source
+                The image, e.g. a `TR064Storage`.
+    @param    validator
+                Receives the validator stored with the image.
+    @param    validatorLen
+                Size of `validator`.
+    @return false (and the registry is empty) if the image is invalid or
+            memory ran out.
+*/
+/**************************************************************************/
+bool TR064ServiceRegistry::load(TR064ByteSource& source, char* validator, size_t validatorLen) {
+    clear();
+    validator[0] = '\0';
+    TR064ImageReader r(source);
+    uint8_t head[5];
+    r.get(head, sizeof(head));
+    if (!r.ok || memcmp(head, imageMagic, sizeof(imageMagic)) != 0 || head[3] != TR064_SERVICES_IMAGE_VERSION
+            || head[4] >= validatorLen) {
+        return false;
+    }
+    r.get(validator, head[4]);
+    validator[head[4]] = '\0';
+    uint16_t count = r.get16();
+    uint16_t arenaLen = r.get16();
+    if (!r.ok || arenaLen == 0) return false;
+    if (_fixed) {
+        if (count > _capacity || arenaLen > _arenaCap) {
+            _overflowed = true;
+            return false;
+        }
+    } else {
+        _entries = (Entry*) malloc((count > 0 ? count : 1) * sizeof(Entry));
+        _arena = (char*) malloc(arenaLen);
+        if (!_entries || !_arena) {
+            clear();
+            return false;
+        }
+        _capacity = count;
+        _arenaCap = arenaLen;
+    }
+    for (uint16_t i = 0; i < count; ++i) {
+        _entries[i].name = r.get16();
+        _entries[i].controlURL = r.get16();
+        _entries[i].scpdURL = r.get16();
+        _entries[i].eventSubURL = r.get16();
+    }
+    r.get(_arena, arenaLen);
+    uint32_t sum = r.hash;
+    uint8_t tail[4];
+    r.get(tail, sizeof(tail));
+    bool ok = r.ok && sum == ((uint32_t) tail[0] | ((uint32_t) tail[1] << 8) | ((uint32_t) tail[2] << 16) | ((uint32_t) tail[3] << 24))
+        && _arena[arenaLen - 1] == '\0';
+    for (uint16_t i = 0; ok && i < count; ++i) {
+        const Entry& e = _entries[i];
+        ok = e.name < arenaLen && e.controlURL < arenaLen && e.scpdURL < arenaLen && e.eventSubURL < arenaLen;
+    }
+    if (!ok) {
+        clear();
+        validator[0] = '\0';
+        return false;
+    }
+    _arenaLen = arenaLen;
+    _count = count;
+    for (uint16_t i = 0; i < count; ++i) {
+        _entries[i].hash = tr064Hash(_arena + _entries[i].name, strlen(_arena + _entries[i].name));
+    }
+    finish();
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Looks up a service by its name and hash.
+    @param    name
+                Name of the service, without the `urn:dslforum-org:service:` prefix.
+    @param    hash
+                `tr064Hash()` of the name.
+    @return The index of the service (see `operator[]`) or -1.
+*/
+/**************************************************************************/
+int TR064ServiceRegistry::indexOf(const char* name, uint32_t hash) const {
+    if (!_index) {
+        for (uint16_t i = 0; i < _count; ++i) {
+            if (strcasecmp(_arena + _entries[i].name, name) == 0) return i;
+        }
+        return -1;
+    }
+    for (uint16_t slot = hash & (_indexSize - 1); _index[slot]; slot = (slot + 1) & (_indexSize - 1)) {
+        const Entry& e = _entries[_index[slot] - 1];
+        if (e.hash == hash && strcasecmp(_arena + e.name, name) == 0) {
+            return _index[slot] - 1;
+        }
+    }
+    return -1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Copies a string into the arena.
+    @return Its offset or -1 if out of memory.
+*/
+/**************************************************************************/
+int TR064ServiceRegistry::intern(const char* s) {
+    size_t len = strlen(s) + 1;
+    if ((size_t) _arenaLen + len > 0xFFFF) return -1;
+    if (_fixed && _arenaLen + len > _arenaCap) {
+        return -1;
+    }
+    if (_arenaLen + len > _arenaCap) {
+        size_t cap = _arenaCap ? 2 * (size_t) _arenaCap : 512;
+        while (cap < _arenaLen + len) cap *= 2;
+        if (cap > 0xFFFF) cap = 0xFFFF;
+        char* arena = (char*) realloc(_arena, cap);
+        if (!arena) return -1;
+        _arena = arena;
+        _arenaCap = (uint16_t) cap;
+    }
+    memcpy(_arena + _arenaLen, s, len);
+    int offset = _arenaLen;
+    _arenaLen += (uint16_t) len;
+    return offset;
+}
@@ -0,0 +1,135 @@
+/*!
+ * @file tr064_services.h
+ *
+ * Registry of the services offered by a TR-064 device, as read from its
+ * description (`/tr64desc.xml`).
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_services_h
+#define tr064_services_h
+
+#include "Arduino.h"
+#include "tr064_transport.h"
+
+#define TR064_HASH_INIT 2166136261u ///< Initial value of `tr064HashStep()`
+#define TR064_SERVICES_IMAGE_VERSION 2 ///< Version of the format written by `TR064ServiceRegistry::save()`
+
+/*!  @brief Adds one character to a case-folded FNV-1a hash, see `tr064Hash()`. */
+inline uint32_t tr064HashStep(uint32_t hash, char c) {
+    uint8_t b = (uint8_t) c;
+    if (b >= 'A' && b <= 'Z') b += 'a' - 'A';
+    return (hash ^ b) * 16777619u;
+}
+
+uint32_t tr064Hash(const char* s, size_t len);
+
+/*!  @brief Compile-time variant of `tr064Hash()` for zero-terminated strings. */
+constexpr uint32_t tr064HashConst(const char* s, uint32_t hash = TR064_HASH_INIT) {
+    return *s ? tr064HashConst(s + 1, (hash ^ (uint8_t) (*s >= 'A' && *s <= 'Z' ? *s + ('a' - 'A') : *s)) * 16777619u)
+              : hash;
+}
+
+/// One service of the device, see `TR064ServiceRegistry`.
+struct TR064Service {
+    const char* name;        ///< Service name without the `urn:dslforum-org:service:` prefix, e.g. `Hosts:1`
+    const char* controlURL;  ///< URL actions of the service are posted to, e.g. `/upnp/control/hosts`
+    const char* scpdURL;     ///< URL of the service description, e.g. `/hostsSCPD.xml` (empty if unknown)
+    const char* eventSubURL; ///< URL event subscriptions are sent to, e.g. `/upnp/control/hosts` (empty if unknown)
+};
+
+/**************************************************************************/
+/*!
+    @brief  Compact, read-only (after `finish()`) table of services. All
+            strings are interned in a single arena, lookups by name are
+            case-insensitive and O(1) through a precomputed hash index.
+            Memory is sized to the number of services actually found, or
+            taken from a buffer of fixed size (see `useStorage()`).
+            Registries of devices with the same services can share one
+            copy, see `share()`.
+*/
+/**************************************************************************/
+class TR064ServiceRegistry {
+    public:
+        /// Iterator over all services, yielding `TR064Service`s.
+        class Iterator {
+            public:
+                Iterator(const TR064ServiceRegistry* registry, uint16_t index) : _registry(registry), _index(index) {}
+                TR064Service operator*() const { return (*_registry)[_index]; }
+                Iterator& operator++() { ++_index; return *this; }
+                bool operator!=(const Iterator& other) const { return _index != other._index; }
+
+            private:
+                const TR064ServiceRegistry* _registry;
+                uint16_t _index;
+        };
+
+        TR064ServiceRegistry();
+        ~TR064ServiceRegistry();
+
+        void clear();
+        bool add(const char* name, const char* controlURL, const char* scpdURL = "", const char* eventSubURL = "");
+        bool finish();
+        const char* find(const char* name) const;
+        const char* find(const char* name, uint32_t hash) const;
+        const char* scpdURL(const char* name) const;
+        const char* eventSubURL(const char* name) const;
+        int indexOf(const char* name, uint32_t hash) const;
+        bool sameAs(const TR064ServiceRegistry& other) const;
+        void share(const TR064ServiceRegistry& owner);
+        /*!  @brief Whether the services are those of another registry, see `share()`. */
+        bool shared() const { return _shared; }
+        bool useStorage(void* storage, size_t size, uint16_t maxServices);
+        /*!  @brief Whether the registry lives in a buffer of fixed size, see `useStorage()`. */
+        bool fixed() const { return _fixed; }
+        /*!  @brief Whether a service could not be stored (buffer full or out of memory) since the last `clear()`. */
+        bool overflowed() const { return _overflowed; }
+        /*!  @brief Size of a buffer for `useStorage()` holding up to `maxServices` services with `arenaBytes` of names and URLs. */
+        static constexpr size_t storageSize(uint16_t maxServices, uint16_t arenaBytes) {
+            return maxServices * sizeof(Entry) + indexSize(maxServices) * sizeof(uint16_t) + arenaBytes;
+        }
+
+        uint16_t size() const { return _count; }
+        TR064Service operator[](uint16_t index) const;
+        Iterator begin() const { return Iterator(this, 0); }
+        Iterator end() const { return Iterator(this, _count); }
+        size_t memoryUsage() const;
+        bool save(TR064ByteSink& sink, const char* validator) const;
+        bool load(TR064ByteSource& source, char* validator, size_t validatorLen);
+
+        static const char* stripPrefix(const char* name);
+
+    private:
+        TR064ServiceRegistry(const TR064ServiceRegistry&);
+        TR064ServiceRegistry& operator=(const TR064ServiceRegistry&);
+
+        struct Entry {
+            uint16_t name;       // Offset of the name in the arena
+            uint16_t controlURL; // Offset of the control URL in the arena
+            uint16_t scpdURL;    // Offset of the SCPD URL in the arena
+            uint16_t eventSubURL; // Offset of the event subscription URL in the arena
+            uint32_t hash;       // Case-folded hash of the name
+        };
+
+        int intern(const char* s);
+        /// Slots of the hash index for `count` services (a power of two, at most half of them used).
+        static constexpr uint32_t indexSize(uint32_t count, uint32_t size = 4) {
+            return size >= 2 * count ? size : indexSize(count, 2 * size);
+        }
+
+        char* _arena;
+        uint16_t _arenaLen;
+        uint16_t _arenaCap;
+        Entry* _entries;
+        uint16_t _count;
+        uint16_t _capacity;
+        uint16_t* _index;        // Open addressing, entry index + 1 (0: empty slot)
+        uint16_t _indexSize;     // Power of two
+        bool _shared;            // The memory belongs to another registry
+        bool _fixed;             // The memory is a buffer of the owner of the registry, see `useStorage()`
+        bool _overflowed;
+};
+
+#endif
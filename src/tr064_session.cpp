@@ -0,0 +1,66 @@
+/*!
+ * @file tr064_session.cpp
+ *
+ * State of a `TR064` connection that survives deep sleep.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_session.h"
+#include "tr064_services.h"
+
+/// Adds bytes to a plain (case-sensitive) FNV-1a hash.
+static uint32_t hashBytes(uint32_t hash, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*) data;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sets the magic number and the checksum, after all other fields
+            were filled in. The state should have been zeroed before (so
+            that unused bytes are deterministic).
+*/
+/**************************************************************************/
+void TR064SessionState::seal() {
+    magic = TR064_SESSION_MAGIC;
+    checksum = hashBytes(TR064_HASH_INIT, this, offsetof(TR064SessionState, checksum));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Whether the state was sealed by this version of the library and
+            is intact, e.g. not the random content of the RTC memory after
+            a power cycle.
+*/
+/**************************************************************************/
+bool TR064SessionState::valid() const {
+    if (magic != TR064_SESSION_MAGIC || nServices > TR064_SESSION_SERVICES
+            || checksum != hashBytes(TR064_HASH_INIT, this, offsetof(TR064SessionState, checksum))) {
+        return false;
+    }
+    // All strings must be terminated
+    bool ok = memchr(realm, '\0', sizeof(realm)) && memchr(nonce, '\0', sizeof(nonce)) && memchr(secret, '\0', sizeof(secret));
+    for (uint8_t i = 0; ok && i < nServices; ++i) {
+        ok = memchr(services[i].name, '\0', sizeof(services[i].name))
+            && memchr(services[i].controlURL, '\0', sizeof(services[i].controlURL));
+    }
+    return ok;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Identifies a server and the credentials, so that a state is not
+            resumed for another device or after the password changed.
+*/
+/**************************************************************************/
+uint32_t TR064SessionState::fingerprintOf(const char* ip, uint16_t port, const char* user, const char* pass) {
+    uint32_t h = hashBytes(TR064_HASH_INIT, ip, strlen(ip) + 1);
+    h = hashBytes(h, &port, sizeof(port));
+    h = hashBytes(h, user, strlen(user) + 1);
+    return hashBytes(h, pass, strlen(pass) + 1);
+}
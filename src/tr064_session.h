@@ -0,0 +1,67 @@
+/*!
+ * @file tr064_session.h
+ *
+ * State of a `TR064` connection that survives deep sleep, see
+ * `TR064::exportSession()` and `TR064::importSession()`. It is small enough
+ * for the RTC memory of the ESP8266/ESP32 and holds what a wakeup would
+ * otherwise have to request again: the realm, the hashed secret and the
+ * last nonce of the authentication, and the control URLs of the services
+ * that were used. A resumed wakeup then needs one request per action (two,
+ * if the nonce expired in the meantime).
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_session_h
+#define tr064_session_h
+
+#include "Arduino.h"
+#include "tr064_auth.h"
+
+#ifndef TR064_SESSION_SERVICES
+#define TR064_SESSION_SERVICES      4  ///< Number of services (the most recently used ones) kept in a session state
+#endif
+#ifndef TR064_SESSION_NAME
+#define TR064_SESSION_NAME          28 ///< Longest service name kept (including terminator)
+#endif
+#ifndef TR064_SESSION_URL
+#define TR064_SESSION_URL           36 ///< Longest control URL kept (including terminator)
+#endif
+
+#define TR064_SESSION_MAGIC         0x54523101u ///< Identifies (the version of) a `TR064SessionState`
+
+/**************************************************************************/
+/*!
+    @brief  Plain, fixed-size copy of the state of a session, e.g. for
+            `ESP.rtcUserMemoryWrite()` (its size is a multiple of 4 bytes).
+            It holds the hashed secret, which grants access to the device
+            just like the password, so it should not leave the device.
+            On the ESP8266:
+            `if (!ESP.rtcUserMemoryRead(0, (uint32_t*) &state, sizeof(state)) || !tr064.importSession(state)) tr064.init();`
+            and before `ESP.deepSleep()`:
+            `if (tr064.exportSession(state)) ESP.rtcUserMemoryWrite(0, (uint32_t*) &state, sizeof(state));`
+*/
+/**************************************************************************/
+struct TR064SessionState {
+    /// A service and its control URL.
+    struct Service {
+        char name[TR064_SESSION_NAME];
+        char controlURL[TR064_SESSION_URL];
+    };
+
+    uint32_t magic;             ///< `TR064_SESSION_MAGIC`
+    uint32_t fingerprint;       ///< Of the server and the credentials, see `fingerprintOf()`
+    char realm[TR064_AUTH_REALM_BUFFER];
+    char nonce[TR064_AUTH_NONCE_BUFFER];
+    char secret[33];
+    uint8_t nServices;
+    Service services[TR064_SESSION_SERVICES];
+    uint32_t checksum;          ///< Over all other bytes, see `seal()`
+
+    void seal();
+    bool valid() const;
+    static uint32_t fingerprintOf(const char* ip, uint16_t port, const char* user, const char* pass);
+};
+
+#endif
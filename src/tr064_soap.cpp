@@ -0,0 +1,270 @@
+/*!
+ * @file tr064_soap.cpp
+ *
+ * Writer for the SOAP envelopes of TR-064 actions.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_soap.h"
+
+static const char soapStart[] PROGMEM = "<?xml version=\"1.0\"?><s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\" s:encodingStyle=\"http://schemas.xmlsoap.org/soap/encoding/\">";
+static const char initChallengeStart[] PROGMEM = "<s:Header><h:InitChallenge xmlns:h=\"http://soap-authentication.org/digest/2001/10/\" s:mustUnderstand=\"1\"><UserID>";
+static const char initChallengeEnd[] PROGMEM = "</UserID></h:InitChallenge ></s:Header>";
+static const char clientAuthStart[] PROGMEM = "<s:Header><h:ClientAuth xmlns:h=\"http://soap-authentication.org/digest/2001/10/\" s:mustUnderstand=\"1\"><Nonce>";
+static const char clientAuthAuth[] PROGMEM = "</Nonce><Auth>";
+static const char clientAuthUser[] PROGMEM = "</Auth><UserID>";
+static const char clientAuthRealm[] PROGMEM = "</UserID><Realm>";
+static const char clientAuthEnd[] PROGMEM = "</Realm></h:ClientAuth></s:Header>";
+static const char bodyStart[] PROGMEM = "<s:Body><u:";
+static const char bodyService[] PROGMEM = " xmlns:u=\"urn:dslforum-org:service:";
+static const char bodyServiceEnd[] PROGMEM = "\">";
+static const char bodyEnd[] PROGMEM = "></s:Body></s:Envelope>";
+
+/// Sink that only counts the bytes, used to compute the length of an envelope.
+class TR064CountingSink : public TR064ByteSink {
+    public:
+        TR064CountingSink() : count(0) {}
+        bool write(const char* data, size_t len) override { (void) data; count += len; return true; }
+        size_t count;
+};
+
+/// Sink writing into a fixed buffer.
+class TR064BufferSink : public TR064ByteSink {
+    public:
+        TR064BufferSink(char* buf, size_t size) : _buf(buf), _size(size), _len(0) {}
+        bool write(const char* data, size_t len) override {
+            if (len > _size - _len) return false;
+            memcpy(_buf + _len, data, len);
+            _len += len;
+            return true;
+        }
+        size_t length() const { return _len; }
+
+    private:
+        char* _buf;
+        size_t _size;
+        size_t _len;
+};
+
+/**************************************************************************/
+/*!
+    @brief  Creates the envelope of an action call without authentication
+            header.
+    @param    service
+                Name of the service, without the `urn:dslforum-org:service:` prefix.
+    @param    action
+                Name of the action.
+    @param    args
+                The input arguments.
+    @param    nArgs
+                Number of input arguments. Arguments with an empty name are skipped.
+*/
+/**************************************************************************/
+TR064SoapEnvelope::TR064SoapEnvelope(const char* service, const char* action,
+                                     const TR064SoapArg* args, uint8_t nArgs)
+    : _service(service), _action(action), _args(args), _nArgs(nArgs),
+      _user(nullptr), _realm(nullptr), _nonce(nullptr), _auth(nullptr),
+      _bodyStart(nullptr), _bodyEnd(nullptr) {
+}
+
+/**************************************************************************/
+/*!
+    @brief  Adds an `InitChallenge` header, which requests a nonce and the
+            realm from the device.
+*/
+/**************************************************************************/
+void TR064SoapEnvelope::setInitChallenge(const char* user) {
+    _user = user;
+    _realm = nullptr;
+    _nonce = nullptr;
+    _auth = nullptr;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Adds a `ClientAuth` header.
+    @param    user
+                The user name.
+    @param    realm
+                The realm of the device.
+    @param    nonce
+                The nonce of the last response.
+    @param    auth
+                The authentication token, `md5(secret:nonce)`.
+*/
+/**************************************************************************/
+void TR064SoapEnvelope::setClientAuth(const char* user, const char* realm, const char* nonce, const char* auth) {
+    _user = user;
+    _realm = realm;
+    _nonce = nonce;
+    _auth = auth;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Uses precomputed fragments for the start of the body (up to the
+            first argument) and its end, see `TR064ActionInfo`.
+    @param    bodyStart
+                `<s:Body><u:Action xmlns:u="urn:dslforum-org:service:Service">`
+    @param    bodyEnd
+                `</u:Action></s:Body></s:Envelope>`
+*/
+/**************************************************************************/
+void TR064SoapEnvelope::setBody(const char* bodyStart, const char* bodyEnd) {
+    _bodyStart = bodyStart;
+    _bodyEnd = bodyEnd;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns the length of the envelope (in bytes), as written by `writeTo()`.
+*/
+/**************************************************************************/
+size_t TR064SoapEnvelope::length() const {
+    TR064CountingSink counter;
+    writeTo(counter);
+    return counter.count;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes the envelope.
+    @param    sink
+                Where to write to.
+    @return success state.
+*/
+/**************************************************************************/
+bool TR064SoapEnvelope::writeTo(TR064ByteSink& sink) const {
+    bool ok = writeProgmem(sink, soapStart);
+    if (_user && !_nonce) {
+        ok = ok && writeProgmem(sink, initChallengeStart) && writeEscaped(sink, _user)
+            && writeProgmem(sink, initChallengeEnd);
+    } else if (_user) {
+        ok = ok && writeProgmem(sink, clientAuthStart) && writeEscaped(sink, _nonce)
+            && writeProgmem(sink, clientAuthAuth) && writeEscaped(sink, _auth)
+            && writeProgmem(sink, clientAuthUser) && writeEscaped(sink, _user)
+            && writeProgmem(sink, clientAuthRealm) && writeEscaped(sink, _realm)
+            && writeProgmem(sink, clientAuthEnd);
+    }
+    if (_bodyStart) {
+        ok = ok && sink.write(_bodyStart, strlen(_bodyStart));
+    } else {
+        ok = ok && writeProgmem(sink, bodyStart) && sink.write(_action, strlen(_action))
+            && writeProgmem(sink, bodyService) && sink.write(_service, strlen(_service))
+            && writeProgmem(sink, bodyServiceEnd);
+    }
+    for (uint8_t i = 0; ok && i < _nArgs; ++i) {
+        const char* name = _args[i].name;
+        size_t len = name ? strlen(name) : 0;
+        if (len == 0) continue;
+        ok = sink.write("<", 1) && sink.write(name, len) && sink.write(">", 1)
+            && writeEscaped(sink, _args[i].value)
+            && sink.write("</", 2) && sink.write(name, len) && sink.write(">", 1);
+    }
+    if (_bodyEnd) {
+        return ok && sink.write(_bodyEnd, strlen(_bodyEnd));
+    }
+    return ok && sink.write("</u:", 4) && sink.write(_action, strlen(_action))
+        && writeProgmem(sink, bodyEnd);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes the envelope into a buffer (zero-terminated if there is room).
+    @param    buf
+                The buffer.
+    @param    size
+                Size of the buffer.
+    @return The length of the envelope or 0 if the buffer is too small.
+*/
+/**************************************************************************/
+size_t TR064SoapEnvelope::writeTo(char* buf, size_t size) const {
+    TR064BufferSink sink(buf, size);
+    if (!writeTo(sink)) {
+        return 0;
+    }
+    if (sink.length() < size) {
+        buf[sink.length()] = '\0';
+    }
+    return sink.length();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes a value, replacing the XML special characters by entities.
+    @param    sink
+                Where to write to.
+    @param    value
+                The value (`nullptr` is written as empty value).
+    @return success state.
+*/
+/**************************************************************************/
+bool TR064SoapEnvelope::writeEscaped(TR064ByteSink& sink, const char* value) {
+    if (!value) {
+        return true;
+    }
+    const char* run = value;
+    for (const char* p = value; ; ++p) {
+        const char* entity;
+        switch (*p) {
+        case '&':  entity = "&amp;";  break;
+        case '<':  entity = "&lt;";   break;
+        case '>':  entity = "&gt;";   break;
+        case '"':  entity = "&quot;"; break;
+        case '\'': entity = "&apos;"; break;
+        case '\0': return sink.write(run, p - run);
+        default:   continue;
+        }
+        if (!sink.write(run, p - run) || !sink.write(entity, strlen(entity))) {
+            return false;
+        }
+        run = p + 1;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Writes a constant string stored in flash (`PROGMEM`).
+    @param    sink
+                Where to write to.
+    @param    fragment
+                The string.
+    @return success state.
+*/
+/**************************************************************************/
+bool TR064SoapEnvelope::writeProgmem(TR064ByteSink& sink, const char* fragment) {
+    char chunk[32];
+    size_t len = strlen_P(fragment);
+    while (len > 0) {
+        size_t n = len < sizeof(chunk) ? len : sizeof(chunk);
+        memcpy_P(chunk, fragment, n);
+        if (!sink.write(chunk, n)) {
+            return false;
+        }
+        fragment += n;
+        len -= n;
+    }
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Formats the SOAPACTION header of an action (`<service type>#<action>`).
+    @param    buf
+                The buffer.
+    @param    size
+                Size of the buffer.
+    @param    service
+                Name of the service, without the `urn:dslforum-org:service:` prefix.
+    @param    action
+                Name of the action.
+    @return The length of the header value; if it is not smaller than `size`,
+            the value was truncated.
+*/
+/**************************************************************************/
+size_t TR064SoapEnvelope::soapAction(char* buf, size_t size, const char* service, const char* action) {
+    int n = snprintf_P(buf, size, PSTR("urn:dslforum-org:service:%s#%s"), service, action);
+    return n < 0 ? size : (size_t) n;
+}
@@ -0,0 +1,69 @@
+/*!
+ * @file tr064_soap.h
+ *
+ * Writer for the SOAP envelopes of TR-064 actions. The envelope is never
+ * assembled in memory: it is written in pieces to a `TR064ByteSink` (e.g.
+ * straight into the send buffer of the HTTP client), its length is
+ * computed beforehand for the `Content-Length` header. Constant fragments
+ * live in flash, argument values are XML-escaped.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_soap_h
+#define tr064_soap_h
+
+#include "Arduino.h"
+#include "tr064_transport.h"
+#include "tr064_http.h"
+
+#ifndef TR064_SOAP_MAX_ARGS
+#define TR064_SOAP_MAX_ARGS         16 ///< Maximal number of arguments of an action
+#endif
+#ifndef TR064_SOAP_ACTION_BUFFER
+#define TR064_SOAP_ACTION_BUFFER    128 ///< Size of the buffer for the SOAPACTION header
+#endif
+
+/// One input argument of an action.
+struct TR064SoapArg {
+    const char* name;   ///< Name of the argument, e.g. `NewIndex`
+    const char* value;  ///< Value of the argument (not escaped)
+};
+
+/**************************************************************************/
+/*!
+    @brief  SOAP envelope of one action call. All strings are referenced,
+            not copied, and must stay valid until the envelope was written.
+*/
+/**************************************************************************/
+class TR064SoapEnvelope : public TR064RequestBody {
+    public:
+        TR064SoapEnvelope(const char* service, const char* action,
+                          const TR064SoapArg* args = nullptr, uint8_t nArgs = 0);
+        void setInitChallenge(const char* user);
+        void setClientAuth(const char* user, const char* realm, const char* nonce, const char* auth);
+        void setBody(const char* bodyStart, const char* bodyEnd);
+
+        size_t length() const override;
+        bool writeTo(TR064ByteSink& sink) const override;
+        size_t writeTo(char* buf, size_t size) const;
+
+        static bool writeEscaped(TR064ByteSink& sink, const char* value);
+        static bool writeProgmem(TR064ByteSink& sink, const char* fragment);
+        static size_t soapAction(char* buf, size_t size, const char* service, const char* action);
+
+    private:
+        const char* _service;
+        const char* _action;
+        const TR064SoapArg* _args;
+        uint8_t _nArgs;
+        const char* _user;      // nullptr: no authentication header
+        const char* _realm;
+        const char* _nonce;     // nullptr: `InitChallenge` header
+        const char* _auth;
+        const char* _bodyStart; // nullptr: composed from service and action
+        const char* _bodyEnd;
+};
+
+#endif
@@ -0,0 +1,31 @@
+/*!
+ * @file tr064_static.cpp
+ *
+ * Errors of the TR-064 client of fixed size.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064.h"
+
+/**************************************************************************/
+/*!
+    @brief  Describes a value of `TR064Static::lastError()`.
+    @param    error
+                `TR064_STATIC_OK` or one of the `TR064_STATIC_ERROR_*` codes.
+    @return A short description.
+*/
+/**************************************************************************/
+const char* tr064StaticErrorToString(int error) {
+    switch (error) {
+        case TR064_STATIC_OK: return "OK";
+        case TR064_STATIC_ERROR_SERVICES: return "Services do not fit";
+        case TR064_STATIC_ERROR_ARGS: return "Too many parameters";
+        case TR064_STATIC_ERROR_OUTPUTS: return "Too many outputs";
+        case TR064_STATIC_ERROR_NAME: return "Service/action name too long";
+        case TR064_STATIC_ERROR_TRUNCATED: return "Output does not fit";
+        case TR064_STATIC_ERROR_FAILED: return "Request failed";
+        default: return "Unknown error";
+    }
+}
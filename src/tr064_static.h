@@ -0,0 +1,170 @@
+/*!
+ * @file tr064_static.h
+ *
+ * A `TR064` whose memory is fixed at compile time, for sketches that must
+ * not fragment the heap of a small device over weeks of uptime. The
+ * service registry lives in a buffer inside the object, sized by template
+ * parameters, and actions take their arguments as C strings. After
+ * `init()`, `action()` with C string arguments and `action<Descriptor>()`
+ * make no allocations. Whatever does not fit is an error instead of being
+ * cut off: a service list that overflows the buffer leaves the client
+ * without services (`TR064_SERVICES_OVERFLOW`), and a text output that was
+ * truncated fails the call (see `lastError()`).
+ *
+ * The HTTP buffers are fixed in every `TR064` already
+ * (`TR064_HTTP_TX_BUFFER`, `TR064_HTTP_RX_BUFFER`). Still allocating: the
+ * network stack when a connection is opened, `describe()` and validation
+ * (`setValidation()`), the response cache, `fetchHosts()` and the `String`
+ * overloads of `action()`.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_static_h
+#define tr064_static_h
+
+#ifndef TR064_STATIC_SERVICE_BYTES
+#define TR064_STATIC_SERVICE_BYTES  96 ///< Default bytes of names and URLs per service of a `TR064Static`
+#endif
+
+// Values of `TR064Static::lastError()`
+#define TR064_STATIC_OK                 0  ///< The last call succeeded
+#define TR064_STATIC_ERROR_SERVICES     -1 ///< The services of the device did not fit into the buffer
+#define TR064_STATIC_ERROR_ARGS         -2 ///< More parameters than `MaxArgs`
+#define TR064_STATIC_ERROR_OUTPUTS      -3 ///< More outputs than a response can be searched for (`TR064_XML_MAX_KEYS` - 5)
+#define TR064_STATIC_ERROR_NAME         -4 ///< Service and action do not fit into `TR064_SOAP_ACTION_BUFFER`
+#define TR064_STATIC_ERROR_TRUNCATED    -5 ///< An output did not fit into its buffer or type
+#define TR064_STATIC_ERROR_FAILED       -6 ///< The request failed (connection, authentication or a fault)
+
+const char* tr064StaticErrorToString(int error);
+
+/**************************************************************************/
+/*!
+    @brief  `TR064` with a service registry of fixed size and actions with
+            C string arguments. Must not be copied; the object is large
+            (see `sizeof`), a global is the usual place for it.
+    @tparam MaxServices
+                Most services of the device; a FRITZ!Box has about 30 to 50.
+    @tparam ArenaBytes
+                Bytes for the service names and the control, SCPD and
+                event URLs of all services.
+    @tparam MaxArgs
+                Most parameters of an action (at most `TR064_SOAP_MAX_ARGS`).
+*/
+/**************************************************************************/
+template <uint16_t MaxServices, uint16_t ArenaBytes = MaxServices * TR064_STATIC_SERVICE_BYTES,
+          uint8_t MaxArgs = TR064_SOAP_MAX_ARGS>
+class TR064Static : public TR064 {
+        static_assert(MaxServices > 0, "A TR064Static needs room for at least one service");
+        static_assert(ArenaBytes > 0, "A TR064Static needs room for the names and URLs of the services");
+        static_assert(MaxArgs <= TR064_SOAP_MAX_ARGS, "MaxArgs is limited by TR064_SOAP_MAX_ARGS");
+
+    public:
+        /*!  @brief Creates the client, see `TR064::TR064()`. */
+        TR064Static() : TR064(), _error(TR064_STATIC_OK) {
+            attach();
+        }
+        /*!  @brief Creates the client, see `TR064::TR064()`. */
+        TR064Static(uint16_t port, const String& ip, const String& user, const String& pass)
+                : TR064(port, ip, user, pass), _error(TR064_STATIC_OK) {
+            attach();
+        }
+        TR064Static(const TR064Static&) = delete;
+        TR064Static& operator=(const TR064Static&) = delete;
+
+        using TR064::action;
+        bool action(const char* service, const char* act, const char* const params[][2], int nParam,
+                    TR064Output* outputs, int nOutputs);
+        int lastError() const;
+        /*!  @brief Describes a value of `lastError()`. */
+        static const char* errorToString(int error) { return tr064StaticErrorToString(error); }
+        /*!  @brief Bytes of the buffer of the service registry. */
+        static constexpr size_t storageSize() { return TR064ServiceRegistry::storageSize(MaxServices, ArenaBytes); }
+
+    private:
+        void attach() {
+            _services.useStorage(_storage, sizeof(_storage), MaxServices);
+        }
+        bool fail(int error) {
+            _error = error;
+            return false;
+        }
+
+        uint32_t _storage[(TR064ServiceRegistry::storageSize(MaxServices, ArenaBytes) + 3) / 4];
+        int _error;     // Error of the last `action()`
+};
+
+/**************************************************************************/
+/*!
+    @brief  Calls an action with C string parameters and decodes the
+            outputs into variables (see `TR064Output`), without allocating
+            memory. Limits are checked before anything is sent.
+    @param    service
+                The name of the service you want to adress.
+    @param    act
+                The action you want to perform on the service.
+    @param    params
+                A list of pairs of input parameters and values, e.g
+              `const char* params[][2] = {{ "NewIndex", "1" }}`.
+    @param    nParam
+                The number of input parameters.
+    @param    outputs
+                The bindings of the output parameters.
+    @param    nOutputs
+                The number of output parameters.
+    @return success state: false if the call failed or an output was cut
+            off (see `lastError()`). Missing or invalid outputs are only
+            reported in their `TR064Output::status`.
+*/
+/**************************************************************************/
+template <uint16_t MaxServices, uint16_t ArenaBytes, uint8_t MaxArgs>
+bool TR064Static<MaxServices, ArenaBytes, MaxArgs>::action(const char* service, const char* act,
+        const char* const params[][2], int nParam, TR064Output* outputs, int nOutputs) {
+    _error = TR064_STATIC_OK;
+    if (_state == TR064_SERVICES_OVERFLOW) {
+        return fail(TR064_STATIC_ERROR_SERVICES);
+    }
+    if (nParam < 0 || nParam > MaxArgs) {
+        TR064_LOG(DEBUG_ERROR, "[TR064][action]<Error> Too many parameters");
+        return fail(TR064_STATIC_ERROR_ARGS);
+    }
+    if (nOutputs < 0 || nOutputs > TR064_XML_MAX_KEYS - 5) {
+        TR064_LOG(DEBUG_ERROR, "[TR064][action]<Error> Too many outputs");
+        return fail(TR064_STATIC_ERROR_OUTPUTS);
+    }
+    service = TR064ServiceRegistry::stripPrefix(service);
+    if (TR064SoapEnvelope::soapAction(nullptr, 0, service, act) >= TR064_SOAP_ACTION_BUFFER) {
+        TR064_LOG(DEBUG_ERROR, "[TR064][action]<Error> Service/action name too long");
+        return fail(TR064_STATIC_ERROR_NAME);
+    }
+    TR064SoapArg args[MaxArgs > 0 ? MaxArgs : 1];
+    for (int i = 0; i < nParam; ++i) {
+        args[i].name = params[i][0];
+        args[i].value = params[i][1];
+    }
+    if (!execute(service, act, args, (uint8_t) nParam, nullptr, 0, outputs, nOutputs, nullptr)) {
+        return fail(_state == TR064_SERVICES_OVERFLOW ? TR064_STATIC_ERROR_SERVICES : TR064_STATIC_ERROR_FAILED);
+    }
+    for (int i = 0; i < nOutputs; ++i) {
+        if (outputs[i].status == TR064_OUTPUT_TRUNCATED || outputs[i].status == TR064_OUTPUT_OVERFLOW) {
+            TR064_LOG(DEBUG_ERROR, "[TR064][action]<Error> %s does not fit", outputs[i].name);
+            return fail(TR064_STATIC_ERROR_TRUNCATED);
+        }
+    }
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Returns why the last `action()` failed, or why the services are
+            missing.
+    @return `TR064_STATIC_OK` or one of the `TR064_STATIC_ERROR_*` codes.
+*/
+/**************************************************************************/
+template <uint16_t MaxServices, uint16_t ArenaBytes, uint8_t MaxArgs>
+int TR064Static<MaxServices, ArenaBytes, MaxArgs>::lastError() const {
+    return _state == TR064_SERVICES_OVERFLOW ? TR064_STATIC_ERROR_SERVICES : _error;
+}
+
+#endif
@@ -0,0 +1,95 @@
+/*!
+ * @file tr064_storage.cpp
+ *
+ * Implementations of the `TR064Storage` interface.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_storage.h"
+
+#if defined(ESP8266) || defined(ESP32)
+
+int TR064FileStorage::read(uint8_t* buf, size_t len) {
+    if (!_file) return -1;
+    return _file.read(buf, len);
+}
+
+bool TR064FileStorage::write(const char* data, size_t len) {
+    _ok = _ok && _file && _file.write((const uint8_t*) data, len) == len;
+    return _ok;
+}
+
+bool TR064FileStorage::openRead() {
+    close();
+    if (!_fs.exists(_path)) return false;
+    _file = _fs.open(_path, "r");
+    _ok = (bool) _file;
+    return _ok;
+}
+
+bool TR064FileStorage::openWrite() {
+    close();
+    _file = _fs.open(_path, "w");
+    _ok = (bool) _file;
+    return _ok;
+}
+
+bool TR064FileStorage::close() {
+    bool ok = _ok;
+    if (_file) {
+        _file.close();
+    }
+    _ok = false;
+    return ok;
+}
+
+void TR064FileStorage::remove() {
+    close();
+    _fs.remove(_path);
+}
+
+#elif defined(TR064_NATIVE)
+
+int TR064FileStorage::read(uint8_t* buf, size_t len) {
+    if (!_file) return -1;
+    size_t n = fread(buf, 1, len, _file);
+    return n > 0 || feof(_file) ? (int) n : -1;
+}
+
+bool TR064FileStorage::write(const char* data, size_t len) {
+    _ok = _ok && _file && fwrite(data, 1, len, _file) == len;
+    return _ok;
+}
+
+bool TR064FileStorage::openRead() {
+    close();
+    _file = fopen(_path, "rb");
+    _ok = _file != nullptr;
+    return _ok;
+}
+
+bool TR064FileStorage::openWrite() {
+    close();
+    _file = fopen(_path, "wb");
+    _ok = _file != nullptr;
+    return _ok;
+}
+
+bool TR064FileStorage::close() {
+    bool ok = _ok;
+    if (_file) {
+        ok = fclose(_file) == 0 && ok;
+        _file = nullptr;
+    }
+    _ok = false;
+    return ok;
+}
+
+void TR064FileStorage::remove() {
+    close();
+    ::remove(_path);
+}
+
+#endif
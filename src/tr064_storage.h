@@ -0,0 +1,99 @@
+/*!
+ * @file tr064_storage.h
+ *
+ * Persistent storage of the library, used to keep the service table of the
+ * device across reboots (see `TR064::setStorage()`), so that `init()` does
+ * not have to download and parse the description of the device again. The
+ * storage is exchangeable: the default on ESP8266/ESP32 is a file on any
+ * Arduino file system (LittleFS, SPIFFS, SD), the native build uses a
+ * plain file; RTC memory or EEPROM can be wrapped the same way.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_storage_h
+#define tr064_storage_h
+
+#include "Arduino.h"
+#include "tr064_transport.h"
+#if defined(ESP8266) || defined(ESP32)
+    #include <FS.h>
+#elif defined(TR064_NATIVE)
+    #include <stdio.h>
+#endif
+
+// Modes of `TR064::setStorage()`
+#define TR064_STORAGE_CHECK     0 ///< Check the stored services with a HEAD request of the description
+#define TR064_STORAGE_TRUST     1 ///< Use the stored services without a request, reload them if a call fails with 404/401
+
+/**************************************************************************/
+/*!
+    @brief  Abstract storage of one blob of data, written and read
+            sequentially. Writes do not need to be atomic: the data is
+            checked when it is read back.
+*/
+/**************************************************************************/
+class TR064Storage : public TR064ByteSource, public TR064ByteSink {
+    public:
+        /*!  @brief Starts reading the stored data from its beginning. @return false if nothing is stored. */
+        virtual bool openRead() = 0;
+        /*!  @brief Starts replacing the stored data. @return success state. */
+        virtual bool openWrite() = 0;
+        /*!  @brief Ends reading or writing. @return false if the data could not be written completely. */
+        virtual bool close() = 0;
+        /*!  @brief Deletes the stored data. */
+        virtual void remove() = 0;
+};
+
+#if defined(ESP8266) || defined(ESP32)
+/**************************************************************************/
+/*!
+    @brief  Storage in a file of an Arduino file system, e.g.
+            `TR064FileStorage storage(LittleFS, "/tr064.bin")`. The file
+            system has to be mounted (`begin()`) before `TR064::init()`.
+*/
+/**************************************************************************/
+class TR064FileStorage : public TR064Storage {
+    public:
+        TR064FileStorage(fs::FS& fs, const char* path) : _fs(fs), _path(path), _ok(false) {}
+        int read(uint8_t* buf, size_t len) override;
+        bool write(const char* data, size_t len) override;
+        bool openRead() override;
+        bool openWrite() override;
+        bool close() override;
+        void remove() override;
+
+    private:
+        fs::FS& _fs;
+        const char* _path;
+        fs::File _file;
+        bool _ok;
+};
+
+#elif defined(TR064_NATIVE)
+/**************************************************************************/
+/*!
+    @brief  Storage in a file (native build).
+*/
+/**************************************************************************/
+class TR064FileStorage : public TR064Storage {
+    public:
+        explicit TR064FileStorage(const char* path) : _path(path), _file(nullptr), _ok(false) {}
+        ~TR064FileStorage() { close(); }
+        int read(uint8_t* buf, size_t len) override;
+        bool write(const char* data, size_t len) override;
+        bool openRead() override;
+        bool openWrite() override;
+        bool close() override;
+        void remove() override;
+
+    private:
+        const char* _path;
+        FILE* _file;
+        bool _ok;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,574 @@
+/*!
+ * @file tr064_tls.cpp
+ *
+ * HTTPS transport with session resumption and certificate pinning.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_tls.h"
+
+#ifdef TR064_TLS
+
+/// Parses `len` bytes written as hex digits, optionally separated by `:` or spaces.
+static bool parseFingerprint(const char* hex, uint8_t* out, size_t len) {
+    size_t n = 0;
+    int high = -1;
+    for (const char* p = hex; *p; ++p) {
+        char c = *p;
+        int v;
+        if (c >= '0' && c <= '9') v = c - '0';
+        else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+        else if ((c == ':' || c == ' ') && high < 0) continue;
+        else return false;
+        if (high < 0) {
+            high = v;
+            continue;
+        }
+        if (n >= len) return false;
+        out[n++] = (uint8_t) (high << 4 | v);
+        high = -1;
+    }
+    return n == len && high < 0;
+}
+
+#if defined(ESP8266) || defined(ESP32)
+
+#if defined(ESP32)
+    #include <mbedtls/x509.h>
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Creates the transport, without pin and without session.
+*/
+/**************************************************************************/
+TR064TlsTransport::TR064TlsTransport() : TR064ClientTransport(_secure), _trust(false), _port(0) {
+#if defined(ESP8266)
+    _anchor = nullptr;
+    _pinned = false;
+#endif
+    _host[0] = '\0';
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+TR064TlsTransport::~TR064TlsTransport() {
+    _secure.stop();
+#if defined(ESP8266)
+    delete _anchor;
+#endif
+}
+
+/**************************************************************************/
+/*!
+    @brief  Pins the certificate of the device by its SHA-1 fingerprint
+            (ESP8266 only, BearSSL does not check names then).
+    @param    hex
+                The fingerprint, 40 hex digits, optionally separated by
+                `:` or spaces.
+    @return false if the fingerprint is malformed or not supported.
+*/
+/**************************************************************************/
+bool TR064TlsTransport::setFingerprint(const char* hex) {
+#if defined(ESP8266)
+    if (!parseFingerprint(hex, _fingerprint, sizeof(_fingerprint))) {
+        return false;
+    }
+    _pinned = true;
+    _trust = true;
+    return true;
+#else
+    (void) hex;
+    return false;
+#endif
+}
+
+/**************************************************************************/
+/*!
+    @brief  Pins the certificate of the device itself (PEM), e.g. the one
+            downloaded from its web interface. On ESP32 the text is
+            referenced and must stay valid, and the certificate has to
+            name the host connected to.
+    @return false if the certificate cannot be read.
+*/
+/**************************************************************************/
+bool TR064TlsTransport::setCertificate(const char* pem) {
+#if defined(ESP8266)
+    delete _anchor;
+    _anchor = new BearSSL::X509List(pem);
+    if (_anchor->getCount() == 0) {
+        delete _anchor;
+        _anchor = nullptr;
+        return false;
+    }
+#else
+    _secure.setCACert(pem);
+#endif
+    _trust = true;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Accepts any certificate. The connection is encrypted but not
+            protected against a man in the middle.
+*/
+/**************************************************************************/
+void TR064TlsTransport::setInsecure() {
+#if defined(ESP32)
+    if (!_trust) {
+        _secure.setInsecure();
+    }
+#endif
+    _trust = true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Forgets the kept session, the next connection makes a full
+            handshake.
+*/
+/**************************************************************************/
+void TR064TlsTransport::clearSession() {
+#if defined(ESP8266)
+    _session = BearSSL::Session();
+#endif
+}
+
+/**************************************************************************/
+/*!
+    @brief  Connects and makes the handshake, resuming the session of the
+            previous connection to the same host and port if there is one
+            (ESP8266).
+*/
+/**************************************************************************/
+bool TR064TlsTransport::connect(const char* host, uint16_t port) {
+    if (!_trust) {
+        ++_stats.failures;
+        return false;
+    }
+    if (port != _port || strcmp(host, _host) != 0) {
+        clearSession();
+        _port = port;
+        strncpy(_host, host, sizeof(_host) - 1);
+        _host[sizeof(_host) - 1] = '\0';
+    }
+#if defined(ESP8266)
+    if (_pinned) {
+        _secure.setFingerprint(_fingerprint);
+    } else if (_anchor) {
+        _secure.setTrustAnchors(_anchor);
+    } else {
+        _secure.setInsecure();
+    }
+    // A session offered and accepted keeps its ID
+    const br_ssl_session_parameters* cached = _session.getSession();
+    uint8_t offered[32];
+    uint8_t offeredLen = cached->session_id_len;
+    memcpy(offered, cached->session_id, offeredLen);
+    _secure.setSession(&_session);
+#endif
+    unsigned long start = micros();
+    if (_secure.connect(host, port) != 1) {
+        ++_stats.failures;
+#if defined(ESP8266)
+        if (_secure.getLastSSLError() == BR_ERR_X509_NOT_TRUSTED) ++_stats.rejected;
+#else
+        char text[2];
+        if (_secure.lastError(text, sizeof(text)) == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED) ++_stats.rejected;
+#endif
+        return false;
+    }
+    uint32_t us = (uint32_t) (micros() - start);
+    _stats.lastUs = us;
+#if defined(ESP8266)
+    if (offeredLen > 0 && cached->session_id_len == offeredLen && memcmp(cached->session_id, offered, offeredLen) == 0) {
+        ++_stats.resumed;
+        _stats.resumedUs += us;
+        return true;
+    }
+#endif
+    ++_stats.handshakes;
+    _stats.fullUs += us;
+    return true;
+}
+
+#elif defined(TR064_TLS_OPENSSL)
+
+#include <errno.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+// Socket BIO that never raises SIGPIPE and never blocks, whatever the mode of the socket
+static int bioWrite(BIO* bio, const char* data, int len) {
+    BIO_clear_retry_flags(bio);
+    ssize_t n = send((int) (intptr_t) BIO_get_data(bio), data, (size_t) len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        BIO_set_retry_write(bio);
+    }
+    return (int) n;
+}
+
+static int bioRead(BIO* bio, char* buf, int len) {
+    BIO_clear_retry_flags(bio);
+    ssize_t n = recv((int) (intptr_t) BIO_get_data(bio), buf, (size_t) len, MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        BIO_set_retry_read(bio);
+    }
+    return (int) n;
+}
+
+static long bioCtrl(BIO* bio, int cmd, long num, void* ptr) {
+    (void) bio;
+    (void) num;
+    (void) ptr;
+    return cmd == BIO_CTRL_FLUSH ? 1 : 0;
+}
+
+static BIO* socketBio(int fd) {
+    static BIO_METHOD* method = nullptr;
+    if (!method) {
+        method = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "tr064 socket");
+        BIO_meth_set_write(method, bioWrite);
+        BIO_meth_set_read(method, bioRead);
+        BIO_meth_set_ctrl(method, bioCtrl);
+    }
+    BIO* bio = BIO_new(method);
+    if (bio) {
+        BIO_set_data(bio, (void*) (intptr_t) fd);
+        BIO_set_init(bio, 1);
+    }
+    return bio;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Creates the transport, without pin and without session.
+*/
+/**************************************************************************/
+TR064TlsTransport::TR064TlsTransport() : _ssl(nullptr), _session(nullptr), _established(false), _trust(false),
+                                         _pinned(false), _port(0), _timeout(5000), _started(0) {
+    _host[0] = '\0';
+    memset(&_stats, 0, sizeof(_stats));
+    _ctx = SSL_CTX_new(TLS_client_method());
+    if (_ctx) {
+        SSL_CTX_set_min_proto_version(_ctx, TLS1_2_VERSION);
+        // Sessions are kept by the transport, for the host it connects to
+        SSL_CTX_set_session_cache_mode(_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(_ctx, keepSession);
+        SSL_CTX_set_app_data(_ctx, this);
+    }
+}
+
+TR064TlsTransport::~TR064TlsTransport() {
+    stop();
+    clearSession();
+    SSL_CTX_free(_ctx);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Pins the certificate of the device by its SHA-256 fingerprint
+            (e.g. `openssl x509 -noout -fingerprint -sha256`). Names and
+            validity are not checked then.
+    @param    hex
+                The fingerprint, 64 hex digits, optionally separated by
+                `:` or spaces.
+    @return false if the fingerprint is malformed.
+*/
+/**************************************************************************/
+bool TR064TlsTransport::setFingerprint(const char* hex) {
+    if (!parseFingerprint(hex, _fingerprint, sizeof(_fingerprint))) {
+        return false;
+    }
+    _pinned = true;
+    _trust = true;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Pins the certificate of the device itself (PEM), e.g. the one
+            downloaded from its web interface. It is trusted as it is,
+            whatever host name it was issued for.
+    @return false if the certificate cannot be read.
+*/
+/**************************************************************************/
+bool TR064TlsTransport::setCertificate(const char* pem) {
+    if (!_ctx) {
+        return false;
+    }
+    BIO* bio = BIO_new_mem_buf(pem, -1);
+    X509* cert = bio ? PEM_read_bio_X509(bio, nullptr, nullptr, nullptr) : nullptr;
+    BIO_free(bio);
+    if (!cert) {
+        ERR_clear_error();
+        return false;
+    }
+    X509_STORE* store = SSL_CTX_get_cert_store(_ctx);
+    X509_STORE_add_cert(store, cert);
+    X509_free(cert);
+    // The certificate is a trust anchor even if it is not self-signed
+    X509_STORE_set_flags(store, X509_V_FLAG_PARTIAL_CHAIN);
+    SSL_CTX_set_verify(_ctx, SSL_VERIFY_PEER, nullptr);
+    _trust = true;
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Accepts any certificate. The connection is encrypted but not
+            protected against a man in the middle.
+*/
+/**************************************************************************/
+void TR064TlsTransport::setInsecure() {
+    _trust = true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Forgets the kept session, the next connection makes a full
+            handshake.
+*/
+/**************************************************************************/
+void TR064TlsTransport::clearSession() {
+    if (_session) {
+        SSL_SESSION_free(_session);
+        _session = nullptr;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Connects and makes the handshake, resuming the session of the
+            previous connection to the same host and port if there is one.
+            Both together take at most the connect timeout.
+*/
+/**************************************************************************/
+bool TR064TlsTransport::connect(const char* host, uint16_t port) {
+    if (!prepare(host, port) || !_tcp.connect(host, port) || !startHandshake()) {
+        return false;
+    }
+    unsigned long start = millis();
+    while (true) {
+        int rc = handshake();
+        if (rc != 0) {
+            return rc == 1;
+        }
+        uint32_t elapsed = millis() - start;
+        if (elapsed >= _timeout || !wait(_timeout - elapsed)) {
+            ++_stats.failures;
+            stop();
+            return false;
+        }
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Starts the connection, see `pollConnect()`. Name resolution
+            blocks, like with `TR064PosixTransport`.
+*/
+/**************************************************************************/
+bool TR064TlsTransport::beginConnect(const char* host, uint16_t port) {
+    return prepare(host, port) && _tcp.beginConnect(host, port);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Advances the connect and then the handshake, without waiting.
+    @return 1 if the handshake finished, 0 if pending, -1 if it failed.
+*/
+/**************************************************************************/
+int TR064TlsTransport::pollConnect() {
+    if (_established) {
+        return 1;
+    }
+    if (!_ssl) {
+        int rc = _tcp.pollConnect();
+        if (rc != 1) {
+            return rc;
+        }
+        if (!startHandshake()) {
+            return -1;
+        }
+    }
+    return handshake();
+}
+
+bool TR064TlsTransport::connected() {
+    return _established && _tcp.connected();
+}
+
+size_t TR064TlsTransport::write(const uint8_t* data, size_t len) {
+    size_t sent = 0;
+    unsigned long start = millis();
+    while (_established && sent < len) {
+        int n = SSL_write(_ssl, data + sent, (int) (len - sent));
+        if (n > 0) {
+            sent += (size_t) n;
+            continue;
+        }
+        int err = SSL_get_error(_ssl, n);
+        uint32_t elapsed = millis() - start;
+        if ((err != SSL_ERROR_WANT_READ && err != SSL_ERROR_WANT_WRITE) || elapsed >= _timeout || !wait(_timeout - elapsed)) {
+            ERR_clear_error();
+            break;
+        }
+    }
+    return sent;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads decrypted data, waiting up to `timeout` ms for a complete
+            record. Session tickets sent by the device are taken in here.
+*/
+/**************************************************************************/
+int TR064TlsTransport::read(uint8_t* buf, size_t len, uint32_t timeout) {
+    if (!_established) {
+        return TR064_TRANSPORT_CLOSED;
+    }
+    unsigned long start = millis();
+    while (true) {
+        int n = SSL_read(_ssl, buf, (int) len);
+        if (n > 0) {
+            return n;
+        }
+        int err = SSL_get_error(_ssl, n);
+        if (err != SSL_ERROR_WANT_READ && err != SSL_ERROR_WANT_WRITE) {
+            ERR_clear_error();
+            return TR064_TRANSPORT_CLOSED;
+        }
+        uint32_t elapsed = millis() - start;
+        if (elapsed >= timeout || !wait(timeout - elapsed)) {
+            return 0;
+        }
+    }
+}
+
+void TR064TlsTransport::stop() {
+    if (_ssl) {
+        if (_established) {
+            SSL_shutdown(_ssl);
+        }
+        SSL_free(_ssl);
+        _ssl = nullptr;
+        ERR_clear_error();
+    }
+    _established = false;
+    _tcp.stop();
+}
+
+/// Checks whether a connection may be opened and remembers its host, whose session is offered.
+bool TR064TlsTransport::prepare(const char* host, uint16_t port) {
+    stop();
+    if (!_ctx || !_trust) {
+        ++_stats.failures;
+        return false;
+    }
+    if (port != _port || strcmp(host, _host) != 0) {
+        clearSession();
+        _port = port;
+        if (strlen(host) < sizeof(_host)) {
+            strcpy(_host, host);
+        } else {
+            _host[0] = '\0'; // Too long to be remembered, its sessions are not resumed
+        }
+    }
+    return true;
+}
+
+/// Sets up the TLS connection on the connected socket.
+bool TR064TlsTransport::startHandshake() {
+    _ssl = SSL_new(_ctx);
+    BIO* bio = _ssl ? socketBio(_tcp.fd()) : nullptr;
+    if (!bio) {
+        ++_stats.failures;
+        stop();
+        return false;
+    }
+    SSL_set_bio(_ssl, bio, bio);
+    // Server name indication takes names only, not addresses
+    uint8_t addr[16];
+    if (_host[0] != '\0' && inet_pton(AF_INET, _host, addr) != 1 && inet_pton(AF_INET6, _host, addr) != 1) {
+        SSL_set_tlsext_host_name(_ssl, _host);
+    }
+    if (_session) {
+        SSL_set_session(_ssl, _session);
+    }
+    _started = micros();
+    return true;
+}
+
+/// Advances the handshake. @return 1 when done, 0 if it waits for the socket (see `wait()`), -1 if it failed.
+int TR064TlsTransport::handshake() {
+    int rc = SSL_connect(_ssl);
+    if (rc != 1) {
+        int err = SSL_get_error(_ssl, rc);
+        if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+            return 0;
+        }
+        if (SSL_get_verify_result(_ssl) != X509_V_OK) ++_stats.rejected;
+        ++_stats.failures;
+        stop();
+        return -1;
+    }
+    if (_pinned) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        X509* cert = SSL_get1_peer_certificate(_ssl);
+#else
+        X509* cert = SSL_get_peer_certificate(_ssl);
+#endif
+        uint8_t md[EVP_MAX_MD_SIZE];
+        unsigned int mdLen = 0;
+        bool match = cert && X509_digest(cert, EVP_sha256(), md, &mdLen) == 1
+            && mdLen == sizeof(_fingerprint) && memcmp(md, _fingerprint, mdLen) == 0;
+        X509_free(cert);
+        if (!match) {
+            ++_stats.rejected;
+            ++_stats.failures;
+            // A session of this certificate must not be resumed either
+            clearSession();
+            stop();
+            return -1;
+        }
+    }
+    uint32_t us = (uint32_t) (micros() - _started);
+    _stats.lastUs = us;
+    if (SSL_session_reused(_ssl)) {
+        ++_stats.resumed;
+        _stats.resumedUs += us;
+    } else {
+        ++_stats.handshakes;
+        _stats.fullUs += us;
+    }
+    _established = true;
+    return 1;
+}
+
+/// Waits up to `timeout` ms until the socket is ready for what the TLS connection waits for.
+bool TR064TlsTransport::wait(uint32_t timeout) {
+    struct pollfd pfd = {_tcp.fd(), (short) (SSL_want_write(_ssl) ? POLLOUT : POLLIN), 0};
+    int ready = poll(&pfd, 1, (int) timeout);
+    return ready > 0 || (ready < 0 && errno == EINTR);
+}
+
+/// Keeps the newest session of a connection (callback of OpenSSL, which hands over its reference).
+int TR064TlsTransport::keepSession(SSL* ssl, SSL_SESSION* session) {
+    TR064TlsTransport* transport = (TR064TlsTransport*) SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+    transport->clearSession();
+    transport->_session = session;
+    return 1;
+}
+
+#endif
+
+#endif
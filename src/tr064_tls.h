@@ -0,0 +1,145 @@
+/*!
+ * @file tr064_tls.h
+ *
+ * HTTPS transport for the TR-064 TLS port (`TR064_TLS_PORT`, 49443 on a
+ * FRITZ!Box), to be set with `TR064::setTransport()`. A full handshake
+ * costs seconds of RSA/ECDHE work on an ESP8266, so the transport keeps
+ * the TLS session of the last connection and resumes it on the next one;
+ * together with the kept-alive connection (`TR064::setKeepAlive()`) most
+ * actions need no handshake at all. The self-signed certificate of the
+ * router is pinned, by fingerprint or by the certificate itself. Full and
+ * resumed handshakes are counted and timed separately, see `stats()`.
+ *
+ * ESP8266: BearSSL `WiFiClientSecure`, SHA-1 fingerprints, sessions are
+ * resumed. ESP32: `WiFiClientSecure` (mbedTLS), certificate pinning only,
+ * without session resumption. Native build: OpenSSL (`TR064_TLS_OPENSSL`,
+ * set by CMake if OpenSSL is found), SHA-256 fingerprints.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_tls_h
+#define tr064_tls_h
+
+#include "Arduino.h"
+#include "tr064_transport.h"
+#if defined(ESP8266) || defined(ESP32)
+    #include <WiFiClientSecure.h>
+#endif
+
+#define TR064_TLS_PORT              49443 ///< TR-064 port of a FRITZ!Box for HTTPS (`DeviceInfo:1` `GetSecurityPort`)
+
+#if defined(ESP8266) || defined(ESP32) || defined(TR064_TLS_OPENSSL)
+#define TR064_TLS                   1 ///< Defined if `TR064TlsTransport` is available
+
+#ifndef TR064_TLS_HOST
+#define TR064_TLS_HOST              64 ///< Longest host name whose session is kept (including terminator)
+#endif
+
+/// Handshakes of a `TR064TlsTransport`, see `TR064TlsTransport::stats()`.
+struct TR064TlsStats {
+    uint32_t handshakes;    ///< Full handshakes
+    uint32_t resumed;       ///< Handshakes that resumed the kept session
+    uint32_t failures;      ///< Failed handshakes (including rejected certificates)
+    uint32_t rejected;      ///< Certificates that did not match the pinned one
+    uint32_t lastUs;        ///< Duration of the last successful handshake (us)
+    uint64_t fullUs;        ///< Sum of the durations of the full handshakes (us)
+    uint64_t resumedUs;     ///< Sum of the durations of the resumed handshakes (us)
+};
+
+#if defined(ESP8266) || defined(ESP32)
+/**************************************************************************/
+/*!
+    @brief  HTTPS transport on top of a `WiFiClientSecure`. One of
+            `setFingerprint()` (ESP8266 only), `setCertificate()` or
+            `setInsecure()` has to be called before the first connection.
+*/
+/**************************************************************************/
+class TR064TlsTransport : public TR064ClientTransport {
+    public:
+        TR064TlsTransport();
+        ~TR064TlsTransport();
+        bool setFingerprint(const char* hex);
+        bool setCertificate(const char* pem);
+        void setInsecure();
+        void clearSession();
+        /*!  @brief Counters and durations of the handshakes. */
+        const TR064TlsStats& stats() const { return _stats; }
+        bool connect(const char* host, uint16_t port) override;
+
+    private:
+        WiFiClientSecure _secure;
+#if defined(ESP8266)
+        BearSSL::Session _session;
+        BearSSL::X509List* _anchor;
+        uint8_t _fingerprint[20];
+        bool _pinned;
+#endif
+        bool _trust;            // A pin was set or `setInsecure()` was called
+        char _host[TR064_TLS_HOST]; // Host and port the session belongs to
+        uint16_t _port;
+        TR064TlsStats _stats;
+};
+
+#else
+typedef struct ssl_ctx_st SSL_CTX;
+typedef struct ssl_st SSL;
+typedef struct ssl_session_st SSL_SESSION;
+
+/**************************************************************************/
+/*!
+    @brief  HTTPS transport on top of OpenSSL and a POSIX socket (native
+            build). One of `setFingerprint()`, `setCertificate()` or
+            `setInsecure()` has to be called before the first connection.
+            The handshake of `beginConnect()`/`pollConnect()` does not
+            block, like the connect itself.
+*/
+/**************************************************************************/
+class TR064TlsTransport : public TR064Transport {
+    public:
+        TR064TlsTransport();
+        ~TR064TlsTransport();
+        bool setFingerprint(const char* hex);
+        bool setCertificate(const char* pem);
+        void setInsecure();
+        void clearSession();
+        /*!  @brief Counters and durations of the handshakes. */
+        const TR064TlsStats& stats() const { return _stats; }
+        /*!  @brief Longest time for the connect and the handshake (ms). */
+        void setConnectTimeout(uint32_t timeout) { _tcp.setConnectTimeout(timeout); _timeout = timeout; }
+
+        bool connect(const char* host, uint16_t port) override;
+        bool connected() override;
+        size_t write(const uint8_t* data, size_t len) override;
+        int read(uint8_t* buf, size_t len, uint32_t timeout) override;
+        void stop() override;
+        bool beginConnect(const char* host, uint16_t port) override;
+        int pollConnect() override;
+
+    private:
+        bool prepare(const char* host, uint16_t port);
+        bool startHandshake();
+        int handshake();
+        bool wait(uint32_t timeout);
+        static int keepSession(SSL* ssl, SSL_SESSION* session);
+
+        TR064PosixTransport _tcp;
+        SSL_CTX* _ctx;
+        SSL* _ssl;
+        SSL_SESSION* _session;  // Session of the last connection, offered for resumption
+        bool _established;      // The handshake of `_ssl` finished
+        bool _trust;            // A pin was set or `setInsecure()` was called
+        uint8_t _fingerprint[32]; // SHA-256 of the certificate
+        bool _pinned;
+        char _host[TR064_TLS_HOST]; // Host and port of the connection (and of `_session`)
+        uint16_t _port;
+        uint32_t _timeout;
+        unsigned long _started; // `micros()` at the start of the handshake
+        TR064TlsStats _stats;
+};
+#endif
+
+#endif
+
+#endif
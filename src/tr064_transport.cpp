@@ -0,0 +1,407 @@
+/*!
+ * @file tr064_transport.cpp
+ *
+ * Implementations of the `TR064Transport` interface.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_transport.h"
+
+#if defined(ESP8266) || defined(ESP32)
+
+/**************************************************************************/
+/*!
+    @brief  Wraps an Arduino `Client`. The client must outlive the transport.
+    @param    client
+                The client used for the connection (e.g. a `WiFiClient`).
+*/
+/**************************************************************************/
+TR064ClientTransport::TR064ClientTransport(Client& client) : _client(client) {
+}
+
+bool TR064ClientTransport::connect(const char* host, uint16_t port) {
+    return _client.connect(host, port) == 1;
+}
+
+bool TR064ClientTransport::connected() {
+    return _client.connected();
+}
+
+size_t TR064ClientTransport::write(const uint8_t* data, size_t len) {
+    return _client.write(data, len);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Opens a connection, waiting at most for the connect timeout.
+*/
+/**************************************************************************/
+bool TR064WiFiTransport::connect(const char* host, uint16_t port) {
+#if defined(ESP32)
+    return _wifiClient.connect(host, port, (int32_t) _connectTimeout) == 1;
+#else
+    // The ESP8266 `WiFiClient` waits for the connection as long as its stream timeout
+    _wifiClient.setTimeout(_connectTimeout);
+    return _wifiClient.connect(host, port) == 1;
+#endif
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads whatever is available, waiting up to `timeout` ms for data.
+            Data still buffered after the peer closed the socket is returned
+            before `TR064_TRANSPORT_CLOSED`.
+*/
+/**************************************************************************/
+int TR064ClientTransport::read(uint8_t* buf, size_t len, uint32_t timeout) {
+    unsigned long start = millis();
+    while (true) {
+        int avail = _client.available();
+        if (avail > 0) {
+            return _client.read(buf, (size_t) avail < len ? (size_t) avail : len);
+        }
+        if (!_client.connected()) {
+            return TR064_TRANSPORT_CLOSED;
+        }
+        if (millis() - start >= timeout) {
+            return 0;
+        }
+        delay(1);
+    }
+}
+
+void TR064ClientTransport::stop() {
+    _client.stop();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Starts the `WiFiServer` on `port` (which must not be 0).
+*/
+/**************************************************************************/
+bool TR064WiFiListener::begin(uint16_t port) {
+    if (port == 0) {
+        return false;
+    }
+    end();
+    _server.begin(port);
+    _port = port;
+    return true;
+}
+
+TR064Transport* TR064WiFiListener::accept() {
+    if (_port == 0) {
+        return nullptr;
+    }
+    WiFiClient client = _server.available();
+    if (!client) {
+        return nullptr;
+    }
+    _connection.adopt(client);
+    return &_connection;
+}
+
+void TR064WiFiListener::end() {
+    _connection.stop();
+    if (_port != 0) {
+        _server.stop();
+        _port = 0;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  The IP of the WiFi station interface (the device is expected in
+            the same network).
+*/
+/**************************************************************************/
+bool TR064WiFiListener::localAddress(const char* host, char* buf, size_t len) {
+    (void) host;
+    IPAddress ip = WiFi.localIP();
+    snprintf(buf, len, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    return (uint32_t) ip != 0;
+}
+
+#elif defined(TR064_NATIVE)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+TR064PosixTransport::TR064PosixTransport() : _fd(-1), _pendingFd(-1), _pendingFlags(0), _connectTimeout(5000) {
+}
+
+TR064PosixTransport::~TR064PosixTransport() {
+    stop();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Resolves `host` and connects with a bounded (non-blocking)
+            connect, then switches the socket back to blocking mode.
+*/
+/**************************************************************************/
+bool TR064PosixTransport::connect(const char* host, uint16_t port) {
+    stop();
+    char service[6];
+    snprintf(service, sizeof(service), "%u", (unsigned) port);
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(host, service, &hints, &result) != 0) {
+        return false;
+    }
+    for (struct addrinfo* ai = result; ai && _fd < 0; ai = ai->ai_next) {
+        int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        int rc = ::connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (rc < 0 && errno == EINPROGRESS) {
+            struct pollfd pfd = {fd, POLLOUT, 0};
+            int err = 0;
+            socklen_t errLen = sizeof(err);
+            if (poll(&pfd, 1, (int) _connectTimeout) == 1
+                    && getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errLen) == 0 && err == 0) {
+                rc = 0;
+            }
+        }
+        if (rc == 0) {
+            fcntl(fd, F_SETFL, flags);
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            _fd = fd;
+        } else {
+            close(fd);
+        }
+    }
+    freeaddrinfo(result);
+    return _fd >= 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Resolves `host` and starts a non-blocking connect to its first
+            address, see `pollConnect()`. Name resolution itself blocks.
+*/
+/**************************************************************************/
+bool TR064PosixTransport::beginConnect(const char* host, uint16_t port) {
+    stop();
+    char service[6];
+    snprintf(service, sizeof(service), "%u", (unsigned) port);
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(host, service, &hints, &result) != 0) {
+        return false;
+    }
+    for (struct addrinfo* ai = result; ai && _pendingFd < 0 && _fd < 0; ai = ai->ai_next) {
+        int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        int rc = ::connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (rc == 0 || errno == EINPROGRESS) {
+            _pendingFd = fd;
+            _pendingFlags = flags;
+        } else {
+            close(fd);
+        }
+    }
+    freeaddrinfo(result);
+    return _pendingFd >= 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Checks (without waiting) whether the connect started by
+            `beginConnect()` finished.
+    @return 1 if connected, 0 if pending, -1 if it failed.
+*/
+/**************************************************************************/
+int TR064PosixTransport::pollConnect() {
+    if (_pendingFd < 0) {
+        return _fd >= 0 ? 1 : -1;
+    }
+    struct pollfd pfd = {_pendingFd, POLLOUT, 0};
+    int ready = poll(&pfd, 1, 0);
+    if (ready == 0 || (ready < 0 && errno == EINTR)) {
+        return 0;
+    }
+    int fd = _pendingFd;
+    _pendingFd = -1;
+    int err = 0;
+    socklen_t errLen = sizeof(err);
+    if (ready < 0 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errLen) != 0 || err != 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, _pendingFlags);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    _fd = fd;
+    return 1;
+}
+
+bool TR064PosixTransport::connected() {
+    if (_fd < 0) return false;
+    // A readable socket with nothing to read has been closed by the peer.
+    struct pollfd pfd = {_fd, POLLIN, 0};
+    if (poll(&pfd, 1, 0) == 1) {
+        char c;
+        ssize_t n = recv(_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t TR064PosixTransport::write(const uint8_t* data, size_t len) {
+    size_t sent = 0;
+    while (_fd >= 0 && sent < len) {
+        ssize_t n = send(_fd, data + sent, len - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        sent += (size_t) n;
+    }
+    return sent;
+}
+
+int TR064PosixTransport::read(uint8_t* buf, size_t len, uint32_t timeout) {
+    if (_fd < 0) return TR064_TRANSPORT_CLOSED;
+    struct pollfd pfd = {_fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, (int) timeout);
+    if (ready == 0) return 0;
+    if (ready < 0) return errno == EINTR ? 0 : TR064_TRANSPORT_CLOSED;
+    ssize_t n = recv(_fd, buf, len, 0);
+    if (n > 0) return (int) n;
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) return 0;
+    return TR064_TRANSPORT_CLOSED;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Takes over a connected socket, e.g. one accepted by a
+            `TR064PosixListener`.
+*/
+/**************************************************************************/
+void TR064PosixTransport::adopt(int fd) {
+    stop();
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    _fd = fd;
+}
+
+void TR064PosixTransport::stop() {
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+    if (_pendingFd >= 0) {
+        close(_pendingFd);
+        _pendingFd = -1;
+    }
+}
+
+TR064PosixListener::TR064PosixListener() : _fd(-1), _port(0) {
+}
+
+TR064PosixListener::~TR064PosixListener() {
+    end();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Listens on all IPv4 interfaces. With `port` 0, the system picks
+            a free port (see `port()`).
+*/
+/**************************************************************************/
+bool TR064PosixListener::begin(uint16_t port) {
+    end();
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    socklen_t addrLen = sizeof(addr);
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 || listen(fd, 4) < 0
+            || getsockname(fd, (struct sockaddr*) &addr, &addrLen) < 0) {
+        close(fd);
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    _fd = fd;
+    _port = ntohs(addr.sin_port);
+    return true;
+}
+
+TR064Transport* TR064PosixListener::accept() {
+    if (_fd < 0) {
+        return nullptr;
+    }
+    int fd = ::accept(_fd, nullptr, nullptr);
+    if (fd < 0) {
+        return nullptr;
+    }
+    // Accepted sockets do not inherit O_NONBLOCK on Linux, reads wait with poll()
+    _connection.adopt(fd);
+    return &_connection;
+}
+
+void TR064PosixListener::end() {
+    _connection.stop();
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+    _port = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  The source address the system chooses for connections to
+            `host` (found with an unconnected UDP socket, nothing is sent).
+*/
+/**************************************************************************/
+bool TR064PosixListener::localAddress(const char* host, char* buf, size_t len) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(host, "9", &hints, &result) != 0) {
+        return false;
+    }
+    bool ok = false;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd >= 0 && ::connect(fd, result->ai_addr, result->ai_addrlen) == 0) {
+        struct sockaddr_in addr;
+        socklen_t addrLen = sizeof(addr);
+        ok = getsockname(fd, (struct sockaddr*) &addr, &addrLen) == 0
+            && inet_ntop(AF_INET, &addr.sin_addr, buf, (socklen_t) len) != nullptr;
+    }
+    if (fd >= 0) close(fd);
+    freeaddrinfo(result);
+    return ok;
+}
+
+#endif
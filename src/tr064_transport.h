@@ -0,0 +1,229 @@
+/*!
+ * @file tr064_transport.h
+ *
+ * Transport layer of the TR-064 library. The `TR064` class talks to the
+ * device exclusively through a `TR064Transport`, so that the socket
+ * implementation can be exchanged: the default on ESP8266/ESP32 wraps a
+ * `WiFiClient`, the native (Linux) build uses plain POSIX sockets.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_transport_h
+#define tr064_transport_h
+
+#include "Arduino.h"
+#if defined(ESP8266)
+    #include <ESP8266WiFi.h>
+#elif defined(ESP32)
+    #include <WiFi.h>
+#endif
+
+/// Return value of `TR064Transport::read()` if the connection was closed.
+#define TR064_TRANSPORT_CLOSED      -1
+
+#ifndef TR064_WIFI_CONNECT_TIMEOUT
+#define TR064_WIFI_CONNECT_TIMEOUT  1000 ///< Default longest wait (ms) of a `TR064WiFiTransport` for a new connection
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Abstract byte transport (connect, write, streaming read, close)
+            used by the HTTP layer of the library.
+*/
+/**************************************************************************/
+class TR064Transport {
+    public:
+        virtual ~TR064Transport() {}
+        /*!  @brief Opens a connection to `host`:`port`. @return success state. */
+        virtual bool connect(const char* host, uint16_t port) = 0;
+        /*!  @brief Whether the connection is (still) open. */
+        virtual bool connected() = 0;
+        /*!  @brief Writes `len` bytes. @return The number of bytes written. */
+        virtual size_t write(const uint8_t* data, size_t len) = 0;
+        /*!  @brief Reads up to `len` bytes, waiting at most `timeout` ms for the first one.
+             @return The number of bytes read, 0 on timeout or `TR064_TRANSPORT_CLOSED`. */
+        virtual int read(uint8_t* buf, size_t len, uint32_t timeout) = 0;
+        /*!  @brief Closes the connection. */
+        virtual void stop() = 0;
+        /*!  @brief Starts opening a connection without waiting for it, see `pollConnect()`.
+             The default implementation connects synchronously. @return false if it failed already. */
+        virtual bool beginConnect(const char* host, uint16_t port) { return connect(host, port); }
+        /*!  @brief Progress of `beginConnect()`. @return 1 if connected, 0 if pending, -1 if it failed. */
+        virtual int pollConnect() { return connected() ? 1 : -1; }
+};
+
+/**************************************************************************/
+/*!
+    @brief  Streaming source of bytes, e.g. the body of an HTTP response.
+*/
+/**************************************************************************/
+class TR064ByteSource {
+    public:
+        virtual ~TR064ByteSource() {}
+        /*!  @brief Reads up to `len` bytes.
+             @return The number of bytes read, 0 at the end of the data or a negative error code. */
+        virtual int read(uint8_t* buf, size_t len) = 0;
+};
+
+/**************************************************************************/
+/*!
+    @brief  Streaming sink for bytes, e.g. the body of an HTTP request.
+*/
+/**************************************************************************/
+class TR064ByteSink {
+    public:
+        virtual ~TR064ByteSink() {}
+        /*!  @brief Writes `len` bytes. @return success state. */
+        virtual bool write(const char* data, size_t len) = 0;
+};
+
+/**************************************************************************/
+/*!
+    @brief  Abstract server socket, accepting the connections of the device
+            to this one, e.g. the NOTIFY requests of event subscriptions
+            (see `TR064Events`). One accepted connection is handled at a
+            time.
+*/
+/**************************************************************************/
+class TR064Listener {
+    public:
+        virtual ~TR064Listener() {}
+        /*!  @brief Starts listening on `port` (0: any free port, if supported). @return success state. */
+        virtual bool begin(uint16_t port) = 0;
+        /*!  @brief The port listened on, 0 if not listening. */
+        virtual uint16_t port() const = 0;
+        /*!  @brief Takes the next pending connection without waiting. It replaces (and closes) the
+             previous one and stays valid until the next `accept()` or `end()`.
+             @return The connection or `nullptr` if none is pending. */
+        virtual TR064Transport* accept() = 0;
+        /*!  @brief Closes the accepted connection and stops listening. */
+        virtual void end() = 0;
+        /*!  @brief Writes the address (IP) under which `host` reaches this device into `buf`,
+             e.g. for callback URLs. @return success state. */
+        virtual bool localAddress(const char* host, char* buf, size_t len) = 0;
+};
+
+#if defined(ESP8266) || defined(ESP32)
+/**************************************************************************/
+/*!
+    @brief  Transport on top of any Arduino `Client` (e.g. `WiFiClient`).
+*/
+/**************************************************************************/
+class TR064ClientTransport : public TR064Transport {
+    public:
+        explicit TR064ClientTransport(Client& client);
+        bool connect(const char* host, uint16_t port) override;
+        bool connected() override;
+        size_t write(const uint8_t* data, size_t len) override;
+        int read(uint8_t* buf, size_t len, uint32_t timeout) override;
+        void stop() override;
+
+    protected:
+        Client& _client;
+};
+
+/**************************************************************************/
+/*!
+    @brief  Default transport on ESP8266/ESP32, owning its `WiFiClient`.
+            The `WiFiClient` cannot connect without waiting, so
+            `beginConnect()` waits as well, but at most for the connect
+            timeout (see `setConnectTimeout()`).
+*/
+/**************************************************************************/
+class TR064WiFiTransport : public TR064ClientTransport {
+    public:
+        TR064WiFiTransport() : TR064ClientTransport(_wifiClient), _connectTimeout(TR064_WIFI_CONNECT_TIMEOUT) {}
+        bool connect(const char* host, uint16_t port) override;
+        /*!  @brief Sets the longest wait (ms) for a new connection. */
+        void setConnectTimeout(uint32_t timeout) { _connectTimeout = timeout; }
+        /*!  @brief Takes over a connection, e.g. one accepted by a `WiFiServer`. */
+        void adopt(const WiFiClient& client) { _wifiClient.stop(); _wifiClient = client; }
+
+    private:
+        WiFiClient _wifiClient;
+        uint32_t _connectTimeout;
+};
+
+typedef TR064WiFiTransport TR064DefaultTransport; ///< Transport used if none is set explicitly
+
+/**************************************************************************/
+/*!
+    @brief  Default listener on ESP8266/ESP32, a `WiFiServer`.
+*/
+/**************************************************************************/
+class TR064WiFiListener : public TR064Listener {
+    public:
+        TR064WiFiListener() : _server(0), _port(0) {}
+        bool begin(uint16_t port) override;
+        uint16_t port() const override { return _port; }
+        TR064Transport* accept() override;
+        void end() override;
+        bool localAddress(const char* host, char* buf, size_t len) override;
+
+    private:
+        WiFiServer _server;
+        TR064WiFiTransport _connection;
+        uint16_t _port;
+};
+
+typedef TR064WiFiListener TR064DefaultListener; ///< Listener used if none is set explicitly
+
+#elif defined(TR064_NATIVE)
+/**************************************************************************/
+/*!
+    @brief  Transport on top of blocking POSIX sockets (native build).
+*/
+/**************************************************************************/
+class TR064PosixTransport : public TR064Transport {
+    public:
+        TR064PosixTransport();
+        ~TR064PosixTransport();
+        bool connect(const char* host, uint16_t port) override;
+        bool connected() override;
+        size_t write(const uint8_t* data, size_t len) override;
+        int read(uint8_t* buf, size_t len, uint32_t timeout) override;
+        void stop() override;
+        bool beginConnect(const char* host, uint16_t port) override;
+        int pollConnect() override;
+        void setConnectTimeout(uint32_t timeout) { _connectTimeout = timeout; }
+        void adopt(int fd);
+        /*!  @brief The socket of the connection, -1 if not connected. */
+        int fd() const { return _fd; }
+
+    private:
+        int _fd;
+        int _pendingFd;         // Socket of a connection in progress (`beginConnect()`)
+        int _pendingFlags;      // File status flags of `_pendingFd` before switching to non-blocking
+        uint32_t _connectTimeout;
+};
+
+typedef TR064PosixTransport TR064DefaultTransport; ///< Transport used if none is set explicitly
+
+/**************************************************************************/
+/*!
+    @brief  Listener on a non-blocking POSIX server socket (native build).
+*/
+/**************************************************************************/
+class TR064PosixListener : public TR064Listener {
+    public:
+        TR064PosixListener();
+        ~TR064PosixListener();
+        bool begin(uint16_t port) override;
+        uint16_t port() const override { return _port; }
+        TR064Transport* accept() override;
+        void end() override;
+        bool localAddress(const char* host, char* buf, size_t len) override;
+
+    private:
+        int _fd;
+        uint16_t _port;
+        TR064PosixTransport _connection;
+};
+
+typedef TR064PosixListener TR064DefaultListener; ///< Listener used if none is set explicitly
+
+#endif
+
+#endif
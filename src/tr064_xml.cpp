@@ -0,0 +1,324 @@
+/*!
+ * @file tr064_xml.cpp
+ *
+ * Streaming, allocation-free XML tokenizer for TR-064 responses.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#include "tr064_xml.h"
+#include "tr064_services.h"
+
+/**************************************************************************/
+/*!
+    @brief  Adds an element name to the set.
+    @param    name
+                The element name. It is not copied.
+    @return The key of the name (its index) or -1 if the set is full.
+*/
+/**************************************************************************/
+int TR064XmlKeys::add(const char* name) {
+    if (_count >= TR064_XML_MAX_KEYS) {
+        return -1;
+    }
+    size_t len = strlen(name);
+    Key& k = _keys[_count];
+    k.name = name;
+    k.len = len < 0xFF ? (uint8_t) len : 0xFF;
+    k.hash = tr064Hash(name, len);
+    if (len < 64) {
+        _lengths |= (uint64_t) 1 << len;
+    }
+    return _count++;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Adds a key that matches every element name not matched by
+            another key, e.g. to read elements whose names are not known in
+            advance (see `TR064XmlTokenizer::name()`).
+    @return The key or -1 if the set is full.
+*/
+/**************************************************************************/
+int TR064XmlKeys::addAny() {
+    if (_count >= TR064_XML_MAX_KEYS) {
+        return -1;
+    }
+    Key& k = _keys[_count];
+    k.name = "*";
+    k.len = 0;
+    k.hash = 0;
+    _any = (int8_t) _count;
+    return _count++;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Looks up an element name (case-insensitive).
+    @param    name
+                The element name (not zero-terminated).
+    @param    len
+                Its length.
+    @param    hash
+                Its hash (see `tr064Hash()`).
+    @return The key of the first matching name, otherwise the key of `addAny()` or -1.
+*/
+/**************************************************************************/
+int TR064XmlKeys::match(const char* name, size_t len, uint32_t hash) const {
+    if (len < 64 && !((_lengths >> len) & 1)) {
+        return _any;
+    }
+    for (uint8_t i = 0; i < _count; ++i) {
+        const Key& k = _keys[i];
+        if (k.len == len && k.hash == hash && strncasecmp(k.name, name, len) == 0) {
+            return i;
+        }
+    }
+    return _any;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Creates a tokenizer.
+    @param    keys
+                The element names to report. Must outlive the tokenizer.
+    @param    handler
+                Receives the text of matching elements.
+*/
+/**************************************************************************/
+TR064XmlTokenizer::TR064XmlTokenizer(const TR064XmlKeys& keys, TR064XmlHandler& handler)
+    : _keys(keys), _handler(handler) {
+    reset();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Prepares the tokenizer for a new document.
+*/
+/**************************************************************************/
+void TR064XmlTokenizer::reset() {
+    _state = TEXT;
+    _stopped = false;
+    _selfClosing = false;
+    _quote = 0;
+    _current = -1;
+    _tagKey = -1;
+    _hash = TR064_HASH_INIT;
+    _nameLen = 0;
+    _nameOverflow = false;
+    _entityLen = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Scans the next chunk of the document.
+    @param    data
+                The chunk.
+    @param    len
+                Length of the chunk.
+    @return false if the handler stopped the scan.
+*/
+/**************************************************************************/
+bool TR064XmlTokenizer::feed(const char* data, size_t len) {
+    const char* p = data;
+    const char* const end = data + len;
+    while (p < end && !_stopped) {
+        const char c = *p;
+        switch (_state) {
+        case TEXT: {
+            // Hand runs of plain text to the handler in one piece
+            const char* run = p;
+            while (p < end && *p != '<' && *p != '&') ++p;
+            if (_current >= 0 && p > run) {
+                _handler.onText(_current, run, p - run);
+            }
+            if (p < end) {
+                _state = *p == '<' ? TAG : ENTITY;
+                _entityLen = 0;
+                ++p;
+            }
+            continue;
+        }
+        case ENTITY:
+            if (c == ';') {
+                decodeEntity();
+                _state = TEXT;
+            } else if (c != '<' && c != '&' && _entityLen < sizeof(_entity) - 1) {
+                _entity[_entityLen++] = c;
+            } else {
+                // Not an entity after all, keep it as it is
+                if (_current >= 0) {
+                    _handler.onText(_current, "&", 1);
+                    _handler.onText(_current, _entity, _entityLen);
+                }
+                _state = TEXT;
+                continue;
+            }
+            break;
+        case TAG:
+            _current = -1;
+            _tagKey = -1;
+            _selfClosing = false;
+            _hash = TR064_HASH_INIT;
+            _nameLen = 0;
+            _nameOverflow = false;
+            if (c == '/') {
+                _state = END_NAME;
+            } else if (c == '?' || c == '!') {
+                // Processing instruction, declaration or comment
+                _state = SKIP;
+            } else {
+                _state = NAME;
+                continue;
+            }
+            break;
+        case NAME:
+        case END_NAME:
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '/' || c == '>') {
+                endName();
+                _state = _state == NAME ? ATTRIBUTES : END_TAG;
+                continue;
+            }
+            if (_nameLen < sizeof(_name)) {
+                _name[_nameLen++] = c;
+            } else {
+                _nameOverflow = true;
+            }
+            _hash = tr064HashStep(_hash, c);
+            break;
+        case ATTRIBUTES:
+            if (c == '"' || c == '\'') {
+                _quote = c;
+                _state = QUOTED;
+            } else if (c == '/') {
+                _selfClosing = true;
+            } else if (c == '>') {
+                _state = TEXT;
+                if (_tagKey >= 0) {
+                    _handler.onStart(_tagKey);
+                    if (!_selfClosing) {
+                        _current = _tagKey;
+                    } else if (!_handler.onEnd(_tagKey)) {
+                        _stopped = true;
+                    }
+                }
+            } else if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+                _selfClosing = false;
+            }
+            break;
+        case QUOTED:
+            if (c == _quote) {
+                _state = ATTRIBUTES;
+            }
+            break;
+        case END_TAG:
+            if (c == '>') {
+                _state = TEXT;
+                if (_tagKey >= 0 && !_handler.onEnd(_tagKey)) {
+                    _stopped = true;
+                }
+            }
+            break;
+        case SKIP:
+            if (c == '>') {
+                _state = TEXT;
+            }
+            break;
+        }
+        ++p;
+    }
+    return !_stopped;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads the whole source (or until the handler stops) and scans it.
+    @param    source
+                The source of the document, e.g. a `TR064HttpClient`.
+    @return `TR064_XML_END`, `TR064_XML_STOPPED` or the negative error of the source.
+*/
+/**************************************************************************/
+int TR064XmlTokenizer::scan(TR064ByteSource& source) {
+    char buf[TR064_XML_CHUNK];
+    while (true) {
+        int n = source.read((uint8_t*) buf, sizeof(buf));
+        if (n < 0) {
+            return n;
+        }
+        if (n == 0) {
+            return TR064_XML_END;
+        }
+        if (!feed(buf, (size_t) n)) {
+            return TR064_XML_STOPPED;
+        }
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Matches the element name just read against the keys.
+*/
+/**************************************************************************/
+void TR064XmlTokenizer::endName() {
+    _tagKey = _nameOverflow ? -1 : _keys.match(_name, _nameLen, _hash);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Decodes the entity in `_entity` and passes it on as text.
+*/
+/**************************************************************************/
+void TR064XmlTokenizer::decodeEntity() {
+    if (_current < 0) {
+        return;
+    }
+    _entity[_entityLen] = '\0';
+    char out[4];
+    size_t n = 1;
+    if (strcmp(_entity, "lt") == 0) {
+        out[0] = '<';
+    } else if (strcmp(_entity, "gt") == 0) {
+        out[0] = '>';
+    } else if (strcmp(_entity, "amp") == 0) {
+        out[0] = '&';
+    } else if (strcmp(_entity, "quot") == 0) {
+        out[0] = '"';
+    } else if (strcmp(_entity, "apos") == 0) {
+        out[0] = '\'';
+    } else if (_entity[0] == '#' && _entityLen > 1) {
+        char* end = nullptr;
+        unsigned long cp = _entity[1] == 'x' || _entity[1] == 'X'
+            ? strtoul(_entity + 2, &end, 16) : strtoul(_entity + 1, &end, 10);
+        if (*end != '\0' || cp > 0x10FFFF) {
+            n = 0;
+        } else if (cp < 0x80) {
+            out[0] = (char) cp;
+        } else if (cp < 0x800) {
+            out[0] = (char) (0xC0 | (cp >> 6));
+            out[1] = (char) (0x80 | (cp & 0x3F));
+            n = 2;
+        } else if (cp < 0x10000) {
+            out[0] = (char) (0xE0 | (cp >> 12));
+            out[1] = (char) (0x80 | ((cp >> 6) & 0x3F));
+            out[2] = (char) (0x80 | (cp & 0x3F));
+            n = 3;
+        } else {
+            out[0] = (char) (0xF0 | (cp >> 18));
+            out[1] = (char) (0x80 | ((cp >> 12) & 0x3F));
+            out[2] = (char) (0x80 | ((cp >> 6) & 0x3F));
+            out[3] = (char) (0x80 | (cp & 0x3F));
+            n = 4;
+        }
+    } else {
+        n = 0;
+    }
+    if (n > 0) {
+        _handler.onText(_current, out, n);
+    } else {
+        // Unknown entity, keep it as it is
+        _handler.onText(_current, "&", 1);
+        _handler.onText(_current, _entity, _entityLen);
+        _handler.onText(_current, ";", 1);
+    }
+}
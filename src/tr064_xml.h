@@ -0,0 +1,143 @@
+/*!
+ * @file tr064_xml.h
+ *
+ * Streaming, allocation-free XML tokenizer for TR-064 responses. It scans
+ * the data in chunks, matches element names against a precompiled set of
+ * keys and only hands the (entity-decoded) text of matching elements to a
+ * `TR064XmlHandler`.
+ *
+ * MIT License, all text here must be included in any redistribution.
+ *
+ */
+
+#ifndef tr064_xml_h
+#define tr064_xml_h
+
+#include "Arduino.h"
+#include "tr064_transport.h"
+
+#ifndef TR064_XML_MAX_KEYS
+#define TR064_XML_MAX_KEYS      32 ///< Maximal number of keys of a `TR064XmlKeys` set
+#endif
+#ifndef TR064_XML_MAX_NAME
+#define TR064_XML_MAX_NAME      48 ///< Longest element name that can be matched
+#endif
+#ifndef TR064_XML_CHUNK
+#define TR064_XML_CHUNK         128 ///< Size of the read buffer used by `TR064XmlTokenizer::scan()`
+#endif
+
+// Return values of `TR064XmlTokenizer::scan()` (or a negative error of the source)
+#define TR064_XML_END           0 ///< The whole input was scanned
+#define TR064_XML_STOPPED       1 ///< The handler stopped the scan early
+
+/**************************************************************************/
+/*!
+    @brief  Precompiled set of element names (case-insensitive). The names
+            are not copied and must stay valid while the set is in use.
+*/
+/**************************************************************************/
+class TR064XmlKeys {
+    public:
+        TR064XmlKeys() : _count(0), _lengths(0), _any(-1) {}
+        void clear() { _count = 0; _lengths = 0; _any = -1; }
+        int add(const char* name);
+        int addAny();
+        int match(const char* name, size_t len, uint32_t hash) const;
+        uint8_t size() const { return _count; }
+        const char* name(int key) const { return _keys[key].name; }
+
+    private:
+        struct Key {
+            const char* name;
+            uint32_t hash;
+            uint8_t len;
+        };
+        Key _keys[TR064_XML_MAX_KEYS];
+        uint8_t _count;
+        uint64_t _lengths;  // Bit n is set if a key of length n (< 64) exists
+        int8_t _any;        // Key matching all other names, -1 if none
+};
+
+/**************************************************************************/
+/*!
+    @brief  Receives the events of a `TR064XmlTokenizer` for elements that
+            match one of its keys.
+*/
+/**************************************************************************/
+class TR064XmlHandler {
+    public:
+        virtual ~TR064XmlHandler() {}
+        /*!  @brief Start tag of an element matching `key`. */
+        virtual void onStart(int key) { (void) key; }
+        /*!  @brief Decoded text of the element matching `key`, possibly in several pieces. */
+        virtual void onText(int key, const char* text, size_t len) = 0;
+        /*!  @brief End tag of an element matching `key`. @return false to stop scanning. */
+        virtual bool onEnd(int key) = 0;
+};
+
+/**************************************************************************/
+/*!
+    @brief  Chunked XML tokenizer. Data is pushed with `feed()` (or pulled
+            from a `TR064ByteSource` with `scan()`); no memory is allocated.
+            Processing instructions, comments and attributes are skipped.
+*/
+/**************************************************************************/
+class TR064XmlTokenizer {
+    public:
+        TR064XmlTokenizer(const TR064XmlKeys& keys, TR064XmlHandler& handler);
+        void reset();
+        bool feed(const char* data, size_t len);
+        int scan(TR064ByteSource& source);
+        /*!  @brief Name of the tag just read (not zero-terminated, see `nameLength()`),
+             valid in `TR064XmlHandler::onStart()` and `onEnd()`. */
+        const char* name() const { return _name; }
+        uint8_t nameLength() const { return _nameLen; }
+
+    private:
+        enum State { TEXT, ENTITY, TAG, NAME, ATTRIBUTES, QUOTED, END_NAME, END_TAG, SKIP };
+
+        void endName();
+        void decodeEntity();
+
+        const TR064XmlKeys& _keys;
+        TR064XmlHandler& _handler;
+        State _state;
+        bool _stopped;
+        bool _selfClosing;  // Last character in a tag was a '/'
+        char _quote;        // Quote character of the attribute value being skipped
+        int _current;       // Key of the element whose text is captured, -1 if none
+        int _tagKey;        // Key of the tag being parsed, -1 if none
+        uint32_t _hash;     // Hash of the element name being parsed
+        uint8_t _nameLen;
+        bool _nameOverflow;
+        char _name[TR064_XML_MAX_NAME];
+        uint8_t _entityLen;
+        char _entity[12];
+};
+
+/**************************************************************************/
+/*!
+    @brief  Fixed-size buffer collecting the text of an element. Longer
+            text is truncated (and flagged).
+*/
+/**************************************************************************/
+template<size_t N>
+struct TR064XmlText {
+    char text[N];       ///< Zero-terminated text
+    size_t len;         ///< Length of the text
+    bool truncated;     ///< Whether text was dropped
+
+    TR064XmlText() { clear(); }
+    void clear() { text[0] = '\0'; len = 0; truncated = false; }
+    void append(const char* s, size_t n) {
+        if (n > N - 1 - len) {
+            n = N - 1 - len;
+            truncated = true;
+        }
+        memcpy(text + len, s, n);
+        len += n;
+        text[len] = '\0';
+    }
+};
+
+#endif